@@ -0,0 +1,178 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+#include <tiny/cpu.h>
+#include <tiny/crypto/chacha20poly1305.h>
+#include <tiny/crypto/hmac.h>
+#include <tiny/time.h>
+#include "bench.h"
+
+using namespace tiny;
+using namespace tiny::crypto;
+
+static const double c_seconds = 1.0;
+// the mesh's media header: prefix, connection tag and nonce counter
+static const uint32_t c_headerSize = 13;
+
+// report the cost per packet of `packets' processed in `seconds'
+static void reportCost(const char* protection, const char* kernel, uint32_t size, uint64_t packets, double seconds)
+{
+	char name[64];
+	snprintf(name, sizeof(name), "aead.%s_%s_%u", protection, kernel, size);
+	bench::report(name, "ns_per_packet", seconds * 1e9 / static_cast<double>(packets), "ns");
+	bench::report(name, "throughput", static_cast<double>(packets) * size / seconds / 1e6, "MB/s");
+}
+
+// today's media protection: HMAC-SHA1 of the sender id, tag and payload,
+// one packet at a time as on the send path
+static void benchHmac(const char* kernel, uint32_t features, uint32_t size)
+{
+	cpuFeaturesRestrict(features);
+
+	static const uint8_t sessionKey[] = "bench session key";
+	hmac_sha1_key key;
+	hmac_sha1_key_init(&key, sessionKey, sizeof(sessionKey) - 1);
+
+	const uint64_t senderId = 0x0123456789ABCDEFull;
+	std::vector<uint8_t> packet(c_headerSize + size);
+	for (size_t ii = 0, nn = packet.size(); ii != nn; ++ii)
+	{
+		packet[ii] = static_cast<uint8_t>(ii * 131);
+	}
+
+	hmac_sha1_input input;
+	input.prefix = &senderId;
+	input.nprefix = sizeof(senderId);
+	input.p = &packet[1];
+	input.n = static_cast<uint32_t>(packet.size() - 1);
+
+	uint8_t mac[hmac_sha1_state::DIGEST_SIZE];
+	uint64_t packets = 0;
+	const uint64_t start = timestampCurrent();
+	while (bench::secondsSince(start) < c_seconds)
+	{
+		for (uint32_t ii = 0; ii < 256; ++ii)
+		{
+			hmac_sha1_batch(&key, &input, 1, &mac);
+			packet[1] ^= mac[0];
+		}
+		packets += 256;
+	}
+	reportCost("hmac_sha1", kernel, size, packets, bench::secondsSince(start));
+
+	cpuFeaturesRestrict(~0u);
+}
+
+// ChaCha20-Poly1305 seal and open of a packet with the mesh's header as
+// additional data
+static void benchAead(const char* kernel, uint32_t features, uint32_t size)
+{
+	cpuFeaturesRestrict(features);
+
+	uint8_t keyBytes[chacha20poly1305_key::KEY_SIZE];
+	for (uint32_t ii = 0; ii < sizeof(keyBytes); ++ii)
+	{
+		keyBytes[ii] = static_cast<uint8_t>(ii * 7);
+	}
+	chacha20poly1305_key key;
+	chacha20poly1305_key_init(&key, keyBytes);
+
+	std::vector<uint8_t> packet(c_headerSize + size + chacha20poly1305_key::TAG_SIZE);
+	for (size_t ii = 0, nn = packet.size(); ii != nn; ++ii)
+	{
+		packet[ii] = static_cast<uint8_t>(ii * 131);
+	}
+	uint8_t* header = packet.data();
+	uint8_t* payload = header + c_headerSize;
+	uint8_t* tag = payload + size;
+
+	uint8_t nonce[chacha20poly1305_key::NONCE_SIZE] = {};
+	uint64_t sealed = 0;
+	uint64_t start = timestampCurrent();
+	while (bench::secondsSince(start) < c_seconds)
+	{
+		for (uint32_t ii = 0; ii < 256; ++ii)
+		{
+			++nonce[4];
+			chacha20poly1305_seal(&key, nonce, header, c_headerSize, payload, payload, size, tag);
+		}
+		sealed += 256;
+	}
+	reportCost("seal", kernel, size, sealed, bench::secondsSince(start));
+
+	// open the same packet repeatedly; a failed tag would skip decryption
+	chacha20poly1305_seal(&key, nonce, header, c_headerSize, payload, payload, size, tag);
+	std::vector<uint8_t> plaintext(size);
+	uint64_t opened = 0;
+	uint64_t failed = 0;
+	start = timestampCurrent();
+	while (bench::secondsSince(start) < c_seconds)
+	{
+		for (uint32_t ii = 0; ii < 256; ++ii)
+		{
+			if (!chacha20poly1305_open(&key, nonce, header, c_headerSize, payload, plaintext.data(), size, tag))
+			{
+				++failed;
+			}
+		}
+		opened += 256;
+	}
+	reportCost("open", kernel, size, opened, bench::secondsSince(start));
+	if (failed)
+	{
+		fprintf(stderr, "aead: %llu packets failed to open\n", static_cast<unsigned long long>(failed));
+	}
+
+	cpuFeaturesRestrict(~0u);
+}
+
+static void benchKernel(const char* kernel, uint32_t features)
+{
+	// a 20 ms Opus frame at 24 and 64 kbit/s, and a full datagram
+	static const uint32_t c_sizes[] = { 60, 160, 1200 };
+	for (uint32_t ii = 0; ii < sizeof(c_sizes) / sizeof(c_sizes[0]); ++ii)
+	{
+		benchHmac(kernel, features, c_sizes[ii]);
+		benchAead(kernel, features, c_sizes[ii]);
+	}
+}
+
+int main()
+{
+	const uint32_t features = cpuFeatures();
+
+	benchKernel("scalar", 0);
+	if (features & CpuFeature::SSSE3)
+	{
+		benchKernel("ssse3", CpuFeature::SSE2 | CpuFeature::SSSE3);
+	}
+	if (features & CpuFeature::AVX2)
+	{
+		benchKernel("best", ~0u);
+	}
+}
@@ -0,0 +1,79 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TINY_BENCH__BENCH_H
+#define TINY_BENCH__BENCH_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+#include <tiny/net/resolve.h>
+#include <tiny/time.h>
+
+namespace bench
+{
+	// seconds elapsed since `start' (a value from `tiny::timestampCurrent')
+	static inline double secondsSince(uint64_t start)
+	{
+		return static_cast<double>(tiny::timestampCurrent() - start) / static_cast<double>(tiny::timestampFrequency());
+	}
+
+	// convert a timestamp delta to microseconds
+	static inline double toMicroseconds(uint64_t delta)
+	{
+		return static_cast<double>(delta) * 1000000.0 / static_cast<double>(tiny::timestampFrequency());
+	}
+
+	// `p'th percentile (0..1) of `samples'. reorders `samples'
+	static inline double percentile(std::vector<double>& samples, double p)
+	{
+		if (samples.empty())
+			return 0.0;
+
+		size_t index = static_cast<size_t>(p * static_cast<double>(samples.size() - 1) + 0.5);
+		std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+		return samples[index];
+	}
+
+	// parse a numeric host such as "10.0.0.1" for a simulated network
+	static inline tiny::net::Address numericAddress(const char* text)
+	{
+		tiny::net::Address addr;
+		tiny::net::resolveNumericHost(&addr, text);
+		return addr;
+	}
+
+	// emit a single result as a tab separated line:
+	//  <benchmark> <metric> <value> <unit>
+	static inline void report(const char* benchmark, const char* metric, double value, const char* unit)
+	{
+		printf("%s\t%s\t%.3f\t%s\n", benchmark, metric, value, unit);
+		fflush(stdout);
+	}
+}
+
+#endif // TINY_BENCH__BENCH_H
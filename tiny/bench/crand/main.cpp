@@ -0,0 +1,70 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+#include <tiny/crypto/rand.h>
+#include <tiny/time.h>
+#include "bench.h"
+
+using namespace tiny;
+using namespace tiny::crypto;
+
+static const double c_seconds = 1.0;
+
+// fill `size' byte requests for `c_seconds'
+static void benchSize(const char* name, uint32_t size)
+{
+	CryptoRandSource rand;
+	crandInit(&rand);
+
+	std::vector<uint8_t> out(size);
+	uint64_t calls = 0;
+	const uint64_t start = timestampCurrent();
+	while (bench::secondsSince(start) < c_seconds)
+	{
+		for (uint32_t ii = 0; ii < 256; ++ii)
+		{
+			crandFill(&rand, out.data(), size);
+		}
+		calls += 256;
+	}
+	const double seconds = bench::secondsSince(start);
+
+	bench::report(name, "calls_per_sec", static_cast<double>(calls) / seconds, "calls/s");
+	bench::report(name, "throughput", static_cast<double>(calls) * size / seconds / 1e6, "MB/s");
+
+	crandDestroy(&rand);
+}
+
+int main()
+{
+	// a tie-breaker, a STUN transaction id, a session key and bulk output
+	benchSize("crand.fill_8", 8);
+	benchSize("crand.fill_12", 12);
+	benchSize("crand.fill_32", 32);
+	benchSize("crand.fill_65536", 64 * 1024);
+}
@@ -0,0 +1,90 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+#include <tiny/cpu.h>
+#include <tiny/hash/crc32.h>
+#include <tiny/time.h>
+#include "bench.h"
+
+using namespace tiny;
+using namespace tiny::hash;
+
+static const double c_seconds = 1.0;
+
+// checksum `size' byte buffers for `c_seconds' on the implementation
+// selected by `features'
+static void benchSize(const char* kernel, uint32_t features, uint32_t size)
+{
+	cpuFeaturesRestrict(features);
+
+	std::vector<uint8_t> buffer(size);
+	for (uint32_t ii = 0; ii < size; ++ii)
+	{
+		buffer[ii] = static_cast<uint8_t>(ii * 131);
+	}
+
+	uint64_t summed = 0;
+	const uint64_t start = timestampCurrent();
+	while (bench::secondsSince(start) < c_seconds)
+	{
+		for (uint32_t ii = 0; ii < 64; ++ii)
+		{
+			crc32_state st;
+			crc32_begin(&st);
+			crc32_add(&st, buffer.data(), size);
+			buffer[0] ^= static_cast<uint8_t>(crc32_end(&st));
+		}
+		summed += 64;
+	}
+	const double seconds = bench::secondsSince(start);
+
+	char name[64];
+	snprintf(name, sizeof(name), "crc32.%s_%u", kernel, size);
+	bench::report(name, "throughput", static_cast<double>(summed) * size / seconds / 1e6, "MB/s");
+	bench::report(name, "buffers_per_sec", static_cast<double>(summed) / seconds, "buffers/s");
+
+	cpuFeaturesRestrict(~0u);
+}
+
+static void benchKernel(const char* kernel, uint32_t features)
+{
+	// a STUN request with FINGERPRINT, a full datagram and a chunk of a
+	// recorded voice log
+	benchSize(kernel, features, 80);
+	benchSize(kernel, features, 1500);
+	benchSize(kernel, features, 64 * 1024);
+}
+
+int main()
+{
+	benchKernel("slice8", 0);
+	if (cpuFeatures() & CpuFeature::PCLMUL)
+	{
+		benchKernel("pclmul", ~0u);
+	}
+}
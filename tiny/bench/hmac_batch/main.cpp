@@ -0,0 +1,159 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <tiny/cpu.h>
+#include <tiny/crypto/hmac.h>
+#include <tiny/time.h>
+#include "bench.h"
+
+using namespace tiny;
+using namespace tiny::crypto;
+
+// one receive batch: what the mesh reads from a socket per update
+static const uint32_t c_batchSize = 10;
+static const double c_seconds = 1.0;
+
+namespace
+{
+	struct Packets
+	{
+		std::vector<uint8_t> data;
+		std::vector<hmac_sha1_input> inputs;
+		uint64_t senderId;
+		uint32_t size;
+	};
+}
+
+static void packetsInit(Packets* packets, uint32_t size)
+{
+	packets->senderId = 0x0123456789ABCDEFull;
+	packets->size = size;
+	packets->data.resize(c_batchSize * size);
+	for (size_t ii = 0, nn = packets->data.size(); ii != nn; ++ii)
+	{
+		packets->data[ii] = static_cast<uint8_t>(ii * 131);
+	}
+
+	packets->inputs.resize(c_batchSize);
+	for (uint32_t ii = 0; ii < c_batchSize; ++ii)
+	{
+		hmac_sha1_input& input = packets->inputs[ii];
+		input.prefix = &packets->senderId;
+		input.nprefix = sizeof(packets->senderId);
+		input.p = &packets->data[ii * size];
+		input.n = size;
+	}
+}
+
+// the per-packet path the mesh used before batching, on the fastest
+// single stream SHA-1 the CPU supports
+static void benchScalar(const char* name, const Packets& packets, const uint8_t* key, uint32_t nkey)
+{
+	uint8_t digests[c_batchSize][hmac_sha1_state::DIGEST_SIZE];
+	uint64_t verified = 0;
+	const uint64_t start = timestampCurrent();
+	while (bench::secondsSince(start) < c_seconds)
+	{
+		for (uint32_t ii = 0; ii < c_batchSize; ++ii)
+		{
+			hmac_sha1_state st;
+			hmac_sha1_begin(&st, key, nkey);
+			hmac_sha1_add(&st, &packets.senderId, sizeof(packets.senderId));
+			hmac_sha1_add(&st, packets.inputs[ii].p, packets.size);
+			hmac_sha1_end(&st, digests[ii]);
+		}
+		verified += c_batchSize;
+	}
+
+	bench::report(name, "packets_per_sec", static_cast<double>(verified) / bench::secondsSince(start), "packets/s");
+}
+
+static void benchBatch(const char* name, const Packets& packets, const hmac_sha1_key& key, uint32_t features)
+{
+	cpuFeaturesRestrict(features);
+
+	uint8_t digests[c_batchSize][hmac_sha1_state::DIGEST_SIZE];
+	uint64_t verified = 0;
+	const uint64_t start = timestampCurrent();
+	while (bench::secondsSince(start) < c_seconds)
+	{
+		hmac_sha1_batch(&key, packets.inputs.data(), c_batchSize, digests);
+		verified += c_batchSize;
+	}
+
+	bench::report(name, "packets_per_sec", static_cast<double>(verified) / bench::secondsSince(start), "packets/s");
+	bench::report(name, "lanes", static_cast<double>(hmac_sha1_batch_width()), "lanes");
+
+	cpuFeaturesRestrict(~0u);
+}
+
+static void benchSize(uint32_t size)
+{
+	static const uint8_t key[] = "bench session key";
+
+	Packets packets;
+	packetsInit(&packets, size);
+
+	hmac_sha1_key macKey;
+	hmac_sha1_key_init(&macKey, key, sizeof(key));
+
+	char name[64];
+	snprintf(name, sizeof(name), "hmac_batch.scalar_%u", size);
+	benchScalar(name, packets, key, sizeof(key));
+
+	snprintf(name, sizeof(name), "hmac_batch.batch_scalar_%u", size);
+	benchBatch(name, packets, macKey, 0);
+
+	if (cpuFeatures() & CpuFeature::SSE2)
+	{
+		snprintf(name, sizeof(name), "hmac_batch.batch_sse2_%u", size);
+		benchBatch(name, packets, macKey, CpuFeature::SSE2);
+	}
+
+	if (cpuFeatures() & CpuFeature::AVX2)
+	{
+		snprintf(name, sizeof(name), "hmac_batch.batch_avx2_%u", size);
+		benchBatch(name, packets, macKey, CpuFeature::SSE2 | CpuFeature::AVX2);
+	}
+
+	// a single lane with the SHA extensions
+	if (cpuFeatures() & CpuFeature::SHA)
+	{
+		snprintf(name, sizeof(name), "hmac_batch.batch_sha_%u", size);
+		benchBatch(name, packets, macKey, ~0u);
+	}
+}
+
+int main()
+{
+	// a voice frame and a full datagram
+	benchSize(160);
+	benchSize(1200);
+}
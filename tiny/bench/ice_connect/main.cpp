@@ -0,0 +1,187 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+#include <tiny/net/engine.h>
+#include <tiny/peer/mesh.h>
+#include <tiny/platform.h>
+#include <tiny/time.h>
+#include "bench.h"
+
+using namespace tiny;
+using namespace tiny::net;
+using namespace tiny::peer;
+
+static const uint32_t c_trials = 50;
+static const double c_trialTimeoutSeconds = 10.0;
+
+namespace
+{
+	// platform socket engine that drops a fraction of outgoing datagrams
+	class LossyEngine : public ISocketEngine
+	{
+	public:
+		LossyEngine(double lossRate, uint32_t seed)
+			: inner(socketEngineCreatePlatform())
+			, threshold(static_cast<uint32_t>(lossRate * 4294967295.0))
+			, state(seed | 1)
+		{
+		}
+
+		virtual void release() { delete this; }
+		virtual SocketEngineType::E type() const { return inner->type(); }
+		virtual uint32_t adapters(Address* addresses, uint32_t naddresses) { return inner->adapters(addresses, naddresses); }
+		virtual IClock* clock() { return inner->clock(); }
+		virtual bool createUDP(Socket* out, const Address& addr, uint16_t* bePort) { return inner->createUDP(out, addr, bePort); }
+		virtual void close(Socket s) { inner->close(s); }
+		virtual uint32_t recvBatch(Socket s, Datagram* datagrams, uint32_t ndatagrams) { return inner->recvBatch(s, datagrams, ndatagrams); }
+		virtual bool operationWouldHaveBlocked() { return inner->operationWouldHaveBlocked(); }
+		virtual void sendBatchBegin() { inner->sendBatchBegin(); }
+		virtual void sendBatchEnd() { inner->sendBatchEnd(); }
+		virtual void wait(uint32_t timeoutMS) { inner->wait(timeoutMS); }
+		virtual void wake() { inner->wake(); }
+
+		virtual bool sendTo(Socket s, const ConstBuffer* buffers, uint32_t nbuffers, const PlatformSocketAddr& addr)
+		{
+			// xorshift32
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			if (state < threshold)
+				return true;
+
+			return inner->sendTo(s, buffers, nbuffers, addr);
+		}
+
+	private:
+		~LossyEngine()
+		{
+			inner->release();
+		}
+
+		ISocketEngine* const inner;
+		const uint32_t threshold;
+		uint32_t state;
+	};
+}
+
+static std::vector<uint8_t> localAddress(IMesh* m)
+{
+	std::vector<uint8_t> address(m->localAddressSize());
+	if (!address.empty())
+	{
+		m->serializeLocalAddress(address.data());
+	}
+	return address;
+}
+
+// seconds until two meshes on this host both report the other connected,
+// or a negative value on failure
+static double connectPair(double lossRate, uint32_t seed)
+{
+	static const uint8_t key[] = "bench session key";
+
+	IMesh* a = meshCreateICE(1, 1, 0, new LossyEngine(lossRate, seed));
+	IMesh* b = meshCreateICE(1, 2, 0, new LossyEngine(lossRate, seed * 31));
+	if (!a || !b)
+	{
+		if (a) a->destroy();
+		if (b) b->destroy();
+		return -1.0;
+	}
+
+	a->setSessionKey(key, sizeof(key));
+	b->setSessionKey(key, sizeof(key));
+	// host candidates only
+	const StunServer* noServers = nullptr;
+	a->startSession(noServers, 0);
+	b->startSession(noServers, 0);
+
+	const uint64_t start = timestampCurrent();
+
+	const std::vector<uint8_t> addrA = localAddress(a);
+	const std::vector<uint8_t> addrB = localAddress(b);
+	const uint32_t peerB = a->connectToPeer(2, addrB.data(), static_cast<uint32_t>(addrB.size()));
+	const uint32_t peerA = b->connectToPeer(1, addrA.data(), static_cast<uint32_t>(addrA.size()));
+
+	double elapsed = -1.0;
+	while (peerA != InvalidMeshPeer && peerB != InvalidMeshPeer)
+	{
+		a->update();
+		b->update();
+
+		const PeerState::E stateA = b->peerState(peerA);
+		const PeerState::E stateB = a->peerState(peerB);
+		if (stateA == PeerState::Connected && stateB == PeerState::Connected)
+		{
+			elapsed = bench::secondsSince(start);
+			break;
+		}
+		if (stateA == PeerState::Invalid || stateB == PeerState::Invalid || bench::secondsSince(start) > c_trialTimeoutSeconds)
+		{
+			break;
+		}
+	}
+
+	a->destroy();
+	b->destroy();
+	return elapsed;
+}
+
+static void benchLoss(const char* name, double lossRate)
+{
+	std::vector<double> samples;
+	uint32_t failures = 0;
+	for (uint32_t ii = 0; ii < c_trials; ++ii)
+	{
+		const double t = connectPair(lossRate, 0x9E3779B9u * (ii + 1));
+		if (t < 0.0)
+		{
+			++failures;
+			continue;
+		}
+
+		samples.push_back(t * 1000.0);
+	}
+
+	bench::report(name, "connect_p50", bench::percentile(samples, 0.50), "ms");
+	bench::report(name, "connect_p95", bench::percentile(samples, 0.95), "ms");
+	bench::report(name, "failures", static_cast<double>(failures), "trials");
+}
+
+int main()
+{
+	if (!platformStartup())
+		return -1;
+
+	benchLoss("ice_connect.loss_0", 0.0);
+	benchLoss("ice_connect.loss_5", 0.05);
+	benchLoss("ice_connect.loss_20", 0.20);
+
+	platformShutdown();
+}
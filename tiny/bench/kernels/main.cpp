@@ -0,0 +1,488 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <opus.h>
+#include <webrtc/modules/audio_processing/include/audio_processing.h>
+#include <tiny/audio/resample.h>
+#include <tiny/crypto/hmac.h>
+#include <tiny/crypto/rand.h>
+#include <tiny/crypto/sha1.h>
+#include <tiny/hash/crc32.h>
+#include <tiny/hash/fnv.h>
+#include <tiny/hash/murmur3.h>
+#include <tiny/net/engine.h>
+#include <tiny/net/packet.h>
+#include <tiny/net/resolve.h>
+#include <tiny/peer/mesh.h>
+#include <tiny/peer/message.h>
+#include <tiny/platform.h>
+#include <tiny/time.h>
+#include "peer/ice/candidate.h"
+#include "peer/ice/priority.h"
+#include "peer/ice/stun.h"
+#include "bench.h"
+
+using namespace tiny;
+using namespace tiny::audio;
+using namespace tiny::crypto;
+using namespace tiny::hash;
+using namespace tiny::net;
+using namespace tiny::peer;
+
+// time spent on each measurement
+static const double c_seconds = 0.5;
+static const uint32_t c_sizes[] = {64, 1200};
+static const int c_sampleRate = 48000;
+static const int c_samplesPer10ms = c_sampleRate / 100;
+static const double c_pi = 3.14159265358979323846;
+// datagrams sent per mesh update, and their size
+static const uint32_t c_meshBurst = 32;
+static const uint32_t c_meshPayload = 200;
+
+// results of benchmarked operations are folded into this so they can't
+// be optimized away
+static volatile uint32_t s_sink;
+
+// run `op' in batches of `batch' for `c_seconds'. returns the number of
+// operations per second
+template<typename F>
+static double opsPerSecond(uint32_t batch, F op)
+{
+	uint32_t sink = 0;
+	uint64_t ops = 0;
+	const uint64_t start = timestampCurrent();
+	do
+	{
+		for (uint32_t ii = 0; ii < batch; ++ii)
+		{
+			sink += op();
+		}
+		ops += batch;
+	} while (bench::secondsSince(start) < c_seconds);
+
+	const double seconds = bench::secondsSince(start);
+	s_sink += sink;
+	return static_cast<double>(ops) / seconds;
+}
+
+static void reportBytes(const char* kernel, uint32_t size, double opsPerSec)
+{
+	char name[64];
+	snprintf(name, sizeof(name), "kernels.%s_%u", kernel, size);
+	bench::report(name, "throughput", opsPerSec * size / 1e6, "MB/s");
+	bench::report(name, "ns_per_op", 1e9 / opsPerSec, "ns");
+}
+
+// 10ms frames of a voiced test signal: harmonics of 150Hz
+static std::vector<float> voiceFrames(int frames, int sampleRate)
+{
+	std::vector<float> samples(static_cast<size_t>(frames) * sampleRate / 100);
+	for (size_t ii = 0, nn = samples.size(); ii != nn; ++ii)
+	{
+		const double t = static_cast<double>(ii) / sampleRate;
+		double s = 0.0;
+		for (int k = 1; k <= 10; ++k)
+		{
+			s += sin(2.0 * c_pi * 150.0 * k * t) / k;
+		}
+		samples[ii] = static_cast<float>(0.1 * s * (0.75 + 0.25 * sin(2.0 * c_pi * 4.0 * t)));
+	}
+	return samples;
+}
+
+static void benchHashes()
+{
+	static const uint8_t key[] = "bench session key";
+
+	for (size_t ss = 0; ss < sizeof(c_sizes)/sizeof(c_sizes[0]); ++ss)
+	{
+		const uint32_t size = c_sizes[ss];
+		std::vector<uint8_t> data(size);
+		for (uint32_t ii = 0; ii < size; ++ii)
+		{
+			data[ii] = static_cast<uint8_t>(ii * 7 + 1);
+		}
+		const uint8_t* p = data.data();
+
+		reportBytes("sha1", size, opsPerSecond(64, [&]() {
+			sha1_state st;
+			uint8_t digest[sha1_state::DIGEST_SIZE];
+			sha1_begin(&st);
+			sha1_add(&st, p, size);
+			sha1_end(&st, digest);
+			return static_cast<uint32_t>(digest[0]);
+		}));
+
+		reportBytes("hmac_sha1", size, opsPerSecond(64, [&]() {
+			hmac_sha1_state st;
+			uint8_t digest[hmac_sha1_state::DIGEST_SIZE];
+			hmac_sha1_begin(&st, key, sizeof(key));
+			hmac_sha1_add(&st, p, size);
+			hmac_sha1_end(&st, digest);
+			return static_cast<uint32_t>(digest[0]);
+		}));
+
+		reportBytes("crc32", size, opsPerSecond(256, [&]() {
+			crc32_state st;
+			crc32_begin(&st);
+			crc32_add(&st, p, size);
+			return crc32_end(&st);
+		}));
+
+		reportBytes("murmur3_x86_32", size, opsPerSecond(256, [&]() {
+			murmur3_state st;
+			murmur3_begin(&st);
+			murmur3_add(&st, p, size);
+			return murmur3_end(&st);
+		}));
+
+		reportBytes("murmur3_x64_128", size, opsPerSecond(256, [&]() {
+			return static_cast<uint32_t>(murmur3_x64_128(p, size).h1);
+		}));
+
+		reportBytes("fnv1a", size, opsPerSecond(256, [&]() {
+			return fnv1a(p, size);
+		}));
+	}
+}
+
+// resample 10ms frames from `inRate' to `outRate' with every channel layout
+static void benchResample(int inRate, int outRate)
+{
+	resample::Linear resampler(inRate, outRate);
+	const int nin = inRate / 100;
+	const int nout = resampler.outputSamples(nin);
+
+	const std::vector<float> mono = voiceFrames(1, inRate);
+	std::vector<float> stereo(2 * nin);
+	for (int ii = 0; ii < nin; ++ii)
+	{
+		stereo[2*ii] = mono[ii];
+		stereo[2*ii + 1] = -mono[ii];
+	}
+	std::vector<float> out(2 * nout);
+
+	struct Variant
+	{
+		const char* name;
+		void (resample::Linear::*fn)(const float*, int, float*, int);
+		const float* in;
+	};
+	const Variant variants[] = {
+		{"mono", &resample::Linear::resampleMono, mono.data()},
+		{"stereo_to_mono", &resample::Linear::resampleStereoToMono, stereo.data()},
+		{"mono_to_stereo", &resample::Linear::resampleMonoToStereo, mono.data()},
+		{"stereo", &resample::Linear::resampleStereo, stereo.data()},
+	};
+
+	for (size_t vv = 0; vv < sizeof(variants)/sizeof(variants[0]); ++vv)
+	{
+		const Variant& v = variants[vv];
+		const double frames = opsPerSecond(64, [&]() {
+			(resampler.*v.fn)(v.in, nin, out.data(), nout);
+			return static_cast<uint32_t>(out[0] != 0.0f);
+		});
+
+		char name[64];
+		snprintf(name, sizeof(name), "kernels.resample_%s_%d_%d", v.name, inRate, outRate);
+		bench::report(name, "samples_per_sec", frames * nout, "samples/s");
+		bench::report(name, "ns_per_10ms", 1e9 / frames, "ns");
+	}
+}
+
+// encode and decode 10ms frames at 48kHz mono with the engine's settings
+static void benchOpus(int complexity)
+{
+	static const int c_frames = 100;
+	const std::vector<float> pcm = voiceFrames(c_frames, c_sampleRate);
+
+	int error;
+	OpusEncoder* encoder = opus_encoder_create(c_sampleRate, 1, OPUS_APPLICATION_VOIP, &error);
+	OpusDecoder* decoder = opus_decoder_create(c_sampleRate, 1, &error);
+	if (!encoder || !decoder)
+	{
+		fprintf(stderr, "opus: failed to create codec\n");
+		return;
+	}
+	opus_encoder_ctl(encoder, OPUS_SET_COMPLEXITY(complexity));
+
+	std::vector<std::vector<uint8_t> > packets(c_frames);
+	uint8_t packet[1500];
+	int frame = 0;
+	const double encoded = opsPerSecond(c_frames, [&]() {
+		const int n = opus_encode_float(encoder, pcm.data() + frame * c_samplesPer10ms, c_samplesPer10ms, packet, sizeof(packet));
+		if (n > 0 && packets[frame].empty())
+		{
+			packets[frame].assign(packet, packet + n);
+		}
+		frame = (frame + 1) % c_frames;
+		return static_cast<uint32_t>(n);
+	});
+
+	float out[c_samplesPer10ms];
+	frame = 0;
+	const double decoded = opsPerSecond(c_frames, [&]() {
+		const std::vector<uint8_t>& p = packets[frame];
+		frame = (frame + 1) % c_frames;
+		return static_cast<uint32_t>(opus_decode_float(decoder, p.empty() ? nullptr : p.data(), static_cast<opus_int32>(p.size()), out, c_samplesPer10ms, 0));
+	});
+
+	char name[64];
+	snprintf(name, sizeof(name), "kernels.opus_encode_c%d", complexity);
+	bench::report(name, "frames_per_sec", encoded, "frames/s");
+	bench::report(name, "realtime", encoded / 100.0, "x");
+	snprintf(name, sizeof(name), "kernels.opus_decode_c%d", complexity);
+	bench::report(name, "frames_per_sec", decoded, "frames/s");
+	bench::report(name, "realtime", decoded / 100.0, "x");
+
+	opus_encoder_destroy(encoder);
+	opus_decoder_destroy(decoder);
+}
+
+// `AudioProcessing::ProcessStream' configured as `voice::Engine' does
+static void benchProcessStream()
+{
+	static const int c_frames = 100;
+	const std::vector<float> pcm = voiceFrames(c_frames, c_sampleRate);
+
+	webrtc::AudioProcessing* processor = webrtc::AudioProcessing::Create();
+	processor->high_pass_filter()->Enable(true);
+	processor->echo_cancellation()->enable_drift_compensation(false);
+	processor->echo_cancellation()->Enable(false);
+	processor->noise_suppression()->set_level(webrtc::NoiseSuppression::kHigh);
+	processor->noise_suppression()->Enable(true);
+	processor->gain_control()->set_analog_level_limits(0, 255);
+	processor->gain_control()->set_mode(webrtc::GainControl::kAdaptiveAnalog);
+	processor->gain_control()->Enable(true);
+	processor->voice_detection()->Enable(true);
+
+	float out[c_samplesPer10ms];
+	int frame = 0;
+	const double frames = opsPerSecond(c_frames, [&]() {
+		const float* in = pcm.data() + frame * c_samplesPer10ms;
+		float* outs[1] = {out};
+		frame = (frame + 1) % c_frames;
+		return static_cast<uint32_t>(processor->ProcessStream(&in, webrtc::StreamConfig(c_sampleRate, 1, false), webrtc::StreamConfig(c_sampleRate, 1, false), outs));
+	});
+
+	bench::report("kernels.apm_process_stream", "frames_per_sec", frames, "frames/s");
+	bench::report("kernels.apm_process_stream", "realtime", frames / 100.0, "x");
+
+	delete processor;
+}
+
+// connectivity check requests as the ICE mesh builds and verifies them
+static void benchStun()
+{
+	static const uint8_t key[] = "bench session key";
+
+	CryptoRandSource rand;
+	crandInit(&rand);
+
+	uint8_t request[128];
+	uint32_t nrequest = 0;
+	const double generated = opsPerSecond(256, [&]() {
+		uint8_t* attr = stunGenerateBindingRequest(rand, request, 76);
+		attr = stunAppendUsernameAttribute20(attr, 1, 2);
+		attr = stunAppendICEControlAttribute12(attr, true, 1);
+		attr = stunAppendICEPriorityAttribute8(attr, 0x6E0001FF);
+		attr = stunAppendICEUseCandidateAttribute4(attr);
+		attr = stunAppendMessageIntegrityAttribute24(attr, request, key, sizeof(key));
+		attr = stunAppendFingerprint8(attr, request);
+		nrequest = static_cast<uint32_t>(attr - request);
+		return nrequest;
+	});
+
+	const double parsed = opsPerSecond(256, [&]() {
+		StunBindingRequest req;
+		memset(&req, 0, sizeof(req));
+		req.hmacKey = key;
+		req.nhmacKey = sizeof(key);
+		return static_cast<uint32_t>(stunIsBindingRequest(request, static_cast<int>(nrequest)) && stunProcessBindingRequest(&req, request, nrequest));
+	});
+
+	Address addr;
+	resolveNumericHost(&addr, "203.0.113.7");
+	uint8_t response[c_stunServerResponseMaxSize];
+	const double served = opsPerSecond(256, [&]() {
+		return stunGenerateServerResponse(response, request, nrequest, addr, 0x3412);
+	});
+
+	crandDestroy(&rand);
+
+	bench::report("kernels.stun_check_generate", "ops_per_sec", generated, "requests/s");
+	bench::report("kernels.stun_check_verify", "ops_per_sec", parsed, "requests/s");
+	bench::report("kernels.stun_server_response", "ops_per_sec", served, "responses/s");
+}
+
+static void benchCandidates()
+{
+	static const char* const hosts[] = {"192.168.1.20", "2001:db8::1:20"};
+	static const char* const names[] = {"kernels.candidate_ipv4", "kernels.candidate_ipv6"};
+
+	for (int ii = 0; ii < 2; ++ii)
+	{
+		Candidate c;
+		memset(&c, 0, sizeof(c));
+		resolveNumericHost(&c.address, hosts[ii]);
+		c.port = 0x3412;
+		c.priority = priorityForHostAddress(c.address);
+		c.foundation = 0x12345678;
+
+		uint8_t encoded[64];
+		uint32_t nencoded = 0;
+		const double encodes = opsPerSecond(1024, [&]() {
+			nencoded = static_cast<uint32_t>(candidatesEncode(encoded, c) - encoded);
+			return nencoded;
+		});
+
+		const double decodes = opsPerSecond(1024, [&]() {
+			Candidate out;
+			return candidateDecode(&out, encoded, nencoded);
+		});
+
+		bench::report(names[ii], "encodes_per_sec", encodes, "candidates/s");
+		bench::report(names[ii], "decodes_per_sec", decodes, "candidates/s");
+	}
+}
+
+static std::vector<uint8_t> localAddress(IMesh* m)
+{
+	std::vector<uint8_t> address(m->localAddressSize());
+	if (!address.empty())
+	{
+		m->serializeLocalAddress(address.data());
+	}
+	return address;
+}
+
+// media between two meshes on this host. each round sends a burst from
+// one mesh and collects it on the other
+static void benchMesh(const char* name, bool encrypt)
+{
+	static const uint8_t key[] = "bench session key";
+
+	IMesh* a = meshCreateICE(1, 1, 0);
+	IMesh* b = meshCreateICE(1, 2, 0);
+	if (!a || !b)
+	{
+		fprintf(stderr, "%s: failed to create meshes\n", name);
+		return;
+	}
+
+	a->setSessionKey(key, sizeof(key));
+	b->setSessionKey(key, sizeof(key));
+	a->setMediaEncryption(encrypt);
+	b->setMediaEncryption(encrypt);
+	// host candidates only
+	const StunServer* noServers = nullptr;
+	a->startSession(noServers, 0);
+	b->startSession(noServers, 0);
+
+	const std::vector<uint8_t> addrA = localAddress(a);
+	const std::vector<uint8_t> addrB = localAddress(b);
+	const uint32_t peerB = a->connectToPeer(2, addrB.data(), static_cast<uint32_t>(addrB.size()));
+	const uint32_t peerA = b->connectToPeer(1, addrA.data(), static_cast<uint32_t>(addrA.size()));
+
+	const uint64_t connectStart = timestampCurrent();
+	while (a->peerState(peerB) != PeerState::Connected || b->peerState(peerA) != PeerState::Connected)
+	{
+		a->update();
+		b->update();
+		if (bench::secondsSince(connectStart) > 10.0)
+		{
+			fprintf(stderr, "%s: meshes failed to connect\n", name);
+			a->destroy();
+			b->destroy();
+			return;
+		}
+	}
+
+	// the mesh frames the packet in place and leaves the payload alone,
+	// so one packet serves the whole run
+	std::vector<uint8_t> storage(a->packetHeadroom() + c_meshPayload + a->packetTailroom());
+	PacketBuffer packet;
+	packetInit(&packet, storage.data(), static_cast<uint32_t>(storage.size()), a->packetHeadroom(), a->packetTailroom());
+	memset(packetEnd(packet), 0x5A, c_meshPayload);
+	packetCommit(&packet, c_meshPayload);
+
+	uint64_t sent = 0;
+	uint64_t received = 0;
+	const uint64_t start = timestampCurrent();
+	while (bench::secondsSince(start) < c_seconds)
+	{
+		for (uint32_t ii = 0; ii < c_meshBurst; ++ii)
+		{
+			a->sendUnreliablePacketToPeer(peerB, &packet);
+		}
+		a->update();
+		sent += c_meshBurst;
+
+		b->update();
+		Message** messages;
+		uint32_t nmessages;
+		if (b->receive(peerA, &messages, &nmessages))
+		{
+			received += nmessages;
+		}
+	}
+	const double seconds = bench::secondsSince(start);
+
+	a->destroy();
+	b->destroy();
+
+	bench::report(name, "sent_pps", static_cast<double>(sent) / seconds, "packets/s");
+	bench::report(name, "received_pps", static_cast<double>(received) / seconds, "packets/s");
+	bench::report(name, "delivered", sent ? 100.0 * static_cast<double>(received) / static_cast<double>(sent) : 0.0, "%");
+}
+
+int main()
+{
+	if (!platformStartup())
+		return -1;
+
+	benchHashes();
+
+	benchResample(48000, 44100);
+	benchResample(16000, 48000);
+
+	benchOpus(0);
+	benchOpus(5);
+	benchOpus(10);
+	benchProcessStream();
+
+	benchStun();
+	benchCandidates();
+
+	benchMesh("kernels.mesh_loopback", false);
+	benchMesh("kernels.mesh_loopback_encrypted", true);
+
+	platformShutdown();
+}
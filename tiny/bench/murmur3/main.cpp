@@ -0,0 +1,165 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+#include <tiny/hash/fnv.h>
+#include <tiny/hash/murmur3.h>
+#include <tiny/time.h>
+#include "bench.h"
+
+using namespace tiny;
+using namespace tiny::hash;
+
+static const double c_seconds = 1.0;
+// keys hashed per timed iteration, e.g. the sources of a receive batch
+static const uint32_t c_keys = 256;
+// room for a `PlatformSocketAddr'
+static const uint32_t c_keyStride = 32;
+
+static void fillKeys(std::vector<uint8_t>* keys)
+{
+	for (size_t ii = 0, nn = keys->size(); ii != nn; ++ii)
+	{
+		(*keys)[ii] = static_cast<uint8_t>(ii * 131 + (ii >> 8));
+	}
+}
+
+// run `hash' over `c_keys' keys per iteration for `c_seconds'
+template<typename F>
+static void benchKeys(const char* name, uint32_t keySize, F hash)
+{
+	std::vector<uint8_t> keys(c_keys * c_keyStride);
+	fillKeys(&keys);
+
+	uint64_t sink = 0;
+	uint64_t hashed = 0;
+	const uint64_t start = timestampCurrent();
+	while (bench::secondsSince(start) < c_seconds)
+	{
+		sink += hash(keys.data());
+		keys[0] ^= static_cast<uint8_t>(sink);
+		hashed += c_keys;
+	}
+	const double seconds = bench::secondsSince(start);
+
+	char label[64];
+	snprintf(label, sizeof(label), "murmur3.%s_%u", name, keySize);
+	bench::report(label, "keys_per_sec", static_cast<double>(hashed) / seconds, "keys/s");
+	bench::report(label, "ns_per_key", seconds * 1e9 / static_cast<double>(hashed), "ns");
+}
+
+template<uint32_t N>
+static void benchKeySize()
+{
+	benchKeys("fnv1a", N, [](const uint8_t* keys) {
+		uint64_t sum = 0;
+		for (uint32_t ii = 0; ii < c_keys; ++ii)
+			sum += fnv1a(keys + ii*c_keyStride, N);
+		return sum;
+	});
+	benchKeys("x86_32", N, [](const uint8_t* keys) {
+		uint64_t sum = 0;
+		for (uint32_t ii = 0; ii < c_keys; ++ii)
+		{
+			murmur3_state st;
+			murmur3_begin(&st);
+			murmur3_add(&st, keys + ii*c_keyStride, N);
+			sum += murmur3_end(&st);
+		}
+		return sum;
+	});
+	benchKeys("x64_128", N, [](const uint8_t* keys) {
+		uint64_t sum = 0;
+		for (uint32_t ii = 0; ii < c_keys; ++ii)
+			sum += murmur3_x64_128(keys + ii*c_keyStride, N).h1;
+		return sum;
+	});
+	benchKeys("x64_128_fixed", N, [](const uint8_t* keys) {
+		uint64_t sum = 0;
+		for (uint32_t ii = 0; ii < c_keys; ++ii)
+			sum += murmur3_x64_128_fixed<N>(keys + ii*c_keyStride).h1;
+		return sum;
+	});
+	benchKeys("x64_128_batch", N, [](const uint8_t* keys) {
+		murmur3_128 out[c_keys];
+		murmur3_x64_128_batch(keys, N, c_keyStride, c_keys, out);
+		uint64_t sum = 0;
+		for (uint32_t ii = 0; ii < c_keys; ++ii)
+			sum += out[ii].h1;
+		return sum;
+	});
+}
+
+// hash `size' byte buffers, e.g. recorded packets
+static void benchBulk(const char* name, uint32_t size, uint64_t (*hash)(const uint8_t*, uint32_t))
+{
+	std::vector<uint8_t> buffer(size);
+	fillKeys(&buffer);
+
+	uint64_t sink = 0;
+	uint64_t hashed = 0;
+	const uint64_t start = timestampCurrent();
+	while (bench::secondsSince(start) < c_seconds)
+	{
+		for (uint32_t ii = 0; ii < 16; ++ii)
+		{
+			sink += hash(buffer.data(), size);
+			buffer[0] ^= static_cast<uint8_t>(sink);
+		}
+		hashed += 16;
+	}
+	const double seconds = bench::secondsSince(start);
+
+	char label[64];
+	snprintf(label, sizeof(label), "murmur3.%s_%u", name, size);
+	bench::report(label, "throughput", static_cast<double>(hashed) * size / seconds / 1e6, "MB/s");
+}
+
+static uint64_t hashX86_32(const uint8_t* p, uint32_t n)
+{
+	murmur3_state st;
+	murmur3_begin(&st);
+	murmur3_add(&st, p, n);
+	return murmur3_end(&st);
+}
+
+static uint64_t hashX64_128(const uint8_t* p, uint32_t n)
+{
+	return murmur3_x64_128(p, n).h1;
+}
+
+int main()
+{
+	// IPv4 and IPv6 socket addresses
+	benchKeySize<16>();
+	benchKeySize<28>();
+
+	benchBulk("x86_32", 1500, hashX86_32);
+	benchBulk("x64_128", 1500, hashX64_128);
+	benchBulk("x86_32", 64 * 1024, hashX86_32);
+	benchBulk("x64_128", 64 * 1024, hashX64_128);
+}
@@ -0,0 +1,281 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <tiny/net/adapter.h>
+#include <tiny/net/address.h>
+#include <tiny/peer/mesh.h>
+#include <tiny/peer/message.h>
+#include <tiny/peer/relayserver.h>
+#include <tiny/peer/stats.h>
+#include <tiny/platform.h>
+#include <tiny/time.h>
+#include "bench.h"
+
+using namespace tiny;
+using namespace tiny::net;
+using namespace tiny::peer;
+
+static const uint32_t c_trials = 20;
+static const uint32_t c_pings = 2000;
+static const double c_trialTimeoutSeconds = 10.0;
+static const uint8_t c_relayKey[] = "bench relay key";
+static const uint8_t c_sessionKey[] = "bench session key";
+
+// meshes only use host candidates on real adapters, so the relay is
+// served on the first non-loopback IPv4 address of this host
+static bool hostAddress(Address* out)
+{
+	std::vector<Address> addresses(enumerateAdapters(nullptr, 0));
+	addresses.resize(enumerateAdapters(addresses.data(), static_cast<uint32_t>(addresses.size())));
+	for (size_t ii = 0, nn = addresses.size(); ii != nn; ++ii)
+	{
+		if (addresses[ii].family == AddressFamily::IPv4 && !addressIsLoopback(addresses[ii].u.v4))
+		{
+			*out = addresses[ii];
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static std::vector<uint8_t> localAddress(IMesh* m)
+{
+	std::vector<uint8_t> address(m->localAddressSize());
+	if (!address.empty())
+	{
+		m->serializeLocalAddress(address.data());
+	}
+	return address;
+}
+
+// create a relay-only mesh and wait for its allocation
+static IMesh* createMesh(uint64_t id, const char* relayHost, uint16_t relayPort)
+{
+	IMesh* m = meshCreateICE(1, id, 0, nullptr);
+	if (!m)
+		return nullptr;
+
+	m->setSessionKey(c_sessionKey, sizeof(c_sessionKey));
+	m->setRelayServer(relayHost, relayPort, c_relayKey, sizeof(c_relayKey), true);
+
+	const StunServer* noServers = nullptr;
+	m->startSession(noServers, 0);
+
+	const uint64_t start = timestampCurrent();
+	while (m->update() == MeshState::Starting)
+	{
+		if (bench::secondsSince(start) > c_trialTimeoutSeconds)
+		{
+			m->destroy();
+			return nullptr;
+		}
+	}
+
+	return m;
+}
+
+struct Pair
+{
+	IMesh* a;
+	IMesh* b;
+	uint32_t peerA; // `a' as seen from `b'
+	uint32_t peerB; // `b' as seen from `a'
+};
+
+// seconds until both meshes are connected through the relay, or a
+// negative value on failure
+static double connectPair(Pair* pair, const char* relayHost, uint16_t relayPort)
+{
+	pair->a = createMesh(1, relayHost, relayPort);
+	pair->b = createMesh(2, relayHost, relayPort);
+	if (!pair->a || !pair->b)
+		return -1.0;
+
+	const uint64_t start = timestampCurrent();
+
+	const std::vector<uint8_t> addrA = localAddress(pair->a);
+	const std::vector<uint8_t> addrB = localAddress(pair->b);
+	pair->peerB = pair->a->connectToPeer(2, addrB.data(), static_cast<uint32_t>(addrB.size()));
+	pair->peerA = pair->b->connectToPeer(1, addrA.data(), static_cast<uint32_t>(addrA.size()));
+
+	while (pair->peerA != InvalidMeshPeer && pair->peerB != InvalidMeshPeer)
+	{
+		pair->a->update();
+		pair->b->update();
+
+		const PeerState::E stateA = pair->b->peerState(pair->peerA);
+		const PeerState::E stateB = pair->a->peerState(pair->peerB);
+		if (stateA == PeerState::Connected && stateB == PeerState::Connected)
+			return bench::secondsSince(start);
+
+		if (stateA == PeerState::Invalid || stateB == PeerState::Invalid || bench::secondsSince(start) > c_trialTimeoutSeconds)
+			break;
+	}
+
+	return -1.0;
+}
+
+static void destroyPair(Pair* pair)
+{
+	if (pair->a) pair->a->destroy();
+	if (pair->b) pair->b->destroy();
+}
+
+static void benchConnect(const char* relayHost, uint16_t relayPort)
+{
+	std::vector<double> samples;
+	uint32_t failures = 0;
+	uint32_t notRelayed = 0;
+	for (uint32_t ii = 0; ii < c_trials; ++ii)
+	{
+		Pair pair = {};
+		const double t = connectPair(&pair, relayHost, relayPort);
+		if (t < 0.0)
+		{
+			++failures;
+		}
+		else
+		{
+			samples.push_back(t * 1000.0);
+
+			PeerStats stats;
+			if (!pair.a->peerStats(pair.peerB, &stats) || stats.localCandidateType != CandidateType::Relay)
+			{
+				++notRelayed;
+			}
+		}
+
+		destroyPair(&pair);
+	}
+
+	bench::report("relay.connect", "connect_p50", bench::percentile(samples, 0.50), "ms");
+	bench::report("relay.connect", "connect_p95", bench::percentile(samples, 0.95), "ms");
+	bench::report("relay.connect", "failures", static_cast<double>(failures), "trials");
+	bench::report("relay.connect", "not_relayed", static_cast<double>(notRelayed), "trials");
+}
+
+// round trips of small datagrams echoed by the remote mesh
+static void benchRoundTrip(const char* relayHost, uint16_t relayPort, IRelayServer* server)
+{
+	Pair pair = {};
+	if (connectPair(&pair, relayHost, relayPort) < 0.0)
+	{
+		printf("# relay.rtt: failed to connect\n");
+		destroyPair(&pair);
+		return;
+	}
+
+	std::vector<double> samples;
+	samples.reserve(c_pings);
+
+	const uint64_t relayedBefore = server->packetsRelayed();
+	const uint64_t start = timestampCurrent();
+	for (uint32_t ii = 0; ii < c_pings; ++ii)
+	{
+		const uint64_t sent = timestampCurrent();
+		pair.a->sendUnreliableDataToPeer(pair.peerB, &ii, sizeof(ii));
+
+		bool answered = false;
+		while (!answered && bench::secondsSince(sent) < 1.0)
+		{
+			pair.b->update();
+
+			Message** messages;
+			uint32_t nmessages;
+			if (pair.b->receive(pair.peerA, &messages, &nmessages))
+			{
+				for (uint32_t jj = 0; jj < nmessages; ++jj)
+				{
+					pair.b->sendUnreliableDataToPeer(pair.peerA, messages[jj]->data, messages[jj]->ndata);
+				}
+			}
+
+			pair.a->update();
+			if (pair.a->receive(pair.peerB, &messages, &nmessages))
+			{
+				for (uint32_t jj = 0; jj < nmessages; ++jj)
+				{
+					uint32_t seq;
+					if (messages[jj]->ndata == sizeof(seq))
+					{
+						memcpy(&seq, messages[jj]->data, sizeof(seq));
+						answered = answered || seq == ii;
+					}
+				}
+			}
+		}
+
+		if (answered)
+		{
+			samples.push_back(bench::toMicroseconds(timestampCurrent() - sent));
+		}
+	}
+	const double elapsed = bench::secondsSince(start);
+	const uint64_t relayed = server->packetsRelayed() - relayedBefore;
+
+	destroyPair(&pair);
+
+	bench::report("relay.rtt", "rtt_p50", bench::percentile(samples, 0.50), "us");
+	bench::report("relay.rtt", "rtt_p99", bench::percentile(samples, 0.99), "us");
+	bench::report("relay.rtt", "lost", static_cast<double>(c_pings - samples.size()), "pings");
+	bench::report("relay.rtt", "relayed", static_cast<double>(relayed) / elapsed, "packets/s");
+}
+
+int main()
+{
+	if (!platformStartup())
+		return -1;
+
+	Address addr;
+	if (!hostAddress(&addr))
+	{
+		printf("# relay: no IPv4 adapter\n");
+		platformShutdown();
+		return -1;
+	}
+
+	IRelayServer* server = relayServerCreate(addr, addr, 0, c_relayKey, sizeof(c_relayKey));
+	if (!server)
+	{
+		printf("# relay: failed to create server\n");
+		platformShutdown();
+		return -1;
+	}
+
+	char relayHost[16];
+	snprintf(relayHost, sizeof(relayHost), "%u.%u.%u.%u", addr.u.v4.addr[0], addr.u.v4.addr[1], addr.u.v4.addr[2], addr.u.v4.addr[3]);
+
+	benchConnect(relayHost, server->port());
+	benchRoundTrip(relayHost, server->port(), server);
+
+	server->destroy();
+	platformShutdown();
+}
@@ -0,0 +1,97 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+#include <tiny/cpu.h>
+#include <tiny/crypto/sha1.h>
+#include <tiny/time.h>
+#include "bench.h"
+
+using namespace tiny;
+using namespace tiny::crypto;
+
+static const double c_seconds = 1.0;
+
+// hash `size' byte messages for `c_seconds' on the implementation
+// selected by `features'
+static void benchSize(const char* kernel, uint32_t features, uint32_t size)
+{
+	cpuFeaturesRestrict(features);
+
+	std::vector<uint8_t> message(size);
+	for (uint32_t ii = 0; ii < size; ++ii)
+	{
+		message[ii] = static_cast<uint8_t>(ii * 131);
+	}
+
+	uint8_t digest[sha1_state::DIGEST_SIZE];
+	uint64_t hashed = 0;
+	const uint64_t start = timestampCurrent();
+	while (bench::secondsSince(start) < c_seconds)
+	{
+		for (uint32_t ii = 0; ii < 64; ++ii)
+		{
+			sha1_state st;
+			sha1_begin(&st);
+			sha1_add(&st, message.data(), size);
+			sha1_end(&st, digest);
+			message[0] ^= digest[0];
+		}
+		hashed += 64;
+	}
+	const double seconds = bench::secondsSince(start);
+
+	char name[64];
+	snprintf(name, sizeof(name), "sha1.%s_%u", kernel, size);
+	bench::report(name, "throughput", static_cast<double>(hashed) * size / seconds / 1e6, "MB/s");
+	bench::report(name, "messages_per_sec", static_cast<double>(hashed) / seconds, "messages/s");
+
+	cpuFeaturesRestrict(~0u);
+}
+
+static void benchKernel(const char* kernel, uint32_t features)
+{
+	// a STUN request and a full datagram
+	benchSize(kernel, features, 64);
+	benchSize(kernel, features, 1500);
+}
+
+int main()
+{
+	const uint32_t features = cpuFeatures();
+
+	benchKernel("scalar", 0);
+	if (features & CpuFeature::SSSE3)
+	{
+		benchKernel("ssse3", CpuFeature::SSSE3);
+	}
+	if ((features & CpuFeature::SHA) && (features & CpuFeature::SSSE3) && (features & CpuFeature::SSE41))
+	{
+		benchKernel("sha", ~0u);
+	}
+}
@@ -0,0 +1,205 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+#include <tiny/endian.h>
+#include <tiny/net/address.h>
+#include <tiny/net/sharedchannel.h>
+#include <tiny/net/socket.h>
+#include <tiny/platform.h>
+#include <tiny/time.h>
+#include "bench.h"
+
+using namespace tiny;
+using namespace tiny::net;
+
+static const uint32_t c_pings = 20000;
+static const uint32_t c_payloadSize = 160; // a 20 ms opus frame at ~64 kbit/s
+static const uint32_t c_waitMS = 1000;
+
+// ping-pong `c_pings' datagrams through a pair of shared channel ends.
+// the echo side runs on its own thread, as it would in another process
+static void benchShared()
+{
+	char name[64];
+	snprintf(name, sizeof(name), "tiny-bench-shm-%llu", static_cast<unsigned long long>(timestampCurrent()));
+
+	SharedChannel* a = sharedChannelOpen(name, 0);
+	SharedChannel* b = sharedChannelOpen(name, 1);
+	if (!a || !b)
+	{
+		printf("# shm_transport.shared: failed to open channel\n");
+		if (a) sharedChannelClose(a);
+		if (b) sharedChannelClose(b);
+		return;
+	}
+
+	std::thread echo([b]() {
+		SharedDatagram dgs[32];
+		for (uint32_t echoed = 0; echoed < c_pings; )
+		{
+			if (!sharedChannelWait(b, c_waitMS))
+				break;
+
+			const uint32_t n = sharedChannelRead(b, dgs, 32);
+			for (uint32_t ii = 0; ii < n; ++ii)
+			{
+				ConstBuffer buf;
+				buf.p = dgs[ii].p;
+				buf.len = dgs[ii].len;
+				sharedChannelSend(b, &buf, 1);
+			}
+			echoed += n;
+		}
+	});
+
+	uint8_t payload[c_payloadSize];
+	memset(payload, 0xA5, sizeof(payload));
+	ConstBuffer buf;
+	buf.p = payload;
+	buf.len = sizeof(payload);
+
+	std::vector<double> samples;
+	samples.reserve(c_pings);
+	const uint64_t start = timestampCurrent();
+	for (uint32_t ii = 0; ii < c_pings; ++ii)
+	{
+		const uint64_t sent = timestampCurrent();
+		sharedChannelSend(a, &buf, 1);
+
+		SharedDatagram dg;
+		if (!sharedChannelWait(a, c_waitMS) || sharedChannelRead(a, &dg, 1) != 1)
+			break;
+
+		samples.push_back(bench::toMicroseconds(timestampCurrent() - sent));
+	}
+	const double elapsed = bench::secondsSince(start);
+
+	echo.join();
+	sharedChannelClose(a);
+	sharedChannelClose(b);
+
+	bench::report("shm_transport.shared", "rtt_p50", bench::percentile(samples, 0.50), "us");
+	bench::report("shm_transport.shared", "rtt_p99", bench::percentile(samples, 0.99), "us");
+	bench::report("shm_transport.shared", "round_trips", static_cast<double>(samples.size()) / elapsed, "round trips/s");
+}
+
+// the same ping-pong over loopback UDP
+static void benchLoopback()
+{
+	Address loopback;
+	memset(&loopback, 0, sizeof(loopback));
+	loopback.family = AddressFamily::IPv4;
+	loopback.u.v4.addr[0] = 127;
+	loopback.u.v4.addr[3] = 1;
+
+	Socket a, b;
+	uint16_t portA = 0, portB = 0;
+	if (!socketCreateUDP(&a, loopback, &portA) || !socketCreateUDP(&b, loopback, &portB))
+	{
+		printf("# shm_transport.loopback: failed to create sockets\n");
+		return;
+	}
+
+	PlatformSocketAddr addrA, addrB;
+	addressFrom(&addrA, loopback, portA);
+	addressFrom(&addrB, loopback, portB);
+
+	std::thread echo([b, &addrA]() {
+		uint8_t storage[32][c_payloadSize];
+		Datagram dgs[32];
+		for (uint32_t ii = 0; ii < 32; ++ii)
+		{
+			dgs[ii].p = storage[ii];
+			dgs[ii].capacity = c_payloadSize;
+		}
+
+		for (uint32_t echoed = 0; echoed < c_pings; )
+		{
+			if (!socketWaitReadable(b, c_waitMS))
+				break;
+
+			const uint32_t n = socketRecvBatch(b, dgs, 32);
+			for (uint32_t ii = 0; ii < n; ++ii)
+			{
+				ConstBuffer buf;
+				buf.p = dgs[ii].p;
+				buf.len = dgs[ii].len;
+				socketSendTo(b, &buf, 1, addrA);
+			}
+			echoed += n;
+		}
+	});
+
+	uint8_t payload[c_payloadSize];
+	memset(payload, 0xA5, sizeof(payload));
+	ConstBuffer buf;
+	buf.p = payload;
+	buf.len = sizeof(payload);
+
+	uint8_t response[c_payloadSize];
+	Datagram dg;
+	dg.p = response;
+	dg.capacity = sizeof(response);
+
+	std::vector<double> samples;
+	samples.reserve(c_pings);
+	const uint64_t start = timestampCurrent();
+	for (uint32_t ii = 0; ii < c_pings; ++ii)
+	{
+		const uint64_t sent = timestampCurrent();
+		socketSendTo(a, &buf, 1, addrB);
+
+		if (!socketWaitReadable(a, c_waitMS) || socketRecvBatch(a, &dg, 1) != 1)
+			break;
+
+		samples.push_back(bench::toMicroseconds(timestampCurrent() - sent));
+	}
+	const double elapsed = bench::secondsSince(start);
+
+	echo.join();
+	socketClose(a);
+	socketClose(b);
+
+	bench::report("shm_transport.loopback", "rtt_p50", bench::percentile(samples, 0.50), "us");
+	bench::report("shm_transport.loopback", "rtt_p99", bench::percentile(samples, 0.99), "us");
+	bench::report("shm_transport.loopback", "round_trips", static_cast<double>(samples.size()) / elapsed, "round trips/s");
+}
+
+int main()
+{
+	if (!platformStartup())
+		return -1;
+
+	benchShared();
+	benchLoopback();
+
+	platformShutdown();
+}
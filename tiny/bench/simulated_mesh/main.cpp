@@ -0,0 +1,227 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+#include <tiny/net/engine.h>
+#include <tiny/net/simulator.h>
+#include <tiny/peer/mesh.h>
+#include <tiny/platform.h>
+#include <tiny/time.h>
+#include "bench.h"
+
+using namespace tiny;
+using namespace tiny::net;
+using namespace tiny::peer;
+
+static const uint32_t c_meshes = 500;
+// virtual time per simulation step, and the limits of each phase
+static const uint64_t c_stepUS = 1000;
+static const uint64_t c_startTimeoutUS = 10000000;
+static const uint64_t c_connectTimeoutUS = 30000000;
+static const uint16_t c_stunPort = 3478;
+
+namespace
+{
+	struct SimMesh
+	{
+		IMesh* mesh;
+		uint32_t next; // connection to the next mesh in the ring
+		uint32_t prev; // connection to the previous mesh in the ring
+		std::vector<uint8_t> address;
+	};
+}
+
+// one in ten hosts is directly reachable and one in ten is behind a
+// symmetric NAT; the rest are spread over the cone NATs
+static NatType::E natFor(uint32_t index)
+{
+	static const NatType::E mix[10] = {
+		NatType::None,
+		NatType::FullCone,
+		NatType::FullCone,
+		NatType::AddressRestricted,
+		NatType::AddressRestricted,
+		NatType::PortRestricted,
+		NatType::PortRestricted,
+		NatType::PortRestricted,
+		NatType::PortRestricted,
+		NatType::Symmetric,
+	};
+	return mix[index % 10];
+}
+
+// every mesh connects to its neighbours in a ring of `c_meshes'. reports
+// the simulated time until both ends of a link are connected
+static void benchRing(const char* name, float loss, uint64_t seed)
+{
+	static const uint8_t key[] = "bench session key";
+
+	const uint64_t wallStart = timestampCurrent();
+
+	INetworkSimulator* sim = networkSimulatorCreate(seed);
+	const uint64_t simulatedStart = sim->clock()->current();
+
+	sim->addStunServer(bench::numericAddress("198.51.100.1"), c_stunPort);
+
+	LinkConditions link;
+	link.latencyUS = 10000;
+	link.jitterUS = 5000;
+	link.reorderUS = 10000;
+	link.loss = loss;
+	link.duplicate = 0.001f;
+	link.reorder = 0.01f;
+
+	// private addresses are unique so no two meshes look colocated
+	std::vector<SimMesh> meshes(c_meshes);
+	for (uint32_t ii = 0; ii < c_meshes; ++ii)
+	{
+		const uint32_t host = ii + 1;
+		char privateAddr[32];
+		char publicAddr[32];
+		snprintf(privateAddr, sizeof(privateAddr), "10.%u.%u.%u", (host >> 16) & 0xFF, (host >> 8) & 0xFF, host & 0xFF);
+		snprintf(publicAddr, sizeof(publicAddr), "203.0.%u.%u", (host >> 8) & 0xFF, host & 0xFF);
+
+		const NatType::E nat = natFor(ii);
+		ISocketEngine* engine = sim->createHost(bench::numericAddress(privateAddr), bench::numericAddress(publicAddr), nat, link);
+
+		SimMesh& m = meshes[ii];
+		m.mesh = meshCreateICE(8, ii + 1, 0, engine);
+		m.next = InvalidMeshPeer;
+		m.prev = InvalidMeshPeer;
+		if (!m.mesh)
+		{
+			fprintf(stderr, "%s: failed to create mesh %u\n", name, ii);
+			return;
+		}
+
+		const StunServer server = { "198.51.100.1", c_stunPort };
+		m.mesh->setSessionKey(key, sizeof(key));
+		m.mesh->startSession(&server, 1);
+	}
+
+	// gather candidates
+	uint64_t elapsedUS = 0;
+	for (uint32_t nstarted = 0; nstarted != c_meshes && elapsedUS < c_startTimeoutUS; elapsedUS += c_stepUS)
+	{
+		nstarted = 0;
+		for (uint32_t ii = 0; ii < c_meshes; ++ii)
+		{
+			const MeshState::E state = meshes[ii].mesh->update();
+			if (state == MeshState::StartComplete || state == MeshState::Running)
+			{
+				++nstarted;
+			}
+		}
+		sim->advance(c_stepUS);
+	}
+
+	for (uint32_t ii = 0; ii < c_meshes; ++ii)
+	{
+		SimMesh& m = meshes[ii];
+		m.address.resize(m.mesh->localAddressSize());
+		if (!m.address.empty())
+		{
+			m.mesh->serializeLocalAddress(m.address.data());
+		}
+	}
+
+	for (uint32_t ii = 0; ii < c_meshes; ++ii)
+	{
+		SimMesh& a = meshes[ii];
+		SimMesh& b = meshes[(ii + 1) % c_meshes];
+		a.next = a.mesh->connectToPeer((ii + 1) % c_meshes + 1, b.address.data(), static_cast<uint32_t>(b.address.size()));
+		b.prev = b.mesh->connectToPeer(ii + 1, a.address.data(), static_cast<uint32_t>(a.address.size()));
+	}
+
+	// link `ii' joins mesh `ii' and its successor
+	std::vector<double> connectMS(c_meshes, -1.0);
+	uint32_t npending = c_meshes;
+	for (elapsedUS = 0; npending && elapsedUS < c_connectTimeoutUS; elapsedUS += c_stepUS)
+	{
+		for (uint32_t ii = 0; ii < c_meshes; ++ii)
+		{
+			meshes[ii].mesh->update();
+		}
+
+		for (uint32_t ii = 0; ii < c_meshes; ++ii)
+		{
+			if (connectMS[ii] >= 0.0)
+				continue;
+
+			const SimMesh& a = meshes[ii];
+			const SimMesh& b = meshes[(ii + 1) % c_meshes];
+			if (a.mesh->peerState(a.next) == PeerState::Connected && b.mesh->peerState(b.prev) == PeerState::Connected)
+			{
+				connectMS[ii] = static_cast<double>(elapsedUS) / 1000.0;
+				--npending;
+			}
+		}
+
+		sim->advance(c_stepUS);
+	}
+
+	const uint64_t simulatedUS = sim->clock()->current() - simulatedStart;
+	SimulatorStats stats;
+	sim->stats(&stats);
+
+	for (uint32_t ii = 0; ii < c_meshes; ++ii)
+	{
+		meshes[ii].mesh->destroy();
+	}
+	sim->destroy();
+
+	const double wallSeconds = bench::secondsSince(wallStart);
+
+	std::vector<double> samples;
+	for (uint32_t ii = 0; ii < c_meshes; ++ii)
+	{
+		if (connectMS[ii] >= 0.0)
+		{
+			samples.push_back(connectMS[ii]);
+		}
+	}
+
+	bench::report(name, "connect_p50", bench::percentile(samples, 0.50), "ms");
+	bench::report(name, "connect_p95", bench::percentile(samples, 0.95), "ms");
+	bench::report(name, "failures", static_cast<double>(npending), "links");
+	bench::report(name, "datagrams", static_cast<double>(stats.sent), "datagrams");
+	bench::report(name, "nat_filtered", static_cast<double>(stats.filtered), "datagrams");
+	bench::report(name, "wall_time", wallSeconds, "s");
+	bench::report(name, "speedup", static_cast<double>(simulatedUS) / 1000000.0 / wallSeconds, "x");
+}
+
+int main()
+{
+	if (!platformStartup())
+		return -1;
+
+	benchRing("simulated_mesh.loss_0", 0.0f, 1);
+	benchRing("simulated_mesh.loss_5", 0.05f, 2);
+
+	platformShutdown();
+}
@@ -0,0 +1,144 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include <tiny/net/address.h>
+#include <tiny/net/engine.h>
+#include <tiny/net/socket.h>
+#include <tiny/platform.h>
+#include <tiny/time.h>
+#include "bench.h"
+
+using namespace tiny;
+using namespace tiny::net;
+
+static const uint32_t c_packetSize = 64;
+static const uint32_t c_pingPongs = 20000;
+static const uint32_t c_burstSize = 32;
+static const double c_throughputSeconds = 2.0;
+
+// loopback packets/sec and round-trip latency for a single socket engine
+static void benchEngine(const char* name, SocketEngineType::E type)
+{
+	ISocketEngine* engine = socketEngineCreate(type);
+	if (engine->type() != type)
+	{
+		printf("# %s: not supported on this host, skipping\n", name);
+		engine->release();
+		return;
+	}
+
+	Address loopback;
+	memset(&loopback, 0, sizeof(loopback));
+	loopback.family = AddressFamily::IPv4;
+	loopback.u.v4.addr[0] = 127;
+	loopback.u.v4.addr[3] = 1;
+
+	Socket a, b;
+	uint16_t portA = 0, portB = 0;
+	if (!engine->createUDP(&a, loopback, &portA) || !engine->createUDP(&b, loopback, &portB))
+	{
+		printf("# %s: failed to create sockets\n", name);
+		engine->release();
+		return;
+	}
+
+	PlatformSocketAddr addrA, addrB;
+	addressFrom(&addrA, loopback, portA);
+	addressFrom(&addrB, loopback, portB);
+
+	uint8_t payload[c_packetSize];
+	memset(payload, 0xA5, sizeof(payload));
+	ConstBuffer buf;
+	buf.p = payload;
+	buf.len = sizeof(payload);
+
+	uint8_t storage[c_burstSize][2048];
+	Datagram dgs[c_burstSize];
+	for (uint32_t ii = 0; ii < c_burstSize; ++ii)
+	{
+		dgs[ii].p = storage[ii];
+		dgs[ii].capacity = sizeof(storage[ii]);
+	}
+
+	// round trip latency: A -> B -> A, one packet in flight
+	std::vector<double> rtt;
+	rtt.reserve(c_pingPongs);
+	for (uint32_t ii = 0; ii < c_pingPongs; ++ii)
+	{
+		const uint64_t start = timestampCurrent();
+		engine->sendTo(a, &buf, 1, addrB);
+		while (0 == engine->recvBatch(b, dgs, 1))
+			;
+		engine->sendTo(b, &buf, 1, addrA);
+		while (0 == engine->recvBatch(a, dgs, 1))
+			;
+		rtt.push_back(bench::toMicroseconds(timestampCurrent() - start));
+	}
+
+	// throughput: A bursts batches at B, B drains everything it can
+	uint64_t sent = 0;
+	uint64_t received = 0;
+	const uint64_t start = timestampCurrent();
+	while (bench::secondsSince(start) < c_throughputSeconds)
+	{
+		engine->sendBatchBegin();
+		for (uint32_t ii = 0; ii < c_burstSize; ++ii)
+		{
+			if (engine->sendTo(a, &buf, 1, addrB))
+				++sent;
+		}
+		engine->sendBatchEnd();
+
+		for (uint32_t n; 0 != (n = engine->recvBatch(b, dgs, c_burstSize));)
+		{
+			received += n;
+		}
+	}
+	const double elapsed = bench::secondsSince(start);
+
+	bench::report(name, "recv_pps", static_cast<double>(received) / elapsed, "packets/s");
+	bench::report(name, "send_pps", static_cast<double>(sent) / elapsed, "packets/s");
+	bench::report(name, "rtt_p50", bench::percentile(rtt, 0.50), "us");
+	bench::report(name, "rtt_p99", bench::percentile(rtt, 0.99), "us");
+
+	engine->close(a);
+	engine->close(b);
+	engine->release();
+}
+
+int main()
+{
+	if (!platformStartup())
+		return -1;
+
+	benchEngine("socket_engine.platform", SocketEngineType::Platform);
+	benchEngine("socket_engine.registered_io", SocketEngineType::RegisteredIO);
+
+	platformShutdown();
+}
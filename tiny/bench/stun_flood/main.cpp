@@ -0,0 +1,231 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <tiny/endian.h>
+#include <tiny/net/engine.h>
+#include <tiny/net/simulator.h>
+#include <tiny/net/socket.h>
+#include <tiny/peer/mesh.h>
+#include <tiny/peer/stats.h>
+#include <tiny/platform.h>
+#include <tiny/time.h>
+#include "bench.h"
+
+using namespace tiny;
+using namespace tiny::net;
+using namespace tiny::peer;
+
+// virtual time per simulation step, and the limits of each phase
+static const uint64_t c_stepUS = 1000;
+static const uint64_t c_startTimeoutUS = 10000000;
+static const uint64_t c_connectTimeoutUS = 10000000;
+static const uint64_t c_floodUS = 20000000;
+static const uint16_t c_stunPort = 3478;
+static const uint16_t c_victimPort = 7000;
+
+// spoofed requests per step, each from the next of `c_floodSources'
+// source ports. well over the mesh's aggregate STUN budget, but under
+// what it drains from its socket per update
+static const uint32_t c_floodPerStep = 6;
+static const uint32_t c_floodSources = 1024;
+
+// update both meshes and move virtual time forward by one step
+static void step(INetworkSimulator* sim, IMesh* a, IMesh* b)
+{
+	a->update();
+	b->update();
+	sim->advance(c_stepUS);
+}
+
+// flood a mesh with binding requests from rotating spoofed sources while
+// a connected peer keeps checking the connection. every keep-alive of the
+// peer must still be answered. returns `false' if it isn't
+static bool benchFlood(const char* name, uint64_t seed)
+{
+	static const uint8_t key[] = "bench session key";
+
+	const uint64_t wallStart = timestampCurrent();
+
+	INetworkSimulator* sim = networkSimulatorCreate(seed);
+	sim->addStunServer(bench::numericAddress("198.51.100.1"), c_stunPort);
+
+	LinkConditions link;
+	memset(&link, 0, sizeof(link));
+	link.latencyUS = 10000;
+
+	const Address victimAddr = bench::numericAddress("203.0.113.1");
+	IMesh* victim = meshCreateICE(1, 1, c_victimPort, sim->createHost(victimAddr, victimAddr, NatType::None, link));
+	IMesh* peer = meshCreateICE(1, 2, 0, sim->createHost(bench::numericAddress("203.0.113.2"), bench::numericAddress("203.0.113.2"), NatType::None, link));
+	ISocketEngine* attacker = sim->createHost(bench::numericAddress("203.0.113.66"), bench::numericAddress("203.0.113.66"), NatType::None, link);
+	if (!victim || !peer)
+	{
+		fprintf(stderr, "%s: failed to create meshes\n", name);
+		return false;
+	}
+
+	const StunServer server = { "198.51.100.1", c_stunPort };
+	IMesh* meshes[2] = {victim, peer};
+	for (uint32_t ii = 0; ii < 2; ++ii)
+	{
+		meshes[ii]->setSessionKey(key, sizeof(key));
+		meshes[ii]->startSession(&server, 1);
+	}
+
+	uint64_t elapsedUS = 0;
+	for (; elapsedUS < c_startTimeoutUS; elapsedUS += c_stepUS)
+	{
+		const MeshState::E a = victim->update();
+		const MeshState::E b = peer->update();
+		if ((a == MeshState::StartComplete || a == MeshState::Running) && (b == MeshState::StartComplete || b == MeshState::Running))
+			break;
+
+		sim->advance(c_stepUS);
+	}
+
+	std::vector<uint8_t> addresses[2];
+	for (uint32_t ii = 0; ii < 2; ++ii)
+	{
+		addresses[ii].resize(meshes[ii]->localAddressSize());
+		if (!addresses[ii].empty())
+		{
+			meshes[ii]->serializeLocalAddress(addresses[ii].data());
+		}
+	}
+
+	const uint32_t toPeer = victim->connectToPeer(2, addresses[1].data(), static_cast<uint32_t>(addresses[1].size()));
+	const uint32_t toVictim = peer->connectToPeer(1, addresses[0].data(), static_cast<uint32_t>(addresses[0].size()));
+	for (elapsedUS = 0; elapsedUS < c_connectTimeoutUS; elapsedUS += c_stepUS)
+	{
+		if (victim->peerState(toPeer) == PeerState::Connected && peer->peerState(toVictim) == PeerState::Connected)
+			break;
+
+		step(sim, victim, peer);
+	}
+
+	// every request comes from a new source port, so each lands in the
+	// per-source limiter with nothing to its name
+	std::vector<Socket> sources(c_floodSources);
+	for (uint32_t ii = 0; ii < c_floodSources; ++ii)
+	{
+		uint16_t port = 0;
+		if (!attacker->createUDP(&sources[ii], bench::numericAddress("203.0.113.66"), &port))
+		{
+			fprintf(stderr, "%s: failed to create flood socket %u\n", name, ii);
+			return false;
+		}
+	}
+
+	PlatformSocketAddr target;
+	addressFrom(&target, victimAddr, endianToBig(c_victimPort));
+
+	// a bare binding request: passes the cheap type check, fails parsing
+	uint8_t request[20];
+	memset(request, 0, sizeof(request));
+	request[1] = 0x01;
+	request[4] = 0x21;
+	request[5] = 0x12;
+	request[6] = 0xA4;
+	request[7] = 0x42;
+	memset(&request[8], 0x5A, 12);
+
+	ConstBuffer b;
+	b.p = request;
+	b.len = sizeof(request);
+
+	PeerStats before;
+	MeshStats victimBefore;
+	peer->peerStats(toVictim, &before);
+	victim->meshStats(&victimBefore);
+
+	uint32_t nextSource = 0;
+	for (elapsedUS = 0; elapsedUS < c_floodUS; elapsedUS += c_stepUS)
+	{
+		for (uint32_t ii = 0; ii < c_floodPerStep; ++ii)
+		{
+			attacker->sendTo(sources[nextSource], &b, 1, target);
+			nextSource = (nextSource + 1) % c_floodSources;
+		}
+
+		step(sim, victim, peer);
+	}
+
+	PeerStats after;
+	MeshStats victimAfter;
+	peer->peerStats(toVictim, &after);
+	victim->meshStats(&victimAfter);
+
+	// collect the answer to the last keep-alive of the flood
+	for (elapsedUS = 0; elapsedUS < 100000; elapsedUS += c_stepUS)
+	{
+		step(sim, victim, peer);
+	}
+
+	PeerStats answered;
+	peer->peerStats(toVictim, &answered);
+	const bool connected = victim->peerState(toPeer) == PeerState::Connected && peer->peerState(toVictim) == PeerState::Connected;
+
+	for (uint32_t ii = 0; ii < c_floodSources; ++ii)
+	{
+		attacker->close(sources[ii]);
+	}
+	attacker->release();
+	victim->destroy();
+	peer->destroy();
+	sim->destroy();
+
+	const uint32_t sent = after.keepAlivesSent - before.keepAlivesSent;
+	const uint32_t acked = answered.keepAlivesAcked - before.keepAlivesAcked;
+	const uint32_t limited = victimAfter.stunRateLimited - victimBefore.stunRateLimited;
+
+	bench::report(name, "keepalives_sent", static_cast<double>(sent), "requests");
+	bench::report(name, "keepalives_acked", static_cast<double>(acked), "requests");
+	bench::report(name, "flood_limited", static_cast<double>(limited), "requests");
+	bench::report(name, "wall_time", bench::secondsSince(wallStart), "s");
+
+	if (!connected || sent == 0 || acked < sent || limited == 0)
+	{
+		fprintf(stderr, "%s: FAILED, connected %d, %u of %u keep-alives answered, %u flood requests limited\n"
+			, name, connected ? 1 : 0, acked, sent, limited);
+		return false;
+	}
+
+	return true;
+}
+
+int main()
+{
+	if (!platformStartup())
+		return -1;
+
+	const bool passed = benchFlood("stun_flood", 1);
+
+	platformShutdown();
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,148 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <tiny/endian.h>
+#include <tiny/net/address.h>
+#include <tiny/net/socket.h>
+#include <tiny/peer/stunserver.h>
+#include <tiny/platform.h>
+#include <tiny/time.h>
+#include "bench.h"
+
+using namespace tiny;
+using namespace tiny::net;
+using namespace tiny::peer;
+
+static const uint32_t c_clientThreads = 4;
+static const uint32_t c_burstSize = 32;
+static const double c_runSeconds = 2.0;
+
+// blast binding requests at `server' and drain responses until `quit'
+static void client(const Address& loopback, const PlatformSocketAddr* server, std::atomic<bool>* quit)
+{
+	Socket s;
+	uint16_t port = 0;
+	if (!socketCreateUDP(&s, loopback, &port))
+		return;
+
+	// bare binding request: no attributes, a fixed transaction id
+	uint8_t request[20];
+	memset(request, 0, sizeof(request));
+	request[1] = 0x01;
+	request[4] = 0x21;
+	request[5] = 0x12;
+	request[6] = 0xA4;
+	request[7] = 0x42;
+	memset(&request[8], 0x5A, 12);
+
+	ConstBuffer b;
+	b.p = request;
+	b.len = sizeof(request);
+
+	uint8_t storage[c_burstSize][64];
+	Datagram dgs[c_burstSize];
+	for (uint32_t ii = 0; ii < c_burstSize; ++ii)
+	{
+		dgs[ii].p = storage[ii];
+		dgs[ii].capacity = sizeof(storage[ii]);
+	}
+
+	while (!quit->load(std::memory_order_relaxed))
+	{
+		for (uint32_t ii = 0; ii < c_burstSize; ++ii)
+		{
+			socketSendTo(s, &b, 1, *server);
+		}
+
+		while (0 != socketRecvBatch(s, dgs, c_burstSize))
+			;
+	}
+
+	socketClose(s);
+}
+
+static void benchThreads(const char* name, uint32_t nthreads)
+{
+	Address loopback;
+	memset(&loopback, 0, sizeof(loopback));
+	loopback.family = AddressFamily::IPv4;
+	loopback.u.v4.addr[0] = 127;
+	loopback.u.v4.addr[3] = 1;
+
+	IStunServer* server = stunServerCreate(loopback, 0, nthreads);
+	if (!server)
+	{
+		printf("# %s: failed to create server\n", name);
+		return;
+	}
+
+	PlatformSocketAddr serverAddr;
+	addressFrom(&serverAddr, loopback, endianToBig(server->port()));
+
+	std::atomic<bool> quit(false);
+	std::vector<std::thread> clients;
+	for (uint32_t ii = 0; ii < c_clientThreads; ++ii)
+	{
+		clients.push_back(std::thread(client, loopback, &serverAddr, &quit));
+	}
+
+	const uint64_t start = timestampCurrent();
+	const uint64_t before = server->responsesSent();
+	while (bench::secondsSince(start) < c_runSeconds)
+	{
+		std::this_thread::yield();
+	}
+	const uint64_t responses = server->responsesSent() - before;
+	const double elapsed = bench::secondsSince(start);
+
+	quit.store(true);
+	for (size_t ii = 0, nn = clients.size(); ii != nn; ++ii)
+	{
+		clients[ii].join();
+	}
+	server->destroy();
+
+	const double rate = static_cast<double>(responses) / elapsed;
+	bench::report(name, "responses", rate, "responses/s");
+	bench::report(name, "responses_per_thread", rate / static_cast<double>(nthreads), "responses/s");
+}
+
+int main()
+{
+	if (!platformStartup())
+		return -1;
+
+	benchThreads("stun_server.threads_1", 1);
+	benchThreads("stun_server.threads_2", 2);
+	benchThreads("stun_server.threads_4", 4);
+
+	platformShutdown();
+}
@@ -0,0 +1,601 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <tiny/audio/capture.h>
+#include <tiny/audio/render.h>
+#include <tiny/net/engine.h>
+#include <tiny/net/packet.h>
+#include <tiny/net/simulator.h>
+#include <tiny/peer/mesh.h>
+#include <tiny/peer/message.h>
+#include <tiny/platform.h>
+#include <tiny/time.h>
+#include <tiny/voice/engine.h>
+#include <tiny/voice/latency.h>
+#include <tiny/voice/source.h>
+#include "bench.h"
+
+using namespace tiny;
+using namespace tiny::audio;
+using namespace tiny::net;
+using namespace tiny::peer;
+
+static const int c_sampleRate = 48000;
+static const int c_samplesPer10ms = c_sampleRate / 100;
+// virtual time per simulation step, and the limits of each phase
+static const uint64_t c_stepUS = 1000;
+static const uint64_t c_connectTimeoutUS = 10000000;
+static const uint64_t c_runUS = 20000000;
+static const uint16_t c_stunPort = 3478;
+// a chirp is mixed into the test signal this often. latencies must stay
+// below the period to be attributed to the right chirp
+static const uint32_t c_chirpPeriod = c_sampleRate / 2;
+static const uint32_t c_chirpSamples = c_sampleRate / 50;
+// the render device plays 10ms buffers and accepts this many ahead
+static const int c_renderBuffers = 2;
+// received audio held back before playback starts
+static const uint32_t c_prebufferSamples = 2 * c_samplesPer10ms;
+// chirps correlating worse than this are counted as lost
+static const double c_minCorrelation = 0.5;
+// a sample step larger than this fraction of the output's peak is heard
+// as a click. the test signal never moves this fast
+static const float c_clickThreshold = 0.35f;
+// the carrier is never this quiet for this long, so such a run in the
+// output is a dropout
+static const float c_silenceLevel = 0.001f;
+static const uint32_t c_dropoutSamples = c_sampleRate / 400;
+
+static const double c_pi = 3.14159265358979323846;
+
+// linear sweep from 300Hz to 1800Hz, with a raised cosine envelope
+static float chirpSample(uint32_t ii)
+{
+	const double t = static_cast<double>(ii) / c_sampleRate;
+	const double duration = static_cast<double>(c_chirpSamples) / c_sampleRate;
+	const double phase = 2.0 * c_pi * (300.0 * t + 0.5 * (1500.0 / duration) * t * t);
+	const double envelope = 0.5 - 0.5 * cos(2.0 * c_pi * ii / c_chirpSamples);
+	return static_cast<float>(0.5 * envelope * sin(phase));
+}
+
+// sample `n' of the test signal: a voiced carrier (harmonics of 150Hz
+// with a syllable rate envelope) so the sender's voice detection keeps
+// transmitting, plus a chirp at the start of every period
+static float signalSample(uint64_t n)
+{
+	const double t = static_cast<double>(n) / c_sampleRate;
+	double carrier = 0.0;
+	for (int k = 1; k <= 10; ++k)
+	{
+		carrier += sin(2.0 * c_pi * 150.0 * k * t) / k;
+	}
+	carrier *= 0.06 * (0.75 + 0.25 * sin(2.0 * c_pi * 4.0 * t));
+
+	const uint32_t offset = static_cast<uint32_t>(n % c_chirpPeriod);
+	const float chirp = offset < c_chirpSamples ? chirpSample(offset) : 0.0f;
+	return static_cast<float>(carrier) + chirp;
+}
+
+namespace
+{
+	// plays the test signal in real (or virtual) time, like
+	// `createSinCaptureDevice'. remembers when each chirp started
+	class SignalCaptureDevice : public ICaptureDevice
+	{
+	public:
+		SignalCaptureDevice()
+			: ticksPer10ms(timestampFrequency() / 100)
+		{
+		}
+
+		virtual void release() {}
+		virtual int sampleRate() const { return c_sampleRate; }
+		virtual int samplesPer10ms() const { return c_samplesPer10ms; }
+		virtual int channels() const { return 1; }
+		virtual void stop() {}
+
+		virtual bool start()
+		{
+			generated = 0;
+			nextOutputTime = timestampCurrent() + ticksPer10ms;
+			blockTimestamp = 0;
+			chirpTimes.clear();
+			return true;
+		}
+
+		virtual const float* get10msOfSamples()
+		{
+			if (timestampCurrent() < nextOutputTime)
+				return nullptr;
+
+			// the block covers the 10ms ending at `nextOutputTime'
+			blockTimestamp = nextOutputTime - ticksPer10ms;
+			for (int ii = 0; ii < c_samplesPer10ms; ++ii)
+			{
+				if ((generated + ii) % c_chirpPeriod == 0)
+				{
+					chirpTimes.push_back(blockTimestamp + ii * ticksPer10ms / c_samplesPer10ms);
+				}
+
+				block[ii] = signalSample(generated + ii);
+			}
+
+			generated += c_samplesPer10ms;
+			nextOutputTime += ticksPer10ms;
+			return block;
+		}
+
+		virtual uint64_t captureTimestamp() const
+		{
+			return blockTimestamp;
+		}
+
+		std::vector<uint64_t> chirpTimes;
+
+	private:
+		const uint64_t ticksPer10ms;
+		uint64_t generated;
+		uint64_t nextOutputTime;
+		uint64_t blockTimestamp;
+		float block[c_samplesPer10ms];
+	};
+
+	// a sound card that plays a 10ms stereo buffer every 10ms and keeps
+	// what it played, stamped with the time it was heard. if no buffer
+	// is committed in time the device underruns and later buffers play
+	// late
+	class VirtualRenderDevice : public IRenderDevice
+	{
+	public:
+		VirtualRenderDevice()
+			: ticksPer10ms(timestampFrequency() / 100)
+		{
+		}
+
+		virtual void release() {}
+		virtual int sampleRate() const { return c_sampleRate; }
+		virtual void stop() {}
+
+		virtual bool start()
+		{
+			nextPlayTime = timestampCurrent();
+			underruns = 0;
+			played.clear();
+			playTimes.clear();
+			return true;
+		}
+
+		virtual int acquireBuffer(float** buffer)
+		{
+			const uint64_t now = timestampCurrent();
+			if (nextPlayTime > now && nextPlayTime - now >= c_renderBuffers * ticksPer10ms)
+				return 0;
+
+			*buffer = stereo;
+			return c_samplesPer10ms;
+		}
+
+		virtual void commitBuffer()
+		{
+			const uint64_t now = timestampCurrent();
+			if (nextPlayTime < now)
+			{
+				if (!playTimes.empty())
+				{
+					++underruns;
+				}
+				nextPlayTime = now;
+			}
+
+			playTimes.push_back(nextPlayTime);
+			for (int ii = 0; ii < c_samplesPer10ms; ++ii)
+			{
+				played.push_back(stereo[2*ii]);
+			}
+			nextPlayTime += ticksPer10ms;
+		}
+
+		virtual void discardBuffer() {}
+
+		virtual int queuedSamples()
+		{
+			const uint64_t now = timestampCurrent();
+			if (nextPlayTime <= now)
+				return 0;
+
+			return static_cast<int>((nextPlayTime - now) * c_samplesPer10ms / ticksPer10ms);
+		}
+
+		// time sample `ii' of `played' was heard
+		uint64_t playTime(size_t ii) const
+		{
+			return playTimes[ii / c_samplesPer10ms] + (ii % c_samplesPer10ms) * ticksPer10ms / c_samplesPer10ms;
+		}
+
+		std::vector<float> played; // left channel
+		std::vector<uint64_t> playTimes; // per 10ms buffer
+		uint32_t underruns;
+
+	private:
+		const uint64_t ticksPer10ms;
+		uint64_t nextPlayTime;
+		float stereo[2 * c_samplesPer10ms];
+	};
+
+	struct LoopbackResult
+	{
+		std::vector<double> latencyMS; // per chirp found
+		uint32_t chirpsLost;
+		uint32_t sourceUnderruns; // playing, but the source ran dry
+		uint32_t deviceUnderruns;
+		uint32_t dropouts;
+		uint32_t clicks;
+	};
+}
+
+// locate every chirp in the played audio by normalized cross-correlation
+// and measure when it was heard against when it was captured
+static void measureChirps(const SignalCaptureDevice& capture, const VirtualRenderDevice& render, LoopbackResult* result)
+{
+	std::vector<float> chirp(c_chirpSamples);
+	double chirpEnergy = 0.0;
+	for (uint32_t ii = 0; ii < c_chirpSamples; ++ii)
+	{
+		chirp[ii] = chirpSample(ii);
+		chirpEnergy += chirp[ii] * chirp[ii];
+	}
+
+	const std::vector<float>& played = render.played;
+	if (played.size() < c_chirpSamples)
+	{
+		result->chirpsLost = static_cast<uint32_t>(capture.chirpTimes.size());
+		return;
+	}
+
+	const uint64_t window = timestampFrequency() * c_chirpPeriod / c_sampleRate;
+	const size_t lastStart = played.size() - c_chirpSamples;
+
+	size_t first = 0;
+	for (size_t kk = 0, nn = capture.chirpTimes.size(); kk != nn; ++kk)
+	{
+		const uint64_t emitted = capture.chirpTimes[kk];
+
+		// candidate positions heard within a period of the capture
+		while (first <= lastStart && render.playTime(first) < emitted)
+		{
+			++first;
+		}
+		if (first > lastStart)
+		{
+			++result->chirpsLost;
+			continue;
+		}
+
+		double energy = 0.0;
+		for (uint32_t ii = 0; ii < c_chirpSamples; ++ii)
+		{
+			energy += played[first + ii] * played[first + ii];
+		}
+
+		double best = 0.0;
+		size_t bestAt = first;
+		for (size_t jj = first; jj <= lastStart && render.playTime(jj) - emitted < window; ++jj)
+		{
+			if (jj != first)
+			{
+				const float out = played[jj - 1];
+				const float in = played[jj + c_chirpSamples - 1];
+				energy += in * in - out * out;
+			}
+
+			if (energy <= 0.0)
+				continue;
+
+			double dot = 0.0;
+			for (uint32_t ii = 0; ii < c_chirpSamples; ++ii)
+			{
+				dot += chirp[ii] * played[jj + ii];
+			}
+
+			const double correlation = dot / sqrt(chirpEnergy * energy);
+			if (correlation > best)
+			{
+				best = correlation;
+				bestAt = jj;
+			}
+		}
+
+		if (best < c_minCorrelation)
+		{
+			++result->chirpsLost;
+			continue;
+		}
+
+		result->latencyMS.push_back(bench::toMicroseconds(render.playTime(bestAt) - emitted) / 1000.0);
+	}
+}
+
+// count sample steps no part of the test signal can produce
+static uint32_t countClicks(const std::vector<float>& played)
+{
+	float peak = 0.0f;
+	for (size_t ii = 0, nn = played.size(); ii != nn; ++ii)
+	{
+		peak = fabsf(played[ii]) > peak ? fabsf(played[ii]) : peak;
+	}
+
+	uint32_t clicks = 0;
+	const float threshold = c_clickThreshold * peak;
+	for (size_t ii = 1, nn = played.size(); ii < nn; ++ii)
+	{
+		if (fabsf(played[ii] - played[ii - 1]) > threshold)
+		{
+			++clicks;
+		}
+	}
+
+	return clicks;
+}
+
+// count silent gaps of at least `c_dropoutSamples' once playback started
+static uint32_t countDropouts(const std::vector<float>& played)
+{
+	uint32_t dropouts = 0;
+	uint32_t silent = 0;
+	bool started = false;
+	for (size_t ii = 0, nn = played.size(); ii != nn; ++ii)
+	{
+		if (fabsf(played[ii]) >= c_silenceLevel)
+		{
+			if (started && silent >= c_dropoutSamples)
+			{
+				++dropouts;
+			}
+
+			started = true;
+			silent = 0;
+		}
+		else
+		{
+			++silent;
+		}
+	}
+
+	return dropouts;
+}
+
+// stream the test signal from one mesh to another across the simulated
+// network `link' for `c_runUS' of virtual time
+static void benchLoopback(const char* name, const LinkConditions& link, uint64_t seed)
+{
+	static const uint8_t key[] = "bench session key";
+
+	const uint64_t wallStart = timestampCurrent();
+
+	INetworkSimulator* sim = networkSimulatorCreate(seed);
+	// the meshes take the virtual clock from their hosts, the voice engine
+	// and the fake devices read `timestampCurrent'
+	clockInstall(sim->clock());
+	sim->addStunServer(bench::numericAddress("198.51.100.1"), c_stunPort);
+
+	// impairments apply on the sending host only
+	LinkConditions clean;
+	memset(&clean, 0, sizeof(clean));
+
+	IMesh* sender = meshCreateICE(1, 1, 0, sim->createHost(bench::numericAddress("203.0.113.1"), bench::numericAddress("203.0.113.1"), NatType::None, link));
+	IMesh* receiver = meshCreateICE(1, 2, 0, sim->createHost(bench::numericAddress("203.0.113.2"), bench::numericAddress("203.0.113.2"), NatType::None, clean));
+	if (!sender || !receiver)
+	{
+		fprintf(stderr, "%s: failed to create meshes\n", name);
+		return;
+	}
+
+	const StunServer server = { "198.51.100.1", c_stunPort };
+	IMesh* meshes[2] = {sender, receiver};
+	for (int ii = 0; ii < 2; ++ii)
+	{
+		meshes[ii]->setSessionKey(key, sizeof(key));
+		meshes[ii]->startSession(&server, 1);
+	}
+
+	// gather candidates, then connect
+	uint64_t elapsedUS = 0;
+	for (int nstarted = 0; nstarted != 2 && elapsedUS < c_connectTimeoutUS; elapsedUS += c_stepUS)
+	{
+		nstarted = 0;
+		for (int ii = 0; ii < 2; ++ii)
+		{
+			const MeshState::E state = meshes[ii]->update();
+			if (state == MeshState::StartComplete || state == MeshState::Running)
+			{
+				++nstarted;
+			}
+		}
+		sim->advance(c_stepUS);
+	}
+
+	std::vector<uint8_t> addresses[2];
+	for (int ii = 0; ii < 2; ++ii)
+	{
+		addresses[ii].resize(meshes[ii]->localAddressSize());
+		if (!addresses[ii].empty())
+		{
+			meshes[ii]->serializeLocalAddress(addresses[ii].data());
+		}
+	}
+
+	const uint32_t toReceiver = sender->connectToPeer(2, addresses[1].data(), static_cast<uint32_t>(addresses[1].size()));
+	const uint32_t fromSender = receiver->connectToPeer(1, addresses[0].data(), static_cast<uint32_t>(addresses[0].size()));
+	for (elapsedUS = 0; elapsedUS < c_connectTimeoutUS; elapsedUS += c_stepUS)
+	{
+		sender->update();
+		receiver->update();
+		if (sender->peerState(toReceiver) == PeerState::Connected && receiver->peerState(fromSender) == PeerState::Connected)
+			break;
+
+		sim->advance(c_stepUS);
+	}
+
+	if (elapsedUS >= c_connectTimeoutUS)
+	{
+		fprintf(stderr, "%s: meshes failed to connect\n", name);
+		return;
+	}
+
+	// stream
+	SignalCaptureDevice capture;
+	VirtualRenderDevice render;
+	voice::Engine encoder(&capture, c_sampleRate);
+	voice::Engine decoder(nullptr, c_sampleRate);
+	voice::Source source;
+	encoder.setSendTimestamps(true);
+	decoder.addSource(&source);
+	capture.start();
+	render.start();
+
+	LoopbackResult result;
+	result.chirpsLost = 0;
+	result.sourceUnderruns = 0;
+
+	bool playing = false;
+	// encode behind the mesh's framing so packets are sent without a copy
+	std::vector<uint8_t> storage(sender->packetHeadroom() + 1200 + sender->packetTailroom());
+	for (elapsedUS = 0; elapsedUS < c_runUS; elapsedUS += c_stepUS)
+	{
+		sender->update();
+		for (;;)
+		{
+			PacketBuffer packet;
+			packetInit(&packet, storage.data(), static_cast<uint32_t>(storage.size()), sender->packetHeadroom(), sender->packetTailroom());
+			if (!encoder.generatePacket(&packet))
+				break;
+
+			sender->sendUnreliablePacketToPeer(toReceiver, &packet);
+		}
+
+		receiver->update();
+		Message** messages;
+		uint32_t nmessages;
+		if (receiver->receive(fromSender, &messages, &nmessages))
+		{
+			for (uint32_t ii = 0; ii < nmessages; ++ii)
+			{
+				decoder.processPacket(&source, messages[ii]->data, messages[ii]->ndata);
+			}
+		}
+
+		// keep the render device fed once enough audio arrived
+		float* buffer;
+		while (render.acquireBuffer(&buffer) > 0)
+		{
+			const float* samples;
+			uint32_t available = source.getSourceAudio(&samples);
+			if (!playing && available >= c_prebufferSamples)
+			{
+				playing = true;
+			}
+
+			if (!playing)
+			{
+				available = 0;
+			}
+			else if (available < static_cast<uint32_t>(c_samplesPer10ms))
+			{
+				++result.sourceUnderruns;
+			}
+			else
+			{
+				available = c_samplesPer10ms;
+			}
+
+			for (int ii = 0; ii < c_samplesPer10ms; ++ii)
+			{
+				const float s = ii < static_cast<int>(available) ? samples[ii] : 0.0f;
+				buffer[2*ii] = s;
+				buffer[2*ii + 1] = s;
+			}
+
+			const int queued = render.queuedSamples();
+			render.commitBuffer();
+			if (playing)
+			{
+				source.consumeSourceAudio(available, static_cast<uint32_t>(queued));
+			}
+		}
+
+		sim->advance(c_stepUS);
+	}
+
+	voice::LatencyStats received;
+	source.latencyStats(&received);
+
+	sender->destroy();
+	receiver->destroy();
+	clockInstall(nullptr);
+	sim->destroy();
+
+	measureChirps(capture, render, &result);
+	result.deviceUnderruns = render.underruns;
+	result.dropouts = countDropouts(render.played);
+	result.clicks = countClicks(render.played);
+
+	bench::report(name, "latency_p50", bench::percentile(result.latencyMS, 0.50), "ms");
+	bench::report(name, "latency_p95", bench::percentile(result.latencyMS, 0.95), "ms");
+	bench::report(name, "latency_max", bench::percentile(result.latencyMS, 1.0), "ms");
+	bench::report(name, "chirps_lost", static_cast<double>(result.chirpsLost), "chirps");
+	bench::report(name, "source_underruns", static_cast<double>(result.sourceUnderruns), "buffers");
+	bench::report(name, "device_underruns", static_cast<double>(result.deviceUnderruns), "buffers");
+	bench::report(name, "dropouts", static_cast<double>(result.dropouts), "gaps");
+	bench::report(name, "clicks", static_cast<double>(result.clicks), "samples");
+	bench::report(name, "mouth_to_ear_p50", voice::latencyPercentile(received.stages[voice::LatencyStage::MouthToEar], 0.5f) / 1000.0, "ms");
+	bench::report(name, "wall_time", bench::secondsSince(wallStart), "s");
+}
+
+int main()
+{
+	if (!platformStartup())
+		return -1;
+
+	LinkConditions link;
+	memset(&link, 0, sizeof(link));
+
+	link.latencyUS = 20000;
+	benchLoopback("voice_loopback.clean", link, 1);
+
+	link.jitterUS = 30000;
+	benchLoopback("voice_loopback.jitter_30", link, 2);
+
+	link.jitterUS = 10000;
+	link.loss = 0.05f;
+	link.reorder = 0.01f;
+	link.reorderUS = 20000;
+	benchLoopback("voice_loopback.loss_5", link, 3);
+
+	platformShutdown();
+}
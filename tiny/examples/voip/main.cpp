@@ -28,7 +28,9 @@
 #include <tiny/audio/capture.h>
 #include <tiny/audio/render.h>
 #include <tiny/voice/engine.h>
+#include <tiny/voice/latency.h>
 #include <tiny/voice/source.h>
+#include <tiny/voice/trace.h>
 
 #include <stdio.h>
 #include <time.h>
@@ -36,7 +38,9 @@
 using namespace tiny;
 using namespace tiny::audio;
 
-int main()
+// usage: voip [trace]
+// if `trace' is given, received packets are recorded there for replay
+int main(int argc, char** argv)
 {
 	if (!platformStartup())
 		return -1;
@@ -58,6 +62,10 @@ int main()
 
 	voice::Source vsource;
 	engine.addSource(&vsource);
+	engine.setSendTimestamps(true);
+
+	voice::PacketTraceWriter* trace = argc > 1 ? voice::packetTraceCreate(argv[1]) : nullptr;
+	engine.setPacketTrace(trace);
 
 	uint8_t packet[4000];
 	const time_t end = time(nullptr)+10;
@@ -98,11 +106,34 @@ int main()
 			}
 			buffer[2*ii+1] = buffer[2*ii];
 		}
-		vsource.consumeSourceAudio(samplesAvailable);
+		vsource.consumeSourceAudio(samplesAvailable, static_cast<uint32_t>(speaker->queuedSamples()));
 
 		speaker->commitBuffer();
 	}
 
+	static const char* const stageNames[voice::LatencyStage::Count] = {
+		"capture queue", "processing", "encode", "network", "decode", "jitter buffer", "render queue", "mouth to ear",
+	};
+
+	voice::LatencyStats sent;
+	voice::LatencyStats received;
+	engine.latencyStats(&sent);
+	vsource.latencyStats(&received);
+	for (int ii = 0; ii < voice::LatencyStage::Count; ++ii)
+	{
+		const voice::LatencyHistogram& h = sent.stages[ii].count ? sent.stages[ii] : received.stages[ii];
+		printf("%-14s p50 %6.2fms  p99 %6.2fms  max %6.2fms\n", stageNames[ii]
+			, voice::latencyPercentile(h, 0.5f) / 1000.0
+			, voice::latencyPercentile(h, 0.99f) / 1000.0
+			, h.maxUs / 1000.0);
+	}
+
+	engine.setPacketTrace(nullptr);
+	if (trace)
+	{
+		voice::packetTraceDestroy(trace);
+	}
+
 	engine.removeSource(&vsource);
 	speaker->release();
 	mic->release();
@@ -32,6 +32,7 @@
 #include <tiny/audio/capture.h>
 #include <tiny/audio/render.h>
 #include <tiny/audio/resample.h>
+#include <tiny/net/packet.h>
 #include <tiny/platform.h>
 #include <tiny/sleep.h>
 #include <tiny/time.h>
@@ -130,10 +131,12 @@ int main()
 	uint8_t voicePacket[1200];
 	for (;;)
 	{
-		uint32_t nvoicePacket = engine.generatePacket(voicePacket, sizeof(voicePacket));
-		if (nvoicePacket)
+		// no mesh in between, so the packet needs no headroom or tailroom
+		net::PacketBuffer pb;
+		net::packetInit(&pb, voicePacket, sizeof(voicePacket), 0, 0);
+		if (engine.generatePacket(&pb))
 		{
-			engine.processPacket(&source, voicePacket, nvoicePacket);
+			engine.processPacket(&source, net::packetData(pb), net::packetSize(pb));
 		}
 
 		std::vector<float> data = source.takeAllSourceAudio();
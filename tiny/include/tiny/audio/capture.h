@@ -47,6 +47,11 @@ namespace tiny
 
 			virtual const float* get10msOfSamples() = 0;
 
+			// `timestampCurrent' at which the first sample of the block last
+			// returned by `get10msOfSamples' was captured, or 0 if the
+			// device can't tell
+			virtual uint64_t captureTimestamp() const = 0;
+
 		protected:
 			virtual ~ICaptureDevice() = 0;
 		};
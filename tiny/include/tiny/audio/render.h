@@ -47,6 +47,10 @@ namespace tiny
 			virtual void commitBuffer() = 0;
 			virtual void discardBuffer() = 0;
 
+			// samples committed with `commitBuffer' that have not been
+			// played yet, including any buffered by the device itself
+			virtual int queuedSamples() = 0;
+
 		protected:
 			virtual ~IRenderDevice() = 0;
 		};
@@ -0,0 +1,69 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TINY__CPU_H
+#define TINY__CPU_H
+
+#include <stdint.h>
+
+#if !defined(TINY_CPU_X86)
+#	if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#		define TINY_CPU_X86 1
+#	else
+#		define TINY_CPU_X86 0
+#	endif // _M_IX86 || _M_X64 || __i386__ || __x86_64__
+#endif // ... TINY_CPU_X86
+
+namespace tiny
+{
+	// instruction set extensions kernels are selected on at runtime
+	struct CpuFeature
+	{
+		enum E
+		{
+			SSE2 = 1 << 0,
+			AVX2 = 1 << 1,
+			SSSE3 = 1 << 2,
+			SSE41 = 1 << 3,
+			// SHA-1 and SHA-256 extensions
+			SHA = 1 << 4,
+			// carry-less multiply (PCLMULQDQ)
+			PCLMUL = 1 << 5,
+		};
+	};
+
+	// `CpuFeature' bits supported by the executing CPU (and enabled by the
+	// OS), less any removed with `cpuFeaturesRestrict'. cheap enough to
+	// call per operation
+	uint32_t cpuFeatures();
+
+	// limit the features kernels are selected on to those in `mask', e.g.
+	// to compare a SIMD kernel against its scalar fallback. pass ~0u to
+	// lift the restriction
+	void cpuFeaturesRestrict(uint32_t mask);
+}
+
+#endif // TINY__CPU_H
@@ -0,0 +1,63 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef TINY_CRYPTO__CHACHA20POLY1305_H
+#define TINY_CRYPTO__CHACHA20POLY1305_H
+
+#include <stdint.h>
+
+namespace tiny
+{
+	namespace crypto
+	{
+		// ChaCha20-Poly1305 AEAD (RFC 8439)
+		struct chacha20poly1305_key
+		{
+			static const uint32_t KEY_SIZE = 32;
+			static const uint32_t NONCE_SIZE = 12;
+			static const uint32_t TAG_SIZE = 16;
+
+			uint32_t k[8];
+		};
+
+		void chacha20poly1305_key_init(chacha20poly1305_key* key, const uint8_t p[chacha20poly1305_key::KEY_SIZE]);
+
+		// encrypt `n' bytes of `in' into `out', which may be `in', and
+		// compute `tag' over the additional data `ad' and the ciphertext.
+		// a nonce must never be used twice with the same key
+		void chacha20poly1305_seal(const chacha20poly1305_key* key, const uint8_t nonce[chacha20poly1305_key::NONCE_SIZE]
+			, const void* ad, uint32_t nad, const void* in, void* out, uint32_t n
+			, uint8_t tag[chacha20poly1305_key::TAG_SIZE]);
+
+		// verify `tag' over `ad' and the ciphertext `in', then decrypt it
+		// into `out', which may be `in'. returns `false' without touching
+		// `out' if the tag doesn't match
+		bool chacha20poly1305_open(const chacha20poly1305_key* key, const uint8_t nonce[chacha20poly1305_key::NONCE_SIZE]
+			, const void* ad, uint32_t nad, const void* in, void* out, uint32_t n
+			, const uint8_t tag[chacha20poly1305_key::TAG_SIZE]);
+	}
+}
+
+#endif // TINY_CRYPTO__CHACHA20POLY1305_H
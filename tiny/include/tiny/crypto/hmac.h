@@ -47,6 +47,35 @@ namespace tiny
 		void hmac_sha1_add(hmac_sha1_state* st, const void* p, uint32_t n);
 		void hmac_sha1_end(hmac_sha1_state* st, uint8_t digest[hmac_sha1_state::DIGEST_SIZE]);
 		bool hmac_sha1_digest_equal(const uint8_t* digest1, uint32_t ndigest1, const uint8_t* digest2, uint32_t ndigest2);
+
+		// HMAC-SHA1 key with its padded blocks hashed once up front, two
+		// fewer compressions per message than `hmac_sha1_begin'
+		struct hmac_sha1_key
+		{
+			uint32_t inner[5];
+			uint32_t outer[5];
+		};
+
+		// a message hashed as `prefix' followed by `p'. `nprefix' may be 0
+		struct hmac_sha1_input
+		{
+			const void* prefix;
+			const void* p;
+			uint32_t nprefix;
+			uint32_t n;
+		};
+
+		void hmac_sha1_key_init(hmac_sha1_key* key, const uint8_t* p, uint32_t n);
+
+		// compute the digests of `ninputs' independent messages under
+		// `key' into `digests'. messages are hashed in parallel SIMD lanes
+		// (8 with AVX2, 4 with SSE2) and are best batched by similar
+		// length. CPUs with the SHA extensions hash them one at a time
+		void hmac_sha1_batch(const hmac_sha1_key* key, const hmac_sha1_input* inputs, uint32_t ninputs
+			, uint8_t (*digests)[hmac_sha1_state::DIGEST_SIZE]);
+
+		// number of messages `hmac_sha1_batch' hashes at once on this CPU
+		uint32_t hmac_sha1_batch_width();
 	}
 }
 
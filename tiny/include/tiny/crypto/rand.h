@@ -36,12 +36,29 @@ namespace tiny
 	{
 		struct CryptoRandSource
 		{
+			static const uint32_t BUFFER_SIZE = 512;
+
 			void* platformHandle;
 			std::mt19937 fallback;
+
+			// fast-key-erasure ChaCha20 generator seeded from the platform,
+			// see `crandFill'
+			uint32_t key[8];
+			uint8_t buffer[BUFFER_SIZE];
+			uint32_t available; // unread bytes at the end of `buffer'
+			uint32_t untilReseed; // bytes
+			uint64_t reseedAt; // timestamp
 		};
 
 		void crandInit(CryptoRandSource* s);
 		void crandDestroy(CryptoRandSource* s);
+
+		// fill `p' with `n' random bytes. output comes from a ChaCha20
+		// generator whose key is replaced by its own output on every
+		// refill, so earlier output can't be recovered from the state. it
+		// is reseeded from the platform provider after a fixed amount of
+		// output or time; small requests are served from a buffer without
+		// a system call
 		void crandFill(CryptoRandSource* s, uint8_t* p, uint32_t n);
 	}
 }
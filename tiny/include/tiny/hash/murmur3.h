@@ -28,6 +28,8 @@
 #define TINY_HASH__MURMUR3_H
 
 #include <stdint.h>
+#include <string.h>
+#include "tiny/endian.h"
 
 namespace tiny
 {
@@ -47,6 +49,123 @@ namespace tiny
 		void murmur3_begin(murmur3_state* st, uint32_t seed = 0);
 		void murmur3_add(murmur3_state* st, const void* p, uint32_t n);
 		uint32_t murmur3_end(const murmur3_state* st);
+
+		// 128 bit MurmurHash3, x64 variant. `h1' alone serves as a 64 bit
+		// hash
+		struct murmur3_128
+		{
+			uint64_t h1;
+			uint64_t h2;
+		};
+
+		murmur3_128 murmur3_x64_128(const void* p, uint32_t n, uint32_t seed = 0);
+
+		static inline uint64_t murmur3_x64_64(const void* p, uint32_t n, uint32_t seed = 0)
+		{
+			return murmur3_x64_128(p, n, seed).h1;
+		}
+
+		// hash `nkeys' keys of `keySize' bytes each, `stride' bytes apart,
+		// into `out'. common key sizes (8, 16, 28 and 32 bytes) take the
+		// fixed size path and independent keys are interleaved, so the
+		// multiply chains of several keys overlap
+		void murmur3_x64_128_batch(const void* keys, uint32_t keySize, uint32_t stride, uint32_t nkeys
+			, murmur3_128* out, uint32_t seed = 0);
+
+		namespace detail
+		{
+			static const uint64_t murmur3_c1 = 0x87C37B91114253D5ull;
+			static const uint64_t murmur3_c2 = 0x4CF5AD432745937Full;
+
+			static inline uint64_t murmur3_rotl64(uint64_t x, int r)
+			{
+				return (x << r) | (x >> (64 - r));
+			}
+
+			static inline uint64_t murmur3_load64(const uint8_t* p)
+			{
+				uint64_t v;
+				memcpy(&v, p, sizeof(v));
+				return edianFromLittle(v);
+			}
+
+			static inline uint64_t murmur3_fmix64(uint64_t k)
+			{
+				k ^= k >> 33;
+				k *= 0xFF51AFD7ED558CCDull;
+				k ^= k >> 33;
+				k *= 0xC4CEB9FE1A85EC53ull;
+				k ^= k >> 33;
+				return k;
+			}
+
+			static inline void murmur3_blocks(murmur3_128* h, const uint8_t* p, uint32_t nblocks)
+			{
+				for (uint32_t ii = 0; ii < nblocks; ++ii, p += 16)
+				{
+					uint64_t k1 = murmur3_load64(p);
+					uint64_t k2 = murmur3_load64(p + 8);
+
+					k1 *= murmur3_c1; k1 = murmur3_rotl64(k1, 31); k1 *= murmur3_c2; h->h1 ^= k1;
+					h->h1 = murmur3_rotl64(h->h1, 27); h->h1 += h->h2; h->h1 = h->h1 * 5 + 0x52DCE729;
+
+					k2 *= murmur3_c2; k2 = murmur3_rotl64(k2, 33); k2 *= murmur3_c1; h->h2 ^= k2;
+					h->h2 = murmur3_rotl64(h->h2, 31); h->h2 += h->h1; h->h2 = h->h2 * 5 + 0x38495AB5;
+				}
+			}
+
+			// the last `n' (< 16) bytes, then finalization of a `len' byte key
+			static inline void murmur3_tail(murmur3_128* h, const uint8_t* p, uint32_t n, uint32_t len)
+			{
+				uint64_t k1 = 0;
+				uint64_t k2 = 0;
+				switch (n)
+				{
+				case 15: k2 ^= static_cast<uint64_t>(p[14]) << 48; // fallthrough
+				case 14: k2 ^= static_cast<uint64_t>(p[13]) << 40; // fallthrough
+				case 13: k2 ^= static_cast<uint64_t>(p[12]) << 32; // fallthrough
+				case 12: k2 ^= static_cast<uint64_t>(p[11]) << 24; // fallthrough
+				case 11: k2 ^= static_cast<uint64_t>(p[10]) << 16; // fallthrough
+				case 10: k2 ^= static_cast<uint64_t>(p[9]) << 8; // fallthrough
+				case 9: k2 ^= static_cast<uint64_t>(p[8]);
+					k2 *= murmur3_c2; k2 = murmur3_rotl64(k2, 33); k2 *= murmur3_c1; h->h2 ^= k2; // fallthrough
+				case 8: k1 ^= static_cast<uint64_t>(p[7]) << 56; // fallthrough
+				case 7: k1 ^= static_cast<uint64_t>(p[6]) << 48; // fallthrough
+				case 6: k1 ^= static_cast<uint64_t>(p[5]) << 40; // fallthrough
+				case 5: k1 ^= static_cast<uint64_t>(p[4]) << 32; // fallthrough
+				case 4: k1 ^= static_cast<uint64_t>(p[3]) << 24; // fallthrough
+				case 3: k1 ^= static_cast<uint64_t>(p[2]) << 16; // fallthrough
+				case 2: k1 ^= static_cast<uint64_t>(p[1]) << 8; // fallthrough
+				case 1: k1 ^= static_cast<uint64_t>(p[0]);
+					k1 *= murmur3_c1; k1 = murmur3_rotl64(k1, 31); k1 *= murmur3_c2; h->h1 ^= k1;
+				}
+
+				h->h1 ^= len;
+				h->h2 ^= len;
+				h->h1 += h->h2;
+				h->h2 += h->h1;
+				h->h1 = murmur3_fmix64(h->h1);
+				h->h2 = murmur3_fmix64(h->h2);
+				h->h1 += h->h2;
+				h->h2 += h->h1;
+			}
+		}
+
+		// `murmur3_x64_128' of a key of a size known at compile time, such
+		// as the storage of a `PlatformSocketAddr'. inlined, with the loop
+		// and tail branches folded away
+		template<uint32_t N>
+		static inline murmur3_128 murmur3_x64_128_fixed(const void* p, uint32_t seed = 0)
+		{
+			const uint8_t* bytes = static_cast<const uint8_t*>(p);
+
+			murmur3_128 h;
+			h.h1 = seed;
+			h.h2 = seed;
+			detail::murmur3_blocks(&h, bytes, N / 16);
+			detail::murmur3_tail(&h, bytes + (N & ~15u), N & 15, N);
+			return h;
+		}
 	}
 }
 
@@ -0,0 +1,102 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TINY_NET__ENGINE_H
+#define TINY_NET__ENGINE_H
+
+#include <stdint.h>
+#include "tiny/net/socket.h"
+#include "tiny/time.h"
+
+namespace tiny
+{
+	namespace net
+	{
+		struct SocketEngineType
+		{
+			enum E
+			{
+				// plain non-blocking sockets (socket.h)
+				Platform,
+				// registered buffers with kernel-side receive queues and
+				// batched submissions. Windows RIO
+				RegisteredIO,
+			};
+		};
+
+		// socket I/O backend. all sockets created by an engine must be
+		// used and closed through that engine.
+		class ISocketEngine
+		{
+		public:
+			virtual void release() = 0;
+
+			virtual SocketEngineType::E type() const = 0;
+
+			// addresses sockets of this engine may be bound to, see
+			// `enumerateAdapters'
+			virtual uint32_t adapters(Address* addresses, uint32_t naddresses) = 0;
+
+			// the clock users of this engine time their traffic by. owned by
+			// the engine
+			virtual IClock* clock() = 0;
+
+			virtual bool createUDP(Socket* out, const Address& addr, uint16_t* bePort) = 0;
+			virtual void close(Socket s) = 0;
+
+			virtual bool sendTo(Socket s, const ConstBuffer* buffers, uint32_t nbuffers, const PlatformSocketAddr& addr) = 0;
+
+			// receive up to `ndatagrams' datagrams. on return, `p' of each
+			// received datagram may have been redirected to engine-owned
+			// memory that stays valid until the next `recvBatch' on `s'.
+			virtual uint32_t recvBatch(Socket s, Datagram* datagrams, uint32_t ndatagrams) = 0;
+			virtual bool operationWouldHaveBlocked() = 0;
+
+			// sends issued between `sendBatchBegin' and `sendBatchEnd' may be
+			// queued and submitted to the kernel together
+			virtual void sendBatchBegin() = 0;
+			virtual void sendBatchEnd() = 0;
+
+			// block until a socket of this engine may have data to read,
+			// `wake' is called or `timeoutMS' elapses. `wake' may be called
+			// from any thread
+			virtual void wait(uint32_t timeoutMS) = 0;
+			virtual void wake() = 0;
+
+		protected:
+			virtual ~ISocketEngine() = 0;
+		};
+
+		// create a socket engine of type `type'. falls back to the platform
+		// engine if `type' is not supported by the host.
+		ISocketEngine* socketEngineCreate(SocketEngineType::E type);
+
+		ISocketEngine* socketEngineCreatePlatform();
+		ISocketEngine* socketEngineCreateRegisteredIO();
+	}
+}
+
+#endif // TINY_NET__ENGINE_H
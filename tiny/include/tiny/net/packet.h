@@ -0,0 +1,113 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TINY_NET__PACKET_H
+#define TINY_NET__PACKET_H
+
+#include <assert.h>
+#include <stdint.h>
+
+namespace tiny
+{
+	namespace net
+	{
+		// a contiguous packet buffer with reserved space in front of
+		// (headroom) and behind (tailroom) the payload. producers write
+		// the payload in place, then lower layers add their header and
+		// trailer around it without copying the payload.
+		//
+		//  base      head          tail      limit       capacity
+		//   |headroom |   payload   | writable |  tailroom  |
+		struct PacketBuffer
+		{
+			uint8_t* base;
+			uint32_t head;
+			uint32_t tail;
+			uint32_t limit;
+			uint32_t capacity;
+		};
+
+		// initialize a packet over `storage', reserving `headroom' bytes
+		// in front of the payload and `tailroom' bytes after it
+		static inline bool packetInit(PacketBuffer* pb, uint8_t* storage, uint32_t capacity, uint32_t headroom, uint32_t tailroom)
+		{
+			if (headroom + tailroom > capacity)
+				return false;
+
+			pb->base = storage;
+			pb->head = headroom;
+			pb->tail = headroom;
+			pb->limit = capacity - tailroom;
+			pb->capacity = capacity;
+			return true;
+		}
+
+		// first byte of the payload
+		static inline uint8_t* packetData(const PacketBuffer& pb)
+		{
+			return pb.base + pb.head;
+		}
+
+		// number of payload bytes written so far
+		static inline uint32_t packetSize(const PacketBuffer& pb)
+		{
+			return pb.tail - pb.head;
+		}
+
+		// next payload byte to be written
+		static inline uint8_t* packetEnd(const PacketBuffer& pb)
+		{
+			return pb.base + pb.tail;
+		}
+
+		// number of payload bytes that may still be written at `packetEnd'
+		static inline uint32_t packetWritable(const PacketBuffer& pb)
+		{
+			return pb.limit - pb.tail;
+		}
+
+		// extend the payload by `n' bytes already written at `packetEnd'
+		static inline void packetCommit(PacketBuffer* pb, uint32_t n)
+		{
+			assert(n <= packetWritable(*pb));
+			pb->tail += n;
+		}
+
+		// bytes reserved in front of the payload
+		static inline uint32_t packetHeadroom(const PacketBuffer& pb)
+		{
+			return pb.head;
+		}
+
+		// bytes available behind the payload, including the reserved tailroom
+		static inline uint32_t packetTailroom(const PacketBuffer& pb)
+		{
+			return pb.capacity - pb.tail;
+		}
+	}
+}
+
+#endif // TINY_NET__PACKET_H
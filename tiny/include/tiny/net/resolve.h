@@ -27,14 +27,48 @@
 #ifndef TINY_NET__RESOLVE_H
 #define TINY_NET__RESOLVE_H
 
+#include "tiny/net/address.h"
+
 namespace tiny
 {
 	namespace net
 	{
-		struct Address4;
-		struct Address6;
-
 		bool resolveHost(Address4* out4, Address6* out6, const char* hostname);
+
+		// parse a numeric IPv4 or IPv6 literal. never touches DNS
+		bool resolveNumericHost(Address* out, const char* hostname);
+
+		struct ResolveState
+		{
+			enum E
+			{
+				Pending,
+				Resolved,
+				Failed,
+			};
+		};
+
+		struct ResolvedHost
+		{
+			Address4 v4;
+			Address6 v6;
+			bool hasV4;
+			bool hasV6;
+		};
+
+		struct ResolveRequest;
+
+		// start resolving `hostname' without blocking the calling thread.
+		// numeric literals and names in the process-wide cache complete
+		// immediately; other names are looked up on a background thread
+		// and cached for later requests. release the request with
+		// `resolveRelease'
+		ResolveRequest* resolveHostAsync(const char* hostname);
+
+		// current state of `request'. fills `out' once resolved
+		ResolveState::E resolvePoll(ResolveRequest* request, ResolvedHost* out);
+
+		void resolveRelease(ResolveRequest* request);
 	}
 }
 
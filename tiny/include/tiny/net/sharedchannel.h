@@ -0,0 +1,80 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TINY_NET__SHAREDCHANNEL_H
+#define TINY_NET__SHAREDCHANNEL_H
+
+#include <stdint.h>
+#include "tiny/net/socket.h"
+
+namespace tiny
+{
+	namespace net
+	{
+		// bidirectional datagram channel between two processes on the same
+		// host, backed by a pair of single-producer single-consumer rings
+		// in named shared memory. each side is one producer and one
+		// consumer; the channel itself is not thread safe. only processes
+		// of the current user can open it, datagrams are otherwise not
+		// authenticated.
+		struct SharedChannel;
+
+		// a datagram read from the channel. points into the shared ring and
+		// stays valid until `sharedChannelRelease'
+		struct SharedDatagram
+		{
+			uint8_t* p;
+			uint32_t len;
+		};
+
+		// open (or create) the channel `name' as `side' (0 or 1). both
+		// sides must agree on the name and pick different sides.
+		SharedChannel* sharedChannelOpen(const char* name, uint32_t side);
+		void sharedChannelClose(SharedChannel* channel);
+
+		// `true' while the other side has the channel open and has not
+		// written a malformed record
+		bool sharedChannelConnected(SharedChannel* channel);
+
+		// gather `buffers' into a single datagram. returns `false' if the
+		// ring is full or the datagram is too large
+		bool sharedChannelSend(SharedChannel* channel, const ConstBuffer* buffers, uint32_t nbuffers);
+
+		// views of up to `ndatagrams' datagrams that arrived since the last
+		// read. the ring space is only returned to the sender by
+		// `sharedChannelRelease', so views stay valid until then. views
+		// always lie within the ring; reading stops for good at a record
+		// that doesn't
+		uint32_t sharedChannelRead(SharedChannel* channel, SharedDatagram* datagrams, uint32_t ndatagrams);
+		void sharedChannelRelease(SharedChannel* channel);
+
+		// release everything read so far, then block until there is unread
+		// data or `timeoutMS' elapses. returns `true' if data is available
+		bool sharedChannelWait(SharedChannel* channel, uint32_t timeoutMS);
+	}
+}
+
+#endif // TINY_NET__SHAREDCHANNEL_H
@@ -0,0 +1,124 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TINY_NET__SIMULATOR_H
+#define TINY_NET__SIMULATOR_H
+
+#include <stdint.h>
+#include "tiny/net/address.h"
+#include "tiny/time.h"
+
+namespace tiny
+{
+	namespace net
+	{
+		class ISocketEngine;
+
+		// filtering of a simulated host's NAT, RFC 4787 terms
+		struct NatType
+		{
+			enum E
+			{
+				// the host's address is public
+				None,
+				// one mapping per local port, anyone may send to it
+				FullCone,
+				// one mapping per local port, only addresses the host sent to may reply
+				AddressRestricted,
+				// one mapping per local port, only address and port pairs the host sent to may reply
+				PortRestricted,
+				// one mapping per local port and destination, only that destination may reply
+				Symmetric,
+			};
+		};
+
+		// impairments of a host's access link, applied to every datagram
+		// the host sends and receives
+		struct LinkConditions
+		{
+			uint32_t latencyUS; // one way
+			uint32_t jitterUS; // uniform, added to `latencyUS'
+			uint32_t reorderUS; // extra delay of reordered datagrams
+			float loss; // 0..1
+			float duplicate; // 0..1
+			float reorder; // 0..1
+		};
+
+		struct SimulatorStats
+		{
+			uint64_t sent;
+			uint64_t delivered;
+			uint64_t lost;
+			uint64_t duplicated;
+			uint64_t filtered; // dropped by a NAT
+			uint64_t unroutable; // no host at the destination address
+		};
+
+		// deterministic in-process network. hosts are socket engines that
+		// route datagrams to each other with simulated latency, loss and
+		// NAT behaviour instead of touching the network. time is virtual:
+		// it only moves in `advance', so a simulation runs as fast as the
+		// code under test allows and repeats exactly for the same seed.
+		// the simulator is driven from a single thread; it is locked so
+		// meshes may close sockets from their cleanup threads.
+		class INetworkSimulator
+		{
+		public:
+			virtual void destroy() = 0;
+
+			// add a host. `privateAddr' is the address its sockets bind
+			// to; if `nat' is not `NatType::None' it reaches others as
+			// `publicAddr'. pass the returned engine to `meshCreateICE';
+			// the host lives until the engine is released
+			virtual ISocketEngine* createHost(const Address& privateAddr, const Address& publicAddr
+				, NatType::E nat, const LinkConditions& link) = 0;
+
+			// answer STUN binding requests sent to `addr':`port' (host order)
+			virtual void addStunServer(const Address& addr, uint16_t port) = 0;
+
+			// the virtual clock, microsecond resolution. hosts report it as
+			// their clock, so meshes on them run on virtual time; install
+			// it with `clockInstall' only for code that reads
+			// `timestampCurrent' directly. `IClock::sleep' advances the
+			// simulation on the thread that created it and sleeps in real
+			// time on any other thread
+			virtual IClock* clock() = 0;
+
+			// move virtual time forward by `microseconds', delivering every
+			// datagram that arrives until then
+			virtual void advance(uint64_t microseconds) = 0;
+
+			virtual void stats(SimulatorStats* out) = 0;
+
+		protected:
+			virtual ~INetworkSimulator() = 0;
+		};
+
+		INetworkSimulator* networkSimulatorCreate(uint64_t seed);
+	}
+}
+
+#endif // TINY_NET__SIMULATOR_H
@@ -55,14 +55,56 @@ namespace tiny
 #endif
 		};
 
+		// a single datagram slot for batched receives. `p' and `capacity'
+		// are supplied by the caller, `len' and `addr' are filled in by
+		// `socketRecvBatch'
+		struct Datagram
+		{
+			uint8_t* p;
+			uint32_t capacity;
+			uint32_t len;
+			PlatformSocketAddr addr;
+		};
+
 		// allocate a socket
 		bool socketCreateUDP(Socket* out, const Address& addr, uint16_t* bePort);
 		void socketClose(Socket s);
 
 		bool socketSendTo(Socket s, const ConstBuffer* buffers, uint32_t nbuffers, const PlatformSocketAddr& addr);
 		int32_t socketRecvFrom(Socket s, uint8_t* buffer, int32_t nbuffer, PlatformSocketAddr* addr);
+
+		// receive up to `ndatagrams' pending datagrams directly into the
+		// caller's slots. returns the number of datagrams received; stops at
+		// the first failed receive, use `socketOperationWouldHaveBlocked' to
+		// tell an empty socket from an error.
+		uint32_t socketRecvBatch(Socket s, Datagram* datagrams, uint32_t ndatagrams);
 		bool socketOperationWouldHaveBlocked();
 
+		// block until `s' has data to read or `timeoutMS' elapses. returns
+		// `true' if data is available. several threads may wait on and
+		// read from the same socket.
+		bool socketWaitReadable(Socket s, uint32_t timeoutMS);
+
+		// block until any of the `n' sockets in `s' has data to read or
+		// `timeoutMS' elapses. `readable[i]' is set for every socket with
+		// pending data; returns the number of such sockets.
+		uint32_t socketWaitReadable(const Socket* s, bool* readable, uint32_t n, uint32_t timeoutMS);
+
+		// an event that is signaled when a socket attached to it becomes
+		// readable, or when `socketEventSignal' is called from any thread.
+		// a socket may only be attached to a single event.
+		typedef uintptr_t SocketEvent;
+		static const SocketEvent InvalidSocketEvent = 0;
+
+		bool socketEventCreate(SocketEvent* out);
+		void socketEventDestroy(SocketEvent e);
+		bool socketEventAttach(SocketEvent e, Socket s);
+		void socketEventSignal(SocketEvent e);
+
+		// block until `e' is signaled or `timeoutMS' elapses, then reset it.
+		// returns `true' if the event was signaled
+		bool socketEventWait(SocketEvent e, uint32_t timeoutMS);
+
 		// create a platform socket address from an IP address and port
 		void addressFrom(PlatformSocketAddr* out, const Address& addr, uint16_t bePort);
 		void addressTo(Address* out, uint16_t* outBePort, const PlatformSocketAddr& addr);
@@ -28,12 +28,20 @@
 #define TINY_PEER__MESH_H
 
 #include <stdint.h>
+#include "tiny/net/engine.h"
 
 namespace tiny
 {
+	namespace net
+	{
+		struct PacketBuffer;
+	}
+
 	namespace peer
 	{
 		struct Message;
+		struct MeshStats;
+		struct PeerStats;
 
 		struct MeshState
 		{
@@ -60,6 +68,12 @@ namespace tiny
 
 		static const uint32_t InvalidMeshPeer = 0xFFFFFFFF;
 
+		struct StunServer
+		{
+			const char* host;
+			uint16_t port;
+		};
+
 		// peer-to-peer mesh interface
 		class IMesh
 		{
@@ -77,6 +91,24 @@ namespace tiny
 			// to aid in NAT traversal.
 			virtual bool startSession(const char* stunHost, uint16_t stunPort) = 0;
 
+			// same as above, but queries every server in `servers' to obtain
+			// server reflexive candidates. host names are resolved in the
+			// background. the first valid response per candidate wins, and
+			// the observed response times of servers order the attempts of
+			// later sessions.
+			virtual bool startSession(const StunServer* servers, uint32_t nservers) = 0;
+
+			// use the relay server at `host':`port' (see `relayServerCreate')
+			// as a last resort for peers that can't be reached directly. the
+			// mesh allocates a relayed address while gathering and publishes
+			// it as a relay candidate, which ICE only nominates when no
+			// direct pair succeeds. `key' authenticates the mesh with the
+			// server. if `relayOnly' is set, only the relayed address is
+			// published and checked. takes effect on the next
+			// `startSession'; passing a `nullptr' host disables the relay.
+			virtual void setRelayServer(const char* host, uint16_t port
+				, const uint8_t* key, uint32_t nkey, bool relayOnly) = 0;
+
 			// sets the session key for the peer-to-peer session. any client
 			// connecting to this mesh will need to have the same key set
 			// before `connectToPeer' is called. key distribution must
@@ -86,14 +118,22 @@ namespace tiny
 			// remote peers attempt to connect
 			virtual void setSessionKey(const uint8_t* key, int nkey) = 0;
 
+			// encrypt media sent from now on with ChaCha20-Poly1305 under
+			// per-connection keys derived from the session key, instead of
+			// only authenticating it with HMAC-SHA1. either format is
+			// accepted on receipt, and `packetHeadroom' and `packetTailroom'
+			// cover both. off by default
+			virtual void setMediaEncryption(bool encrypt) = 0;
+
 			// end a running peer-to-peer session
 			virtual void endSession() = 0;
 
 			// acquires the number of bytes needed to serialize the local
 			// address of the peer mesh. this address is platform specific
 			// and may map to multiple host or reflexive addresses. this
-			// function will return 0 until `update' returns a state
-			// of `MeshState::StartComplete' or `MeshState::Running'
+			// function will return 0 until `startSession' succeeds. while
+			// the mesh is `MeshState::Starting' the address only carries
+			// the candidates gathered so far; see `localAddressSizeFrom'
 			virtual uint32_t localAddressSize() = 0;
 
 			// serialize the local address of the peer mesh to a binary stream.
@@ -101,11 +141,33 @@ namespace tiny
 			// `out'
 			virtual void serializeLocalAddress(uint8_t* out) = 0;
 
+			// number of local candidates gathered so far. candidates are
+			// only ever appended, so a count previously returned can be
+			// passed to `localAddressSizeFrom' to trickle the candidates
+			// discovered since then. returns 0 until `startSession' succeeds
+			virtual uint32_t localCandidateCount() = 0;
+
+			// same as `localAddressSize' and `serializeLocalAddress', but
+			// only for the local candidates starting at index `first'. the
+			// result is suitable for `addRemoteCandidates' on the remote
+			// mesh. `serializeLocalAddressFrom' must be called with the same
+			// `first' and without an intervening `update'
+			virtual uint32_t localAddressSizeFrom(uint32_t first) = 0;
+			virtual void serializeLocalAddressFrom(uint32_t first, uint8_t* out) = 0;
+
 			// start the process of connecting to a peer. returns an index
-			// to the connection
+			// to the connection. may be called as soon as `startSession'
+			// succeeds; `remoteAddress' may hold a partial candidate list
 			virtual uint32_t connectToPeer(uint64_t remoteId
 				, const uint8_t* remoteAddress, uint32_t nremoteAddress) = 0;
 
+			// add candidates trickled by the remote mesh to a connection
+			// that is still negotiating. candidates already known are
+			// ignored. returns `false' if the peer isn't negotiating or the
+			// address is malformed
+			virtual bool addRemoteCandidates(uint32_t peer
+				, const uint8_t* remoteAddress, uint32_t nremoteAddress) = 0;
+
 			// disconnect from a peer. does not signal the peer, simply
 			// stops processing incoming packets
 			virtual void disconnectPeer(uint32_t peer) = 0;
@@ -117,13 +179,35 @@ namespace tiny
 			virtual void sendUnreliableDataToPeer(uint32_t peer
 				, const void* p, uint32_t n) = 0;
 
+			// bytes that must be reserved in front of and behind the payload
+			// of a packet passed to `sendUnreliablePacketToPeer'
+			virtual uint32_t packetHeadroom() = 0;
+			virtual uint32_t packetTailroom() = 0;
+
+			// send an unreliable packet to a connection without copying it.
+			// the packet must reserve at least `packetHeadroom' and
+			// `packetTailroom' bytes. the mesh writes its framing into the
+			// reserved space in place; the payload and offsets of `packet'
+			// are left untouched so the same packet may be sent to several
+			// peers.
+			virtual void sendUnreliablePacketToPeer(uint32_t peer
+				, net::PacketBuffer* packet) = 0;
+
 			// receive data from a peer connection. fills `messages', and
 			// `nmessages' and returns `true' if data is available. otherwise returns
-			// `false'. the mesh itself will release all messages internally on the next
-			// update.
+			// `false'. messages are views into the mesh's receive buffers and are
+			// only valid until the next call to `update'.
 			virtual bool receive(uint32_t peer , Message*** messages
 				, uint32_t* nmessages) = 0;
 
+			// fill `stats' with the statistics of a peer connection. returns
+			// `false' if `peer' does not name a connection
+			virtual bool peerStats(uint32_t peer, PeerStats* stats) = 0;
+
+			// fill `stats' with aggregate statistics for the mesh. cheap
+			// enough to poll periodically
+			virtual void meshStats(MeshStats* stats) = 0;
+
 		protected:
 			virtual ~IMesh() = 0;
 		};
@@ -131,8 +215,27 @@ namespace tiny
 		// create a new peer-to-peer mesh that supports up to `maxPeers'
 		// remote connections and runs on the port `port'. If the platform
 		// supports it, setting `port' to 0 allows the platform to operate
-		// on an arbitrary port.
-		IMesh* meshCreateICE(uint32_t maxPeers, uint64_t localId, uint16_t port);
+		// on an arbitrary port. the mesh takes ownership of `engine' and
+		// performs all socket I/O through it; if `engine' is `nullptr' the
+		// platform socket engine is used.
+		IMesh* meshCreateICE(uint32_t maxPeers, uint64_t localId, uint16_t port
+			, net::ISocketEngine* engine = nullptr);
+
+		// create a mesh that spreads its peers over `shards' ICE meshes,
+		// each running on its own worker thread with its own socket engine
+		// of type `engineType'. shard `n' binds `port + n' (or an arbitrary
+		// port if `port' is 0) and the local address carries one block per
+		// shard; remote meshes pick the block for their own id, so each
+		// peer lands on a single shard. media is exchanged with the workers
+		// through lock-free queues and control calls are queued to them, so
+		// no call waits on a worker's update. state, statistics and the
+		// local address are snapshots the workers publish after each
+		// update; in particular the local address is empty until the
+		// workers started the session. `update' must still be called
+		// regularly to collect received messages.
+		IMesh* meshCreateSharded(uint32_t shards, uint32_t maxPeers, uint64_t localId
+			, uint16_t port
+			, net::SocketEngineType::E engineType = net::SocketEngineType::Platform);
 	}
 }
 
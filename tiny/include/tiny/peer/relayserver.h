@@ -0,0 +1,73 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TINY_PEER__RELAYSERVER_H
+#define TINY_PEER__RELAYSERVER_H
+
+#include <stdint.h>
+
+namespace tiny
+{
+	namespace net
+	{
+		struct Address;
+	}
+
+	namespace peer
+	{
+		// relay server for peers that can not reach each other directly.
+		// clients authenticate with a shared key and receive a relayed
+		// address, datagrams are forwarded between that address and the
+		// peers the client has sent to.
+		class IRelayServer
+		{
+		public:
+			// stops the worker thread and closes all sockets
+			virtual void destroy() = 0;
+
+			// control port the server is bound to, in host byte order
+			virtual uint16_t port() = 0;
+
+			// number of live allocations
+			virtual uint32_t allocations() = 0;
+
+			// datagrams forwarded in either direction since the server was created
+			virtual uint64_t packetsRelayed() = 0;
+
+		protected:
+			virtual ~IRelayServer() = 0;
+		};
+
+		// create a relay server listening on `bindAddr':`port'. relayed
+		// sockets are bound on `bindAddr' as well and advertised to clients
+		// as `publicAddr', which is the address peers reach this host on.
+		// `key' must match the key the meshes were given in
+		// `IMesh::setRelayServer'. setting `port' to 0 binds an arbitrary port.
+		IRelayServer* relayServerCreate(const net::Address& bindAddr, const net::Address& publicAddr, uint16_t port, const uint8_t* key, uint32_t nkey);
+	}
+}
+
+#endif // TINY_PEER__RELAYSERVER_H
@@ -0,0 +1,128 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TINY_PEER__STATS_H
+#define TINY_PEER__STATS_H
+
+#include <stdint.h>
+
+namespace tiny
+{
+	namespace peer
+	{
+		struct CandidateType
+		{
+			enum E
+			{
+				Unknown,
+				Host,
+				ServerReflexive,
+				PeerReflexive,
+				Relay,
+			};
+		};
+
+		// statistics for a single peer connection. counters accumulate from
+		// `connectToPeer' and cover media packets only; STUN traffic is
+		// reported through the check and keep-alive fields.
+		struct PeerStats
+		{
+			uint64_t bytesIn;
+			uint64_t bytesOut;
+			uint64_t packetsIn;
+			uint64_t packetsOut;
+
+			// media packets from the peer's address that failed authentication
+			uint32_t authFailures;
+			// media packets from the peer's address dropped before the MAC:
+			// with a wrong connection tag, or over the peer's rate limit
+			uint32_t tagMismatches;
+			uint32_t rateLimited;
+
+			// round trip time measured from keep-alive binding requests, in
+			// microseconds. `rttSmoothedUS' is 0 until the first sample
+			uint32_t rttLatestUS;
+			uint32_t rttSmoothedUS;
+			uint32_t rttVarianceUS;
+			uint32_t rttMinUS;
+
+			// keep-alives sent and answered once connected. the difference
+			// approximates path loss
+			uint32_t keepAlivesSent;
+			uint32_t keepAlivesAcked;
+
+			// time from `connectToPeer' until the peer was connected, in
+			// microseconds. 0 while negotiating
+			uint32_t connectTimeUS;
+
+			// connectivity check requests that had to be retransmitted, and
+			// the number of attempts the nominated check took
+			uint32_t checkRetransmits;
+			uint32_t nominatedCheckAttempts;
+
+			CandidateType::E localCandidateType;
+			CandidateType::E remoteCandidateType;
+
+			// connected on the pair remembered from the previous connection
+			// to the same remote id
+			bool cachedPair;
+
+			// media bypasses the network through shared memory, the peer
+			// runs on the same host
+			bool sharedMemory;
+		};
+
+		// aggregate statistics for a mesh. counters are maintained on the
+		// receive and send paths; a snapshot only copies them
+		struct MeshStats
+		{
+			uint64_t bytesIn;
+			uint64_t bytesOut;
+			uint64_t packetsIn;
+			uint64_t packetsOut;
+
+			uint32_t authFailures;
+			// media packets from addresses that aren't a connected peer
+			uint32_t unknownSourceDrops;
+			// media packets with a wrong connection tag, or over their
+			// peer's rate limit
+			uint32_t tagMismatches;
+			uint32_t mediaRateLimited;
+			// STUN requests over the per source or aggregate rate limit, and
+			// responses that match no outstanding request
+			uint32_t stunRateLimited;
+			uint32_t unmatchedStunDrops;
+
+			uint32_t stunRequestsIn;
+			uint32_t stunResponsesIn;
+
+			uint32_t peersConnected;
+			uint32_t peersNegotiating;
+		};
+	}
+}
+
+#endif // TINY_PEER__STATS_H
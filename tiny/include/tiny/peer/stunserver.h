@@ -0,0 +1,66 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TINY_PEER__STUNSERVER_H
+#define TINY_PEER__STUNSERVER_H
+
+#include <stdint.h>
+
+namespace tiny
+{
+	namespace net
+	{
+		struct Address;
+	}
+
+	namespace peer
+	{
+		// standalone STUN binding server
+		class IStunServer
+		{
+		public:
+			// stops the worker threads and closes the socket
+			virtual void destroy() = 0;
+
+			// port the server is bound to, in host byte order
+			virtual uint16_t port() = 0;
+
+			// binding responses sent since the server was created
+			virtual uint64_t responsesSent() = 0;
+
+		protected:
+			virtual ~IStunServer() = 0;
+		};
+
+		// create a STUN server that answers binding requests on
+		// `addr':`port' with the requester's reflexive address. requests
+		// are handled statelessly by `nthreads' worker threads that share
+		// the socket. setting `port' to 0 binds an arbitrary port.
+		IStunServer* stunServerCreate(const net::Address& addr, uint16_t port, uint32_t nthreads);
+	}
+}
+
+#endif // TINY_PEER__STUNSERVER_H
@@ -0,0 +1,114 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef TINY__PROFILE_H
+#define TINY__PROFILE_H
+
+#include <stdint.h>
+#include <atomic>
+#include "tiny/time.h"
+
+// compile zones out entirely with TINY_PROFILE=0. when compiled in, a
+// zone costs a relaxed load and a branch until `profileEnable' is called
+#if !defined(TINY_PROFILE)
+#	define TINY_PROFILE 1
+#endif // ... TINY_PROFILE
+
+namespace tiny
+{
+	namespace detail
+	{
+		extern std::atomic<bool> profileActive;
+	}
+
+	// start or stop recording zones process wide. off by default
+	void profileEnable(bool enable);
+
+	inline bool profileEnabled()
+	{
+		return detail::profileActive.load(std::memory_order_relaxed);
+	}
+
+	// label the calling thread in exported traces, e.g. "mesh shard 2".
+	// longer names are truncated to 31 characters
+	void profileThreadName(const char* name);
+
+	// record a zone `name' spanning the `timestampPlatform' values `begin'
+	// and `end' on the calling thread. `name' must outlive the recording,
+	// typically a string literal. each thread records into its own
+	// fixed-size ring; the oldest zones are overwritten once it fills
+	void profileRecord(const char* name, uint64_t begin, uint64_t end);
+
+	// discard everything recorded so far. zones of exited threads are kept
+	// until cleared or exported, for the most recently exited threads
+	void profileClear();
+
+	// write the recorded zones of every thread as Chrome trace-event JSON
+	// (chrome://tracing, Perfetto) through `write'. may be called while
+	// other threads keep recording; zones overwritten during the export
+	// are dropped
+	typedef void (*ProfileWriteFn)(void* user, const char* p, uint32_t n);
+	void profileExportChromeTrace(ProfileWriteFn write, void* user);
+
+	// records the lifetime of a scope as a zone, see `TINY_PROFILE_ZONE'
+	class ProfileScope
+	{
+	public:
+		explicit ProfileScope(const char* name)
+			: name(name)
+			, active(profileEnabled())
+			, begin(active ? timestampPlatform() : 0)
+		{
+		}
+
+		~ProfileScope()
+		{
+			if (active)
+			{
+				profileRecord(name, begin, timestampPlatform());
+			}
+		}
+
+	private:
+		ProfileScope(const ProfileScope&); // = delete
+		ProfileScope& operator=(const ProfileScope&); // = delete
+
+		const char* const name;
+		const bool active;
+		const uint64_t begin;
+	};
+}
+
+#define TINY_PROFILE_CONCAT_(a, b) a##b
+#define TINY_PROFILE_CONCAT(a, b) TINY_PROFILE_CONCAT_(a, b)
+
+// record the remainder of the enclosing scope as a zone named `name'
+#if TINY_PROFILE
+#	define TINY_PROFILE_ZONE(name) ::tiny::ProfileScope TINY_PROFILE_CONCAT(tinyProfileZone, __LINE__)(name)
+#else
+#	define TINY_PROFILE_ZONE(name) do {} while (0)
+#endif // TINY_PROFILE
+
+#endif // TINY__PROFILE_H
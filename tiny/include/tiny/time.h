@@ -33,6 +33,34 @@ namespace tiny
 {
 	uint64_t timestampCurrent();
 	uint64_t timestampFrequency();
+
+	// the platform clock, even while another clock is installed. for
+	// measuring real elapsed time, e.g. in the profiler
+	uint64_t timestampPlatform();
+	uint64_t timestampPlatformFrequency();
+
+	// a source of time. socket engines report the clock their sockets run
+	// on, so a mesh on a simulated network runs on its virtual time
+	class IClock
+	{
+	public:
+		virtual uint64_t current() = 0;
+		virtual uint64_t frequency() = 0;
+		virtual void sleep(uint32_t milliseconds) = 0;
+
+	protected:
+		virtual ~IClock() = 0;
+	};
+
+	// the clock of the platform, see `timestampPlatform'
+	IClock* clockPlatform();
+
+	// replace the source of `timestampCurrent' and `timestampFrequency'
+	// process wide, for code that has no socket engine to take a clock
+	// from. install it before creating objects that cache the frequency.
+	// `sleep' always waits in real time. `nullptr' restores the platform
+	// clock
+	void clockInstall(IClock* clock);
 }
 
 #endif // TINY__TIME_H
@@ -27,7 +27,9 @@
 #ifndef TINY_VOICE__ENGINE_H
 #define TINY_VOICE__ENGINE_H
 
+#include <stddef.h>
 #include <stdint.h>
+#include "tiny/voice/latency.h"
 
 struct OpusEncoder;
 
@@ -36,10 +38,12 @@ namespace webrtc { class AudioProcessing; }
 namespace tiny
 {
 	namespace audio { class ICaptureDevice; }
+	namespace net { struct PacketBuffer; }
 
 	namespace voice
 	{
 		class Source;
+		struct PacketTraceWriter;
 
 		class Engine
 		{
@@ -52,12 +56,39 @@ namespace tiny
 			void removeSource(Source* s);
 
 			uint32_t generatePacket(uint8_t* packet, uint32_t npacket);
-			void processPacket(Source* s, const uint8_t* packet, uint32_t npacket);
+
+			// encode directly into the payload area of `packet', leaving its
+			// reserved headroom and tailroom untouched. returns the number of
+			// bytes appended to the payload
+			uint32_t generatePacket(net::PacketBuffer* packet);
+
+			// `peer' identifies the sender in packet traces
+			void processPacket(Source* s, const uint8_t* packet, uint32_t npacket, uint32_t peer = 0);
+
+			// record every packet passed to `processPacket' to `trace' (see
+			// `packetTraceCreate') until replaced or set to `nullptr'. the
+			// engine does not take ownership
+			void setPacketTrace(PacketTraceWriter* trace);
+
+			// start generated packets with the send time and the age of
+			// their first sample, letting receivers measure the `Network'
+			// and `MouthToEar' latency stages. packets with timestamps
+			// can't be processed by engines that predate them. off by
+			// default
+			void setSendTimestamps(bool enable);
+
+			// latency of the sending stages (`CaptureQueue', `Processing'
+			// and `Encode') since creation or the last reset. receiving
+			// stages are tracked per `Source'
+			void latencyStats(LatencyStats* stats) const;
+			void resetLatencyStats();
 
 		private:
 			Engine(const Engine&); // = delete
 			Engine& operator=(const Engine&); // = delete
 
+			void queueDecoded(Source* s, size_t existingSize, uint64_t decodeStart, bool hasCapture, uint32_t captureUs);
+
 			static const int c_monoSamples = 480; // 10ms @ 48khz
 
 			audio::ICaptureDevice* const mic;
@@ -67,6 +98,9 @@ namespace tiny
 			const uint32_t outputSampleRate;
 			uint32_t outgoingSequence;
 			const int micSampleRate;
+			bool sendTimestamps;
+			PacketTraceWriter* trace;
+			LatencyStats latency;
 			float monoBuffer[c_monoSamples];
 
 			union
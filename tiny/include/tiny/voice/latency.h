@@ -0,0 +1,102 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef TINY_VOICE__LATENCY_H
+#define TINY_VOICE__LATENCY_H
+
+#include <stdint.h>
+
+namespace tiny
+{
+	namespace voice
+	{
+		// stages of the path from capture to render, see
+		// `Engine::latencyStats' and `Source::latencyStats'
+		struct LatencyStage
+		{
+			enum E
+			{
+				// sender: first sample captured until the engine reads it,
+				// including the 10ms framing delay
+				CaptureQueue,
+				// sender: audio processing (APM) of a 10ms frame
+				Processing,
+				// sender: Opus encode of a 10ms frame
+				Encode,
+				// packet sent until received. requires the sender to enable
+				// send timestamps, and is only meaningful when both ends share
+				// a clock (loopback, same host) or have synchronized clocks
+				Network,
+				// receiver: Opus decode and resampling of a 10ms frame
+				Decode,
+				// receiver: decoded audio queued in the `Source' until consumed
+				JitterBuffer,
+				// receiver: consumed audio queued on the render device, as
+				// reported to `Source::consumeSourceAudio'
+				RenderQueue,
+				// first sample captured until it is expected to play. same
+				// requirements as `Network'
+				MouthToEar,
+
+				Count,
+			};
+		};
+
+		// log-linear histogram of latencies in microseconds. four buckets
+		// per power of two up to ~67 seconds; larger values land in the
+		// last bucket
+		struct LatencyHistogram
+		{
+			static const uint32_t Buckets = 104;
+
+			uint32_t counts[Buckets];
+			uint32_t count;
+			uint32_t maxUs;
+			uint64_t totalUs;
+		};
+
+		struct LatencyStats
+		{
+			LatencyHistogram stages[LatencyStage::Count];
+		};
+
+		void latencyReset(LatencyStats* stats);
+		void latencyRecord(LatencyHistogram* h, uint32_t us);
+
+		// latency in microseconds below which `fraction' (0-1) of the
+		// recorded samples fall, rounded up to the bucket boundary. returns
+		// 0 for an empty histogram
+		uint32_t latencyPercentile(const LatencyHistogram& h, float fraction);
+
+		// mean latency in microseconds, 0 for an empty histogram
+		uint32_t latencyMean(const LatencyHistogram& h);
+
+		// `timestampCurrent' ticks in wrapping microseconds, the unit of the
+		// send timestamps carried in voice packets
+		uint32_t latencyMicroseconds(uint64_t ticks);
+	}
+}
+
+#endif // TINY_VOICE__LATENCY_H
@@ -30,6 +30,7 @@
 #include <stdint.h>
 #include <vector>
 #include <tiny/audio/resample.h>
+#include <tiny/voice/latency.h>
 
 struct OpusDecoder;
 
@@ -51,14 +52,40 @@ namespace tiny
 			void swap(Source& other);
 
 			uint32_t getSourceAudio(const float** monoSamples);
-			void consumeSourceAudio(uint32_t samples);
+
+			// `renderQueued' is the number of samples already queued on the
+			// render device ahead of the consumed ones (see
+			// `IRenderDevice::queuedSamples'), recorded as the `RenderQueue'
+			// latency stage
+			void consumeSourceAudio(uint32_t samples, uint32_t renderQueued = 0);
 
 			std::vector<float> takeAllSourceAudio();
 
+			// latency of the receiving stages (`Network', `Decode',
+			// `JitterBuffer', `RenderQueue' and `MouthToEar') since the last
+			// `reset' or `resetLatencyStats'
+			void latencyStats(LatencyStats* stats) const;
+			void resetLatencyStats();
+
 		private:
+			// decoded audio in `incomingData', in order
+			struct QueuedAudio
+			{
+				uint32_t samples; // not yet consumed
+				uint64_t queuedAt;
+				uint32_t captureUs; // sender's capture time, see `latencyMicroseconds'
+				bool hasCapture;
+				bool consumed; // latency already recorded
+			};
+
+			void recordConsumed(uint32_t samples, uint32_t renderQueued);
+
 			std::vector<float> incomingData;
+			std::vector<QueuedAudio> queuedAudio;
 			audio::resample::Linear outputResampler;
 			uint32_t incomingSequence;
+			uint32_t outputSampleRate;
+			LatencyStats latency;
 			
 			struct Decoder
 			{
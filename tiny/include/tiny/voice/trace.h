@@ -0,0 +1,97 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TINY_VOICE__TRACE_H
+#define TINY_VOICE__TRACE_H
+
+#include <stdint.h>
+
+namespace tiny
+{
+	namespace voice
+	{
+		// packet traces capture the voice packets reaching
+		// `Engine::processPacket' so field sessions can be replayed
+		// offline. a trace is an append-only file of little-endian
+		// records following an 8 byte header (`TVPT' and a 32-bit
+		// version):
+		//
+		//   u32 microseconds since the previous record (or the start of
+		//       the trace), saturating
+		//   u32 peer, as passed to `Engine::processPacket'
+		//   u16 packet size
+		//   packet bytes
+		//
+		// a trace cut short by a crash is valid up to its last complete
+		// record.
+		static const uint32_t c_packetTraceVersion = 1;
+
+		// packets larger than this are counted as dropped
+		static const uint32_t c_packetTraceMaxPacket = 1500;
+
+		struct PacketTraceWriter;
+		struct PacketTraceReader;
+
+		// create the trace file `path', replacing any existing file.
+		// records are handed to a background thread that writes them
+		// out, so recording never blocks on I/O. returns `nullptr' if the
+		// file can't be created
+		PacketTraceWriter* packetTraceCreate(const char* path);
+
+		// write out every queued record and close the file
+		void packetTraceDestroy(PacketTraceWriter* trace);
+
+		// queue a packet that arrived at `arrivedAt' (see
+		// `timestampCurrent') from `peer'. records must come from a single
+		// thread at a time. returns `false' and counts the packet as
+		// dropped if the writer has fallen too far behind
+		bool packetTraceRecord(PacketTraceWriter* trace, uint32_t peer
+			, const uint8_t* packet, uint32_t npacket, uint64_t arrivedAt);
+
+		// packets not recorded because the writer was behind or they were
+		// too large
+		uint32_t packetTraceDropped(PacketTraceWriter* trace);
+
+		// a packet read back from a trace
+		struct PacketTraceRecord
+		{
+			uint64_t arrivalUs; // since the start of the trace
+			uint32_t peer;
+			uint32_t npacket;
+			const uint8_t* packet; // valid until the next `packetTraceRead'
+		};
+
+		// open the trace `path' for reading. returns `nullptr' if the file
+		// can't be opened or isn't a trace of a known version
+		PacketTraceReader* packetTraceOpen(const char* path);
+		void packetTraceClose(PacketTraceReader* reader);
+
+		// read the next record. returns `false' at the end of the trace
+		bool packetTraceRead(PacketTraceReader* reader, PacketTraceRecord* record);
+	}
+}
+
+#endif // TINY_VOICE__TRACE_H
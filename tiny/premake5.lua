@@ -1,5 +1,7 @@
 local ROOT_DIR = path.join(path.getdirectory(_SCRIPT), ".") .. "/"
 local EXAMPLES_DIR = (ROOT_DIR .. "examples/")
+local BENCH_DIR = (ROOT_DIR .. "bench/")
+local TOOLS_DIR = (ROOT_DIR .. "tools/")
 
 solution "tiny_sln"
 	location (".build/projects/" .. _ACTION)
@@ -62,3 +64,91 @@ example_project("audio_sin")
 example_project("audio_micecho")
 example_project("voip")
 example_project("voip_net")
+
+function bench_project(name)
+	project ("bench_" .. name)
+		kind "ConsoleApp"
+
+		files {
+			BENCH_DIR .. "bench.h",
+			BENCH_DIR .. name .. "/**",
+		}
+		includedirs {
+			ROOT_DIR .. "include/",
+			BENCH_DIR,
+		}
+
+		links {
+			"tiny",
+			"webrtc",
+		}
+
+		configuration "windows"
+			links {
+				"ws2_32",
+				"Iphlpapi",
+				"winmm",
+			}
+
+		configuration {}
+end
+
+bench_project("socket_engine")
+bench_project("ice_connect")
+bench_project("stun_server")
+bench_project("relay")
+bench_project("shm_transport")
+bench_project("simulated_mesh")
+bench_project("stun_flood")
+bench_project("hmac_batch")
+bench_project("sha1")
+bench_project("crc32")
+bench_project("aead")
+bench_project("crand")
+bench_project("murmur3")
+bench_project("voice_loopback")
+
+-- the kernel suite also drives library internals and the codecs directly
+bench_project("kernels")
+	includedirs {
+		ROOT_DIR .. "src/",
+		ROOT_DIR .. "3rdparty/opus/include/",
+		ROOT_DIR .. "3rdparty/webrtc/",
+	}
+
+	configuration "windows"
+		defines {
+			"WEBRTC_WIN",
+		}
+
+	configuration {}
+
+function tool_project(name)
+	project ("tool_" .. name)
+		kind "ConsoleApp"
+
+		files {
+			TOOLS_DIR .. name .. "/**",
+		}
+		includedirs {
+			ROOT_DIR .. "include/",
+		}
+
+		links {
+			"tiny",
+			"webrtc",
+		}
+
+		configuration "windows"
+			links {
+				"ws2_32",
+				"Iphlpapi",
+				"winmm",
+			}
+
+		configuration {}
+end
+
+tool_project("stunserver")
+tool_project("relayserver")
+tool_project("voicereplay")
@@ -71,6 +71,7 @@ namespace
 		{
 			angle = 0.0f;
 			nextOutputTime = timestampCurrent();
+			blockTimestamp = 0;
 			return true;
 		}
 
@@ -98,10 +99,17 @@ namespace
 			}
 
 			angle = localAngle;
+			// the block covers the 10ms ending at `nextOutputTime'
+			blockTimestamp = nextOutputTime > outputFrequency ? nextOutputTime - outputFrequency : 0;
 			nextOutputTime += outputFrequency;
 			return buffer;
 		}
 
+		virtual uint64_t captureTimestamp() const
+		{
+			return blockTimestamp;
+		}
+
 	private:
 		SinCaptureDevice(const SinCaptureDevice&); // = delete
 		SinCaptureDevice& operator=(const SinCaptureDevice&); // = delete
@@ -109,6 +117,7 @@ namespace
 		float* const buffer;
 		float angle;
 		uint64_t nextOutputTime;
+		uint64_t blockTimestamp;
 		
 		const float deltaAngle;
 		const int deviceSamplesPer10ms;
@@ -0,0 +1,64 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <atomic>
+#include "tiny/sleep.h"
+#include "clock.h"
+
+using namespace tiny;
+
+IClock::~IClock()
+{
+}
+
+namespace
+{
+	class PlatformClock : public IClock
+	{
+	public:
+		virtual uint64_t current() { return timestampPlatform(); }
+		virtual uint64_t frequency() { return timestampPlatformFrequency(); }
+		virtual void sleep(uint32_t milliseconds) { tiny::sleep(milliseconds); }
+	};
+}
+
+static PlatformClock s_platformClock;
+static std::atomic<IClock*> s_clock(nullptr);
+
+IClock* tiny::clockPlatform()
+{
+	return &s_platformClock;
+}
+
+void tiny::clockInstall(IClock* clock)
+{
+	s_clock.store(clock, std::memory_order_release);
+}
+
+IClock* tiny::clockInstalled()
+{
+	return s_clock.load(std::memory_order_acquire);
+}
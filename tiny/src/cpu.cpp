@@ -0,0 +1,126 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <atomic>
+#include "tiny/cpu.h"
+
+#if TINY_CPU_X86
+#	if defined(_MSC_VER)
+#		include <intrin.h>
+#	else
+#		include <cpuid.h>
+#	endif // _MSC_VER
+#endif // TINY_CPU_X86
+
+using namespace tiny;
+
+#if TINY_CPU_X86
+static void cpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4])
+{
+#if defined(_MSC_VER)
+	int r[4];
+	__cpuidex(r, static_cast<int>(leaf), static_cast<int>(subleaf));
+	for (int ii = 0; ii < 4; ++ii)
+		regs[ii] = static_cast<uint32_t>(r[ii]);
+#else
+	__cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif // _MSC_VER
+}
+
+// extended control register 0: register state the OS saves on a context switch
+static uint64_t xgetbv0()
+{
+#if defined(_MSC_VER)
+	return _xgetbv(0);
+#else
+	uint32_t lo, hi;
+	__asm__ __volatile__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+	return (static_cast<uint64_t>(hi) << 32) | lo;
+#endif // _MSC_VER
+}
+#endif // TINY_CPU_X86
+
+static uint32_t detectFeatures()
+{
+	uint32_t features = 0;
+
+#if TINY_CPU_X86
+	uint32_t regs[4];
+	cpuid(0, 0, regs);
+	const uint32_t maxLeaf = regs[0];
+
+	cpuid(1, 0, regs);
+	if (regs[3] & (1u << 26))
+	{
+		features |= CpuFeature::SSE2;
+	}
+	if (regs[2] & (1u << 1))
+	{
+		features |= CpuFeature::PCLMUL;
+	}
+	if (regs[2] & (1u << 9))
+	{
+		features |= CpuFeature::SSSE3;
+	}
+	if (regs[2] & (1u << 19))
+	{
+		features |= CpuFeature::SSE41;
+	}
+
+	// AVX2 needs the OS to save the ymm registers (OSXSAVE, XCR0 bits 1 and 2)
+	const bool osxsave = (regs[2] & (1u << 27)) != 0;
+	const bool avx = (regs[2] & (1u << 28)) != 0;
+	const bool ymmState = osxsave && avx && (xgetbv0() & 0x6) == 0x6;
+	if (maxLeaf >= 7)
+	{
+		cpuid(7, 0, regs);
+		if (ymmState && (regs[1] & (1u << 5)))
+		{
+			features |= CpuFeature::AVX2;
+		}
+		if (regs[1] & (1u << 29))
+		{
+			features |= CpuFeature::SHA;
+		}
+	}
+#endif // TINY_CPU_X86
+
+	return features;
+}
+
+static std::atomic<uint32_t> s_restrict(~0u);
+
+uint32_t tiny::cpuFeatures()
+{
+	static const uint32_t detected = detectFeatures();
+	return detected & s_restrict.load(std::memory_order_relaxed);
+}
+
+void tiny::cpuFeaturesRestrict(uint32_t mask)
+{
+	s_restrict.store(mask, std::memory_order_relaxed);
+}
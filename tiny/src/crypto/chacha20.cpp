@@ -0,0 +1,176 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdint.h>
+#include <string.h>
+#include "tiny/cpu.h"
+#include "tiny/endian.h"
+#include "crypto/chacha20.h"
+#include "secureclear.h"
+#include "rotate.h"
+
+using namespace tiny;
+using namespace tiny::crypto;
+
+// blocks of keystream generated per call while xoring
+static const uint32_t c_xorBlocks = 8;
+
+namespace
+{
+	struct LanesScalar
+	{
+		typedef uint32_t V;
+		static const uint32_t Lanes = 1;
+
+		static inline V set1(uint32_t x) { return x; }
+		static inline V laneIndex() { return 0; }
+		static inline V add(V a, V b) { return a + b; }
+		static inline V xor_(V a, V b) { return a ^ b; }
+
+		template<int R>
+		static inline V rotl(V v) { return rotate_left<R>(v); }
+
+		static inline void storeBlocks(const V x[16], uint8_t* out)
+		{
+			for (uint32_t ii = 0; ii < 16; ++ii)
+			{
+				const uint32_t w = endianToLittle(x[ii]);
+				memcpy(out + ii*4, &w, sizeof(w));
+			}
+		}
+	};
+}
+
+void crypto::chacha20Init(uint32_t state[16], const uint32_t key[8], uint32_t counter, const uint8_t nonce[12])
+{
+	// "expand 32-byte k"
+	state[0] = 0x61707865;
+	state[1] = 0x3320646e;
+	state[2] = 0x79622d32;
+	state[3] = 0x6b206574;
+	for (int ii = 0; ii < 8; ++ii)
+	{
+		state[4 + ii] = key[ii];
+	}
+	state[12] = counter;
+	for (int ii = 0; ii < 3; ++ii)
+	{
+		uint32_t n;
+		memcpy(&n, nonce + ii*4, sizeof(n));
+		state[13 + ii] = endianFromLittle(n);
+	}
+}
+
+uint32_t crypto::chacha20KeystreamWidth(uint32_t nblocks)
+{
+#if TINY_CPU_X86
+	const uint32_t features = cpuFeatures();
+	if ((features & CpuFeature::AVX2) && nblocks > 4)
+	{
+		return 8;
+	}
+	if (features & CpuFeature::SSSE3)
+	{
+		return 4;
+	}
+#endif // TINY_CPU_X86
+
+	return 1;
+}
+
+void crypto::chacha20Keystream(uint32_t state[16], uint8_t* out, uint32_t nblocks)
+{
+#if TINY_CPU_X86
+	const uint32_t features = cpuFeatures();
+	if (features & CpuFeature::AVX2)
+	{
+		for (; nblocks >= 8; nblocks -= 8, out += 8*64)
+		{
+			chacha20LanesAVX2(state, out);
+			state[12] += 8;
+		}
+	}
+	if (features & CpuFeature::SSSE3)
+	{
+		for (; nblocks >= 4; nblocks -= 4, out += 4*64)
+		{
+			chacha20LanesSSSE3(state, out);
+			state[12] += 4;
+		}
+
+		// two or three blocks still beat the scalar rounds in four lanes
+		if (nblocks >= 2)
+		{
+			uint8_t blocks[4*64];
+			chacha20LanesSSSE3(state, blocks);
+			memcpy(out, blocks, nblocks*64);
+			secureClearMemory(blocks, sizeof(blocks));
+			state[12] += nblocks;
+			return;
+		}
+	}
+#endif // TINY_CPU_X86
+
+	for (; nblocks; --nblocks, out += 64)
+	{
+		chacha20Lanes<LanesScalar>(state, out);
+		++state[12];
+	}
+}
+
+void crypto::chacha20XorStream(const uint8_t* in, const uint8_t* stream, uint8_t* out, uint32_t n)
+{
+	uint32_t ii = 0;
+	for (; ii + 8 <= n; ii += 8)
+	{
+		uint64_t a, b;
+		memcpy(&a, in + ii, sizeof(a));
+		memcpy(&b, stream + ii, sizeof(b));
+		a ^= b;
+		memcpy(out + ii, &a, sizeof(a));
+	}
+	for (; ii < n; ++ii)
+	{
+		out[ii] = in[ii] ^ stream[ii];
+	}
+}
+
+void crypto::chacha20Xor(uint32_t state[16], const uint8_t* in, uint8_t* out, uint32_t n)
+{
+	uint8_t stream[c_xorBlocks*64];
+	const uint32_t used = n < sizeof(stream) ? (n + 63) & ~63u : sizeof(stream);
+	while (n)
+	{
+		const uint32_t nblocks = (n + 63) / 64 < c_xorBlocks ? (n + 63) / 64 : c_xorBlocks;
+		const uint32_t nstream = nblocks*64 < n ? nblocks*64 : n;
+		chacha20Keystream(state, stream, nblocks);
+		chacha20XorStream(in, stream, out, nstream);
+
+		in += nstream;
+		out += nstream;
+		n -= nstream;
+	}
+	secureClearMemory(stream, used);
+}
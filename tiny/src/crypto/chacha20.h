@@ -0,0 +1,111 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef TINYCRYPTO_SRC__CHACHA20_H
+#define TINYCRYPTO_SRC__CHACHA20_H
+
+#include <stdint.h>
+
+namespace tiny
+{
+	namespace crypto
+	{
+		// ChaCha20 (RFC 8439) input: constants, key, block counter and nonce
+		void chacha20Init(uint32_t state[16], const uint32_t key[8], uint32_t counter, const uint8_t nonce[12]);
+
+		// write `nblocks' 64 byte blocks of keystream to `out' and advance
+		// the block counter past them. several blocks are generated at
+		// once in SIMD lanes when the CPU supports it
+		void chacha20Keystream(uint32_t state[16], uint8_t* out, uint32_t nblocks);
+
+		// blocks generated at once by the kernel `chacha20Keystream' picks
+		// for `nblocks'. asking for a multiple avoids a copy
+		uint32_t chacha20KeystreamWidth(uint32_t nblocks);
+
+		// `out' = `in' ^ `stream' for `n' bytes. `out' may be `in'
+		void chacha20XorStream(const uint8_t* in, const uint8_t* stream, uint8_t* out, uint32_t n);
+
+		// xor `n' bytes of `in' with the keystream into `out', which may be
+		// `in'. a trailing partial block consumes a whole block
+		void chacha20Xor(uint32_t state[16], const uint8_t* in, uint8_t* out, uint32_t n);
+
+		// `T::Lanes' consecutive keystream blocks of `state', one per lane,
+		// starting at its block counter. `T' supplies the vector type and
+		// its operations, as for `sha1LanesCompress', and stores the
+		// sixteen word vectors as `Lanes' little-endian blocks
+		template<typename T>
+		static inline void chacha20Lanes(const uint32_t state[16], uint8_t* out)
+		{
+			typedef typename T::V V;
+
+			V in[16];
+			for (uint32_t ii = 0; ii < 16; ++ii)
+			{
+				in[ii] = T::set1(state[ii]);
+			}
+			in[12] = T::add(in[12], T::laneIndex());
+
+			V x[16];
+			for (uint32_t ii = 0; ii < 16; ++ii)
+			{
+				x[ii] = in[ii];
+			}
+
+#define TINY_CHACHA20_QUARTER(a, b, c, d) \
+			x[a] = T::add(x[a], x[b]); x[d] = T::template rotl<16>(T::xor_(x[d], x[a])); \
+			x[c] = T::add(x[c], x[d]); x[b] = T::template rotl<12>(T::xor_(x[b], x[c])); \
+			x[a] = T::add(x[a], x[b]); x[d] = T::template rotl<8>(T::xor_(x[d], x[a])); \
+			x[c] = T::add(x[c], x[d]); x[b] = T::template rotl<7>(T::xor_(x[b], x[c]));
+
+			for (int round = 0; round < 10; ++round)
+			{
+				TINY_CHACHA20_QUARTER(0, 4, 8, 12)
+				TINY_CHACHA20_QUARTER(1, 5, 9, 13)
+				TINY_CHACHA20_QUARTER(2, 6, 10, 14)
+				TINY_CHACHA20_QUARTER(3, 7, 11, 15)
+				TINY_CHACHA20_QUARTER(0, 5, 10, 15)
+				TINY_CHACHA20_QUARTER(1, 6, 11, 12)
+				TINY_CHACHA20_QUARTER(2, 7, 8, 13)
+				TINY_CHACHA20_QUARTER(3, 4, 9, 14)
+			}
+
+#undef TINY_CHACHA20_QUARTER
+
+			for (uint32_t ii = 0; ii < 16; ++ii)
+			{
+				x[ii] = T::add(x[ii], in[ii]);
+			}
+
+			// lanes hold word `ii' of every block; transpose to blocks
+			T::storeBlocks(x, out);
+		}
+
+		// keystream kernels for `Lanes' blocks, laid out as above
+		void chacha20LanesSSSE3(const uint32_t state[16], uint8_t* out);
+		void chacha20LanesAVX2(const uint32_t state[16], uint8_t* out);
+	}
+}
+
+#endif // TINYCRYPTO_SRC__CHACHA20_H
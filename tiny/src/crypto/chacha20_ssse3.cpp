@@ -0,0 +1,94 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+// only called when the CPU reports SSSE3, see `cpuFeatures'. the pragma
+// has to precede the kernel template for it to be compiled for SSSE3
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#	pragma GCC target("ssse3")
+#endif // __GNUC__ && (__i386__ || __x86_64__)
+
+#include <stdint.h>
+#include "tiny/cpu.h"
+#include "crypto/chacha20.h"
+
+#if TINY_CPU_X86
+#include <tmmintrin.h>
+
+using namespace tiny;
+using namespace tiny::crypto;
+
+namespace
+{
+	struct LanesSSSE3
+	{
+		typedef __m128i V;
+		static const uint32_t Lanes = 4;
+
+		static inline V set1(uint32_t x) { return _mm_set1_epi32(static_cast<int>(x)); }
+		static inline V laneIndex() { return _mm_setr_epi32(0, 1, 2, 3); }
+		static inline V add(V a, V b) { return _mm_add_epi32(a, b); }
+		static inline V xor_(V a, V b) { return _mm_xor_si128(a, b); }
+
+		// rotations by whole bytes are a single shuffle
+		template<int R>
+		static inline V rotl(V v)
+		{
+			if (R == 16)
+			{
+				return _mm_shuffle_epi8(v, _mm_setr_epi8(2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13));
+			}
+			if (R == 8)
+			{
+				return _mm_shuffle_epi8(v, _mm_setr_epi8(3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14));
+			}
+			return _mm_or_si128(_mm_slli_epi32(v, R), _mm_srli_epi32(v, 32 - R));
+		}
+
+		// 4x4 transposes of each group of four words
+		static inline void storeBlocks(const V x[16], uint8_t* out)
+		{
+			for (uint32_t group = 0; group < 4; ++group)
+			{
+				const V* g = x + group*4;
+				const V t0 = _mm_unpacklo_epi32(g[0], g[1]);
+				const V t1 = _mm_unpacklo_epi32(g[2], g[3]);
+				const V t2 = _mm_unpackhi_epi32(g[0], g[1]);
+				const V t3 = _mm_unpackhi_epi32(g[2], g[3]);
+
+				uint8_t* p = out + group*16;
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(p + 0*64), _mm_unpacklo_epi64(t0, t1));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(p + 1*64), _mm_unpackhi_epi64(t0, t1));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(p + 2*64), _mm_unpacklo_epi64(t2, t3));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(p + 3*64), _mm_unpackhi_epi64(t2, t3));
+			}
+		}
+	};
+}
+
+void crypto::chacha20LanesSSSE3(const uint32_t state[16], uint8_t* out)
+{
+	chacha20Lanes<LanesSSSE3>(state, out);
+}
+#endif // TINY_CPU_X86
@@ -0,0 +1,448 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdint.h>
+#include <string.h>
+#include "tiny/endian.h"
+#include "tiny/crypto/chacha20poly1305.h"
+#include "tiny/crypto/constant.h"
+#include "crypto/chacha20.h"
+#include "secureclear.h"
+
+#if !defined(TINY_POLY1305_WIDE)
+#	if defined(__SIZEOF_INT128__) || (defined(_MSC_VER) && defined(_M_X64))
+#		define TINY_POLY1305_WIDE 1
+#	else
+#		define TINY_POLY1305_WIDE 0
+#	endif // __SIZEOF_INT128__ || (_MSC_VER && _M_X64)
+#endif // ... TINY_POLY1305_WIDE
+
+#if TINY_POLY1305_WIDE && defined(_MSC_VER)
+#	include <intrin.h>
+#endif // TINY_POLY1305_WIDE && _MSC_VER
+
+using namespace tiny;
+using namespace tiny::crypto;
+
+// keystream blocks generated along with the Poly1305 key. a voice packet
+// fits, so a single call fills the SIMD lanes
+static const uint32_t c_firstBlocks = 8;
+
+namespace
+{
+#if TINY_POLY1305_WIDE
+	// Poly1305 accumulator in 44 bit limbs: 9 wide multiplies per block
+	// rather than 25 narrow ones
+	struct Poly1305
+	{
+		uint64_t r[3];
+		uint64_t h[3];
+		uint64_t pad[2];
+	};
+
+	struct Wide
+	{
+		uint64_t lo;
+		uint64_t hi;
+	};
+#else
+	// Poly1305 accumulator in 26 bit limbs, so products fit in 64 bits on
+	// every platform
+	struct Poly1305
+	{
+		uint32_t r[5];
+		uint32_t h[5];
+		uint32_t pad[4];
+	};
+#endif // TINY_POLY1305_WIDE
+}
+
+
+static inline uint32_t load32(const uint8_t* p)
+{
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return endianFromLittle(v);
+}
+
+static inline void store32(uint8_t* p, uint32_t v)
+{
+	v = endianToLittle(v);
+	memcpy(p, &v, sizeof(v));
+}
+
+static inline uint64_t load64(const uint8_t* p)
+{
+	uint64_t v;
+	memcpy(&v, p, sizeof(v));
+	return edianFromLittle(v);
+}
+
+static inline void store64(uint8_t* p, uint64_t v)
+{
+	v = endianToLittle(v);
+	memcpy(p, &v, sizeof(v));
+}
+
+#if TINY_POLY1305_WIDE
+static inline Wide mul(uint64_t a, uint64_t b)
+{
+	Wide w;
+#if defined(_MSC_VER)
+	w.lo = _umul128(a, b, &w.hi);
+#else
+	const unsigned __int128 p = static_cast<unsigned __int128>(a) * b;
+	w.lo = static_cast<uint64_t>(p);
+	w.hi = static_cast<uint64_t>(p >> 64);
+#endif // _MSC_VER
+	return w;
+}
+
+static inline Wide add(Wide a, Wide b)
+{
+	Wide w;
+	w.lo = a.lo + b.lo;
+	w.hi = a.hi + b.hi + (w.lo < a.lo);
+	return w;
+}
+
+static inline Wide add(Wide a, uint64_t b)
+{
+	Wide w;
+	w.lo = a.lo + b;
+	w.hi = a.hi + (w.lo < a.lo);
+	return w;
+}
+
+// bits [shift, shift+64) of `a'
+static inline uint64_t shr(Wide a, int shift)
+{
+	return (a.lo >> shift) | (a.hi << (64 - shift));
+}
+
+static const uint64_t c_mask44 = 0xfffffffffffull;
+static const uint64_t c_mask42 = 0x3ffffffffffull;
+
+static void poly1305Init(Poly1305* st, const uint8_t key[32])
+{
+	// clamp r
+	const uint64_t t0 = load64(key + 0);
+	const uint64_t t1 = load64(key + 8);
+	st->r[0] = t0 & 0xffc0fffffffull;
+	st->r[1] = ((t0 >> 44) | (t1 << 20)) & 0xfffffc0ffffull;
+	st->r[2] = (t1 >> 24) & 0x00ffffffc0full;
+
+	for (int ii = 0; ii < 3; ++ii)
+	{
+		st->h[ii] = 0;
+	}
+	st->pad[0] = load64(key + 16);
+	st->pad[1] = load64(key + 24);
+}
+
+// absorb `n' bytes, zero padded to whole 16 byte blocks as the AEAD
+// construction pads the additional data and ciphertext
+static void poly1305Blocks(Poly1305* st, const uint8_t* p, uint32_t n)
+{
+	const uint64_t r0 = st->r[0], r1 = st->r[1], r2 = st->r[2];
+	const uint64_t s1 = r1 * (5 << 2), s2 = r2 * (5 << 2);
+	uint64_t h0 = st->h[0], h1 = st->h[1], h2 = st->h[2];
+
+	uint8_t last[16];
+	while (n)
+	{
+		const uint8_t* m = p;
+		if (n < 16)
+		{
+			memset(last, 0, sizeof(last));
+			memcpy(last, p, n);
+			m = last;
+		}
+
+		const uint64_t t0 = load64(m + 0);
+		const uint64_t t1 = load64(m + 8);
+		h0 += t0 & c_mask44;
+		h1 += ((t0 >> 44) | (t1 << 20)) & c_mask44;
+		h2 += ((t1 >> 24) & c_mask42) | (1ull << 40);
+
+		// h *= r mod 2^130 - 5
+		Wide d0 = add(add(mul(h0, r0), mul(h1, s2)), mul(h2, s1));
+		Wide d1 = add(add(mul(h0, r1), mul(h1, r0)), mul(h2, s2));
+		Wide d2 = add(add(mul(h0, r2), mul(h1, r1)), mul(h2, r0));
+
+		// partial carry
+		uint64_t c = shr(d0, 44); h0 = d0.lo & c_mask44;
+		d1 = add(d1, c); c = shr(d1, 44); h1 = d1.lo & c_mask44;
+		d2 = add(d2, c); c = shr(d2, 42); h2 = d2.lo & c_mask42;
+		h0 += c * 5; c = h0 >> 44; h0 &= c_mask44;
+		h1 += c;
+
+		if (n < 16)
+			break;
+		p += 16;
+		n -= 16;
+	}
+
+	st->h[0] = h0; st->h[1] = h1; st->h[2] = h2;
+}
+
+static void poly1305Finish(Poly1305* st, uint8_t tag[16])
+{
+	uint64_t h0 = st->h[0], h1 = st->h[1], h2 = st->h[2];
+
+	// full carry
+	uint64_t c = h1 >> 44; h1 &= c_mask44;
+	h2 += c; c = h2 >> 42; h2 &= c_mask42;
+	h0 += c * 5; c = h0 >> 44; h0 &= c_mask44;
+	h1 += c; c = h1 >> 44; h1 &= c_mask44;
+	h2 += c; c = h2 >> 42; h2 &= c_mask42;
+	h0 += c * 5; c = h0 >> 44; h0 &= c_mask44;
+	h1 += c;
+
+	// h - p, selected in constant time if h >= p
+	uint64_t g0 = h0 + 5; c = g0 >> 44; g0 &= c_mask44;
+	uint64_t g1 = h1 + c; c = g1 >> 44; g1 &= c_mask44;
+	uint64_t g2 = h2 + c - (1ull << 42);
+
+	const uint64_t useG = (g2 >> 63) - 1;
+	h0 = (h0 & ~useG) | (g0 & useG);
+	h1 = (h1 & ~useG) | (g1 & useG);
+	h2 = (h2 & ~useG) | (g2 & useG);
+
+	// h + pad mod 2^128
+	const uint64_t t0 = st->pad[0];
+	const uint64_t t1 = st->pad[1];
+	h0 += t0 & c_mask44; c = h0 >> 44; h0 &= c_mask44;
+	h1 += (((t0 >> 44) | (t1 << 20)) & c_mask44) + c; c = h1 >> 44; h1 &= c_mask44;
+	h2 += ((t1 >> 24) & c_mask42) + c; h2 &= c_mask42;
+
+	store64(tag + 0, h0 | (h1 << 44));
+	store64(tag + 8, (h1 >> 20) | (h2 << 24));
+
+	secureClearMemory(st, sizeof(*st));
+}
+#else
+static void poly1305Init(Poly1305* st, const uint8_t key[32])
+{
+	// clamp r
+	st->r[0] = (load32(key + 0)) & 0x3ffffff;
+	st->r[1] = (load32(key + 3) >> 2) & 0x3ffff03;
+	st->r[2] = (load32(key + 6) >> 4) & 0x3ffc0ff;
+	st->r[3] = (load32(key + 9) >> 6) & 0x3f03fff;
+	st->r[4] = (load32(key + 12) >> 8) & 0x00fffff;
+
+	for (int ii = 0; ii < 5; ++ii)
+	{
+		st->h[ii] = 0;
+	}
+	for (int ii = 0; ii < 4; ++ii)
+	{
+		st->pad[ii] = load32(key + 16 + ii*4);
+	}
+}
+
+// absorb `n' bytes, zero padded to whole 16 byte blocks as the AEAD
+// construction pads the additional data and ciphertext
+static void poly1305Blocks(Poly1305* st, const uint8_t* p, uint32_t n)
+{
+	const uint64_t r0 = st->r[0], r1 = st->r[1], r2 = st->r[2], r3 = st->r[3], r4 = st->r[4];
+	const uint64_t s1 = r1 * 5, s2 = r2 * 5, s3 = r3 * 5, s4 = r4 * 5;
+	uint32_t h0 = st->h[0], h1 = st->h[1], h2 = st->h[2], h3 = st->h[3], h4 = st->h[4];
+
+	uint8_t last[16];
+	while (n)
+	{
+		const uint8_t* m = p;
+		if (n < 16)
+		{
+			memset(last, 0, sizeof(last));
+			memcpy(last, p, n);
+			m = last;
+		}
+
+		h0 += (load32(m + 0)) & 0x3ffffff;
+		h1 += (load32(m + 3) >> 2) & 0x3ffffff;
+		h2 += (load32(m + 6) >> 4) & 0x3ffffff;
+		h3 += (load32(m + 9) >> 6) & 0x3ffffff;
+		h4 += (load32(m + 12) >> 8) | (1 << 24);
+
+		// h *= r mod 2^130 - 5
+		const uint64_t d0 = h0*r0 + h1*s4 + h2*s3 + h3*s2 + h4*s1;
+		uint64_t d1 = h0*r1 + h1*r0 + h2*s4 + h3*s3 + h4*s2;
+		uint64_t d2 = h0*r2 + h1*r1 + h2*r0 + h3*s4 + h4*s3;
+		uint64_t d3 = h0*r3 + h1*r2 + h2*r1 + h3*r0 + h4*s4;
+		uint64_t d4 = h0*r4 + h1*r3 + h2*r2 + h3*r1 + h4*r0;
+
+		// partial carry
+		uint32_t c = static_cast<uint32_t>(d0 >> 26); h0 = static_cast<uint32_t>(d0) & 0x3ffffff;
+		d1 += c; c = static_cast<uint32_t>(d1 >> 26); h1 = static_cast<uint32_t>(d1) & 0x3ffffff;
+		d2 += c; c = static_cast<uint32_t>(d2 >> 26); h2 = static_cast<uint32_t>(d2) & 0x3ffffff;
+		d3 += c; c = static_cast<uint32_t>(d3 >> 26); h3 = static_cast<uint32_t>(d3) & 0x3ffffff;
+		d4 += c; c = static_cast<uint32_t>(d4 >> 26); h4 = static_cast<uint32_t>(d4) & 0x3ffffff;
+		h0 += c * 5; c = h0 >> 26; h0 &= 0x3ffffff;
+		h1 += c;
+
+		if (n < 16)
+			break;
+		p += 16;
+		n -= 16;
+	}
+
+	st->h[0] = h0; st->h[1] = h1; st->h[2] = h2; st->h[3] = h3; st->h[4] = h4;
+}
+
+static void poly1305Finish(Poly1305* st, uint8_t tag[16])
+{
+	uint32_t h0 = st->h[0], h1 = st->h[1], h2 = st->h[2], h3 = st->h[3], h4 = st->h[4];
+
+	// full carry
+	uint32_t c = h1 >> 26; h1 &= 0x3ffffff;
+	h2 += c; c = h2 >> 26; h2 &= 0x3ffffff;
+	h3 += c; c = h3 >> 26; h3 &= 0x3ffffff;
+	h4 += c; c = h4 >> 26; h4 &= 0x3ffffff;
+	h0 += c * 5; c = h0 >> 26; h0 &= 0x3ffffff;
+	h1 += c;
+
+	// h - p, selected in constant time if h >= p
+	uint32_t g0 = h0 + 5; c = g0 >> 26; g0 &= 0x3ffffff;
+	uint32_t g1 = h1 + c; c = g1 >> 26; g1 &= 0x3ffffff;
+	uint32_t g2 = h2 + c; c = g2 >> 26; g2 &= 0x3ffffff;
+	uint32_t g3 = h3 + c; c = g3 >> 26; g3 &= 0x3ffffff;
+	uint32_t g4 = h4 + c - (1 << 26);
+
+	const uint32_t useG = (g4 >> 31) - 1;
+	h0 = (h0 & ~useG) | (g0 & useG);
+	h1 = (h1 & ~useG) | (g1 & useG);
+	h2 = (h2 & ~useG) | (g2 & useG);
+	h3 = (h3 & ~useG) | (g3 & useG);
+	h4 = (h4 & ~useG) | (g4 & useG);
+
+	// h + pad mod 2^128
+	const uint32_t w0 = h0 | (h1 << 26);
+	const uint32_t w1 = (h1 >> 6) | (h2 << 20);
+	const uint32_t w2 = (h2 >> 12) | (h3 << 14);
+	const uint32_t w3 = (h3 >> 18) | (h4 << 8);
+
+	uint64_t f = static_cast<uint64_t>(w0) + st->pad[0];
+	store32(tag + 0, static_cast<uint32_t>(f));
+	f = static_cast<uint64_t>(w1) + st->pad[1] + (f >> 32);
+	store32(tag + 4, static_cast<uint32_t>(f));
+	f = static_cast<uint64_t>(w2) + st->pad[2] + (f >> 32);
+	store32(tag + 8, static_cast<uint32_t>(f));
+	f = static_cast<uint64_t>(w3) + st->pad[3] + (f >> 32);
+	store32(tag + 12, static_cast<uint32_t>(f));
+
+	secureClearMemory(st, sizeof(*st));
+}
+#endif // TINY_POLY1305_WIDE
+
+// tag over the padded additional data and ciphertext and their lengths
+static void computeTag(const uint8_t polyKey[32], const void* ad, uint32_t nad, const void* ciphertext, uint32_t n, uint8_t tag[16])
+{
+	Poly1305 st;
+	poly1305Init(&st, polyKey);
+	poly1305Blocks(&st, static_cast<const uint8_t*>(ad), nad);
+	poly1305Blocks(&st, static_cast<const uint8_t*>(ciphertext), n);
+
+	uint8_t lengths[16];
+	store32(lengths + 0, nad);
+	store32(lengths + 4, 0);
+	store32(lengths + 8, n);
+	store32(lengths + 12, 0);
+	poly1305Blocks(&st, lengths, sizeof(lengths));
+
+	poly1305Finish(&st, tag);
+}
+
+// block 0 keys Poly1305, the payload is encrypted from block 1. for short
+// messages both come out of one keystream call
+static uint32_t beginStream(const chacha20poly1305_key* key, const uint8_t nonce[12], uint32_t n, uint32_t state[16], uint8_t stream[c_firstBlocks*64])
+{
+	chacha20Init(state, key->k, 0, nonce);
+
+	// whole multiples of the kernel's lanes; the spare blocks cost
+	// nothing and let the kernel write straight into `stream'
+	const uint32_t needed = (n + 63) / 64 + 1;
+	const uint32_t width = chacha20KeystreamWidth(needed);
+	const uint32_t rounded = (needed + width - 1) / width * width;
+	const uint32_t nblocks = rounded < c_firstBlocks ? rounded : c_firstBlocks;
+	chacha20Keystream(state, stream, nblocks);
+	return (nblocks - 1) * 64;
+}
+
+static void cryptPayload(uint32_t state[16], const uint8_t* stream, uint32_t nstream, const uint8_t* in, uint8_t* out, uint32_t n)
+{
+	const uint32_t first = n < nstream ? n : nstream;
+	chacha20XorStream(in, stream, out, first);
+	if (n > first)
+	{
+		chacha20Xor(state, in + first, out + first, n - first);
+	}
+}
+
+void crypto::chacha20poly1305_key_init(chacha20poly1305_key* key, const uint8_t p[chacha20poly1305_key::KEY_SIZE])
+{
+	for (int ii = 0; ii < 8; ++ii)
+	{
+		key->k[ii] = load32(p + ii*4);
+	}
+}
+
+void crypto::chacha20poly1305_seal(const chacha20poly1305_key* key, const uint8_t nonce[chacha20poly1305_key::NONCE_SIZE]
+	, const void* ad, uint32_t nad, const void* in, void* out, uint32_t n
+	, uint8_t tag[chacha20poly1305_key::TAG_SIZE])
+{
+	uint32_t state[16];
+	uint8_t stream[c_firstBlocks*64];
+	const uint32_t nstream = beginStream(key, nonce, n, state, stream);
+
+	cryptPayload(state, stream + 64, nstream, static_cast<const uint8_t*>(in), static_cast<uint8_t*>(out), n);
+	computeTag(stream, ad, nad, out, n, tag);
+
+	secureClearMemory(stream, 64 + nstream);
+	secureClearMemory(state, sizeof(state));
+}
+
+bool crypto::chacha20poly1305_open(const chacha20poly1305_key* key, const uint8_t nonce[chacha20poly1305_key::NONCE_SIZE]
+	, const void* ad, uint32_t nad, const void* in, void* out, uint32_t n
+	, const uint8_t tag[chacha20poly1305_key::TAG_SIZE])
+{
+	uint32_t state[16];
+	uint8_t stream[c_firstBlocks*64];
+	const uint32_t nstream = beginStream(key, nonce, n, state, stream);
+
+	uint8_t expected[chacha20poly1305_key::TAG_SIZE];
+	computeTag(stream, ad, nad, in, n, expected);
+
+	const bool valid = constCompareRange(expected, tag, sizeof(expected)) != 0;
+	if (valid)
+	{
+		cryptPayload(state, stream + 64, nstream, static_cast<const uint8_t*>(in), static_cast<uint8_t*>(out), n);
+	}
+
+	secureClearMemory(stream, 64 + nstream);
+	secureClearMemory(state, sizeof(state));
+	return valid;
+}
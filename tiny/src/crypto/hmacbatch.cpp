@@ -0,0 +1,319 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "tiny/cpu.h"
+#include "tiny/endian.h"
+#include "tiny/crypto/hmac.h"
+#include "crypto/sha1lanes.h"
+#include "secureclear.h"
+#include "rotate.h"
+
+using namespace tiny;
+using namespace tiny::crypto;
+
+// widest lane count of any kernel
+static const uint32_t c_maxLanes = 8;
+
+namespace
+{
+	struct LanesScalar
+	{
+		typedef uint32_t V;
+		static const uint32_t Lanes = 1;
+
+		static inline V load(const uint32_t* p) { return *p; }
+		static inline void store(uint32_t* p, V v) { *p = v; }
+		static inline V set1(uint32_t x) { return x; }
+		static inline V add(V a, V b) { return a + b; }
+		static inline V and_(V a, V b) { return a & b; }
+		static inline V or_(V a, V b) { return a | b; }
+		static inline V xor_(V a, V b) { return a ^ b; }
+		static inline V xor3(V a, V b, V c) { return a ^ b ^ c; }
+
+		template<int R>
+		static inline V rotl(V v) { return rotate_left<R>(v); }
+	};
+
+	typedef void (*LanesCompressFn)(uint32_t* state, const uint32_t* w);
+
+	struct LanesKernel
+	{
+		LanesCompressFn compress;
+		uint32_t lanes;
+	};
+}
+
+static void sha1LanesCompressScalar(uint32_t* state, const uint32_t* w)
+{
+	sha1LanesCompress<LanesScalar>(state, w);
+}
+
+// the narrowest kernel that hashes `n' messages at once, or the widest
+// available if none does. the SHA extensions hash a single lane about as
+// fast as eight AVX2 lanes, and without waiting on the longest message
+static LanesKernel selectKernel(uint32_t features, uint32_t n)
+{
+	LanesKernel kernel;
+	kernel.compress = sha1LanesCompressScalar;
+	kernel.lanes = 1;
+
+#if TINY_CPU_X86
+	static const uint32_t c_shaFeatures = CpuFeature::SHA | CpuFeature::SSSE3 | CpuFeature::SSE41;
+	if ((features & c_shaFeatures) == c_shaFeatures)
+	{
+		kernel.compress = sha1LanesCompressSHA;
+		kernel.lanes = 1;
+	}
+	else if ((features & CpuFeature::AVX2) && n > 4)
+	{
+		kernel.compress = sha1LanesCompressAVX2;
+		kernel.lanes = 8;
+	}
+	else if ((features & CpuFeature::SSE2) && n > 1)
+	{
+		kernel.compress = sha1LanesCompressSSE2;
+		kernel.lanes = 4;
+	}
+#endif // TINY_CPU_X86
+
+	return kernel;
+}
+
+static inline uint32_t loadBig32(const uint8_t* p)
+{
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return endianFromBig(v);
+}
+
+static inline void storeBig32(uint8_t* p, uint32_t v)
+{
+	p[0] = static_cast<uint8_t>(v >> 24);
+	p[1] = static_cast<uint8_t>(v >> 16);
+	p[2] = static_cast<uint8_t>(v >> 8);
+	p[3] = static_cast<uint8_t>(v);
+}
+
+// copy the part of [p, p+n) that lies at [offset, offset+n) of the stream
+// into the 64 byte block starting at stream position `start'
+static inline void copyRange(uint8_t block[64], uint64_t start, const void* p, uint64_t offset, uint32_t n)
+{
+	const uint64_t lo = (offset > start) ? offset : start;
+	const uint64_t hi = (offset + n < start + 64) ? offset + n : start + 64;
+	if (lo < hi)
+	{
+		memcpy(block + (lo - start), static_cast<const uint8_t*>(p) + (lo - offset), static_cast<size_t>(hi - lo));
+	}
+}
+
+// number of blocks the inner hash of `in' takes after the key block
+static inline uint32_t innerBlockCount(const hmac_sha1_input& in)
+{
+	const uint64_t n = static_cast<uint64_t>(in.nprefix) + in.n;
+	return static_cast<uint32_t>((n + 1 + 8 + 63) / 64);
+}
+
+// assemble block `index' of the padded inner message (prefix, payload,
+// 0x80, zeros, bit length including the key block) as big-endian words
+static void innerBlock(uint32_t* w, uint32_t stride, const hmac_sha1_input& in, uint32_t index)
+{
+	const uint64_t start = static_cast<uint64_t>(index) * 64;
+	const uint64_t n = static_cast<uint64_t>(in.nprefix) + in.n;
+
+	// most blocks lie within the payload and are read in place
+	if (start >= in.nprefix && start + 64 <= n)
+	{
+		const uint8_t* p = static_cast<const uint8_t*>(in.p) + (start - in.nprefix);
+		for (uint32_t ii = 0; ii < 16; ++ii)
+		{
+			w[ii*stride] = loadBig32(p + ii*4);
+		}
+		return;
+	}
+
+	uint8_t block[64];
+	memset(block, 0, sizeof(block));
+	copyRange(block, start, in.prefix, 0, in.nprefix);
+	copyRange(block, start, in.p, in.nprefix, in.n);
+	if (n >= start && n < start + 64)
+	{
+		block[n - start] = 0x80;
+	}
+
+	if (index + 1 == innerBlockCount(in))
+	{
+		const uint64_t bits = (n + hmac_sha1_state::BLOCK_SIZE) * 8;
+		storeBig32(block + 56, static_cast<uint32_t>(bits >> 32));
+		storeBig32(block + 60, static_cast<uint32_t>(bits));
+	}
+
+	for (uint32_t ii = 0; ii < 16; ++ii)
+	{
+		w[ii*stride] = loadBig32(block + ii*4);
+	}
+}
+
+void crypto::hmac_sha1_key_init(hmac_sha1_key* key, const uint8_t* p, uint32_t n)
+{
+	uint8_t block[hmac_sha1_state::BLOCK_SIZE];
+	if (n > hmac_sha1_state::BLOCK_SIZE)
+	{
+		sha1_state st;
+		sha1_begin(&st);
+		sha1_add(&st, p, n);
+		sha1_end(&st, block);
+		n = sha1_state::DIGEST_SIZE;
+	}
+	else
+	{
+		memcpy(block, p, n);
+	}
+	memset(block + n, 0, hmac_sha1_state::BLOCK_SIZE - n);
+
+	static const uint32_t c_iv[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+	memcpy(key->inner, c_iv, sizeof(c_iv));
+	memcpy(key->outer, c_iv, sizeof(c_iv));
+
+	uint32_t w[16];
+	for (uint32_t ii = 0; ii < 16; ++ii)
+	{
+		w[ii] = loadBig32(block + ii*4) ^ 0x36363636;
+	}
+	sha1LanesCompressScalar(key->inner, w);
+
+	for (uint32_t ii = 0; ii < 16; ++ii)
+	{
+		w[ii] ^= 0x36363636 ^ 0x5C5C5C5C;
+	}
+	sha1LanesCompressScalar(key->outer, w);
+
+	secureClearMemory(block, sizeof(block));
+	secureClearMemory(w, sizeof(w));
+}
+
+// hash up to `kernel.lanes' messages, one per lane. lanes step through
+// their blocks together; a lane that ran out feeds a dummy block and its
+// result is ignored, so messages of similar length keep all lanes busy
+static void hashGroup(const LanesKernel& kernel, const hmac_sha1_key* key, const hmac_sha1_input* inputs, uint32_t ninputs
+	, uint8_t (*digests)[hmac_sha1_state::DIGEST_SIZE])
+{
+	const uint32_t L = kernel.lanes;
+
+	uint32_t state[5*c_maxLanes];
+	uint32_t inner[5*c_maxLanes];
+	uint32_t w[16*c_maxLanes];
+	uint32_t nblocks[c_maxLanes];
+
+	uint32_t maxBlocks = 0;
+	for (uint32_t lane = 0; lane < L; ++lane)
+	{
+		nblocks[lane] = (lane < ninputs) ? innerBlockCount(inputs[lane]) : 0;
+		if (nblocks[lane] > maxBlocks)
+		{
+			maxBlocks = nblocks[lane];
+		}
+
+		for (uint32_t ii = 0; ii < 5; ++ii)
+		{
+			state[ii*L + lane] = key->inner[ii];
+		}
+	}
+
+	// inner hash: H(key ^ ipad, message)
+	for (uint32_t block = 0; block < maxBlocks; ++block)
+	{
+		for (uint32_t lane = 0; lane < L; ++lane)
+		{
+			if (block < nblocks[lane])
+			{
+				innerBlock(w + lane, L, inputs[lane], block);
+			}
+			else
+			{
+				for (uint32_t ii = 0; ii < 16; ++ii)
+					w[ii*L + lane] = 0;
+			}
+		}
+
+		kernel.compress(state, w);
+
+		for (uint32_t lane = 0; lane < L; ++lane)
+		{
+			if (block + 1 == nblocks[lane])
+			{
+				for (uint32_t ii = 0; ii < 5; ++ii)
+					inner[ii*L + lane] = state[ii*L + lane];
+			}
+		}
+	}
+
+	// outer hash: H(key ^ opad, inner digest), a single padded block
+	for (uint32_t lane = 0; lane < L; ++lane)
+	{
+		for (uint32_t ii = 0; ii < 5; ++ii)
+		{
+			state[ii*L + lane] = key->outer[ii];
+			w[ii*L + lane] = (lane < ninputs) ? inner[ii*L + lane] : 0;
+		}
+
+		w[5*L + lane] = 0x80000000;
+		for (uint32_t ii = 6; ii < 15; ++ii)
+		{
+			w[ii*L + lane] = 0;
+		}
+		w[15*L + lane] = (hmac_sha1_state::BLOCK_SIZE + hmac_sha1_state::DIGEST_SIZE) * 8;
+	}
+
+	kernel.compress(state, w);
+
+	for (uint32_t lane = 0; lane < ninputs; ++lane)
+	{
+		for (uint32_t ii = 0; ii < 5; ++ii)
+		{
+			storeBig32(digests[lane] + ii*4, state[ii*L + lane]);
+		}
+	}
+}
+
+void crypto::hmac_sha1_batch(const hmac_sha1_key* key, const hmac_sha1_input* inputs, uint32_t ninputs
+	, uint8_t (*digests)[hmac_sha1_state::DIGEST_SIZE])
+{
+	const uint32_t features = cpuFeatures();
+	for (uint32_t first = 0; first < ninputs; )
+	{
+		const LanesKernel kernel = selectKernel(features, ninputs - first);
+		const uint32_t n = (ninputs - first < kernel.lanes) ? ninputs - first : kernel.lanes;
+		hashGroup(kernel, key, inputs + first, n, digests + first);
+		first += n;
+	}
+}
+
+uint32_t crypto::hmac_sha1_batch_width()
+{
+	return selectKernel(cpuFeatures(), c_maxLanes).lanes;
+}
@@ -0,0 +1,134 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdint.h>
+#include <string.h>
+#include "tiny/crypto/rand.h"
+#include "tiny/time.h"
+#include "crypto/chacha20.h"
+#include "crypto/randplatform.h"
+#include "secureclear.h"
+
+using namespace tiny;
+using namespace tiny::crypto;
+
+// output between reseeds from the platform provider
+static const uint32_t c_reseedBytes = 1024 * 1024;
+static const uint32_t c_reseedSeconds = 300;
+// key of the next refill, taken from the front of each buffer
+static const uint32_t c_keySize = 32;
+
+static void reseed(CryptoRandSource* s)
+{
+	// mixed into the key rather than replacing it, so a weak platform
+	// read can't make the state worse
+	uint32_t fresh[8];
+	crandPlatformFill(s, reinterpret_cast<uint8_t*>(fresh), sizeof(fresh));
+	for (int ii = 0; ii < 8; ++ii)
+	{
+		s->key[ii] ^= fresh[ii];
+	}
+	secureClearMemory(fresh, sizeof(fresh));
+
+	// buffered output came from the old key
+	secureClearMemory(s->buffer, sizeof(s->buffer));
+	s->available = 0;
+	s->untilReseed = c_reseedBytes;
+	s->reseedAt = timestampCurrent() + c_reseedSeconds * timestampFrequency();
+}
+
+// fill the buffer from `state', whose key then is replaced by the first
+// bytes of it
+static void refillFrom(CryptoRandSource* s, uint32_t state[16])
+{
+	chacha20Keystream(state, s->buffer, CryptoRandSource::BUFFER_SIZE / 64);
+	memcpy(s->key, s->buffer, c_keySize);
+	secureClearMemory(s->buffer, c_keySize);
+	secureClearMemory(state, 16 * sizeof(uint32_t));
+	s->available = CryptoRandSource::BUFFER_SIZE - c_keySize;
+}
+
+static void beginState(const CryptoRandSource* s, uint32_t state[16])
+{
+	// every key is used for a single stream, so the nonce can be fixed
+	static const uint8_t c_nonce[12] = {};
+	chacha20Init(state, s->key, 0, c_nonce);
+}
+
+void crypto::crandInit(CryptoRandSource* s)
+{
+	crandPlatformInit(s);
+
+	memset(s->key, 0, sizeof(s->key));
+	reseed(s);
+}
+
+void crypto::crandDestroy(CryptoRandSource* s)
+{
+	secureClearMemory(s->key, sizeof(s->key));
+	secureClearMemory(s->buffer, sizeof(s->buffer));
+	s->available = 0;
+
+	crandPlatformDestroy(s);
+}
+
+void crypto::crandFill(CryptoRandSource* s, uint8_t* p, uint32_t n)
+{
+	while (n)
+	{
+		if (s->available == 0)
+		{
+			if (s->untilReseed == 0 || timestampCurrent() >= s->reseedAt)
+			{
+				reseed(s);
+			}
+
+			// whole blocks of a large request are generated in place,
+			// then the same stream refills the buffer and the key
+			uint32_t state[16];
+			beginState(s, state);
+			const uint32_t nblocks = n / 64;
+			if (nblocks)
+			{
+				chacha20Keystream(state, p, nblocks);
+				p += nblocks * 64;
+				n -= nblocks * 64;
+				s->untilReseed = s->untilReseed > nblocks * 64 ? s->untilReseed - nblocks * 64 : 0;
+			}
+			refillFrom(s, state);
+			continue;
+		}
+
+		// hand out the buffer from the front, erasing what was read
+		const uint32_t take = n < s->available ? n : s->available;
+		uint8_t* unread = s->buffer + CryptoRandSource::BUFFER_SIZE - s->available;
+		memcpy(p, unread, take);
+		secureClearMemory(unread, take);
+		s->available -= take;
+		s->untilReseed = s->untilReseed > take ? s->untilReseed - take : 0;
+		p += take;
+		n -= take;
+	}
+}
@@ -26,6 +26,8 @@
 
 #include <string.h>
 #include "crypto/secureclear.h"
+#include "crypto/sha1blocks.h"
+#include "tiny/cpu.h"
 #include "tiny/endian.h"
 #include "tiny/crypto/sha1.h"
 #include "rotate.h"
@@ -91,6 +93,41 @@ static void process_block(uint32_t state[5], uint8_t buffer[64])
 	state[4] += e;
 }
 
+static void sha1BlocksScalar(uint32_t state[5], const uint8_t* blocks, uint32_t nblocks)
+{
+	// `process_block' converts the words in place
+	uint8_t buffer[64];
+	for (uint32_t block = 0; block < nblocks; ++block, blocks += 64)
+	{
+		memcpy(buffer, blocks, sizeof(buffer));
+		process_block(state, buffer);
+	}
+	secureClearMemory(buffer, sizeof(buffer));
+}
+
+// compress consecutive blocks with the fastest implementation the CPU
+// supports
+static void sha1Blocks(uint32_t state[5], const uint8_t* blocks, uint32_t nblocks)
+{
+#if TINY_CPU_X86
+	static const uint32_t c_shaFeatures = CpuFeature::SHA | CpuFeature::SSSE3 | CpuFeature::SSE41;
+
+	const uint32_t features = cpuFeatures();
+	if ((features & c_shaFeatures) == c_shaFeatures)
+	{
+		sha1BlocksSHA(state, blocks, nblocks);
+		return;
+	}
+	if (features & CpuFeature::SSSE3)
+	{
+		sha1BlocksSSSE3(state, blocks, nblocks);
+		return;
+	}
+#endif // TINY_CPU_X86
+
+	sha1BlocksScalar(state, blocks, nblocks);
+}
+
 void crypto::sha1_begin(sha1_state* st)
 {
 	st->state[0] = 0x67452301;
@@ -113,13 +150,14 @@ void crypto::sha1_add(sha1_state* st, const void* p, uint32_t n)
 		// fill remaining buffer
 		i = 64-j;
 		memcpy(&st->buffer[j], p, i);
-		process_block(st->state, st->buffer);
+		sha1Blocks(st->state, st->buffer, 1);
 
-		// copy remaining full blocks
-		for ( ; i + 64 <= n; i += 64)
+		// hash remaining full blocks in place
+		const uint32_t nblocks = (n - i) / 64;
+		if (nblocks)
 		{
-			memcpy(st->buffer, static_cast<const uint8_t*>(p) + i, 64);
-			process_block(st->state, st->buffer);
+			sha1Blocks(st->state, static_cast<const uint8_t*>(p) + i, nblocks);
+			i += nblocks * 64;
 		}
 		j = 0;
 
@@ -140,14 +178,15 @@ void crypto::sha1_end(sha1_state* st, uint8_t digest[sha1_state::DIGEST_SIZE])
 	// pad message
 	//  RFFC 3174: Append a 1 bit, followed by zeros, followed by the 64-bit
 	//  message length until a full 512-bit block is reached
-	static const uint8_t c_finalOne = 0x80;
-	static const uint8_t c_finalNul = 0x00;
-	sha1_add(st, &c_finalOne, 1);
-	while (st->count%512 != (512-64)) // leave room for length
-		sha1_add(st, &c_finalNul, 1);
-
-	// should cause a sha1_transform call
-	sha1_add(st, &beCount, sizeof(beCount));
+	uint8_t padding[64 + 8];
+	const uint32_t used = static_cast<uint32_t>((st->count/8) % 64);
+	const uint32_t npadding = (used < 56) ? 56 - used : 120 - used; // leave room for length
+	padding[0] = 0x80;
+	memset(padding + 1, 0, npadding - 1);
+	memcpy(padding + npadding, &beCount, sizeof(beCount));
+
+	// completes the final block
+	sha1_add(st, padding, npadding + sizeof(beCount));
 
 	for (uint32_t ii = 0; ii < sha1_state::DIGEST_SIZE; ++ii)
 	{
@@ -0,0 +1,137 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// only called when the CPU reports SHA, SSSE3 and SSE4.1, see
+// `cpuFeatures'. the pragma has to precede everything it applies to
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#	pragma GCC target("sha,ssse3,sse4.1")
+#endif // __GNUC__ && (__i386__ || __x86_64__)
+
+#include <stdint.h>
+#include "tiny/cpu.h"
+#include "crypto/sha1blocks.h"
+#include "crypto/sha1lanes.h"
+
+#if TINY_CPU_X86
+#include <immintrin.h>
+
+using namespace tiny;
+using namespace tiny::crypto;
+
+// four rounds of group `g' (rounds 4g..4g+3). `e' carries the E term
+// into the rounds and `next' receives the state the following group's E
+// term is derived from. the message words of later groups are expanded
+// in place in `msg' alongside
+#define TINY_SHA1_GROUP(g, e, next) \
+	{ \
+		if ((g) == 0) \
+			e = _mm_add_epi32(e, msg[0]); \
+		else \
+			e = _mm_sha1nexte_epu32(e, msg[(g) & 3]); \
+		next = abcd; \
+		if ((g) >= 3 && (g) <= 18) \
+			msg[((g) + 1) & 3] = _mm_sha1msg2_epu32(msg[((g) + 1) & 3], msg[(g) & 3]); \
+		abcd = _mm_sha1rnds4_epu32(abcd, e, (g) / 5); \
+		if ((g) >= 1 && (g) <= 16) \
+			msg[((g) - 1) & 3] = _mm_sha1msg1_epu32(msg[((g) - 1) & 3], msg[(g) & 3]); \
+		if ((g) >= 2 && (g) <= 17) \
+			msg[((g) + 2) & 3] = _mm_xor_si128(msg[((g) + 2) & 3], msg[(g) & 3]); \
+	}
+
+// compress one block given as four message vectors, most significant
+// word in the highest lane
+static inline void compress(__m128i* abcd_, __m128i* e0_, __m128i msg[4])
+{
+	__m128i abcd = *abcd_;
+	__m128i e0 = *e0_;
+	__m128i e1;
+
+	const __m128i abcdSave = abcd;
+	const __m128i e0Save = e0;
+
+	TINY_SHA1_GROUP( 0, e0, e1) TINY_SHA1_GROUP( 1, e1, e0) TINY_SHA1_GROUP( 2, e0, e1) TINY_SHA1_GROUP( 3, e1, e0)
+	TINY_SHA1_GROUP( 4, e0, e1) TINY_SHA1_GROUP( 5, e1, e0) TINY_SHA1_GROUP( 6, e0, e1) TINY_SHA1_GROUP( 7, e1, e0)
+	TINY_SHA1_GROUP( 8, e0, e1) TINY_SHA1_GROUP( 9, e1, e0) TINY_SHA1_GROUP(10, e0, e1) TINY_SHA1_GROUP(11, e1, e0)
+	TINY_SHA1_GROUP(12, e0, e1) TINY_SHA1_GROUP(13, e1, e0) TINY_SHA1_GROUP(14, e0, e1) TINY_SHA1_GROUP(15, e1, e0)
+	TINY_SHA1_GROUP(16, e0, e1) TINY_SHA1_GROUP(17, e1, e0) TINY_SHA1_GROUP(18, e0, e1) TINY_SHA1_GROUP(19, e1, e0)
+
+	*e0_ = _mm_sha1nexte_epu32(e0, e0Save);
+	*abcd_ = _mm_add_epi32(abcd, abcdSave);
+}
+
+#undef TINY_SHA1_GROUP
+
+// the extensions keep A..D in one vector, A in the highest lane, and E
+// in the highest lane of another
+static inline void loadState(const uint32_t state[5], __m128i* abcd, __m128i* e0)
+{
+	*abcd = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state)), 0x1B);
+	*e0 = _mm_set_epi32(static_cast<int>(state[4]), 0, 0, 0);
+}
+
+static inline void storeState(uint32_t state[5], __m128i abcd, __m128i e0)
+{
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(state), _mm_shuffle_epi32(abcd, 0x1B));
+	state[4] = static_cast<uint32_t>(_mm_extract_epi32(e0, 3));
+}
+
+void crypto::sha1BlocksSHA(uint32_t state[5], const uint8_t* blocks, uint32_t nblocks)
+{
+	// big-endian words, first word in the highest lane
+	const __m128i mask = _mm_set_epi64x(0x0001020304050607ll, 0x08090A0B0C0D0E0Fll);
+
+	__m128i abcd, e0;
+	loadState(state, &abcd, &e0);
+
+	for (uint32_t block = 0; block < nblocks; ++block, blocks += 64)
+	{
+		__m128i msg[4];
+		for (int ii = 0; ii < 4; ++ii)
+		{
+			msg[ii] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks + ii*16)), mask);
+		}
+
+		compress(&abcd, &e0, msg);
+	}
+
+	storeState(state, abcd, e0);
+}
+
+void crypto::sha1LanesCompressSHA(uint32_t* state, const uint32_t* w)
+{
+	__m128i abcd, e0;
+	loadState(state, &abcd, &e0);
+
+	__m128i msg[4];
+	for (int ii = 0; ii < 4; ++ii)
+	{
+		msg[ii] = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(w + ii*4)), 0x1B);
+	}
+
+	compress(&abcd, &e0, msg);
+	storeState(state, abcd, e0);
+}
+#endif // TINY_CPU_X86
@@ -0,0 +1,124 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// only called when the CPU reports SSSE3, see `cpuFeatures'. the pragma
+// has to precede everything it applies to
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#	pragma GCC target("ssse3")
+#endif // __GNUC__ && (__i386__ || __x86_64__)
+
+#include <stdint.h>
+#include "tiny/cpu.h"
+#include "crypto/sha1blocks.h"
+#include "rotate.h"
+
+#if TINY_CPU_X86
+#include <tmmintrin.h>
+
+using namespace tiny;
+using namespace tiny::crypto;
+
+template<int R>
+static inline __m128i rotl(__m128i v)
+{
+	return _mm_or_si128(_mm_slli_epi32(v, R), _mm_srli_epi32(v, 32 - R));
+}
+
+// message schedule four words at a time, with the round constants added.
+// w[t] depends on w[t-3], so the last lane of each group is completed
+// from the first: rotl1(x ^ w[t]) == rotl1(x) ^ rotl2(first lane's input)
+static inline void schedule(uint32_t wk[80], const uint8_t* block)
+{
+	static const uint32_t c_k[4] = {0x5A827999, 0x6ED9EBA1, 0x8F1BBCDC, 0xCA62C1D6};
+	const __m128i bswap = _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+
+	__m128i w[20];
+	for (int ii = 0; ii < 4; ++ii)
+	{
+		w[ii] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(block + ii*16)), bswap);
+	}
+
+	for (int ii = 4; ii < 20; ++ii)
+	{
+		// w[t-3], w[t-2], w[t-1], 0
+		const __m128i w3 = _mm_srli_si128(w[ii-1], 4);
+		// w[t-8..t-5], w[t-14..t-11], w[t-16..t-13]
+		const __m128i w8 = w[ii-2];
+		const __m128i w14 = _mm_alignr_epi8(w[ii-3], w[ii-4], 8);
+		const __m128i w16 = w[ii-4];
+
+		const __m128i x = _mm_xor_si128(_mm_xor_si128(w3, w8), _mm_xor_si128(w14, w16));
+		const __m128i fix = rotl<2>(_mm_slli_si128(x, 12));
+		w[ii] = _mm_xor_si128(rotl<1>(x), fix);
+	}
+
+	for (int ii = 0; ii < 20; ++ii)
+	{
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(wk + ii*4), _mm_add_epi32(w[ii], _mm_set1_epi32(static_cast<int>(c_k[ii / 5]))));
+	}
+}
+
+void crypto::sha1BlocksSSSE3(uint32_t state[5], const uint8_t* blocks, uint32_t nblocks)
+{
+	uint32_t wk[80];
+	for (uint32_t block = 0; block < nblocks; ++block, blocks += 64)
+	{
+		schedule(wk, blocks);
+
+		uint32_t a = state[0];
+		uint32_t b = state[1];
+		uint32_t c = state[2];
+		uint32_t d = state[3];
+		uint32_t e = state[4];
+
+		// rounds with the variables renamed instead of moved, as in sha1.cpp
+#define TINY_SHA1_F0(b,c,d) (((b) & ((c) ^ (d))) ^ (d))
+#define TINY_SHA1_F1(b,c,d) ((b) ^ (c) ^ (d))
+#define TINY_SHA1_F2(b,c,d) (((b) & (c)) | ((d) & ((b) | (c))))
+#define TINY_SHA1_ROUND(F,v,w,x,y,z,t) z += F(w,x,y) + wk[t] + rotate_left<5>(v); w = rotate_left<30>(w);
+#define TINY_SHA1_ROUNDS5(F,t) \
+		TINY_SHA1_ROUND(F,a,b,c,d,e,(t)+0) TINY_SHA1_ROUND(F,e,a,b,c,d,(t)+1) TINY_SHA1_ROUND(F,d,e,a,b,c,(t)+2) \
+		TINY_SHA1_ROUND(F,c,d,e,a,b,(t)+3) TINY_SHA1_ROUND(F,b,c,d,e,a,(t)+4)
+
+		TINY_SHA1_ROUNDS5(TINY_SHA1_F0, 0) TINY_SHA1_ROUNDS5(TINY_SHA1_F0, 5) TINY_SHA1_ROUNDS5(TINY_SHA1_F0, 10) TINY_SHA1_ROUNDS5(TINY_SHA1_F0, 15)
+		TINY_SHA1_ROUNDS5(TINY_SHA1_F1, 20) TINY_SHA1_ROUNDS5(TINY_SHA1_F1, 25) TINY_SHA1_ROUNDS5(TINY_SHA1_F1, 30) TINY_SHA1_ROUNDS5(TINY_SHA1_F1, 35)
+		TINY_SHA1_ROUNDS5(TINY_SHA1_F2, 40) TINY_SHA1_ROUNDS5(TINY_SHA1_F2, 45) TINY_SHA1_ROUNDS5(TINY_SHA1_F2, 50) TINY_SHA1_ROUNDS5(TINY_SHA1_F2, 55)
+		TINY_SHA1_ROUNDS5(TINY_SHA1_F1, 60) TINY_SHA1_ROUNDS5(TINY_SHA1_F1, 65) TINY_SHA1_ROUNDS5(TINY_SHA1_F1, 70) TINY_SHA1_ROUNDS5(TINY_SHA1_F1, 75)
+
+#undef TINY_SHA1_ROUNDS5
+#undef TINY_SHA1_ROUND
+#undef TINY_SHA1_F2
+#undef TINY_SHA1_F1
+#undef TINY_SHA1_F0
+
+		state[0] += a;
+		state[1] += b;
+		state[2] += c;
+		state[3] += d;
+		state[4] += e;
+	}
+}
+#endif // TINY_CPU_X86
@@ -0,0 +1,105 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TINYCRYPTO_SRC__SHA1LANES_H
+#define TINYCRYPTO_SRC__SHA1LANES_H
+
+#include <stdint.h>
+
+namespace tiny
+{
+	namespace crypto
+	{
+		// SHA-1 compression of one block in each of `T::Lanes' independent
+		// lanes. `state' holds the five state words lane-interleaved
+		// (state[i*Lanes + lane]), `w' the sixteen big-endian message
+		// words the same way. `T' supplies the vector type and its
+		// operations, so the same rounds serve scalar, SSE2 and AVX2 code
+		template<typename T>
+		static inline void sha1LanesCompress(uint32_t* state, const uint32_t* w)
+		{
+			typedef typename T::V V;
+			const uint32_t L = T::Lanes;
+
+			V a = T::load(state + 0*L);
+			V b = T::load(state + 1*L);
+			V c = T::load(state + 2*L);
+			V d = T::load(state + 3*L);
+			V e = T::load(state + 4*L);
+
+			V m[16];
+			for (uint32_t t = 0; t < 16; ++t)
+			{
+				m[t] = T::load(w + t*L);
+			}
+
+#define TINY_SHA1_LANES_SCHEDULE(t) \
+			((t) < 16 ? m[(t)] : (m[(t)&15] = T::template rotl<1>(T::xor3(m[((t)-3)&15], m[((t)-8)&15], T::xor_(m[((t)-14)&15], m[(t)&15])))))
+#define TINY_SHA1_LANES_ROUND(t, f, k) \
+			{ \
+				const V tmp = T::add(T::add(T::template rotl<5>(a), f), T::add(T::add(e, k), TINY_SHA1_LANES_SCHEDULE(t))); \
+				e = d; \
+				d = c; \
+				c = T::template rotl<30>(b); \
+				b = a; \
+				a = tmp; \
+			}
+
+			const V k0 = T::set1(0x5A827999);
+			for (uint32_t t = 0; t < 20; ++t)
+				TINY_SHA1_LANES_ROUND(t, T::xor_(T::and_(b, T::xor_(c, d)), d), k0)
+
+			const V k1 = T::set1(0x6ED9EBA1);
+			for (uint32_t t = 20; t < 40; ++t)
+				TINY_SHA1_LANES_ROUND(t, T::xor3(b, c, d), k1)
+
+			const V k2 = T::set1(0x8F1BBCDC);
+			for (uint32_t t = 40; t < 60; ++t)
+				TINY_SHA1_LANES_ROUND(t, T::or_(T::and_(b, c), T::and_(d, T::or_(b, c))), k2)
+
+			const V k3 = T::set1(0xCA62C1D6);
+			for (uint32_t t = 60; t < 80; ++t)
+				TINY_SHA1_LANES_ROUND(t, T::xor3(b, c, d), k3)
+
+#undef TINY_SHA1_LANES_ROUND
+#undef TINY_SHA1_LANES_SCHEDULE
+
+			T::store(state + 0*L, T::add(a, T::load(state + 0*L)));
+			T::store(state + 1*L, T::add(b, T::load(state + 1*L)));
+			T::store(state + 2*L, T::add(c, T::load(state + 2*L)));
+			T::store(state + 3*L, T::add(d, T::load(state + 3*L)));
+			T::store(state + 4*L, T::add(e, T::load(state + 4*L)));
+		}
+
+		// compression functions for `Lanes' lanes, laid out as above. the
+		// SHA extensions kernel is a single lane
+		void sha1LanesCompressSSE2(uint32_t* state, const uint32_t* w);
+		void sha1LanesCompressAVX2(uint32_t* state, const uint32_t* w);
+		void sha1LanesCompressSHA(uint32_t* state, const uint32_t* w);
+	}
+}
+
+#endif // TINYCRYPTO_SRC__SHA1LANES_H
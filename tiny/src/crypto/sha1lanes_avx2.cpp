@@ -0,0 +1,68 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// only called when the CPU reports AVX2, see `cpuFeatures'. the pragma
+// has to precede the kernel template for it to be compiled for AVX2
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#	pragma GCC target("avx2")
+#endif // __GNUC__ && (__i386__ || __x86_64__)
+
+#include <stdint.h>
+#include "tiny/cpu.h"
+#include "crypto/sha1lanes.h"
+
+#if TINY_CPU_X86
+#include <immintrin.h>
+
+using namespace tiny;
+using namespace tiny::crypto;
+
+namespace
+{
+	struct LanesAVX2
+	{
+		typedef __m256i V;
+		static const uint32_t Lanes = 8;
+
+		static inline V load(const uint32_t* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+		static inline void store(uint32_t* p, V v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v); }
+		static inline V set1(uint32_t x) { return _mm256_set1_epi32(static_cast<int>(x)); }
+		static inline V add(V a, V b) { return _mm256_add_epi32(a, b); }
+		static inline V and_(V a, V b) { return _mm256_and_si256(a, b); }
+		static inline V or_(V a, V b) { return _mm256_or_si256(a, b); }
+		static inline V xor_(V a, V b) { return _mm256_xor_si256(a, b); }
+		static inline V xor3(V a, V b, V c) { return _mm256_xor_si256(_mm256_xor_si256(a, b), c); }
+
+		template<int R>
+		static inline V rotl(V v) { return _mm256_or_si256(_mm256_slli_epi32(v, R), _mm256_srli_epi32(v, 32 - R)); }
+	};
+}
+
+void crypto::sha1LanesCompressAVX2(uint32_t* state, const uint32_t* w)
+{
+	sha1LanesCompress<LanesAVX2>(state, w);
+}
+#endif // TINY_CPU_X86
@@ -0,0 +1,62 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include "tiny/cpu.h"
+#include "crypto/sha1lanes.h"
+
+#if TINY_CPU_X86
+#include <emmintrin.h>
+
+using namespace tiny;
+using namespace tiny::crypto;
+
+namespace
+{
+	struct LanesSSE2
+	{
+		typedef __m128i V;
+		static const uint32_t Lanes = 4;
+
+		static inline V load(const uint32_t* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+		static inline void store(uint32_t* p, V v) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v); }
+		static inline V set1(uint32_t x) { return _mm_set1_epi32(static_cast<int>(x)); }
+		static inline V add(V a, V b) { return _mm_add_epi32(a, b); }
+		static inline V and_(V a, V b) { return _mm_and_si128(a, b); }
+		static inline V or_(V a, V b) { return _mm_or_si128(a, b); }
+		static inline V xor_(V a, V b) { return _mm_xor_si128(a, b); }
+		static inline V xor3(V a, V b, V c) { return _mm_xor_si128(_mm_xor_si128(a, b), c); }
+
+		template<int R>
+		static inline V rotl(V v) { return _mm_or_si128(_mm_slli_epi32(v, R), _mm_srli_epi32(v, 32 - R)); }
+	};
+}
+
+void crypto::sha1LanesCompressSSE2(uint32_t* state, const uint32_t* w)
+{
+	sha1LanesCompress<LanesSSE2>(state, w);
+}
+#endif // TINY_CPU_X86
@@ -24,6 +24,10 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <string.h>
+#include "hash/crc32fold.h"
+#include "tiny/cpu.h"
+#include "tiny/endian.h"
 #include "tiny/hash/crc32.h"
 
 using namespace tiny;
@@ -66,6 +70,59 @@ static const uint32_t c_ieeeTable[256] =
 	0xB3667A2E, 0xC4614AB8, 0x5D681B02, 0x2A6F2B94, 0xB40BBE37, 0xC30C8EA1, 0x5A05DF1B, 0x2D02EF8D
 };
 
+namespace
+{
+	// table `k' advances the CRC over a byte followed by `k' zero bytes, so
+	// eight bytes can be looked up independently
+	struct Slice8Tables
+	{
+		uint32_t t[8][256];
+
+		Slice8Tables()
+		{
+			memcpy(t[0], c_ieeeTable, sizeof(t[0]));
+			for (int kk = 1; kk < 8; ++kk)
+			{
+				for (int ii = 0; ii < 256; ++ii)
+				{
+					const uint32_t prev = t[kk - 1][ii];
+					t[kk][ii] = c_ieeeTable[prev & 0xFF] ^ (prev >> 8);
+				}
+			}
+		}
+	};
+}
+
+static const Slice8Tables& slice8Tables()
+{
+	static const Slice8Tables tables;
+	return tables;
+}
+
+// slice-by-8: eight table lookups per 8 bytes instead of a serial chain
+// of eight
+static uint32_t crc32Slice8(uint32_t h, const uint8_t* bytes, uint32_t n)
+{
+	const uint32_t (*t)[256] = slice8Tables().t;
+
+	for (; n >= 8; n -= 8, bytes += 8)
+	{
+		uint32_t lo, hi;
+		memcpy(&lo, bytes, sizeof(lo));
+		memcpy(&hi, bytes + 4, sizeof(hi));
+		lo = endianFromLittle(lo) ^ h;
+		hi = endianFromLittle(hi);
+
+		h = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24]
+			^ t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+	}
+
+	for (uint32_t ii = 0; ii < n; ++ii)
+		h = c_ieeeTable[(h ^ bytes[ii]) & 0xFF] ^ (h >> 8);
+
+	return h;
+}
+
 void hash::crc32_begin(crc32_state* st)
 {
 	st->hash = 0xFFFFFFFF;
@@ -76,10 +133,18 @@ void hash::crc32_add(crc32_state* st, const void* p, uint32_t n)
 	const uint8_t* bytes = static_cast<const uint8_t*>(p);
 
 	uint32_t h = st->hash;
-	for (uint32_t ii = 0; ii < n; ++ii)
-		h = c_ieeeTable[(h ^ bytes[ii]) & 0xFF] ^ (h >> 8);
+#if TINY_CPU_X86
+	// fold whole 16 byte blocks, the tail goes through the tables
+	if (n >= c_crc32FoldMinimum && (cpuFeatures() & CpuFeature::PCLMUL))
+	{
+		const uint32_t folded = n & ~15u;
+		h = crc32FoldPCLMUL(h, bytes, folded);
+		bytes += folded;
+		n -= folded;
+	}
+#endif // TINY_CPU_X86
 
-	st->hash = h;
+	st->hash = crc32Slice8(h, bytes, n);
 }
 
 uint32_t hash::crc32_end(crc32_state* st)
@@ -0,0 +1,110 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+// only called when the CPU reports PCLMUL, see `cpuFeatures'. the pragma
+// has to precede everything it applies to
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#	pragma GCC target("pclmul,sse2")
+#endif // __GNUC__ && (__i386__ || __x86_64__)
+
+#include <stdint.h>
+#include "tiny/cpu.h"
+#include "hash/crc32fold.h"
+
+#if TINY_CPU_X86
+#include <emmintrin.h>
+#include <wmmintrin.h>
+
+using namespace tiny;
+using namespace tiny::hash;
+
+// folding constants for the reflected polynomial 0xEDB88320, see Gopal et
+// al. "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ".
+// x^(4*128+32) mod P and x^(4*128-32) mod P fold 64 bytes at a time,
+// x^(128+32) and x^(128-32) fold 16 bytes, x^64 folds to 64 bits, and
+// P' and mu drive the final Barrett reduction
+static const uint64_t c_fold4[2] = { 0x0154442bd4ull, 0x01c6e41596ull };
+static const uint64_t c_fold1[2] = { 0x01751997d0ull, 0x00ccaa009eull };
+static const uint64_t c_fold64 = 0x0163cd6124ull;
+static const uint64_t c_barrett[2] = { 0x01db710641ull, 0x01f7011641ull };
+
+static inline __m128i load(const uint64_t k[2])
+{
+	return _mm_set_epi64x(static_cast<long long>(k[1]), static_cast<long long>(k[0]));
+}
+
+// x * x^(a+32) + x * x^(a-32) + next
+static inline __m128i fold(__m128i x, __m128i k, __m128i next)
+{
+	const __m128i lo = _mm_clmulepi64_si128(x, k, 0x00);
+	const __m128i hi = _mm_clmulepi64_si128(x, k, 0x11);
+	return _mm_xor_si128(_mm_xor_si128(hi, lo), next);
+}
+
+uint32_t hash::crc32FoldPCLMUL(uint32_t crc, const uint8_t* p, uint32_t n)
+{
+	__m128i x0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 0x00));
+	__m128i x1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 0x10));
+	__m128i x2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 0x20));
+	__m128i x3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 0x30));
+	x0 = _mm_xor_si128(x0, _mm_cvtsi32_si128(static_cast<int>(crc)));
+	p += 64;
+	n -= 64;
+
+	// four independent accumulators keep the multiplier busy
+	const __m128i k4 = load(c_fold4);
+	for (; n >= 64; n -= 64, p += 64)
+	{
+		x0 = fold(x0, k4, _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 0x00)));
+		x1 = fold(x1, k4, _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 0x10)));
+		x2 = fold(x2, k4, _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 0x20)));
+		x3 = fold(x3, k4, _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 0x30)));
+	}
+
+	// fold the accumulators, then any remaining 16 byte blocks, into one
+	const __m128i k1 = load(c_fold1);
+	x0 = fold(x0, k1, x1);
+	x0 = fold(x0, k1, x2);
+	x0 = fold(x0, k1, x3);
+	for (; n >= 16; n -= 16, p += 16)
+	{
+		x0 = fold(x0, k1, _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+	}
+
+	// 128 -> 64 bits
+	const __m128i mask32 = _mm_setr_epi32(-1, 0, -1, 0);
+	x0 = _mm_xor_si128(_mm_srli_si128(x0, 8), _mm_clmulepi64_si128(x0, k1, 0x10));
+	x0 = _mm_xor_si128(_mm_srli_si128(x0, 4)
+		, _mm_clmulepi64_si128(_mm_and_si128(x0, mask32), _mm_loadl_epi64(reinterpret_cast<const __m128i*>(&c_fold64)), 0x00));
+
+	// Barrett reduction to 32 bits
+	const __m128i kb = load(c_barrett);
+	__m128i t = _mm_clmulepi64_si128(_mm_and_si128(x0, mask32), kb, 0x10);
+	t = _mm_clmulepi64_si128(_mm_and_si128(t, mask32), kb, 0x00);
+	x0 = _mm_xor_si128(x0, t);
+	return static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_srli_si128(x0, 4)));
+}
+
+#endif // TINY_CPU_X86
@@ -136,3 +136,61 @@ uint32_t tiny::hash::murmur3_end(const murmur3_state* st)
 	hash ^= st->len;
 	return avalance(hash);
 }
+
+murmur3_128 hash::murmur3_x64_128(const void* p, uint32_t n, uint32_t seed)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(p);
+
+	murmur3_128 h;
+	h.h1 = seed;
+	h.h2 = seed;
+	detail::murmur3_blocks(&h, bytes, n / 16);
+	detail::murmur3_tail(&h, bytes + (n & ~15u), n & 15, n);
+	return h;
+}
+
+// four keys per iteration: the inlined hashes are independent, so their
+// multiplies overlap instead of waiting on a single chain
+template<uint32_t N>
+static void hashBatchFixed(const uint8_t* keys, uint32_t stride, uint32_t nkeys, murmur3_128* out, uint32_t seed)
+{
+	uint32_t ii = 0;
+	for (; ii + 4 <= nkeys; ii += 4, keys += 4*stride)
+	{
+		out[ii + 0] = murmur3_x64_128_fixed<N>(keys + 0*stride, seed);
+		out[ii + 1] = murmur3_x64_128_fixed<N>(keys + 1*stride, seed);
+		out[ii + 2] = murmur3_x64_128_fixed<N>(keys + 2*stride, seed);
+		out[ii + 3] = murmur3_x64_128_fixed<N>(keys + 3*stride, seed);
+	}
+	for (; ii < nkeys; ++ii, keys += stride)
+	{
+		out[ii] = murmur3_x64_128_fixed<N>(keys, seed);
+	}
+}
+
+void hash::murmur3_x64_128_batch(const void* keys, uint32_t keySize, uint32_t stride, uint32_t nkeys
+	, murmur3_128* out, uint32_t seed)
+{
+	const uint8_t* p = static_cast<const uint8_t*>(keys);
+
+	switch (keySize)
+	{
+	case 8:
+		hashBatchFixed<8>(p, stride, nkeys, out, seed);
+		return;
+	case 16:
+		hashBatchFixed<16>(p, stride, nkeys, out, seed);
+		return;
+	case 28:
+		hashBatchFixed<28>(p, stride, nkeys, out, seed);
+		return;
+	case 32:
+		hashBatchFixed<32>(p, stride, nkeys, out, seed);
+		return;
+	}
+
+	for (uint32_t ii = 0; ii < nkeys; ++ii, p += stride)
+	{
+		out[ii] = murmur3_x64_128(p, keySize, seed);
+	}
+}
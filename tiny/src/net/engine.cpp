@@ -0,0 +1,174 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "tiny/net/adapter.h"
+#include "tiny/net/engine.h"
+#include "tiny/net/socket.h"
+#include "tiny/sleep.h"
+
+using namespace tiny;
+using namespace tiny::net;
+
+ISocketEngine::~ISocketEngine()
+{
+}
+
+namespace
+{
+	// forwards directly to the platform socket layer
+	class PlatformSocketEngine : public ISocketEngine
+	{
+	public:
+		PlatformSocketEngine()
+			: event(InvalidSocketEvent)
+		{
+			socketEventCreate(&event);
+		}
+
+		~PlatformSocketEngine()
+		{
+			if (event != InvalidSocketEvent)
+			{
+				socketEventDestroy(event);
+			}
+		}
+
+		virtual void release()
+		{
+			delete this;
+		}
+
+		virtual SocketEngineType::E type() const
+		{
+			return SocketEngineType::Platform;
+		}
+
+		virtual uint32_t adapters(Address* addresses, uint32_t naddresses)
+		{
+			return enumerateAdapters(addresses, naddresses);
+		}
+
+		virtual IClock* clock()
+		{
+			return clockPlatform();
+		}
+
+		virtual bool createUDP(Socket* out, const Address& addr, uint16_t* bePort)
+		{
+			if (!socketCreateUDP(out, addr, bePort))
+				return false;
+
+			if (event != InvalidSocketEvent && !socketEventAttach(event, *out))
+			{
+				socketClose(*out);
+				return false;
+			}
+
+			return true;
+		}
+
+		virtual void close(Socket s)
+		{
+			socketClose(s);
+		}
+
+		virtual bool sendTo(Socket s, const ConstBuffer* buffers, uint32_t nbuffers, const PlatformSocketAddr& addr)
+		{
+			return socketSendTo(s, buffers, nbuffers, addr);
+		}
+
+		virtual uint32_t recvBatch(Socket s, Datagram* datagrams, uint32_t ndatagrams)
+		{
+			return socketRecvBatch(s, datagrams, ndatagrams);
+		}
+
+		virtual bool operationWouldHaveBlocked()
+		{
+			return socketOperationWouldHaveBlocked();
+		}
+
+		virtual void sendBatchBegin()
+		{
+		}
+
+		virtual void sendBatchEnd()
+		{
+		}
+
+		virtual void wait(uint32_t timeoutMS)
+		{
+			if (event != InvalidSocketEvent)
+			{
+				socketEventWait(event, timeoutMS);
+			}
+			else
+			{
+				sleep(timeoutMS);
+			}
+		}
+
+		virtual void wake()
+		{
+			if (event != InvalidSocketEvent)
+			{
+				socketEventSignal(event);
+			}
+		}
+
+	private:
+		PlatformSocketEngine(const PlatformSocketEngine&); // = delete
+		PlatformSocketEngine& operator=(const PlatformSocketEngine&); // = delete
+
+		// signaled by every socket of this engine
+		SocketEvent event;
+	};
+}
+
+ISocketEngine* net::socketEngineCreatePlatform()
+{
+	return new PlatformSocketEngine;
+}
+
+ISocketEngine* net::socketEngineCreate(SocketEngineType::E type)
+{
+	ISocketEngine* engine = nullptr;
+	switch (type)
+	{
+	case SocketEngineType::RegisteredIO:
+		engine = socketEngineCreateRegisteredIO();
+		break;
+
+	default:
+		break;
+	}
+
+	if (!engine)
+	{
+		engine = socketEngineCreatePlatform();
+	}
+
+	return engine;
+}
@@ -0,0 +1,182 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "tiny/net/address.h"
+#include "tiny/net/resolve.h"
+#include "tiny/time.h"
+
+using namespace tiny;
+using namespace tiny::net;
+
+// Time a resolved name stays in the cache
+static const uint64_t c_resolveCacheSeconds = 300;
+// Time a failed lookup is remembered before it is retried
+static const uint64_t c_resolveFailureSeconds = 5;
+
+// a lookup shared by the cache, the resolver thread and every request for
+// the same name
+struct net::ResolveRequest
+{
+	std::atomic<int32_t> refs;
+	std::atomic<uint8_t> state; // ResolveState::E
+	ResolvedHost result;
+	uint64_t expires;
+	std::string hostname;
+};
+
+namespace
+{
+	struct ResolveCache
+	{
+		std::mutex lock;
+		std::vector<ResolveRequest*> entries;
+	};
+}
+
+static ResolveCache& resolveCache()
+{
+	static ResolveCache cache;
+	return cache;
+}
+
+static bool isAllZero(const uint8_t* p, size_t n)
+{
+	for (size_t ii = 0; ii < n; ++ii)
+	{
+		if (p[ii] != 0)
+			return false;
+	}
+
+	return true;
+}
+
+static void resolveThread(ResolveRequest* request)
+{
+	ResolvedHost result;
+	memset(&result, 0, sizeof(result));
+
+	ResolveState::E state = ResolveState::Failed;
+	if (resolveHost(&result.v4, &result.v6, request->hostname.c_str()))
+	{
+		result.hasV4 = !isAllZero(result.v4.addr, sizeof(result.v4.addr));
+		result.hasV6 = !isAllZero(result.v6.addr, sizeof(result.v6.addr));
+		if (result.hasV4 || result.hasV6)
+		{
+			state = ResolveState::Resolved;
+		}
+	}
+
+	const uint64_t ttl = (state == ResolveState::Resolved) ? c_resolveCacheSeconds : c_resolveFailureSeconds;
+	request->result = result;
+	request->expires = timestampCurrent() + ttl*timestampFrequency();
+	request->state.store(static_cast<uint8_t>(state), std::memory_order_release);
+
+	resolveRelease(request);
+}
+
+ResolveRequest* net::resolveHostAsync(const char* hostname)
+{
+	// numeric literals complete synchronously and skip the cache
+	Address numeric;
+	if (resolveNumericHost(&numeric, hostname))
+	{
+		ResolveRequest* request = new ResolveRequest;
+		request->refs.store(1);
+		memset(&request->result, 0, sizeof(request->result));
+		if (numeric.family == AddressFamily::IPv4)
+		{
+			request->result.v4 = numeric.u.v4;
+			request->result.hasV4 = true;
+		}
+		else
+		{
+			request->result.v6 = numeric.u.v6;
+			request->result.hasV6 = true;
+		}
+		request->expires = 0;
+		request->state.store(ResolveState::Resolved);
+		return request;
+	}
+
+	const uint64_t now = timestampCurrent();
+
+	ResolveCache& cache = resolveCache();
+	std::unique_lock<std::mutex> l(cache.lock);
+	for (size_t ii = 0, nn = cache.entries.size(); ii != nn; ++ii)
+	{
+		ResolveRequest* entry = cache.entries[ii];
+		if (entry->hostname != hostname)
+			continue;
+
+		if (entry->state.load(std::memory_order_acquire) == ResolveState::Pending || now < entry->expires)
+		{
+			entry->refs.fetch_add(1);
+			return entry;
+		}
+
+		// stale, look it up again
+		cache.entries.erase(cache.entries.begin() + ii);
+		resolveRelease(entry);
+		break;
+	}
+
+	// held by the cache, the resolver thread and the caller
+	ResolveRequest* request = new ResolveRequest;
+	request->refs.store(3);
+	request->state.store(ResolveState::Pending);
+	request->expires = 0;
+	request->hostname = hostname;
+	cache.entries.push_back(request);
+
+	std::thread(resolveThread, request).detach();
+	return request;
+}
+
+ResolveState::E net::resolvePoll(ResolveRequest* request, ResolvedHost* out)
+{
+	const ResolveState::E state = static_cast<ResolveState::E>(request->state.load(std::memory_order_acquire));
+	if (state == ResolveState::Resolved)
+	{
+		*out = request->result;
+	}
+
+	return state;
+}
+
+void net::resolveRelease(ResolveRequest* request)
+{
+	if (1 == request->refs.fetch_sub(1, std::memory_order_acq_rel))
+	{
+		delete request;
+	}
+}
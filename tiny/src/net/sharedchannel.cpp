@@ -0,0 +1,265 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include "net/sharedmemory.h"
+#include "tiny/net/sharedchannel.h"
+
+using namespace tiny;
+using namespace tiny::net;
+
+// Bytes per direction, a power of two
+static const uint32_t c_sharedRingSize = 256 * 1024;
+// Record header: length of the datagram, or `c_sharedRecordPad' to skip to
+// the start of the ring
+static const uint32_t c_sharedRecordHeader = 4;
+static const uint32_t c_sharedRecordPad = 0xFFFFFFFF;
+static const uint32_t c_sharedRecordAlign = 8;
+// Largest datagram, keeps a record well below the ring size
+static const uint32_t c_sharedMaxDatagram = 64 * 1024;
+
+namespace
+{
+	// all state lives in the zero filled mapping, so whichever side opens
+	// the channel first needs no initialization. positions only ever grow
+	// and wrap with the integer, the offset is `pos & (size - 1)'
+	struct SharedRing
+	{
+		std::atomic<uint32_t> head; // written by the producer
+		uint8_t pad0[60];
+		std::atomic<uint32_t> tail; // written by the consumer
+		uint8_t pad1[60];
+	};
+
+	struct SharedLayout
+	{
+		std::atomic<uint32_t> attached[2];
+		uint8_t pad[56];
+		SharedRing rings[2]; // ring `n' is produced by side `n'
+		uint8_t data[2][c_sharedRingSize];
+	};
+
+	static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "shared atomics must be plain words");
+}
+
+struct net::SharedChannel
+{
+	SharedHandle mapping;
+	SharedLayout* layout;
+	SharedHandle events[2]; // `events[n]' is signaled when ring `n' becomes non-empty
+	uint32_t side;
+	uint32_t readPos; // consumer position of data handed out but not released
+	bool broken; // the other side wrote a record outside the ring
+};
+
+static uint32_t alignRecord(uint32_t n)
+{
+	return (n + c_sharedRecordAlign - 1) & ~(c_sharedRecordAlign - 1);
+}
+
+SharedChannel* net::sharedChannelOpen(const char* name, uint32_t side)
+{
+	if (side > 1)
+		return nullptr;
+
+	SharedChannel* channel = new SharedChannel;
+	channel->side = side;
+	channel->broken = false;
+	channel->layout = static_cast<SharedLayout*>(sharedMemoryOpen(&channel->mapping, name, sizeof(SharedLayout)));
+	if (!channel->layout)
+	{
+		delete channel;
+		return nullptr;
+	}
+
+	for (uint32_t ii = 0; ii < 2; ++ii)
+	{
+		char eventName[256];
+		snprintf(eventName, sizeof(eventName), "%s-%u", name, ii);
+		channel->events[ii] = sharedEventOpen(eventName);
+	}
+
+	if (channel->events[0] == InvalidSharedHandle || channel->events[1] == InvalidSharedHandle)
+	{
+		sharedChannelClose(channel);
+		return nullptr;
+	}
+
+	// a previous user of this side may have left data behind
+	SharedRing& incoming = channel->layout->rings[side ^ 1];
+	channel->readPos = incoming.tail.load(std::memory_order_relaxed);
+
+	channel->layout->attached[side].store(1, std::memory_order_release);
+	return channel;
+}
+
+void net::sharedChannelClose(SharedChannel* channel)
+{
+	if (channel->layout)
+	{
+		channel->layout->attached[channel->side].store(0, std::memory_order_release);
+		sharedMemoryClose(channel->mapping, channel->layout);
+	}
+
+	for (uint32_t ii = 0; ii < 2; ++ii)
+	{
+		if (channel->events[ii] != InvalidSharedHandle)
+		{
+			sharedEventClose(channel->events[ii]);
+		}
+	}
+
+	delete channel;
+}
+
+bool net::sharedChannelConnected(SharedChannel* channel)
+{
+	return !channel->broken && channel->layout->attached[channel->side ^ 1].load(std::memory_order_acquire) != 0;
+}
+
+bool net::sharedChannelSend(SharedChannel* channel, const ConstBuffer* buffers, uint32_t nbuffers)
+{
+	uint32_t n = 0;
+	for (uint32_t ii = 0; ii < nbuffers; ++ii)
+	{
+		n += static_cast<uint32_t>(buffers[ii].len);
+	}
+	if (n > c_sharedMaxDatagram)
+		return false;
+
+	SharedRing& ring = channel->layout->rings[channel->side];
+	uint8_t* data = channel->layout->data[channel->side];
+
+	const uint32_t head = ring.head.load(std::memory_order_relaxed);
+	const uint32_t tail = ring.tail.load(std::memory_order_acquire);
+
+	// records never wrap, pad to the end of the ring instead
+	const uint32_t need = alignRecord(c_sharedRecordHeader + n);
+	const uint32_t offset = head & (c_sharedRingSize - 1);
+	const uint32_t pad = (c_sharedRingSize - offset < need) ? c_sharedRingSize - offset : 0;
+	if (c_sharedRingSize - (head - tail) < pad + need)
+		return false;
+
+	uint32_t pos = head;
+	if (pad)
+	{
+		memcpy(&data[offset], &c_sharedRecordPad, sizeof(c_sharedRecordPad));
+		pos += pad;
+	}
+
+	uint8_t* record = &data[pos & (c_sharedRingSize - 1)];
+	memcpy(record, &n, sizeof(n));
+	record += c_sharedRecordHeader;
+	for (uint32_t ii = 0; ii < nbuffers; ++ii)
+	{
+		memcpy(record, buffers[ii].p, buffers[ii].len);
+		record += buffers[ii].len;
+	}
+
+	// the consumer releases everything before it sleeps and re-reads
+	// `head' afterwards. with both sides sequentially consistent, either
+	// it sees this record or we see it caught up and wake it
+	ring.head.store(pos + need, std::memory_order_seq_cst);
+	if (ring.tail.load(std::memory_order_seq_cst) == head)
+	{
+		sharedEventSignal(channel->events[channel->side]);
+	}
+
+	return true;
+}
+
+uint32_t net::sharedChannelRead(SharedChannel* channel, SharedDatagram* datagrams, uint32_t ndatagrams)
+{
+	const uint32_t peer = channel->side ^ 1;
+	SharedRing& ring = channel->layout->rings[peer];
+	uint8_t* data = channel->layout->data[peer];
+
+	const uint32_t head = ring.head.load(std::memory_order_acquire);
+
+	// positions and lengths are written by the other process. one that
+	// points outside the ring breaks the channel for good, rather than
+	// hand out views past the end of the mapping
+	uint32_t nread = 0;
+	while (!channel->broken && nread < ndatagrams && channel->readPos != head)
+	{
+		const uint32_t offset = channel->readPos & (c_sharedRingSize - 1);
+		const uint32_t available = head - channel->readPos;
+		if (available > c_sharedRingSize || (offset & (c_sharedRecordAlign - 1)) != 0)
+		{
+			channel->broken = true;
+			break;
+		}
+
+		uint32_t n;
+		memcpy(&n, &data[offset], sizeof(n));
+		if (n == c_sharedRecordPad)
+		{
+			if (c_sharedRingSize - offset > available)
+			{
+				channel->broken = true;
+				break;
+			}
+
+			channel->readPos += c_sharedRingSize - offset;
+			continue;
+		}
+
+		if (n > c_sharedMaxDatagram || offset + c_sharedRecordHeader + n > c_sharedRingSize
+			|| alignRecord(c_sharedRecordHeader + n) > available)
+		{
+			channel->broken = true;
+			break;
+		}
+
+		datagrams[nread].p = &data[offset + c_sharedRecordHeader];
+		datagrams[nread].len = n;
+		++nread;
+
+		channel->readPos += alignRecord(c_sharedRecordHeader + n);
+	}
+
+	return nread;
+}
+
+void net::sharedChannelRelease(SharedChannel* channel)
+{
+	SharedRing& ring = channel->layout->rings[channel->side ^ 1];
+	ring.tail.store(channel->readPos, std::memory_order_release);
+}
+
+bool net::sharedChannelWait(SharedChannel* channel, uint32_t timeoutMS)
+{
+	SharedRing& ring = channel->layout->rings[channel->side ^ 1];
+	ring.tail.store(channel->readPos, std::memory_order_seq_cst);
+	if (ring.head.load(std::memory_order_seq_cst) != channel->readPos)
+		return true;
+
+	sharedEventWait(channel->events[channel->side ^ 1], timeoutMS);
+	return ring.head.load(std::memory_order_acquire) != channel->readPos;
+}
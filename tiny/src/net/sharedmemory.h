@@ -0,0 +1,53 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TINY_SRC_NET__SHAREDMEMORY_H
+#define TINY_SRC_NET__SHAREDMEMORY_H
+
+#include <stdint.h>
+
+namespace tiny
+{
+	namespace net
+	{
+		// platform primitives behind `SharedChannel'
+		typedef uintptr_t SharedHandle;
+		static const SharedHandle InvalidSharedHandle = 0;
+
+		// map `size' bytes of the named region `name', creating it zero
+		// filled if it doesn't exist yet
+		void* sharedMemoryOpen(SharedHandle* handle, const char* name, uint32_t size);
+		void sharedMemoryClose(SharedHandle handle, void* p);
+
+		// named auto-reset event
+		SharedHandle sharedEventOpen(const char* name);
+		void sharedEventClose(SharedHandle event);
+		void sharedEventSignal(SharedHandle event);
+		bool sharedEventWait(SharedHandle event, uint32_t timeoutMS);
+	}
+}
+
+#endif // TINY_SRC_NET__SHAREDMEMORY_H
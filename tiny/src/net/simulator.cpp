@@ -0,0 +1,713 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+#include "peer/ice/stun.h"
+#include "tiny/endian.h"
+#include "tiny/net/engine.h"
+#include "tiny/net/simulator.h"
+#include "tiny/net/socket.h"
+#include "tiny/sleep.h"
+
+using namespace tiny;
+using namespace tiny::net;
+using namespace tiny::peer;
+
+INetworkSimulator::~INetworkSimulator()
+{
+}
+
+// Virtual time at creation; zero is a sentinel in several places
+static const uint64_t c_simStartUS = 1000000;
+// Ports handed out to sockets bound to port 0, and NAT mappings
+static const uint16_t c_simFirstEphemeralPort = 49152;
+static const uint16_t c_simFirstMappedPort = 20000;
+// Largest datagram carried
+static const uint32_t c_simMaxDatagram = 65507;
+
+namespace
+{
+	class NetworkSimulator;
+	class SimHost;
+
+	struct SimEndpoint
+	{
+		Address addr;
+		uint16_t bePort;
+	};
+
+	static bool endpointIsEqual(const SimEndpoint& a, const SimEndpoint& b)
+	{
+		return a.bePort == b.bePort && addressIsEqual(a.addr, b.addr);
+	}
+
+	struct AddressLess
+	{
+		bool operator()(const Address& a, const Address& b) const
+		{
+			if (a.family != b.family)
+				return a.family < b.family;
+
+			if (a.family == AddressFamily::IPv4)
+				return memcmp(&a.u.v4, &b.u.v4, sizeof(a.u.v4)) < 0;
+
+			return memcmp(&a.u.v6, &b.u.v6, sizeof(a.u.v6)) < 0;
+		}
+	};
+
+	struct SimPacket
+	{
+		uint64_t deliverAt;
+		uint64_t sequence; // ties are delivered in send order
+		SimEndpoint from; // as seen by the receiver
+		SimEndpoint to;
+		SimHost* sender; // for STUN responses, nullptr otherwise
+		uint32_t buffer;
+		uint32_t len;
+	};
+
+	struct PacketLater
+	{
+		bool operator()(const SimPacket& a, const SimPacket& b) const
+		{
+			if (a.deliverAt != b.deliverAt)
+				return a.deliverAt > b.deliverAt;
+			return a.sequence > b.sequence;
+		}
+	};
+
+	struct SimQueued
+	{
+		SimEndpoint from;
+		uint32_t buffer;
+		uint32_t len;
+	};
+
+	struct SimSocket
+	{
+		uint16_t bePort;
+		std::deque<SimQueued> queue;
+	};
+
+	struct SimMapping
+	{
+		uint16_t localPort; // network byte order
+		uint16_t publicPort; // network byte order
+		SimEndpoint destination; // symmetric NATs only
+		std::vector<SimEndpoint> permissions;
+	};
+
+	class SimClock : public IClock
+	{
+	public:
+		explicit SimClock(NetworkSimulator* sim)
+			: sim(sim)
+		{
+		}
+
+		virtual uint64_t current();
+		virtual uint64_t frequency() { return 1000000; }
+		virtual void sleep(uint32_t milliseconds);
+
+	private:
+		NetworkSimulator* sim;
+	};
+
+	// a simulated host: its sockets, its NAT and its access link
+	class SimHost : public ISocketEngine
+	{
+	public:
+		SimHost(NetworkSimulator* sim, const Address& privateAddr, const Address& publicAddr, NatType::E nat, const LinkConditions& link)
+			: sim(sim)
+			, privateAddr(privateAddr)
+			, publicAddr(nat == NatType::None ? privateAddr : publicAddr)
+			, nat(nat)
+			, link(link)
+			, nextEphemeralPort(c_simFirstEphemeralPort)
+			, nextMappedPort(c_simFirstMappedPort)
+		{
+		}
+
+		virtual void release();
+		virtual SocketEngineType::E type() const { return SocketEngineType::Platform; }
+		virtual uint32_t adapters(Address* addresses, uint32_t naddresses);
+		virtual IClock* clock();
+		virtual bool createUDP(Socket* out, const Address& addr, uint16_t* bePort);
+		virtual void close(Socket s);
+		virtual bool sendTo(Socket s, const ConstBuffer* buffers, uint32_t nbuffers, const PlatformSocketAddr& addr);
+		virtual uint32_t recvBatch(Socket s, Datagram* datagrams, uint32_t ndatagrams);
+		virtual bool operationWouldHaveBlocked() { return false; }
+		virtual void sendBatchBegin() {}
+		virtual void sendBatchEnd() {}
+		// datagrams are delivered as the simulator's clock is stepped, never
+		// while a host waits
+		virtual void wait(uint32_t /*timeoutMS*/) {}
+		virtual void wake() {}
+
+		// the endpoint a datagram from `localPort' to `to' leaves the NAT with
+		SimEndpoint outbound(uint16_t localPort, const SimEndpoint& to)
+		{
+			SimEndpoint from;
+			from.addr = publicAddr;
+			from.bePort = localPort;
+			if (nat == NatType::None)
+				return from;
+
+			SimMapping* mapping = nullptr;
+			for (size_t ii = 0, nn = mappings.size(); ii != nn; ++ii)
+			{
+				SimMapping& m = mappings[ii];
+				if (m.localPort == localPort && (nat != NatType::Symmetric || endpointIsEqual(m.destination, to)))
+				{
+					mapping = &m;
+					break;
+				}
+			}
+
+			if (!mapping)
+			{
+				mappings.resize(mappings.size() + 1);
+				mapping = &mappings.back();
+				mapping->localPort = localPort;
+				mapping->publicPort = endianToBig(nextMappedPort++);
+				mapping->destination = to;
+			}
+
+			bool known = false;
+			for (size_t ii = 0, nn = mapping->permissions.size(); ii != nn && !known; ++ii)
+			{
+				known = endpointIsEqual(mapping->permissions[ii], to);
+			}
+			if (!known)
+			{
+				mapping->permissions.push_back(to);
+			}
+
+			from.bePort = mapping->publicPort;
+			return from;
+		}
+
+		// the local port a datagram from `from' to public port `bePort'
+		// reaches, or 0 if the NAT drops it
+		uint16_t inbound(uint16_t bePort, const SimEndpoint& from) const
+		{
+			if (nat == NatType::None)
+				return bePort;
+
+			for (size_t ii = 0, nn = mappings.size(); ii != nn; ++ii)
+			{
+				const SimMapping& m = mappings[ii];
+				if (m.publicPort != bePort)
+					continue;
+
+				if (nat == NatType::FullCone)
+					return m.localPort;
+
+				for (size_t jj = 0, nn2 = m.permissions.size(); jj != nn2; ++jj)
+				{
+					const SimEndpoint& permitted = m.permissions[jj];
+					if (!addressIsEqual(permitted.addr, from.addr))
+						continue;
+					if (nat == NatType::AddressRestricted || permitted.bePort == from.bePort)
+						return m.localPort;
+				}
+				return 0;
+			}
+
+			return 0;
+		}
+
+		NetworkSimulator* const sim;
+		const Address privateAddr;
+		const Address publicAddr;
+		const NatType::E nat;
+		const LinkConditions link;
+
+		std::map<uint16_t, SimSocket*> sockets; // by port, network byte order
+		std::vector<SimMapping> mappings;
+		uint16_t nextEphemeralPort;
+		uint16_t nextMappedPort;
+	};
+
+	class NetworkSimulator : public INetworkSimulator
+	{
+	public:
+		explicit NetworkSimulator(uint64_t seed)
+			: simClock(this)
+			, now(c_simStartUS)
+			, rng(seed ? seed : 0x9E3779B97F4A7C15ull)
+			, sequence(0)
+			, refs(1)
+			, driver(std::this_thread::get_id())
+		{
+			memset(&totals, 0, sizeof(totals));
+		}
+
+		~NetworkSimulator()
+		{
+			for (size_t ii = 0, nn = buffers.size(); ii != nn; ++ii)
+			{
+				delete buffers[ii];
+			}
+		}
+
+		virtual void destroy()
+		{
+			releaseRef();
+		}
+
+		virtual ISocketEngine* createHost(const Address& privateAddr, const Address& publicAddr, NatType::E nat, const LinkConditions& link)
+		{
+			std::unique_lock<std::mutex> l(lock);
+
+			SimHost* host = new SimHost(this, privateAddr, publicAddr, nat, link);
+			if (hosts.count(host->publicAddr))
+			{
+				delete host;
+				return nullptr;
+			}
+
+			hosts[host->publicAddr] = host;
+			++refs;
+			return host;
+		}
+
+		virtual void addStunServer(const Address& addr, uint16_t port)
+		{
+			std::unique_lock<std::mutex> l(lock);
+
+			SimEndpoint server;
+			server.addr = addr;
+			server.bePort = endianToBig(port);
+			stunServers.push_back(server);
+		}
+
+		virtual IClock* clock()
+		{
+			return &simClock;
+		}
+
+		virtual void advance(uint64_t microseconds)
+		{
+			std::unique_lock<std::mutex> l(lock);
+
+			const uint64_t target = now.load(std::memory_order_relaxed) + microseconds;
+			while (!inflight.empty() && inflight.top().deliverAt <= target)
+			{
+				const SimPacket packet = inflight.top();
+				inflight.pop();
+
+				now.store(packet.deliverAt, std::memory_order_relaxed);
+				deliver(packet);
+			}
+
+			now.store(target, std::memory_order_relaxed);
+		}
+
+		virtual void stats(SimulatorStats* out)
+		{
+			std::unique_lock<std::mutex> l(lock);
+			*out = totals;
+		}
+
+		uint64_t currentTime() const
+		{
+			return now.load(std::memory_order_relaxed);
+		}
+
+		bool onDriverThread() const
+		{
+			return std::this_thread::get_id() == driver;
+		}
+
+		void releaseRef()
+		{
+			bool last;
+			{
+				std::unique_lock<std::mutex> l(lock);
+				last = (--refs == 0);
+			}
+
+			if (last)
+			{
+				delete this;
+			}
+		}
+
+		void removeHost(SimHost* host)
+		{
+			{
+				std::unique_lock<std::mutex> l(lock);
+				for (std::map<uint16_t, SimSocket*>::iterator it = host->sockets.begin(); it != host->sockets.end(); ++it)
+				{
+					closeSocket(it->second);
+				}
+				host->sockets.clear();
+				hosts.erase(host->publicAddr);
+			}
+
+			delete host;
+			releaseRef();
+		}
+
+		bool createSocket(SimHost* host, Socket* out, const Address& addr, uint16_t* bePort)
+		{
+			std::unique_lock<std::mutex> l(lock);
+
+			if (!addressIsEqual(addr, host->privateAddr) && !isUnspecified(addr))
+				return false;
+
+			uint16_t port = *bePort;
+			if (port == 0)
+			{
+				do
+				{
+					port = endianToBig(host->nextEphemeralPort++);
+				} while (host->sockets.count(port));
+			}
+			else if (host->sockets.count(port))
+			{
+				return false;
+			}
+
+			SimSocket* s = new SimSocket;
+			s->bePort = port;
+			host->sockets[port] = s;
+
+			*bePort = port;
+			*out = reinterpret_cast<Socket>(s);
+			return true;
+		}
+
+		void destroySocket(SimHost* host, Socket handle)
+		{
+			std::unique_lock<std::mutex> l(lock);
+
+			SimSocket* s = reinterpret_cast<SimSocket*>(handle);
+			host->sockets.erase(s->bePort);
+			closeSocket(s);
+		}
+
+		void send(SimHost* host, Socket handle, const ConstBuffer* buffers, uint32_t nbuffers, const PlatformSocketAddr& addr)
+		{
+			std::unique_lock<std::mutex> l(lock);
+
+			const SimSocket* s = reinterpret_cast<const SimSocket*>(handle);
+			++totals.sent;
+
+			SimPacket packet;
+			addressTo(&packet.to.addr, &packet.to.bePort, addr);
+			packet.from = host->outbound(s->bePort, packet.to);
+			packet.sender = nullptr;
+
+			// find the far end: a host, or a STUN server answered on delivery
+			const LinkConditions* downlink = nullptr;
+			std::map<Address, SimHost*, AddressLess>::const_iterator it = hosts.find(packet.to.addr);
+			if (it != hosts.end())
+			{
+				downlink = &it->second->link;
+			}
+			else if (isStunServer(packet.to))
+			{
+				packet.sender = host;
+			}
+			else
+			{
+				++totals.unroutable;
+				return;
+			}
+
+			if (chance(host->link.loss) || (downlink && chance(downlink->loss)))
+			{
+				++totals.lost;
+				return;
+			}
+
+			uint32_t len = 0;
+			for (uint32_t ii = 0; ii < nbuffers; ++ii)
+			{
+				len += static_cast<uint32_t>(buffers[ii].len);
+			}
+			if (len > c_simMaxDatagram)
+				return;
+
+			const uint32_t copies = chance(host->link.duplicate) ? 2 : 1;
+			totals.duplicated += copies - 1;
+			for (uint32_t copy = 0; copy < copies; ++copy)
+			{
+				packet.buffer = allocateBuffer();
+				packet.len = len;
+
+				uint8_t* p = buffers_[packet.buffer];
+				for (uint32_t ii = 0; ii < nbuffers; ++ii)
+				{
+					memcpy(p, buffers[ii].p, buffers[ii].len);
+					p += buffers[ii].len;
+				}
+
+				packet.deliverAt = currentTime() + delay(host->link) + (downlink ? delay(*downlink) : 0);
+				packet.sequence = ++sequence;
+				inflight.push(packet);
+			}
+		}
+
+		uint32_t receive(Socket handle, Datagram* datagrams, uint32_t ndatagrams)
+		{
+			std::unique_lock<std::mutex> l(lock);
+
+			SimSocket* s = reinterpret_cast<SimSocket*>(handle);
+			uint32_t nreceived = 0;
+			while (nreceived < ndatagrams && !s->queue.empty())
+			{
+				const SimQueued& q = s->queue.front();
+
+				Datagram& dg = datagrams[nreceived++];
+				dg.len = std::min(q.len, dg.capacity);
+				memcpy(dg.p, buffers_[q.buffer], dg.len);
+				addressFrom(&dg.addr, q.from.addr, q.from.bePort);
+
+				freeBuffers.push_back(q.buffer);
+				s->queue.pop_front();
+			}
+
+			return nreceived;
+		}
+
+	private:
+		static bool isUnspecified(const Address& addr)
+		{
+			static const uint8_t zero[16] = {};
+			if (addr.family == AddressFamily::IPv4)
+				return 0 == memcmp(&addr.u.v4, zero, sizeof(addr.u.v4));
+			return 0 == memcmp(&addr.u.v6, zero, sizeof(addr.u.v6));
+		}
+
+		bool isStunServer(const SimEndpoint& to) const
+		{
+			for (size_t ii = 0, nn = stunServers.size(); ii != nn; ++ii)
+			{
+				if (endpointIsEqual(stunServers[ii], to))
+					return true;
+			}
+			return false;
+		}
+
+		void deliver(const SimPacket& packet)
+		{
+			if (packet.sender)
+			{
+				answerStun(packet);
+				return;
+			}
+
+			std::map<Address, SimHost*, AddressLess>::const_iterator it = hosts.find(packet.to.addr);
+			const uint16_t localPort = (it != hosts.end()) ? it->second->inbound(packet.to.bePort, packet.from) : 0;
+			std::map<uint16_t, SimSocket*>::const_iterator socket;
+			if (localPort == 0 || (socket = it->second->sockets.find(localPort)) == it->second->sockets.end())
+			{
+				++totals.filtered;
+				freeBuffers.push_back(packet.buffer);
+				return;
+			}
+
+			SimQueued q;
+			q.from = packet.from;
+			q.buffer = packet.buffer;
+			q.len = packet.len;
+			socket->second->queue.push_back(q);
+			++totals.delivered;
+		}
+
+		// the server replies with the reflexive address the request came
+		// from, over the requester's downlink
+		void answerStun(const SimPacket& request)
+		{
+			uint8_t response[c_stunServerResponseMaxSize];
+			const uint32_t nresponse = stunGenerateServerResponse(response, buffers_[request.buffer], request.len, request.from.addr, request.from.bePort);
+			freeBuffers.push_back(request.buffer);
+			++totals.delivered;
+
+			if (nresponse == 0 || hosts.find(request.from.addr) == hosts.end())
+				return;
+
+			SimPacket packet;
+			packet.from = request.to;
+			packet.to = request.from;
+			packet.sender = nullptr;
+			packet.buffer = allocateBuffer();
+			packet.len = nresponse;
+			memcpy(buffers_[packet.buffer], response, nresponse);
+			packet.deliverAt = currentTime() + delay(request.sender->link);
+			packet.sequence = ++sequence;
+			inflight.push(packet);
+			++totals.sent;
+		}
+
+		void closeSocket(SimSocket* s)
+		{
+			for (size_t ii = 0, nn = s->queue.size(); ii != nn; ++ii)
+			{
+				freeBuffers.push_back(s->queue[ii].buffer);
+			}
+			delete s;
+		}
+
+		// datagram storage is recycled, the steady state allocates nothing
+		uint32_t allocateBuffer()
+		{
+			if (!freeBuffers.empty())
+			{
+				const uint32_t index = freeBuffers.back();
+				freeBuffers.pop_back();
+				return index;
+			}
+
+			buffers.push_back(new uint8_t[c_simMaxDatagram]);
+			buffers_ = buffers.data();
+			return static_cast<uint32_t>(buffers.size() - 1);
+		}
+
+		// xorshift64*
+		uint64_t random()
+		{
+			rng ^= rng >> 12;
+			rng ^= rng << 25;
+			rng ^= rng >> 27;
+			return rng * 0x2545F4914F6CDD1Dull;
+		}
+
+		bool chance(float p)
+		{
+			if (p <= 0.0f)
+				return false;
+			return static_cast<double>(random() >> 11) * (1.0 / 9007199254740992.0) < p;
+		}
+
+		uint64_t delay(const LinkConditions& link)
+		{
+			uint64_t us = link.latencyUS;
+			if (link.jitterUS)
+			{
+				us += random() % (link.jitterUS + 1);
+			}
+			if (link.reorderUS && chance(link.reorder))
+			{
+				us += link.reorderUS;
+			}
+			return us;
+		}
+
+		SimClock simClock;
+		std::atomic<uint64_t> now;
+		uint64_t rng;
+		uint64_t sequence;
+		uint32_t refs; // the simulator itself and each host
+		std::thread::id driver; // the thread that created the simulator
+
+		std::mutex lock;
+		std::map<Address, SimHost*, AddressLess> hosts; // by public address
+		std::vector<SimEndpoint> stunServers;
+		std::priority_queue<SimPacket, std::vector<SimPacket>, PacketLater> inflight;
+		std::vector<uint8_t*> buffers;
+		uint8_t** buffers_;
+		std::vector<uint32_t> freeBuffers;
+		SimulatorStats totals;
+	};
+
+	uint64_t SimClock::current()
+	{
+		return sim->currentTime();
+	}
+
+	// only the thread driving the simulation moves time. other threads
+	// would make a run depend on how they are scheduled, they sleep in
+	// real time instead
+	void SimClock::sleep(uint32_t milliseconds)
+	{
+		if (sim->onDriverThread())
+		{
+			sim->advance(static_cast<uint64_t>(milliseconds) * 1000);
+		}
+		else
+		{
+			tiny::sleep(milliseconds);
+		}
+	}
+
+	IClock* SimHost::clock()
+	{
+		return sim->clock();
+	}
+
+	void SimHost::release()
+	{
+		sim->removeHost(this);
+	}
+
+	uint32_t SimHost::adapters(Address* addresses, uint32_t naddresses)
+	{
+		if (naddresses >= 1)
+		{
+			addresses[0] = privateAddr;
+		}
+		return 1;
+	}
+
+	bool SimHost::createUDP(Socket* out, const Address& addr, uint16_t* bePort)
+	{
+		return sim->createSocket(this, out, addr, bePort);
+	}
+
+	void SimHost::close(Socket s)
+	{
+		sim->destroySocket(this, s);
+	}
+
+	bool SimHost::sendTo(Socket s, const ConstBuffer* buffers, uint32_t nbuffers, const PlatformSocketAddr& addr)
+	{
+		sim->send(this, s, buffers, nbuffers, addr);
+		return true;
+	}
+
+	uint32_t SimHost::recvBatch(Socket s, Datagram* datagrams, uint32_t ndatagrams)
+	{
+		return sim->receive(s, datagrams, ndatagrams);
+	}
+}
+
+INetworkSimulator* net::networkSimulatorCreate(uint64_t seed)
+{
+	return new NetworkSimulator(seed);
+}
@@ -29,6 +29,7 @@
 
 #include <stdint.h>
 #include "tiny/net/address.h"
+#include "peer/ice/priority.h"
 
 namespace tiny
 {
@@ -42,6 +43,11 @@ namespace tiny
 			uint16_t port; // network byte order
 		};
 
+		static inline bool candidateIsRelayed(const Candidate& c)
+		{
+			return (c.priority & 0xFF000000) == TypePreference::Relay;
+		}
+
 		bool candidateShouldUseHostAddress(const net::Address& addr);
 		uint32_t candidatesEncodeLength(const Candidate& c);
 		uint8_t* candidatesEncode(uint8_t* out, const Candidate& c);
@@ -92,3 +92,23 @@ uint32_t peer::foundationForPeerReflexiveAddress(const Address& addr)
 
     return murmur3_end(&st);
 }
+
+uint32_t peer::foundationForRelayAddress(const Address& addr)
+{
+	murmur3_state st;
+	murmur3_begin(&st);
+	murmur3_add(&st, "RELAYUDP", 8);
+
+	switch (addr.family)
+	{
+	case AddressFamily::IPv4:
+		murmur3_add(&st, &addr.u.v4, sizeof(addr.u.v4));
+		break;
+
+	case AddressFamily::IPv6:
+		murmur3_add(&st, &addr.u.v6, sizeof(addr.u.v6));
+		break;
+	}
+
+	return murmur3_end(&st);
+}
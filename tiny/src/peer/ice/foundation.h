@@ -37,6 +37,7 @@ namespace tiny
 		uint32_t foundationForHostAddress(const net::Address& addr);
 		uint32_t foundationForServerReflexiveAddress(uint32_t hostFoundation, const net::Address& addr);
 		uint32_t foundationForPeerReflexiveAddress(const net::Address& addr);
+		uint32_t foundationForRelayAddress(const net::Address& addr);
 	}
 }
 
@@ -29,8 +29,10 @@
 #if TINY_PEER_ENABLE_ICE
 
 #include <stdint.h>
+#include <stdio.h>
 #include <string.h>
 #include <algorithm>
+#include <string>
 #include <vector>
 #if TINY_PLATFORM_WINDOWS
 #include <eh.h>
@@ -39,16 +41,24 @@
 #include "peer/ice/candidate.h"
 #include "peer/ice/foundation.h"
 #include "peer/ice/priority.h"
+#include "peer/ice/ratelimit.h"
+#include "peer/ice/relay.h"
 #include "peer/ice/stun.h"
+#include "peer/sharded/address.h"
 #include "tiny/endian.h"
+#include "tiny/crypto/chacha20poly1305.h"
 #include "tiny/crypto/hmac.h"
 #include "tiny/crypto/rand.h"
-#include "tiny/net/adapter.h"
 #include "tiny/net/address.h"
+#include "tiny/net/engine.h"
+#include "tiny/net/packet.h"
 #include "tiny/net/resolve.h"
+#include "tiny/net/sharedchannel.h"
 #include "tiny/net/socket.h"
 #include "tiny/peer/mesh.h"
 #include "tiny/peer/message.h"
+#include "tiny/peer/stats.h"
+#include "tiny/profile.h"
 #include "tiny/time.h"
 
 using namespace tiny;
@@ -73,8 +83,10 @@ namespace
 		uint8_t stunBindingRequest[20+8];
 		uint64_t nextStunAttempt;
 		uint8_t totalStunAttempts;
+		uint8_t stunServer; // server that provided the reflexive address
 		bool waitingOnServerReflexive;
 		bool hasServerReflexiveAddress;
+		bool relayed; // address allocated on the relay server, `s' is the base's socket
 	};
 
 	struct RemoteCandidate : Candidate
@@ -97,14 +109,24 @@ namespace
 		uint64_t foundation;
 		uint64_t priority;
 		uint64_t timeout;
+		uint64_t sentAt;
+		uint32_t triggered; // order in the triggered queue, 0 if not triggered
 		CheckState::E state;
-		uint8_t totalAttempts;
+		uint8_t totalAttempts; // sends of every transaction, the failure budget
+		uint8_t transmissions; // sends of the current transaction, 0 if waiting
 		uint8_t localCandidate;
 		uint8_t remoteCandidate;
 		bool nominated;
+		bool cached; // pair remembered from a previous connection
+		CandidateType::E localType; // from the mapped address of a response
 
 		uint8_t stunRequest[20+76];
 		int nstunRequest;
+
+		// header of the transaction replaced by a triggered check. its
+		// response still completes the check, but is no round trip sample
+		uint8_t cancelledRequest[20];
+		bool cancelled;
 	};
 
 	struct peerconn
@@ -123,6 +145,97 @@ namespace
 		bool controlling;
 
 		uint8_t keepAlive[20+52];
+		uint64_t keepAliveSentAt; // 0 if no keep-alive is outstanding
+		uint64_t nextRttProbe;
+		uint64_t connectStart;
+		uint64_t checkSrtt; // 0 until the first check round trip
+		uint64_t checkRttvar;
+		PeerStats stats;
+
+		// connection tags of media to and from the peer, see `connectionTag'
+		uint32_t sendTag;
+		uint32_t recvTag;
+		TokenBucket mediaBucket;
+		TokenBucket stunBucket; // requests from the peer's known addresses
+
+		// keys of encrypted media to and from the peer, see `mediaKey'.
+		// `sendNonce' starts at a random value per connection so nonces
+		// aren't reused when the peer reconnects
+		chacha20poly1305_key sendKey;
+		chacha20poly1305_key recvKey;
+		uint64_t sendNonce;
+
+		// transport to a peer in another process on this host, nullptr if
+		// the peer is remote. media goes through it once both sides opened it
+		SharedChannel* shm;
+		std::vector<Message> shmMessages;
+	};
+
+	struct StunServerState
+	{
+		ResolveRequest* resolve; // nullptr once resolution finished
+		PlatformSocketAddr addr4; // size is 0 if unavailable
+		PlatformSocketAddr addr6;
+		uint64_t firstSentAt; // 0 until a request was sent this session
+		uint32_t latencySlot; // index into `MeshICE::stunLatency'
+		uint16_t bePort;
+		bool answered;
+	};
+
+	// response time of a STUN server, kept across sessions
+	struct StunLatency
+	{
+		std::string host;
+		uint64_t ewma; // ticks, 0 if unknown
+		uint16_t port;
+	};
+
+	// last nominated pair for a remote id, tried first on reconnect
+	struct CachedPair
+	{
+		uint64_t remoteId;
+		uint64_t lastUsed;
+		Address remoteAddress;
+		uint32_t remotePriority;
+		uint16_t remotePort;
+		uint8_t localCandidate;
+	};
+
+	// allocation on the relay server given to `setRelayServer'
+	struct RelayClient
+	{
+		std::string host;
+		std::vector<uint8_t> key;
+		ResolveRequest* resolve; // nullptr once resolution finished
+		PlatformSocketAddr addr; // size is 0 until resolved
+		uint64_t clientId;
+		uint64_t nextAttempt;
+		uint8_t transactionId[c_relayTransactionIdSize];
+		uint8_t token[c_relayTokenSize];
+		uint8_t cookie[c_relayCookieSize]; // last cookie the server challenged with
+		uint16_t bePort;
+		uint8_t totalAttempts;
+		uint8_t baseCandidate; // host candidate the server is reached from
+		uint8_t localCandidate; // index of the relayed candidate, 0xff until allocated
+		bool configured;
+		bool relayOnly;
+		bool waiting; // allocation outstanding while gathering
+	};
+
+	struct MediaDigest
+	{
+		uint8_t mac[hmac_sha1_state::DIGEST_SIZE];
+	};
+
+	// media packet that passed the cheap checks, waiting for its MAC to be
+	// verified with the rest of the update's packets
+	struct PendingMedia
+	{
+		Message* slot;
+		uint8_t* incoming;
+		int32_t read;
+		uint32_t peer; // index into `MeshICE::peers'
+		bool sealed; // encrypted rather than only authenticated
 	};
 
 	struct peerBindingRequest
@@ -139,6 +252,8 @@ namespace
 static const int c_stunRetryStartupMS = 250; // Time to wait before retyring a STUN request
 static const int c_stunRetryConnectedMS = 15000; // Time to wait before retyring a STUN request
 static const int c_stunMaxAttempts = 5; // Maxmimum times to retry a STUN request
+// Servers queried in parallel per candidate, fastest known first
+static const uint32_t c_stunParallelServers = 3;
 // Time to wait for a remote connectivity attempt to revive an otherwise unreachable peer
 static const int c_peerCloseWaitMS = 3000;
 // Time to wait before assuming there is a gap in traffic, and to trigger a
@@ -146,6 +261,51 @@ static const int c_peerCloseWaitMS = 3000;
 static const int c_peerTrafficAbsentMS = 1000;
 // Time to wait before assuming the connectiong is dead
 static const int c_peerReceiveTimeout = 3000;
+// Interval between keep-alives used to measure round trip time, sent even
+// when media is flowing
+static const int c_peerRttProbeMS = 1000;
+// Maximum connectivity checks per peer
+static const size_t c_maxCandidatePairs = 50;
+// Interval between new connectivity checks across the whole mesh (Ta)
+static const int c_checkPacingMS = 20;
+// Retransmission timeout of a connectivity check before a round trip has
+// been measured, and its bounds once one has
+static const int c_checkInitialRtoMS = 250;
+static const int c_checkMinRtoMS = 100;
+static const int c_checkMaxRtoMS = 3000;
+// Interval between refreshes of a relay allocation, well within the
+// server's allocation lifetime
+static const int c_relayRefreshMS = 10000;
+// Remote ids whose last nominated pair is remembered
+static const size_t c_maxCachedPairs = 64;
+// Maximum datagrams read from a shared memory channel per update
+static const uint32_t c_sharedRecvBatchSize = 64;
+// Maximum datagrams read from each socket per update
+static const uint32_t c_recvBatchSize = 10;
+// Size of a single receive slot (Ethernet MTU, rounded up to a cache line)
+static const uint32_t c_recvSlotSize = 1536;
+// Media packet framing: prefix byte and connection tag in front of the
+// payload, HMAC-SHA1 of the tag and payload behind it
+static const uint8_t c_mediaPrefix = 0xC0;
+static const uint32_t c_connectionTagSize = 4;
+static const uint32_t c_mediaHeadroom = 1 + c_connectionTagSize;
+static const uint32_t c_mediaTailroom = hmac_sha1_state::DIGEST_SIZE;
+// Encrypted media framing: prefix byte, connection tag and nonce counter in
+// front of the ciphertext, Poly1305 tag of the header and ciphertext behind it
+static const uint8_t c_sealedMediaPrefix = 0xC1;
+static const uint32_t c_sealedNonceSize = 8;
+static const uint32_t c_sealedHeadroom = 1 + c_connectionTagSize + c_sealedNonceSize;
+static const uint32_t c_sealedTailroom = chacha20poly1305_key::TAG_SIZE;
+// Flood limits, packets per second and burst. STUN requests from a peer's
+// known addresses are limited per peer, requests from unknown sources per
+// source address and in aggregate. media is limited per peer. dropped
+// packets never reach the MAC
+static const uint32_t c_stunRequestsPerSource = 100;
+static const uint32_t c_stunRequestsPerSourceBurst = 50;
+static const uint32_t c_stunRequestsTotal = 2000;
+static const uint32_t c_stunRequestsTotalBurst = 500;
+static const uint32_t c_mediaPacketsPerPeer = 4000;
+static const uint32_t c_mediaPacketsPerPeerBurst = 1000;
 
 namespace
 {
@@ -156,40 +316,48 @@ namespace
 		~MeshICE()
 		{
 			// destroy sockets on another thread (closesocket is blocking in VR)
-			std::thread([](std::vector<LocalCandidate> localCandidates) {
+			std::thread([](ISocketEngine* engine, std::vector<LocalCandidate> localCandidates) {
 				// destroy sockets
 				for (size_t ii = 0, nn = localCandidates.size(); ii != nn; ++ii)
 				{
-					if (localCandidates[ii].s != InvalidSocket)
+					if (localCandidates[ii].s != InvalidSocket && !localCandidates[ii].relayed)
 					{
-						socketClose(localCandidates[ii].s);
+						engine->close(localCandidates[ii].s);
 					}
 				}
-			}, std::move(localCandidates)).detach();
 
-			// free remaining messages
+				engine->release();
+			}, engine, std::move(localCandidates)).detach();
+
 			for (size_t ii = 0, nn = peers.size(); ii != nn; ++ii)
 			{
-				peerconn* p = &peers[ii];
-				for (size_t jj = 0, nn1 = p->incoming.size(); jj != nn1; ++jj)
-				{
-					messageRelease(p->incoming[jj]);
-				}
+				closeSharedChannel(&peers[ii]);
 			}
 
+			releaseStunServers();
+			if (relay.resolve)
+			{
+				resolveRelease(relay.resolve);
+			}
 			crandDestroy(&rand);
 		}
 
+		explicit MeshICE(ISocketEngine* engine)
+			: engine(engine)
+			, clock(engine->clock())
+		{
+		}
+
 		bool create(uint32_t maxPeers, uint64_t localId, uint16_t port)
 		{
 			std::vector<Address> addresses;
-			uint32_t nadapters = enumerateAdapters(nullptr, 0);
+			uint32_t nadapters = engine->adapters(nullptr, 0);
 			if (0 == nadapters)
 			{
 				return false;
 			}
 			addresses.resize(nadapters);
-			if (nadapters != enumerateAdapters(addresses.data(), nadapters))
+			if (nadapters != engine->adapters(addresses.data(), nadapters))
 			{
 				return false;
 			}
@@ -204,6 +372,7 @@ namespace
 			for (size_t ii = 0, nn = maxPeers; ii != nn; ++ii)
 			{
 				this->peers[ii].state = PeerState::Invalid;
+				this->peers[ii].shm = nullptr;
 			}
 
 			// build local candidates, along with sockets (establish port numbers)
@@ -215,7 +384,7 @@ namespace
 
 				uint16_t candidatePort = endianToBig(port);
 				Socket s;
-				if (!socketCreateUDP(&s, addresses[ii], &candidatePort))
+				if (!engine->createUDP(&s, addresses[ii], &candidatePort))
 				{
 					return false;
 				}
@@ -228,16 +397,55 @@ namespace
 				cand.port = candidatePort;
 				cand.waitingOnServerReflexive = false;
 				cand.hasServerReflexiveAddress = false;
+				cand.relayed = false;
 				this->localCandidates.push_back(cand);
 			}
 
-			this->localCandidates.shrink_to_fit();
 			std::sort(this->localCandidates.begin(), this->localCandidates.end(), SortByPriority());
+
+			// the relayed candidate is appended behind the host candidates
+			// while packets are being processed, room is reserved so
+			// references into the vector stay valid
+			this->hostCandidateCount = static_cast<uint32_t>(this->localCandidates.size());
+			this->localCandidates.reserve(this->hostCandidateCount + 1);
+
+			// each socket owns `c_recvBatchSize' receive slots. datagrams are
+			// read directly into the slots and handed out as messages until
+			// the next update, so there is no per-packet allocation or copy
+			const size_t nslots = this->localCandidates.size() * c_recvBatchSize;
+			this->recvSlots.resize(nslots * c_recvSlotSize);
+			this->recvMessages.resize(nslots);
+			this->recvBatch.resize(c_recvBatchSize);
+			this->pendingMedia.reserve(nslots + c_recvBatchSize);
+			this->pendingInputs.reserve(nslots + c_recvBatchSize);
+			this->pendingDigests.reserve(nslots + c_recvBatchSize);
 	
+			memset(&this->totals, 0, sizeof(this->totals));
 			this->state = MeshState::Created;
-			this->timeFreqMS = timestampFrequency()/1000;
+			this->timeFreqMS = clock->frequency()/1000;
+
+			this->stunSourceLimit = rateLimitCreate(clock->frequency(), c_stunRequestsPerSource, c_stunRequestsPerSourceBurst);
+			this->stunTotalLimit = rateLimitCreate(clock->frequency(), c_stunRequestsTotal, c_stunRequestsTotalBurst);
+			this->mediaLimit = rateLimitCreate(clock->frequency(), c_mediaPacketsPerPeer, c_mediaPacketsPerPeerBurst);
+			sourceRateLimiterInit(&this->stunSources);
+			this->stunBucket.empty = 0;
+			hmac_sha1_key_init(&this->sessionMacKey, this->sessionKey.data(), 0);
+			this->encryptMedia = false;
 			this->peerSequence = 1;
+			this->nextCheckAt = 0;
+			this->nextCheckPeer = 0;
+			this->triggerSequence = 0;
 			crandInit(&this->rand);
+
+			this->relay.resolve = nullptr;
+			this->relay.addr.size = 0;
+			this->relay.baseCandidate = 0;
+			this->relay.localCandidate = 0xff;
+			this->relay.configured = false;
+			this->relay.relayOnly = false;
+			this->relay.waiting = false;
+			memset(this->relay.cookie, 0, sizeof(this->relay.cookie));
+			crandFill(&this->rand, reinterpret_cast<uint8_t*>(&this->relay.clientId), sizeof(this->relay.clientId));
 			return true;
 		}
 
@@ -247,41 +455,71 @@ namespace
 		}
 
 		virtual bool startSession(const char* stunHost, uint16_t stunPort)
+		{
+			StunServer server;
+			server.host = stunHost;
+			server.port = stunPort;
+			return startSession(&server, stunHost ? 1 : 0);
+		}
+
+		virtual void setRelayServer(const char* host, uint16_t port, const uint8_t* key, uint32_t nkey, bool relayOnly)
+		{
+			relay.configured = (host != nullptr);
+			relay.host = host ? host : "";
+			relay.key.assign(key, key + nkey);
+			relay.bePort = endianToBig(port);
+			relay.relayOnly = relay.configured && relayOnly;
+		}
+
+		virtual bool startSession(const StunServer* servers, uint32_t nservers)
 		{
 			if (state != MeshState::Created)
 			{
 				return false;
 			}
 
-			memset(&stunAddr4, 0, sizeof(stunAddr4));
-			memset(&stunAddr6, 0, sizeof(stunAddr6));
+			for (uint32_t ii = 0; ii < nservers; ++ii)
+			{
+				if (!servers[ii].host)
+					return false;
+			}
 
-			// resolve stun address
-			Address stun4;
-			Address stun6;
-			if (!stunHost || !resolveHost(&stun4.u.v4, &stun6.u.v6, stunHost))
+			// server reflexive and relayed candidates are gathered again for
+			// each session
+			remoteCandidates.clear();
+			localCandidates.resize(hostCandidateCount);
+			releaseStunServers();
+			startRelay();
+
+			// start resolving every server in the background. candidates
+			// query the servers as they resolve (see `updateStarting')
+			stunServers.resize(nservers);
+			for (uint32_t ii = 0; ii < nservers; ++ii)
 			{
-				state = MeshState::Starting;
-				return true;
+				StunServerState& server = stunServers[ii];
+				server.resolve = resolveHostAsync(servers[ii].host);
+				server.addr4.size = 0;
+				server.addr6.size = 0;
+				server.firstSentAt = 0;
+				server.latencySlot = findStunLatency(servers[ii].host, servers[ii].port);
+				server.bePort = endianToBig(servers[ii].port);
+				server.answered = false;
 			}
 
-			const uint16_t bePort = endianToBig(stunPort);
-			stun4.family = AddressFamily::IPv4;
-			stun6.family = AddressFamily::IPv6;
-			addressFrom(&stunAddr4, stun4, bePort);
-			addressFrom(&stunAddr6, stun6, bePort);
+			// fastest known servers first. servers without history are
+			// assumed to answer within the startup retry interval
+			std::stable_sort(stunServers.begin(), stunServers.end(), [this](const StunServerState& a, const StunServerState& b) {
+				return expectedLatency(a) < expectedLatency(b);
+			});
 
-			// generate and send initial STUN binding requests
-			const uint64_t now = timestampCurrent();
 			for (size_t ii = 0, nn = localCandidates.size(); ii != nn; ++ii)
 			{
-				uint8_t* attr = stunGenerateBindingRequest(rand, localCandidates[ii].stunBindingRequest, 8);
-				stunAppendFingerprint8(attr, localCandidates[ii].stunBindingRequest);
-				if (sendServerReflexiveBindingRequest(localCandidates[ii], now, c_stunRetryStartupMS))
-				{
-					localCandidates[ii].waitingOnServerReflexive = true;
-					localCandidates[ii].totalStunAttempts = 1;
-				}
+				LocalCandidate& c = localCandidates[ii];
+				uint8_t* attr = stunGenerateBindingRequest(rand, c.stunBindingRequest, 8);
+				stunAppendFingerprint8(attr, c.stunBindingRequest);
+				c.waitingOnServerReflexive = (nservers != 0);
+				c.hasServerReflexiveAddress = false;
+				c.totalStunAttempts = 0;
 			}
 
 			state = MeshState::Starting;
@@ -291,6 +529,12 @@ namespace
 		virtual void setSessionKey(const uint8_t* key, int nkey)
 		{
 			sessionKey.assign(key, key+nkey);
+			hmac_sha1_key_init(&sessionMacKey, key, static_cast<uint32_t>(nkey));
+		}
+
+		virtual void setMediaEncryption(bool encrypt)
+		{
+			encryptMedia = encrypt;
 		}
 
 		virtual void endSession()
@@ -303,46 +547,75 @@ namespace
 
 		virtual uint32_t localAddressSize()
 		{
-			if (state != MeshState::Running)
+			return localAddressSizeFrom(0);
+		}
+
+		virtual void serializeLocalAddress(uint8_t* out)
+		{
+			serializeLocalAddressFrom(0, out);
+		}
+
+		virtual uint32_t localCandidateCount()
+		{
+			if (state != MeshState::Starting && state != MeshState::Running)
 			{
 				return 0;
 			}
 
-			uint32_t sizeRequired = 1; // number of candidates
-			for (size_t ii = 0, nn = localCandidates.size(); ii != nn; ++ii)
+			// host candidates are fixed at creation, server reflexive and
+			// relayed candidates are appended in the order they are discovered
+			return static_cast<uint32_t>(hostCandidateCount + remoteCandidates.size());
+		}
+
+		virtual uint32_t localAddressSizeFrom(uint32_t first)
+		{
+			const uint32_t count = localCandidateCount();
+			if (count == 0)
 			{
-				sizeRequired += candidatesEncodeLength(localCandidates[ii]);
+				return 0;
 			}
-			for (size_t ii = 0, nn = remoteCandidates.size(); ii != nn; ++ii)
+
+			uint32_t sizeRequired = 1; // number of candidates
+			for (uint32_t ii = first; ii < count; ++ii)
 			{
-				sizeRequired += candidatesEncodeLength(remoteCandidates[ii]);
+				if (publishCandidate(localCandidateAt(ii)))
+				{
+					sizeRequired += candidatesEncodeLength(localCandidateAt(ii));
+				}
 			}
 
 			return sizeRequired;
 		}
 
-		virtual void serializeLocalAddress(uint8_t* out)
+		virtual void serializeLocalAddressFrom(uint32_t first, uint8_t* out)
 		{
-			out[0] = static_cast<uint8_t>(localCandidates.size() + remoteCandidates.size());
+			const uint32_t count = localCandidateCount();
+			uint8_t* numCandidates = out;
+			*numCandidates = 0;
 			++out;
-			for (size_t ii = 0, nn = localCandidates.size(); ii != nn; ++ii)
-			{
-				out = candidatesEncode(out, localCandidates[ii]);
-			}
-			for (size_t ii = 0, nn = remoteCandidates.size(); ii != nn; ++ii)
+			for (uint32_t ii = first; ii < count; ++ii)
 			{
-				out = candidatesEncode(out, remoteCandidates[ii]);
+				if (publishCandidate(localCandidateAt(ii)))
+				{
+					out = candidatesEncode(out, localCandidateAt(ii));
+					++*numCandidates;
+				}
 			}
 		}
 
 		virtual uint32_t connectToPeer(uint64_t remoteId, const uint8_t* remoteAddress, uint32_t nremoteAddress)
 		{
-			if (MeshState::Running != state || nremoteAddress == 0)
+			// host candidates are usable as soon as the session starts
+			if ((MeshState::Starting != state && MeshState::Running != state) || nremoteAddress == 0)
 				return InvalidMeshPeer;
 
 			if (localId == remoteId)
 				return InvalidMeshPeer;
 
+			// a sharded remote mesh publishes one address per shard
+			if (!shardedAddressSelect(&remoteAddress, &nremoteAddress, localId) || nremoteAddress == 0)
+				return InvalidMeshPeer;
+
 			// find an available beer
 			uint32_t index = InvalidMeshPeer;
 			for (size_t ii = 0, nn = peers.size(); ii != nn; ++ii)
@@ -360,36 +633,15 @@ namespace
 				return InvalidMeshPeer;
 
 			peerconn* p = &peers[index];
+			closeSharedChannel(p);
 			p->id = remoteId;
 
 			// parse the remote address list
-			uint8_t numCandidates = remoteAddress[0];
-			p->remoteCandidates.resize(numCandidates);
-			++remoteAddress;
-			--nremoteAddress;
-			for (uint8_t ii = 0; ii < numCandidates; ++ii)
-			{
-				uint32_t read = candidateDecode(&p->remoteCandidates[ii], remoteAddress, nremoteAddress);
-				if (read == 0)
-				{
-					return InvalidMeshPeer;
-				}
-
-				remoteAddress += read;
-				nremoteAddress -= read;
-			}
-			if (nremoteAddress != 0)
+			if (!decodeRemoteCandidates(&p->remoteCandidates, remoteAddress, nremoteAddress))
 			{
 				return InvalidMeshPeer;
 			}
 
-			// build socket addresses
-			for (uint8_t ii = 0; ii < numCandidates; ++ii)
-			{
-				RemoteCandidate& c = p->remoteCandidates[ii];
-				addressFrom(&c.sockaddr, c.address, c.port);
-			}
-
 			// are we the controlling entity for this peer
 			p->controlling = localId > remoteId;
 
@@ -403,20 +655,19 @@ namespace
 					const Candidate& remote = p->remoteCandidates[jj];
 
 					// compatible?
-					if (local.address.family != remote.address.family)
+					if (local.address.family != remote.address.family || !pairCandidate(local))
 						continue;
 
 					++numCandidatePairs;
 				}
 			}
 
-			// can't connect to a peer for which we don't have a valid candidate pair
-			if (0 == numCandidatePairs)
-			{
-				return InvalidMeshPeer;
-			}
+			// without a valid candidate pair the peer waits for trickled
+			// candidates (`addRemoteCandidates') or an incoming check, and
+			// is dropped after `c_peerCloseWaitMS'
 
 			// generate candidate pairs
+			p->connectivityChecks.clear();
 			p->connectivityChecks.reserve(numCandidatePairs);
 			for (uint8_t ii = 0, nn0 = static_cast<uint8_t>(localCandidates.size()); ii != nn0; ++ii)
 			{
@@ -426,7 +677,7 @@ namespace
 					const Candidate& remote = p->remoteCandidates[jj];
 
 					// compatible?
-					if (local.address.family != remote.address.family)
+					if (local.address.family != remote.address.family || !pairCandidate(local))
 						continue;
 
 					p->connectivityChecks.resize(p->connectivityChecks.size() + 1);
@@ -437,30 +688,34 @@ namespace
 
 			// limit candidate pairs
 			std::sort(p->connectivityChecks.begin(), p->connectivityChecks.end(), SortByPriority());
-			if (p->connectivityChecks.size() > 50)
+			if (p->connectivityChecks.size() > c_maxCandidatePairs)
 			{
-				p->connectivityChecks.resize(50);
+				p->connectivityChecks.resize(c_maxCandidatePairs);
 				p->connectivityChecks.shrink_to_fit();
 			}
 
-			const uint64_t now = timestampCurrent();
+			const uint64_t now = clock->current();
 
 			// generate STUN request packets
 			for (size_t ii = 0, nn = p->connectivityChecks.size(); ii != nn; ++ii)
 			{
-				ConnectivityCheck* check = &p->connectivityChecks[ii];
-				uint8_t* attr = stunGenerateBindingRequest(rand, check->stunRequest, 72);
-				attr = stunAppendUsernameAttribute20(attr, localId, remoteId);
-				attr = stunAppendICEControlAttribute12(attr, p->controlling, localId);
-				attr = stunAppendICEPriorityAttribute8(attr, priorityChangeTypePreference(localCandidates[check->localCandidate].priority, TypePreference::PeerReflexive));
-				attr = stunAppendMessageIntegrityAttribute24(attr, check->stunRequest, sessionKey.data(), static_cast<uint32_t>(sessionKey.size()));
-				attr = stunAppendFingerprint8(attr, check->stunRequest);
-				check->nstunRequest = static_cast<int>(attr-check->stunRequest);
+				generateCheckRequest(p, &p->connectivityChecks[ii]);
 			}
 
 			p->state = PeerState::Negotiating;
 			p->timeout = 0xFFFFFFFFFFFFFFFF;
 			p->sockaddr.size = 0;
+			p->connectStart = now;
+			p->checkSrtt = 0;
+			p->checkRttvar = 0;
+			memset(&p->stats, 0, sizeof(p->stats));
+			p->sendTag = connectionTag(localId, remoteId);
+			p->recvTag = connectionTag(remoteId, localId);
+			p->mediaBucket.empty = 0;
+			p->stunBucket.empty = 0;
+			mediaKey(localId, remoteId, &p->sendKey);
+			mediaKey(remoteId, localId, &p->recvKey);
+			crandFill(&rand, reinterpret_cast<uint8_t*>(&p->sendNonce), sizeof(p->sendNonce));
 			p->sequence = index|(peerSequence << 8);
 			++peerSequence;
 
@@ -475,10 +730,77 @@ namespace
 				}
 			}
 
+			tryCachedPair(p, now);
 			updatePeerNegotiation(p, now);
+			scheduleChecks(now);
 			return p->sequence;
 		}
 
+		virtual bool addRemoteCandidates(uint32_t peerId, const uint8_t* remoteAddress, uint32_t nremoteAddress)
+		{
+			const uint8_t index = static_cast<uint8_t>(peerId & 0xFF);
+			if (index >= peers.size())
+				return false;
+
+			peerconn* p = &peers[index];
+			if (p->sequence != peerId || p->state != PeerState::Negotiating)
+				return false;
+
+			if (!shardedAddressSelect(&remoteAddress, &nremoteAddress, localId) || nremoteAddress == 0)
+				return false;
+
+			std::vector<RemoteCandidate> candidates;
+			if (!decodeRemoteCandidates(&candidates, remoteAddress, nremoteAddress))
+				return false;
+
+			bool added = false;
+			for (size_t ii = 0, nn = candidates.size(); ii != nn; ++ii)
+			{
+				const RemoteCandidate& c = candidates[ii];
+
+				// candidates may be trickled more than once
+				bool known = false;
+				for (size_t jj = 0, nn2 = p->remoteCandidates.size(); jj != nn2; ++jj)
+				{
+					if (addressIsEqual(p->remoteCandidates[jj].address, c.address) && p->remoteCandidates[jj].port == c.port)
+					{
+						known = true;
+						break;
+					}
+				}
+				if (known || p->remoteCandidates.size() >= 0xff)
+					continue;
+
+				const uint8_t remoteIndex = static_cast<uint8_t>(p->remoteCandidates.size());
+				p->remoteCandidates.push_back(c);
+
+				for (uint8_t jj = 0, nn2 = static_cast<uint8_t>(localCandidates.size()); jj != nn2; ++jj)
+				{
+					if (localCandidates[jj].address.family != c.address.family || !pairCandidate(localCandidates[jj]))
+						continue;
+					if (p->connectivityChecks.size() >= c_maxCandidatePairs)
+						break;
+
+					ConnectivityCheck newCheck;
+					initializeConnectivityCheck(&newCheck, p, jj, remoteIndex);
+					std::vector<ConnectivityCheck>::iterator it = std::lower_bound(p->connectivityChecks.begin(), p->connectivityChecks.end(), newCheck, SortByPriority());
+					generateCheckRequest(p, &(*p->connectivityChecks.insert(it, newCheck)));
+					added = true;
+				}
+			}
+
+			// new pairs revive a peer whose checklist had failed
+			if (added)
+			{
+				const uint64_t now = clock->current();
+				p->timeout = 0xFFFFFFFFFFFFFFFF;
+				updatePeerNegotiation(p, now);
+				scheduleChecks(now);
+			}
+
+			return true;
+		}
+
 		virtual void disconnectPeer(uint32_t peerId)
 		{
 			const uint8_t index = static_cast<uint8_t>(peerId & 0xFF);
@@ -487,7 +809,10 @@ namespace
 
 			struct peerconn* p = &peers[index];
 			if (p->sequence == peerId)
+			{
 				p->state = PeerState::Invalid;
+				closeSharedChannel(p);
+			}
 		}
 
 		virtual PeerState::E peerState(uint32_t peerId)
@@ -511,25 +836,148 @@ namespace
 			if (peer->sequence != peerId || peer->state != PeerState::Connected)
 				return;
 
-			uint8_t mac[hmac_sha1_state::DIGEST_SIZE];
-			hmac_sha1_state st;
-			hmac_sha1_begin(&st, sessionKey.data(), static_cast<uint32_t>(sessionKey.size()));
-			hmac_sha1_add(&st, &localId, sizeof(localId));
-			hmac_sha1_add(&st, p, n);
-			hmac_sha1_end(&st, mac);
+			if (encryptMedia)
+			{
+				sendSealed(peer, static_cast<const uint8_t*>(p), n);
+				return;
+			}
+
+			uint8_t header[c_mediaHeadroom];
+			header[0] = c_mediaPrefix;
+			memcpy(&header[1], &peer->sendTag, c_connectionTagSize);
 
-			const uint8_t packetPrefix = 0xC0;
+			// the tag is MACed along with the payload; hash a copy so the
+			// message is contiguous
+			uint8_t prefix[sizeof(localId) + c_connectionTagSize];
+			memcpy(prefix, &localId, sizeof(localId));
+			memcpy(prefix + sizeof(localId), &header[1], c_connectionTagSize);
+
+			uint8_t mac[hmac_sha1_state::DIGEST_SIZE];
+			hmac_sha1_input input;
+			input.prefix = prefix;
+			input.nprefix = sizeof(prefix);
+			input.p = p;
+			input.n = n;
+			hmac_sha1_batch(&sessionMacKey, &input, 1, &mac);
 
 			ConstBuffer b[3];
-			b[0].p = &packetPrefix;
-			b[0].len = 1;
+			b[0].p = header;
+			b[0].len = sizeof(header);
 			b[1].p = static_cast<const uint8_t*>(p);
 			b[1].len = n;
 			b[2].p = mac;
 			b[2].len = sizeof(mac);
 
-			socketSendTo(localCandidates[peer->localCandidate].s, b, 3, peer->sockaddr);
-			peer->timeout = timestampCurrent() + c_peerTrafficAbsentMS*timeFreqMS;
+			sendMedia(peer, b, 3, n);
+		}
+
+		virtual uint32_t packetHeadroom()
+		{
+			// room for either framing, encryption may be switched on at any time
+			return c_sealedHeadroom > c_mediaHeadroom ? c_sealedHeadroom : c_mediaHeadroom;
+		}
+
+		virtual uint32_t packetTailroom()
+		{
+			return c_sealedTailroom > c_mediaTailroom ? c_sealedTailroom : c_mediaTailroom;
+		}
+
+		virtual void sendUnreliablePacketToPeer(uint32_t peerId, PacketBuffer* packet)
+		{
+			const uint8_t index = static_cast<uint8_t>(peerId & 0xFF);
+			if (index >= peers.size())
+				return;
+
+			peerconn* peer = &peers[index];
+
+			// if we're not connected, drop the packet.
+			if (peer->sequence != peerId || peer->state != PeerState::Connected)
+				return;
+
+			if (net::packetHeadroom(*packet) < c_mediaHeadroom || net::packetTailroom(*packet) < c_mediaTailroom)
+				return;
+
+			uint8_t* payload = packetData(*packet);
+			const uint32_t npayload = packetSize(*packet);
+
+			// the ciphertext differs per peer, so it can't be written over
+			// a payload that may be sent to other peers
+			if (encryptMedia)
+			{
+				sendSealed(peer, payload, npayload);
+				return;
+			}
+
+			// finalize in place: prefix and tag in the headroom, MAC in the
+			// tailroom
+			uint8_t* header = payload - c_mediaHeadroom;
+			header[0] = c_mediaPrefix;
+			memcpy(&header[1], &peer->sendTag, c_connectionTagSize);
+
+			hmac_sha1_input input;
+			input.prefix = &localId;
+			input.nprefix = sizeof(localId);
+			input.p = &header[1];
+			input.n = c_connectionTagSize + npayload;
+			hmac_sha1_batch(&sessionMacKey, &input, 1, reinterpret_cast<uint8_t(*)[hmac_sha1_state::DIGEST_SIZE]>(payload + npayload));
+
+			ConstBuffer b;
+			b.p = header;
+			b.len = c_mediaHeadroom + npayload + c_mediaTailroom;
+
+			sendMedia(peer, &b, 1, npayload);
+		}
+
+		// encrypt a media payload for `peer' into the scratch buffer and send it
+		void sendSealed(peerconn* peer, const uint8_t* payload, uint32_t npayload)
+		{
+			sealScratch.resize(c_sealedHeadroom + npayload + c_sealedTailroom);
+			uint8_t* header = sealScratch.data();
+			header[0] = c_sealedMediaPrefix;
+			memcpy(&header[1], &peer->sendTag, c_connectionTagSize);
+			const uint64_t counter = endianToLittle(peer->sendNonce++);
+			memcpy(&header[1 + c_connectionTagSize], &counter, c_sealedNonceSize);
+
+			// the header is authenticated, not encrypted
+			uint8_t nonce[chacha20poly1305_key::NONCE_SIZE];
+			mediaNonce(nonce, &header[1 + c_connectionTagSize]);
+			chacha20poly1305_seal(&peer->sendKey, nonce
+				, header, c_sealedHeadroom, payload, header + c_sealedHeadroom, npayload
+				, header + c_sealedHeadroom + npayload);
+
+			ConstBuffer b;
+			b.p = header;
+			b.len = static_cast<uint32_t>(sealScratch.size());
+
+			sendMedia(peer, &b, 1, npayload);
+		}
+
+		// send a framed media packet carrying `npayload' bytes of payload.
+		// co-located peers get it through shared memory, which skips the
+		// socket but not the MAC or encryption
+		void sendMedia(peerconn* peer, const ConstBuffer* buffers, uint32_t nbuffers, uint32_t npayload)
+		{
+			if (peer->shm && sharedChannelConnected(peer->shm))
+			{
+				if (sharedChannelSend(peer->shm, buffers, nbuffers))
+				{
+					countSent(peer, npayload);
+				}
+				return;
+			}
+
+			sendFromCandidate(peer->localCandidate, buffers, nbuffers, peer->sockaddr);
+			peer->timeout = clock->current() + c_peerTrafficAbsentMS*timeFreqMS;
+			countSent(peer, npayload);
+		}
+
+		// 96 bit nonce of the 64 bit counter carried by an encrypted packet.
+		// keys are per direction, so only the counter has to be unique
+		static void mediaNonce(uint8_t nonce[chacha20poly1305_key::NONCE_SIZE], const uint8_t* counter)
+		{
+			static const uint32_t c_zeroes = chacha20poly1305_key::NONCE_SIZE - c_sealedNonceSize;
+			memset(nonce, 0, c_zeroes);
+			memcpy(nonce + c_zeroes, counter, c_sealedNonceSize);
 		}
 
 		virtual bool receive(uint32_t peer, Message*** messages, uint32_t* nmessages)
@@ -551,18 +999,57 @@ namespace
 			return true;
 		}
 
+		virtual bool peerStats(uint32_t peer, PeerStats* stats)
+		{
+			const uint8_t index = static_cast<uint8_t>(peer & 0xFF);
+			if (index >= peers.size() || peers[index].sequence != peer)
+				return false;
+
+			*stats = peers[index].stats;
+			stats->sharedMemory = peers[index].shm && sharedChannelConnected(peers[index].shm);
+			return true;
+		}
+
+		virtual void meshStats(MeshStats* stats)
+		{
+			*stats = totals;
+			stats->peersConnected = 0;
+			stats->peersNegotiating = 0;
+			for (size_t ii = 0, nn = peers.size(); ii != nn; ++ii)
+			{
+				switch (peers[ii].state)
+				{
+				case PeerState::Connected:
+					++stats->peersConnected;
+					break;
+				case PeerState::Negotiating:
+					++stats->peersNegotiating;
+					break;
+				}
+			}
+		}
+
 		virtual MeshState::E update()
 		{
+			TINY_PROFILE_ZONE("MeshICE::update");
 			MeshState::E currentState = state;
+
+			// everything the mesh sends on its own during an update (STUN
+			// checks, responses, keep-alives) is submitted together
+			engine->sendBatchBegin();
 			switch (currentState)
 			{
 			case MeshState::Starting:
-				return updateStarting();
+				// peers connect while gathering continues
+				updateRunning();
+				currentState = updateStarting();
+				break;
 
 			case MeshState::Running:
 				updateRunning();
-				return currentState;
+				break;
 			}
+			engine->sendBatchEnd();
 
 			return currentState;
 		}
@@ -571,84 +1058,98 @@ namespace
 
 		MeshState::E updateStarting()
 		{
-			PlatformSocketAddr addr;
-			uint8_t incoming[128];
+			const uint64_t now = clock->current();
+
+			// pick up finished name resolutions. a server that resolves
+			// after candidates started querying joins on the next retry
+			bool resolving = false;
+			for (size_t ii = 0, nn = stunServers.size(); ii != nn; ++ii)
+			{
+				StunServerState& server = stunServers[ii];
+				if (!server.resolve)
+					continue;
+
+				ResolvedHost host;
+				switch (resolvePoll(server.resolve, &host))
+				{
+				case ResolveState::Pending:
+					resolving = true;
+					continue;
+
+				case ResolveState::Resolved:
+					if (host.hasV4)
+					{
+						Address addr;
+						addr.family = AddressFamily::IPv4;
+						addr.u.v4 = host.v4;
+						addressFrom(&server.addr4, addr, server.bePort);
+					}
+					if (host.hasV6)
+					{
+						Address addr;
+						addr.family = AddressFamily::IPv6;
+						addr.u.v6 = host.v6;
+						addressFrom(&server.addr6, addr, server.bePort);
+					}
+					break;
+				}
 
-			const uint64_t now = timestampCurrent();
+				resolveRelease(server.resolve);
+				server.resolve = nullptr;
+			}
 
-			// update STUN requests
+			// responses are handled by `updateRunning', (re)send outstanding
+			// STUN requests
 			bool stillWaiting = false;
 			for (size_t ii = 0, nn = localCandidates.size(); ii != nn; ++ii)
 			{
 				LocalCandidate& c = localCandidates[ii];
 				if (c.waitingOnServerReflexive)
 				{
-					// is data available for this request
-					int32_t read = socketRecvFrom(c.s, incoming, sizeof(incoming), &addr);
-					if (read >= 20)
+					if (c.totalStunAttempts == 0 || now > c.nextStunAttempt)
 					{
-						// ensure response is from STUN host
-						bool validAddress = false;
-						if (addr.size == stunAddr4.size)
+						if (c.totalStunAttempts >= c_stunMaxAttempts)
 						{
-							validAddress = (0 == memcmp(&addr.storage, stunAddr4.storage, addr.size));
+							c.waitingOnServerReflexive = false;
 						}
-						else if (addr.size == stunAddr6.size)
+						else if (sendServerReflexiveBindingRequests(c, now))
 						{
-							validAddress = (0 == memcmp(&addr.storage, stunAddr6.storage, addr.size));
+							++c.totalStunAttempts;
+							c.nextStunAttempt = now + c_stunRetryStartupMS*timeFreqMS;
 						}
-
-						if (validAddress)
+						else if (!resolving)
 						{
-							if (stunIsBindingResponse(incoming, read))// && stunProcessBindingResult(&serverReflexive.address, &serverReflexive.port, incoming, read, c.stunBindingRequest))
-							{
-								StunBindingResult res;
-								res.nhmacKey = 0;
-								if (stunProcessBindingResult(&res, incoming, read))
-								{
-									c.waitingOnServerReflexive = false;
-									c.hasServerReflexiveAddress = true;
-									c.nextStunAttempt = now + 500*timeFreqMS;
-
-									Candidate serverReflexive;
-									serverReflexive.address = res.address;
-									serverReflexive.port = res.bePort;
-									serverReflexive.foundation = foundationForServerReflexiveAddress(c.foundation, serverReflexive.address);
-									serverReflexive.priority = priorityChangeTypePreference(c.priority, TypePreference::ServerReflexive);
-									remoteCandidates.push_back(serverReflexive);
-								}
-							}
+							// no server is reachable from this candidate
+							c.waitingOnServerReflexive = false;
 						}
 					}
-					else if (read < 0 && !socketOperationWouldHaveBlocked())
-					{
-						c.waitingOnServerReflexive = false;
-					}
 
-					// if we're still waiting, see if we need to resend the request
+					// if we're still waiting, then we need to stay in this state
 					if (c.waitingOnServerReflexive)
 					{
-						if (now > c.nextStunAttempt)
-						{
-							++c.totalStunAttempts;
-							if (c.totalStunAttempts > c_stunMaxAttempts || !sendServerReflexiveBindingRequest(c, now, c_stunRetryStartupMS))
-							{
-								c.waitingOnServerReflexive = false;
-							}
-						}
-
-						// if we're still waiting, then we need to stay in this state
-						if (c.waitingOnServerReflexive)
-						{
-							stillWaiting = true;
-						}
+						stillWaiting = true;
 					}
 				}
 			}
 
+			if (relay.waiting && updateRelayAllocation(now))
+			{
+				stillWaiting = true;
+			}
+
 			if (!stillWaiting)
 			{
-				std::sort(remoteCandidates.begin(), remoteCandidates.end(), SortByPriority());
+				// servers that were asked but never answered are charged the
+				// full gathering timeout so later sessions try others first
+				for (size_t ii = 0, nn = stunServers.size(); ii != nn; ++ii)
+				{
+					const StunServerState& server = stunServers[ii];
+					if (server.firstSentAt != 0 && !server.answered)
+					{
+						updateStunLatency(server, c_stunRetryStartupMS*c_stunMaxAttempts*timeFreqMS);
+					}
+				}
+
 				state = MeshState::Running;
 				return MeshState::StartComplete;
 			}
@@ -656,38 +1157,435 @@ namespace
 			return MeshState::Starting;
 		}
 
-		bool sendServerReflexiveBindingRequest(LocalCandidate& c, uint64_t now, uint64_t nextRequestMS)
+		// handle a response from STUN server `serverIndex' on local
+		// candidate `c'. the first valid response wins
+		void processServerReflexiveResponse(LocalCandidate& c, uint32_t serverIndex, const uint8_t* incoming, int32_t read, uint64_t now)
 		{
-			const PlatformSocketAddr* addr;
-			switch (c.address.family)
-			{
+			if (!stunIsBindingResponse(incoming, read) || !stunMatchesTransactionId(incoming, c.stunBindingRequest))
+				return;
+
+			StunBindingResult res;
+			res.nhmacKey = 0;
+			if (!stunProcessBindingResult(&res, incoming, read))
+				return;
+
+			// every server's first answer is a latency sample, even when
+			// another server already won
+			StunServerState& server = stunServers[serverIndex];
+			if (!server.answered && server.firstSentAt != 0)
+			{
+				server.answered = true;
+				updateStunLatency(server, now - server.firstSentAt);
+			}
+
+			if (!c.waitingOnServerReflexive)
+				return;
+
+			c.waitingOnServerReflexive = false;
+			c.hasServerReflexiveAddress = true;
+			c.stunServer = static_cast<uint8_t>(serverIndex);
+			c.nextStunAttempt = now + 500*timeFreqMS;
+
+			Candidate serverReflexive;
+			serverReflexive.address = res.address;
+			serverReflexive.port = res.bePort;
+			serverReflexive.foundation = foundationForServerReflexiveAddress(c.foundation, serverReflexive.address);
+			serverReflexive.priority = priorityChangeTypePreference(c.priority, TypePreference::ServerReflexive);
+			remoteCandidates.push_back(serverReflexive);
+		}
+
+		const Candidate& localCandidateAt(uint32_t index) const
+		{
+			if (index < hostCandidateCount)
+			{
+				return localCandidates[index];
+			}
+
+			return remoteCandidates[index - hostCandidateCount];
+		}
+
+		// parse a serialized candidate list: a count followed by encoded
+		// candidates
+		static bool decodeRemoteCandidates(std::vector<RemoteCandidate>* out, const uint8_t* remoteAddress, uint32_t nremoteAddress)
+		{
+			if (nremoteAddress == 0)
+				return false;
+
+			const uint8_t numCandidates = remoteAddress[0];
+			out->resize(numCandidates);
+			++remoteAddress;
+			--nremoteAddress;
+			for (uint8_t ii = 0; ii < numCandidates; ++ii)
+			{
+				uint32_t read = candidateDecode(&(*out)[ii], remoteAddress, nremoteAddress);
+				if (read == 0)
+				{
+					return false;
+				}
+
+				remoteAddress += read;
+				nremoteAddress -= read;
+			}
+			if (nremoteAddress != 0)
+			{
+				return false;
+			}
+
+			// build socket addresses
+			for (uint8_t ii = 0; ii < numCandidates; ++ii)
+			{
+				RemoteCandidate& c = (*out)[ii];
+				addressFrom(&c.sockaddr, c.address, c.port);
+			}
+
+			return true;
+		}
+
+		// the controlling peer nominates aggressively: every check carries
+		// USE-CANDIDATE and the first pair to succeed is selected
+		void generateCheckRequest(peerconn* p, ConnectivityCheck* check)
+		{
+			uint8_t* attr = stunGenerateBindingRequest(rand, check->stunRequest, p->controlling ? 76 : 72);
+			attr = stunAppendUsernameAttribute20(attr, localId, p->id);
+			attr = stunAppendICEControlAttribute12(attr, p->controlling, localId);
+			attr = stunAppendICEPriorityAttribute8(attr, priorityChangeTypePreference(localCandidates[check->localCandidate].priority, TypePreference::PeerReflexive));
+			if (p->controlling)
+			{
+				attr = stunAppendICEUseCandidateAttribute4(attr);
+			}
+			attr = stunAppendMessageIntegrityAttribute24(attr, check->stunRequest, sessionKey.data(), static_cast<uint32_t>(sessionKey.size()));
+			attr = stunAppendFingerprint8(attr, check->stunRequest);
+			check->nstunRequest = static_cast<int>(attr-check->stunRequest);
+		}
+
+		// send the binding request of `c' to `server'. returns `false' if
+		// the server has no address of the candidate's family
+		bool sendServerReflexiveBindingRequest(LocalCandidate& c, StunServerState& server, uint64_t now)
+		{
+			const PlatformSocketAddr* addr;
+			switch (c.address.family)
+			{
 			case AddressFamily::IPv4:
-				addr = &stunAddr4;
+				addr = &server.addr4;
 				break;
 
 			case AddressFamily::IPv6:
-				addr = &stunAddr6;
+				addr = &server.addr6;
 				break;
 
 			default:
 				return false;
 			}
 
+			if (addr->size == 0)
+			{
+				return false;
+			}
+
 			ConstBuffer b;
 			b.len = sizeof(c.stunBindingRequest);
 			b.p = c.stunBindingRequest;
-			socketSendTo(c.s, &b, 1, *addr);
+			engine->sendTo(c.s, &b, 1, *addr);
+
+			if (server.firstSentAt == 0)
+			{
+				server.firstSentAt = now;
+			}
+			return true;
+		}
+
+		// query the `c_stunParallelServers' fastest resolved servers in
+		// parallel. returns `false' if no server could be queried
+		bool sendServerReflexiveBindingRequests(LocalCandidate& c, uint64_t now)
+		{
+			uint32_t sent = 0;
+			for (size_t ii = 0, nn = stunServers.size(); ii != nn && sent < c_stunParallelServers; ++ii)
+			{
+				StunServerState& server = stunServers[ii];
+				if (server.resolve)
+					continue;
+
+				if (sendServerReflexiveBindingRequest(c, server, now))
+				{
+					++sent;
+				}
+			}
+
+			return sent != 0;
+		}
+
+		// index of the STUN server at `addr', or -1
+		int32_t findStunServer(const PlatformSocketAddr& addr) const
+		{
+			for (size_t ii = 0, nn = stunServers.size(); ii != nn; ++ii)
+			{
+				const StunServerState& server = stunServers[ii];
+				if (addr.size == server.addr4.size && 0 == memcmp(&addr.storage, &server.addr4.storage, addr.size))
+					return static_cast<int32_t>(ii);
+				if (addr.size == server.addr6.size && 0 == memcmp(&addr.storage, &server.addr6.storage, addr.size))
+					return static_cast<int32_t>(ii);
+			}
+
+			return -1;
+		}
+
+		uint32_t findStunLatency(const char* host, uint16_t port)
+		{
+			for (size_t ii = 0, nn = stunLatency.size(); ii != nn; ++ii)
+			{
+				if (stunLatency[ii].port == port && stunLatency[ii].host == host)
+					return static_cast<uint32_t>(ii);
+			}
+
+			StunLatency latency;
+			latency.host = host;
+			latency.ewma = 0;
+			latency.port = port;
+			stunLatency.push_back(latency);
+			return static_cast<uint32_t>(stunLatency.size() - 1);
+		}
+
+		uint64_t expectedLatency(const StunServerState& server) const
+		{
+			const uint64_t ewma = stunLatency[server.latencySlot].ewma;
+			return ewma ? ewma : c_stunRetryStartupMS*timeFreqMS;
+		}
+
+		void updateStunLatency(const StunServerState& server, uint64_t sample)
+		{
+			uint64_t& ewma = stunLatency[server.latencySlot].ewma;
+			ewma = ewma ? (3*ewma + sample) / 4 : sample;
+		}
+
+		void releaseStunServers()
+		{
+			for (size_t ii = 0, nn = stunServers.size(); ii != nn; ++ii)
+			{
+				if (stunServers[ii].resolve)
+				{
+					resolveRelease(stunServers[ii].resolve);
+				}
+			}
+			stunServers.clear();
+		}
+
+		bool publishCandidate(const Candidate& c) const
+		{
+			return !relay.relayOnly || candidateIsRelayed(c);
+		}
+
+		bool pairCandidate(const LocalCandidate& c) const
+		{
+			return !relay.relayOnly || c.relayed;
+		}
+
+		// begin resolving the relay server for a new session. the
+		// allocation is requested by `updateRelayAllocation'
+		void startRelay()
+		{
+			if (relay.resolve)
+			{
+				resolveRelease(relay.resolve);
+				relay.resolve = nullptr;
+			}
+
+			relay.addr.size = 0;
+			relay.localCandidate = 0xff;
+			relay.totalAttempts = 0;
+			memset(relay.cookie, 0, sizeof(relay.cookie));
+			relay.waiting = relay.configured;
+			if (relay.configured)
+			{
+				relay.resolve = resolveHostAsync(relay.host.c_str());
+			}
+		}
+
+		// (re)send the allocation request while gathering. returns `true'
+		// while the allocation is outstanding
+		bool updateRelayAllocation(uint64_t now)
+		{
+			if (relay.resolve)
+			{
+				ResolvedHost host;
+				switch (resolvePoll(relay.resolve, &host))
+				{
+				case ResolveState::Pending:
+					return true;
+
+				case ResolveState::Resolved:
+					// reach the server from the best host candidate of a
+					// family it resolved to
+					for (uint32_t ii = 0; ii < hostCandidateCount; ++ii)
+					{
+						Address addr;
+						addr.family = localCandidates[ii].address.family;
+						if (addr.family == AddressFamily::IPv4 && host.hasV4)
+						{
+							addr.u.v4 = host.v4;
+						}
+						else if (addr.family == AddressFamily::IPv6 && host.hasV6)
+						{
+							addr.u.v6 = host.v6;
+						}
+						else
+						{
+							continue;
+						}
+
+						addressFrom(&relay.addr, addr, relay.bePort);
+						relay.baseCandidate = static_cast<uint8_t>(ii);
+						break;
+					}
+					break;
+				}
+
+				resolveRelease(relay.resolve);
+				relay.resolve = nullptr;
+			}
+
+			if (relay.addr.size == 0 || relay.totalAttempts >= c_stunMaxAttempts)
+			{
+				relay.waiting = false;
+				return false;
+			}
+
+			if (relay.totalAttempts == 0 || now > relay.nextAttempt)
+			{
+				sendRelayAllocate();
+				++relay.totalAttempts;
+				relay.nextAttempt = now + c_stunRetryStartupMS*timeFreqMS;
+			}
 
-			c.nextStunAttempt = now + nextRequestMS*timeFreqMS;
 			return true;
 		}
 
+		// allocation requests double as refreshes, the server keeps the
+		// allocation of a client id it already knows. a request without a
+		// current cookie is answered with a challenge and resent
+		void sendRelayAllocate()
+		{
+			crandFill(&rand, relay.transactionId, sizeof(relay.transactionId));
+
+			uint8_t request[c_relayAllocateSize];
+			ConstBuffer b;
+			b.p = request;
+			b.len = relayGenerateAllocate(request, relay.transactionId, relay.clientId, relay.cookie, relay.key.data(), static_cast<uint32_t>(relay.key.size()));
+			engine->sendTo(localCandidates[relay.baseCandidate].s, &b, 1, relay.addr);
+		}
+
+		// handle a datagram from the relay server
+		void processRelayPacket(uint8_t* incoming, int32_t read, Message* slot, uint64_t now)
+		{
+			if (!relayIsMessage(incoming, read))
+				return;
+
+			switch (incoming[0])
+			{
+			case RelayMessage::Allocated:
+				processRelayAllocated(incoming, read, now);
+				break;
+
+			case RelayMessage::Challenge:
+				// every request gets a new transaction id, so each one is
+				// resent at most once
+				if (relayProcessChallenge(relay.cookie, incoming, read, relay.transactionId))
+				{
+					sendRelayAllocate();
+				}
+				break;
+
+			case RelayMessage::Data:
+				if (relay.localCandidate != 0xff)
+				{
+					// unwrap and process as if it arrived on the relayed address
+					Address from;
+					uint16_t fromPort;
+					const uint32_t offset = relayProcessData(&from, &fromPort, incoming, read);
+					if (offset == 0)
+						return;
+
+					PlatformSocketAddr sockaddr;
+					addressFrom(&sockaddr, from, fromPort);
+					processPacket(relay.localCandidate, incoming + offset, read - static_cast<int32_t>(offset), sockaddr, slot, now);
+				}
+				break;
+			}
+		}
+
+		void processRelayAllocated(const uint8_t* incoming, int32_t read, uint64_t now)
+		{
+			Address addr;
+			uint16_t bePort;
+			if (!relayProcessAllocated(relay.token, &addr, &bePort, incoming, read, relay.transactionId, relay.key.data(), static_cast<uint32_t>(relay.key.size())))
+				return;
+
+			relay.waiting = false;
+			relay.nextAttempt = now + c_relayRefreshMS*timeFreqMS;
+			if (relay.localCandidate != 0xff)
+				return;
+
+			// the relayed candidate shares the socket of its base. there is
+			// room reserved for it (see `create')
+			const LocalCandidate& base = localCandidates[relay.baseCandidate];
+			LocalCandidate cand;
+			cand.s = base.s;
+			cand.priority = priorityForRelayAddress(addr);
+			cand.foundation = foundationForRelayAddress(addr);
+			cand.address = addr;
+			cand.port = bePort;
+			cand.waitingOnServerReflexive = false;
+			cand.hasServerReflexiveAddress = false;
+			cand.relayed = true;
+			relay.localCandidate = static_cast<uint8_t>(localCandidates.size());
+			localCandidates.push_back(cand);
+
+			// publish it to be trickled like a server reflexive candidate
+			remoteCandidates.push_back(cand);
+
+			pairRelayedCandidate();
+		}
+
+		// add checks from the new relayed candidate for peers that are
+		// already negotiating
+		void pairRelayedCandidate()
+		{
+			const LocalCandidate& local = localCandidates[relay.localCandidate];
+			for (size_t ii = 0, nn = peers.size(); ii != nn; ++ii)
+			{
+				peerconn* p = &peers[ii];
+				if (p->state != PeerState::Negotiating)
+					continue;
+
+				bool added = false;
+				for (uint8_t jj = 0, nn2 = static_cast<uint8_t>(p->remoteCandidates.size()); jj != nn2; ++jj)
+				{
+					if (p->remoteCandidates[jj].address.family != local.address.family)
+						continue;
+					if (p->connectivityChecks.size() >= c_maxCandidatePairs)
+						break;
+
+					ConnectivityCheck newCheck;
+					initializeConnectivityCheck(&newCheck, p, relay.localCandidate, jj);
+					std::vector<ConnectivityCheck>::iterator it = std::lower_bound(p->connectivityChecks.begin(), p->connectivityChecks.end(), newCheck, SortByPriority());
+					generateCheckRequest(p, &(*p->connectivityChecks.insert(it, newCheck)));
+					added = true;
+				}
+
+				// new pairs revive a peer whose checklist had failed
+				if (added)
+				{
+					p->timeout = 0xFFFFFFFFFFFFFFFF;
+				}
+			}
+		}
+
+		// retransmit checks whose RTO expired and detect a finished
+		// checklist. new and triggered checks are paced by `scheduleChecks'
 		void updatePeerNegotiation(peerconn* p, uint64_t now)
 		{
 			bool complete = true;
 			bool pendingRequests = false;
 
-			// (re)send binding requests
 			for (size_t ii = 0, nn = p->connectivityChecks.size(); ii != nn; ++ii)
 			{
 				ConnectivityCheck& check = p->connectivityChecks[ii];
@@ -695,32 +1593,15 @@ namespace
 				{
 					complete = false;
 
-					if (check.timeout < now)
+					if (check.transmissions != 0 && check.timeout < now)
 					{
-						++check.totalAttempts;
-						if (check.totalAttempts > c_stunMaxAttempts)
+						if (check.totalAttempts >= c_stunMaxAttempts)
 						{
 							check.state = CheckState::Failed;
 							continue;
 						}
 
-						ConstBuffer buf;
-						buf.p = check.stunRequest;
-						buf.len = check.nstunRequest;
-
-						const RemoteCandidate& remote = p->remoteCandidates[check.remoteCandidate];
-						if (!socketSendTo(localCandidates[check.localCandidate].s
-							, &buf, 1, remote.sockaddr))
-						{
-							if (!socketOperationWouldHaveBlocked())
-							{
-								// failed
-								check.state = CheckState::Failed;
-								continue;
-							}
-						}
-
-						check.timeout = now + c_stunRetryStartupMS*timeFreqMS;
+						sendCheck(p, &check, now);
 					}
 				}
 
@@ -730,47 +1611,158 @@ namespace
 				}
 			}
 
-			// we've completed our checklist
-			if (complete)
+			// we've failed our check list, schedule the peer to be marked as
+			// invalid. an incoming check can revive the peer it is behind a
+			// symmetric NAT. nomination is aggressive, so a controlling
+			// peer is already connected if any check succeeded
+			if (complete && !pendingRequests && p->timeout == 0xFFFFFFFFFFFFFFFF)
 			{
-				// we've failed our check list, schedule the peer to be marked as invalid.
-				// an incoming check can revive the peer it is behind a symmetric NAT
-				if (!pendingRequests && p->timeout == 0xFFFFFFFFFFFFFFFF)
+				p->timeout = now + c_peerCloseWaitMS*timeFreqMS;
+			}
+		}
+
+		// current retransmission timeout for checks to a peer, RFC 5389
+		// style from the round trips of earlier checks
+		uint64_t checkRto(const peerconn* p) const
+		{
+			if (p->checkSrtt == 0)
+			{
+				return c_checkInitialRtoMS*timeFreqMS;
+			}
+
+			const uint64_t rto = p->checkSrtt + std::max<uint64_t>(timeFreqMS, 4*p->checkRttvar);
+			return std::max<uint64_t>(rto, c_checkMinRtoMS*timeFreqMS);
+		}
+
+		void sendCheck(peerconn* p, ConnectivityCheck* check, uint64_t now)
+		{
+			++check->transmissions;
+			++check->totalAttempts;
+			if (check->totalAttempts > 1)
+			{
+				++p->stats.checkRetransmits;
+			}
+
+			ConstBuffer buf;
+			buf.p = check->stunRequest;
+			buf.len = check->nstunRequest;
+
+			const RemoteCandidate& remote = p->remoteCandidates[check->remoteCandidate];
+			if (!sendFromCandidate(check->localCandidate, &buf, 1, remote.sockaddr))
+			{
+				if (!engine->operationWouldHaveBlocked())
 				{
-					p->timeout = now + c_peerCloseWaitMS*timeFreqMS;
+					// failed
+					check->state = CheckState::Failed;
+					return;
 				}
-				else if (p->controlling)
+			}
+
+			// exponential backoff from the peer's RTO
+			const uint64_t rto = std::min<uint64_t>(checkRto(p) << (check->transmissions - 1), c_checkMaxRtoMS*timeFreqMS);
+			check->sentAt = now;
+			check->timeout = now + rto;
+		}
+
+		// Karn's algorithm: only unambiguous (never retransmitted) checks
+		// contribute to the RTO estimate
+		void updateCheckRoundTrip(peerconn* p, const ConnectivityCheck* check, uint64_t now)
+		{
+			if (check->transmissions != 1)
+				return;
+
+			const uint64_t sample = now - check->sentAt;
+			if (p->checkSrtt == 0)
+			{
+				p->checkSrtt = sample;
+				p->checkRttvar = sample / 2;
+			}
+			else
+			{
+				const uint64_t delta = (p->checkSrtt > sample) ? p->checkSrtt - sample : sample - p->checkSrtt;
+				p->checkRttvar = (3*p->checkRttvar + delta) / 4;
+				p->checkSrtt = (7*p->checkSrtt + sample) / 8;
+			}
+		}
+
+		// send at most one new connectivity check every `c_checkPacingMS'
+		// across all peers. triggered checks, in the order they were
+		// triggered, go ahead of the highest priority waiting check of
+		// each peer, which are visited round robin.
+		void scheduleChecks(uint64_t now)
+		{
+			if (now < nextCheckAt)
+				return;
+
+			peerconn* bestPeer = nullptr;
+			ConnectivityCheck* best = nullptr;
+			for (size_t ii = 0, nn = peers.size(); ii != nn; ++ii)
+			{
+				peerconn* p = &peers[(nextCheckPeer + ii) % nn];
+				if (p->state != PeerState::Negotiating)
+					continue;
+
+				for (size_t jj = 0, nn2 = p->connectivityChecks.size(); jj != nn2; ++jj)
 				{
-					// find the highest priority candidate that successfully completed and nominate it
-					for (size_t ii = 0, nn = p->connectivityChecks.size(); ii != nn; ++ii)
+					ConnectivityCheck* check = &p->connectivityChecks[jj];
+					if (check->state != CheckState::InProgress || check->transmissions != 0)
+						continue;
+
+					if (check->triggered != 0)
 					{
-						ConnectivityCheck* check = &p->connectivityChecks[ii];
-						if (check->state == CheckState::Succeeded)
+						if (!best || best->triggered == 0 || check->triggered < best->triggered)
 						{
-							// remove all other checks
-							p->connectivityChecks.erase(p->connectivityChecks.begin(), p->connectivityChecks.begin() + ii);
-							p->connectivityChecks.erase(p->connectivityChecks.begin() + ii + 1, p->connectivityChecks.end());
-
-							// rebuild stun request
-							check = &p->connectivityChecks[0];
-							check->nominated = true;
-							check->state = CheckState::InProgress;
-							check->totalAttempts = 0;
-							check->timeout = 0;
-
-							uint8_t* attr = stunGenerateBindingRequest(rand, check->stunRequest, 76);
-							attr = stunAppendUsernameAttribute20(attr, localId, p->id);
-							attr = stunAppendICEControlAttribute12(attr, p->controlling, localId);
-							attr = stunAppendICEPriorityAttribute8(attr, priorityChangeTypePreference(localCandidates[check->localCandidate].priority, TypePreference::PeerReflexive));
-							attr = stunAppendICEUseCandidateAttribute4(attr);
-							attr = stunAppendMessageIntegrityAttribute24(attr, check->stunRequest, sessionKey.data(), static_cast<uint32_t>(sessionKey.size()));
-							attr = stunAppendFingerprint8(attr, check->stunRequest);
-							check->nstunRequest = static_cast<int>(attr-check->stunRequest);
-							break;
+							bestPeer = p;
+							best = check;
 						}
 					}
+					else if (!best)
+					{
+						// checks are sorted by priority, later ones only
+						// matter if triggered
+						bestPeer = p;
+						best = check;
+					}
 				}
 			}
+
+			if (!best)
+				return;
+
+			best->triggered = 0;
+			sendCheck(bestPeer, best, now);
+			nextCheckAt = now + c_checkPacingMS*timeFreqMS;
+			nextCheckPeer = static_cast<uint32_t>((bestPeer - peers.data()) + 1);
+		}
+
+		// move a check to the front of the schedule in response to an
+		// incoming check on the same pair
+		void triggerCheck(peerconn* p, ConnectivityCheck* check)
+		{
+			// a failed pair gets a new budget. one in progress keeps its
+			// budget, so a pair the remote keeps checking still fails
+			if (check->state == CheckState::Failed)
+			{
+				check->totalAttempts = 0;
+			}
+			else if (check->totalAttempts >= c_stunMaxAttempts)
+			{
+				return;
+			}
+
+			// resend with a fresh transaction id (RFC 8445 7.3.1.4), so a
+			// late response to an earlier send isn't taken for a response
+			// to the new one. see `updateCheckRoundTrip'
+			if (check->transmissions != 0)
+			{
+				memcpy(check->cancelledRequest, check->stunRequest, sizeof(check->cancelledRequest));
+				check->cancelled = true;
+				generateCheckRequest(p, check);
+			}
+
+			check->state = CheckState::InProgress;
+			check->transmissions = 0;
+			check->triggered = ++triggerSequence;
 		}
 
 		void initializeConnectivityCheck(ConnectivityCheck* out, peerconn* p, uint8_t localIndex, uint8_t remoteIndex)
@@ -795,8 +1787,14 @@ namespace
 			out->localCandidate = localIndex;
 			out->remoteCandidate = remoteIndex;
 			out->timeout = 0;
+			out->sentAt = 0;
+			out->triggered = 0;
 			out->totalAttempts = 0;
-			out->nominated = false;
+			out->transmissions = 0;
+			out->cancelled = false;
+			out->nominated = p->controlling;
+			out->cached = false;
+			out->localType = CandidateType::Unknown;
 			out->state = CheckState::InProgress;
 		}
 
@@ -855,13 +1853,11 @@ namespace
 				switch (check->state)
 				{
 				case CheckState::Failed:
-					check->state = CheckState::InProgress;
 					p->timeout = 0xFFFFFFFFFFFFFFFF;
 
 					// fallthrough
 				case CheckState::InProgress:
-					check->timeout = 0;
-					check->totalAttempts = 0;
+					triggerCheck(p, check);
 					break;
 				}
 			}
@@ -872,252 +1868,826 @@ namespace
 				initializeConnectivityCheck(&newCheck, p, request.localCandidate, remoteIndex);
 				std::vector<ConnectivityCheck>::iterator it = std::lower_bound(p->connectivityChecks.begin(), p->connectivityChecks.end(), newCheck, SortByPriority()); 
 				check = &(*p->connectivityChecks.insert(it, newCheck));
-
-				// generate STUN request packet
-				uint8_t* attr = stunGenerateBindingRequest(rand, check->stunRequest, 72);
-				attr = stunAppendUsernameAttribute20(attr, localId, p->id);
-				attr = stunAppendICEControlAttribute12(attr, p->controlling, localId);
-				attr = stunAppendICEPriorityAttribute8(attr, priorityChangeTypePreference(localCandidates[check->localCandidate].priority, TypePreference::PeerReflexive));
-				attr = stunAppendMessageIntegrityAttribute24(attr, check->stunRequest, sessionKey.data(), static_cast<uint32_t>(sessionKey.size()));
-				attr = stunAppendFingerprint8(attr, check->stunRequest);
-				check->nstunRequest = static_cast<int>(attr-check->stunRequest);
+				generateCheckRequest(p, check);
+				triggerCheck(p, check);
 			}
 
 			if (!p->controlling && request.useCandidate)
 			{
 				check->nominated = true;
-				const RemoteCandidate& candidate = p->remoteCandidates[check->remoteCandidate];
-				addressFrom(&p->sockaddr, candidate.address, candidate.port);
-
-				// build keep-alive packet
-				uint8_t* attr = stunGenerateBindingRequest(rand, p->keepAlive, 52);
-				attr = stunAppendUsernameAttribute20(attr, localId, p->id);
-				attr = stunAppendMessageIntegrityAttribute24(attr, p->keepAlive, sessionKey.data(), static_cast<uint32_t>(sessionKey.size()));
-				attr = stunAppendFingerprint8(attr, p->keepAlive);
-
-				p->localCandidate = check->localCandidate;
-				p->state = PeerState::Connected;
-				p->connectivityChecks.clear();
-				p->connectivityChecks.shrink_to_fit();
+				peerConnected(p, check, now);
 			}
 		}
 
-		void updateRunning()
+		// switch a peer to the nominated pair `check'
+		void peerConnected(peerconn* p, const ConnectivityCheck* check, uint64_t now)
 		{
-			const uint64_t now = timestampCurrent();
+			const RemoteCandidate& candidate = p->remoteCandidates[check->remoteCandidate];
+			addressFrom(&p->sockaddr, candidate.address, candidate.port);
 
-			uint8_t incoming[2048];
-			PlatformSocketAddr sockaddr;
+			p->stats.connectTimeUS = static_cast<uint32_t>(((now - p->connectStart) * 1000) / timeFreqMS);
+			p->stats.nominatedCheckAttempts = check->totalAttempts;
+			p->stats.localCandidateType = check->localType;
+			p->stats.remoteCandidateType = priorityCandidateType(candidate.priority);
+			p->stats.cachedPair = check->cached;
 
-			// keep STUN binding requests alive
-			for (size_t ii = 0, nn = localCandidates.size(); ii != nn; ++ii)
-			{
-				LocalCandidate& c = localCandidates[ii];
-				if (c.hasServerReflexiveAddress && now > c.nextStunAttempt)
-				{
-					sendServerReflexiveBindingRequest(c, now, c_stunRetryConnectedMS);
-				}
+			cachePair(p, check, now);
+
+			p->localCandidate = check->localCandidate;
+			p->state = PeerState::Connected;
+			p->keepAliveSentAt = 0;
+			p->nextRttProbe = now + c_peerRttProbeMS*timeFreqMS;
+			p->connectivityChecks.clear();
+			p->connectivityChecks.shrink_to_fit();
+
+			openSharedChannel(p);
+		}
+
+		// a peer that published one of our host addresses runs on this
+		// host. addresses alone can't rule out two private networks that
+		// use the same range, but the channel is only used once the other
+		// side opened it as well
+		bool peerIsColocated(const peerconn* p) const
+		{
+			for (size_t ii = 0, nn = p->remoteCandidates.size(); ii != nn; ++ii)
+			{
+				const RemoteCandidate& remote = p->remoteCandidates[ii];
+				if (priorityCandidateType(remote.priority) != CandidateType::Host)
+					continue;
+
+				for (uint32_t jj = 0; jj < hostCandidateCount; ++jj)
+				{
+					if (addressIsEqual(remote.address, localCandidates[jj].address))
+						return true;
+				}
 			}
 
-			// clear incoming arrays on all peers
-			for (size_t ii = 0, nn = peers.size(); ii != nn; ++ii)
+			return false;
+		}
+
+		// both sides derive the same channel name from an HMAC of the pair
+		// of ids under the session key. the name is visible to every
+		// process of the login session, so it must reveal neither the ids
+		// nor anything that can be checked against a guessed key
+		void openSharedChannel(peerconn* p)
+		{
+			if (p->shm || !peerIsColocated(p))
+				return;
+
+			const uint64_t lo = std::min(localId, p->id);
+			const uint64_t hi = std::max(localId, p->id);
+
+			static const char c_label[] = "tiny-shm";
+			hmac_sha1_state st;
+			hmac_sha1_begin(&st, sessionKey.data(), static_cast<uint32_t>(sessionKey.size()));
+			hmac_sha1_add(&st, c_label, sizeof(c_label) - 1);
+			hmac_sha1_add(&st, &lo, sizeof(lo));
+			hmac_sha1_add(&st, &hi, sizeof(hi));
+
+			uint8_t digest[hmac_sha1_state::DIGEST_SIZE];
+			hmac_sha1_end(&st, digest);
+
+			static const char c_hex[] = "0123456789abcdef";
+			char name[sizeof(c_label) + 2*hmac_sha1_state::DIGEST_SIZE + 1];
+			memcpy(name, c_label, sizeof(c_label) - 1);
+			name[sizeof(c_label) - 1] = '-';
+			for (uint32_t ii = 0; ii < hmac_sha1_state::DIGEST_SIZE; ++ii)
 			{
-				peerconn* p = &peers[ii];
-				for (size_t jj = 0, nn1 = p->incoming.size(); jj != nn1; ++jj)
+				name[sizeof(c_label) + 2*ii + 0] = c_hex[digest[ii] >> 4];
+				name[sizeof(c_label) + 2*ii + 1] = c_hex[digest[ii] & 0xF];
+			}
+			name[sizeof(c_label) + 2*hmac_sha1_state::DIGEST_SIZE] = '\0';
+
+			p->shm = sharedChannelOpen(name, localId == hi ? 1 : 0);
+		}
+
+		void closeSharedChannel(peerconn* p)
+		{
+			if (p->shm)
+			{
+				sharedChannelClose(p->shm);
+				p->shm = nullptr;
+			}
+			p->shmMessages.clear();
+		}
+
+		// queue datagrams from the shared memory channel of a connected
+		// peer for `verifyPendingMedia', like media from the socket. views
+		// from the previous update are released first
+		void receiveShared(peerconn* p, uint64_t now)
+		{
+			sharedChannelRelease(p->shm);
+
+			SharedDatagram datagrams[c_sharedRecvBatchSize];
+			const uint32_t nread = sharedChannelRead(p->shm, datagrams, c_sharedRecvBatchSize);
+
+			// pending media points into `shmMessages', size it completely first
+			p->shmMessages.resize(nread);
+			for (uint32_t ii = 0; ii < nread; ++ii)
+			{
+				const int32_t read = static_cast<int32_t>(datagrams[ii].len);
+				if (isMediaPacket(datagrams[ii].p, read))
 				{
-					messageRelease(p->incoming[jj]);
+					queueMedia(p, &p->shmMessages[ii], datagrams[ii].p, read, now);
 				}
+			}
+		}
 
-				p->incoming.clear();
+		// remember the nominated pair of `p' for the next connection to
+		// the same remote id, evicting the least recently used entry
+		void cachePair(const peerconn* p, const ConnectivityCheck* check, uint64_t now)
+		{
+			CachedPair* entry = nullptr;
+			for (size_t ii = 0, nn = cachedPairs.size(); ii != nn; ++ii)
+			{
+				if (cachedPairs[ii].remoteId == p->id)
+				{
+					entry = &cachedPairs[ii];
+					break;
+				}
+				if (!entry || cachedPairs[ii].lastUsed < entry->lastUsed)
+				{
+					entry = &cachedPairs[ii];
+				}
+			}
+			if (cachedPairs.size() < c_maxCachedPairs && (!entry || entry->remoteId != p->id))
+			{
+				cachedPairs.resize(cachedPairs.size() + 1);
+				entry = &cachedPairs.back();
 			}
 
-			// process incoming messages
-			for (size_t ii = 0, nn = localCandidates.size(); ii != nn; ++ii)
+			const RemoteCandidate& remote = p->remoteCandidates[check->remoteCandidate];
+			entry->remoteId = p->id;
+			entry->lastUsed = now;
+			entry->remoteAddress = remote.address;
+			entry->remotePriority = remote.priority;
+			entry->remotePort = remote.port;
+			entry->localCandidate = check->localCandidate;
+		}
+
+		// send the check for the pair last nominated with this remote id
+		// right away, ahead of pacing. the remaining checklist continues
+		// in the background; if the pair still works the peer resumes
+		// after a single round trip
+		void tryCachedPair(peerconn* p, uint64_t now)
+		{
+			const CachedPair* entry = nullptr;
+			for (size_t ii = 0, nn = cachedPairs.size(); ii != nn; ++ii)
 			{
-				LocalCandidate& c = localCandidates[ii];
-				if (c.s == InvalidSocket)
+				if (cachedPairs[ii].remoteId == p->id)
+				{
+					entry = &cachedPairs[ii];
+					break;
+				}
+			}
+			if (!entry || entry->localCandidate >= localCandidates.size() || !pairCandidate(localCandidates[entry->localCandidate]))
+				return;
+			if (localCandidates[entry->localCandidate].address.family != entry->remoteAddress.family)
+				return;
+
+			// locate the remote candidate, it may have been peer reflexive
+			uint8_t remoteIndex = 0xff;
+			for (size_t ii = 0, nn = p->remoteCandidates.size(); ii != nn; ++ii)
+			{
+				const RemoteCandidate& c = p->remoteCandidates[ii];
+				if (addressIsEqual(c.address, entry->remoteAddress) && c.port == entry->remotePort)
+				{
+					remoteIndex = static_cast<uint8_t>(ii);
+					break;
+				}
+			}
+			if (remoteIndex == 0xff)
+			{
+				if (p->remoteCandidates.size() >= 0xff)
+					return;
+
+				remoteIndex = static_cast<uint8_t>(p->remoteCandidates.size());
+				p->remoteCandidates.resize(remoteIndex + 1);
+				RemoteCandidate& c = p->remoteCandidates.back();
+				c.priority = entry->remotePriority;
+				c.foundation = foundationForPeerReflexiveAddress(entry->remoteAddress);
+				c.address = entry->remoteAddress;
+				c.port = entry->remotePort;
+				addressFrom(&c.sockaddr, c.address, c.port);
+			}
+
+			ConnectivityCheck* check = nullptr;
+			for (size_t ii = 0, nn = p->connectivityChecks.size(); ii != nn; ++ii)
+			{
+				ConnectivityCheck* candidate = &p->connectivityChecks[ii];
+				if (candidate->localCandidate == entry->localCandidate && candidate->remoteCandidate == remoteIndex)
+				{
+					check = candidate;
+					break;
+				}
+			}
+			if (!check)
+			{
+				ConnectivityCheck newCheck;
+				initializeConnectivityCheck(&newCheck, p, entry->localCandidate, remoteIndex);
+				std::vector<ConnectivityCheck>::iterator it = std::lower_bound(p->connectivityChecks.begin(), p->connectivityChecks.end(), newCheck, SortByPriority());
+				check = &(*p->connectivityChecks.insert(it, newCheck));
+				generateCheckRequest(p, check);
+			}
+
+			check->cached = true;
+			if (check->state == CheckState::InProgress && check->transmissions == 0)
+			{
+				check->triggered = 0;
+				sendCheck(p, check, now);
+			}
+		}
+
+		// send a keep-alive binding request to a connected peer. each one
+		// carries a fresh transaction id so its response yields an
+		// unambiguous round trip sample
+		void sendKeepAlive(peerconn* p, uint64_t now)
+		{
+			uint8_t* attr = stunGenerateBindingRequest(rand, p->keepAlive, 52);
+			attr = stunAppendUsernameAttribute20(attr, localId, p->id);
+			attr = stunAppendMessageIntegrityAttribute24(attr, p->keepAlive, sessionKey.data(), static_cast<uint32_t>(sessionKey.size()));
+			attr = stunAppendFingerprint8(attr, p->keepAlive);
+
+			ConstBuffer b;
+			b.p = p->keepAlive;
+			b.len = sizeof(p->keepAlive);
+			sendFromCandidate(p->localCandidate, &b, 1, p->sockaddr);
+
+			++p->stats.keepAlivesSent;
+			p->keepAliveSentAt = now;
+			p->nextRttProbe = now + c_peerRttProbeMS*timeFreqMS;
+			p->timeout = now + c_peerTrafficAbsentMS*timeFreqMS;
+		}
+
+		// RFC 6298 smoothing of a round trip sample
+		void updateRoundTrip(peerconn* p, uint64_t now)
+		{
+			const uint32_t sample = static_cast<uint32_t>(((now - p->keepAliveSentAt) * 1000) / timeFreqMS);
+			p->keepAliveSentAt = 0;
+			++p->stats.keepAlivesAcked;
+
+			PeerStats& stats = p->stats;
+			stats.rttLatestUS = sample;
+			if (stats.rttSmoothedUS == 0)
+			{
+				stats.rttSmoothedUS = sample;
+				stats.rttVarianceUS = sample / 2;
+				stats.rttMinUS = sample;
+			}
+			else
+			{
+				const uint32_t delta = (stats.rttSmoothedUS > sample) ? stats.rttSmoothedUS - sample : sample - stats.rttSmoothedUS;
+				stats.rttVarianceUS = (3*stats.rttVarianceUS + delta) / 4;
+				stats.rttSmoothedUS = (7*stats.rttSmoothedUS + sample) / 8;
+				stats.rttMinUS = std::min(stats.rttMinUS, sample);
+			}
+		}
+
+		// send from local candidate `localIndex'. datagrams from the
+		// relayed candidate are wrapped and sent through the relay server
+		bool sendFromCandidate(uint8_t localIndex, const ConstBuffer* buffers, uint32_t nbuffers, const PlatformSocketAddr& addr)
+		{
+			if (localIndex >= localCandidates.size())
+				return false;
+
+			const LocalCandidate& c = localCandidates[localIndex];
+			if (!c.relayed)
+			{
+				return engine->sendTo(c.s, buffers, nbuffers, addr);
+			}
+
+			Address to;
+			uint16_t toPort;
+			addressTo(&to, &toPort, addr);
+
+			uint8_t header[c_relaySendHeaderMaxSize];
+			ConstBuffer wrapped[4];
+			if (nbuffers >= sizeof(wrapped)/sizeof(wrapped[0]))
+				return false;
+
+			wrapped[0].p = header;
+			wrapped[0].len = relayGenerateSendHeader(header, relay.token, to, toPort);
+			for (uint32_t ii = 0; ii < nbuffers; ++ii)
+			{
+				wrapped[1 + ii] = buffers[ii];
+			}
+
+			return engine->sendTo(c.s, wrapped, nbuffers + 1, relay.addr);
+		}
+
+		void countSent(peerconn* p, uint32_t n)
+		{
+			++p->stats.packetsOut;
+			p->stats.bytesOut += n;
+			++totals.packetsOut;
+			totals.bytesOut += n;
+		}
+
+		// tag carried by media packets from `from' to `to'. derived from the
+		// session key, so off-path hosts can't forge it; it lets the receive
+		// path reject spoofed media without computing a MAC
+		uint32_t connectionTag(uint64_t from, uint64_t to) const
+		{
+			static const char label[] = "tiny connection tag";
+
+			uint8_t mac[hmac_sha1_state::DIGEST_SIZE];
+			hmac_sha1_state st;
+			hmac_sha1_begin(&st, sessionKey.data(), static_cast<uint32_t>(sessionKey.size()));
+			hmac_sha1_add(&st, label, sizeof(label) - 1);
+			hmac_sha1_add(&st, &from, sizeof(from));
+			hmac_sha1_add(&st, &to, sizeof(to));
+			hmac_sha1_end(&st, mac);
+
+			uint32_t tag;
+			memcpy(&tag, mac, sizeof(tag));
+			return tag;
+		}
+
+		// key of encrypted media from `from' to `to', expanded from the
+		// session key like `connectionTag'
+		void mediaKey(uint64_t from, uint64_t to, chacha20poly1305_key* key) const
+		{
+			static const char label[] = "tiny media key";
+
+			uint8_t material[2 * hmac_sha1_state::DIGEST_SIZE];
+			for (uint8_t block = 0; block < 2; ++block)
+			{
+				hmac_sha1_state st;
+				hmac_sha1_begin(&st, sessionKey.data(), static_cast<uint32_t>(sessionKey.size()));
+				hmac_sha1_add(&st, label, sizeof(label) - 1);
+				hmac_sha1_add(&st, &from, sizeof(from));
+				hmac_sha1_add(&st, &to, sizeof(to));
+				hmac_sha1_add(&st, &block, sizeof(block));
+				hmac_sha1_end(&st, material + block * hmac_sha1_state::DIGEST_SIZE);
+			}
+
+			chacha20poly1305_key_init(key, material);
+		}
+
+		// the peer that `sockaddr' is the active pair or a remote candidate
+		// of, nullptr for an unknown source
+		peerconn* findKnownSource(const PlatformSocketAddr& sockaddr)
+		{
+			for (size_t ii = 0, nn = peers.size(); ii != nn; ++ii)
+			{
+				peerconn* p = &peers[ii];
+				if (p->state == PeerState::Invalid)
 					continue;
 
-				for (uint32_t readAttempt = 0; readAttempt < 10; ++readAttempt)
+				if (p->sockaddr.size == sockaddr.size && 0 == memcmp(&p->sockaddr.storage, &sockaddr.storage, sockaddr.size))
+					return p;
+
+				for (size_t jj = 0, mm = p->remoteCandidates.size(); jj != mm; ++jj)
 				{
-					const int32_t read = socketRecvFrom(c.s, incoming, sizeof(incoming), &sockaddr);
-					if (read < 0)
-						break;
+					const PlatformSocketAddr& candidate = p->remoteCandidates[jj].sockaddr;
+					if (candidate.size == sockaddr.size && 0 == memcmp(&candidate.storage, &sockaddr.storage, sockaddr.size))
+						return p;
+				}
+			}
 
-					// if this data is coming from our STUN server, simply ignore it for now
-					if (sockaddr.size == stunAddr4.size && 0 == memcmp(&sockaddr.storage, &stunAddr4.storage, sockaddr.size))
-						continue;
-					else if (sockaddr.size == stunAddr6.size && 0 == memcmp(&sockaddr.storage, &stunAddr6.storage, sockaddr.size))
-						continue;
+			return nullptr;
+		}
 
-					// is this a STUN packet?
-					if (stunIsBindingRequest(incoming, read))
+		// handle a datagram that arrived on local candidate `localIndex'
+		// from `sockaddr'. accepted media is handed out through `slot',
+		// which must stay valid until the next update
+		void processPacket(uint8_t localIndex, uint8_t* incoming, int32_t read, const PlatformSocketAddr& sockaddr, Message* slot, uint64_t now)
+		{
+			// is this a STUN packet?
+			if (stunIsBindingRequest(incoming, read))
+			{
+				TINY_PROFILE_ZONE("MeshICE::stunRequest");
+
+				// every valid request costs a MAC and a signed response.
+				// known peers have a budget of their own, so spoofed
+				// sources can't starve their checks. unknown sources are
+				// limited per source first so a single flooding host can't
+				// use up the aggregate budget
+				peerconn* known = findKnownSource(sockaddr);
+				const bool allowed = known
+					? tokenBucketTake(&known->stunBucket, stunSourceLimit, now)
+					: sourceRateLimiterTake(&stunSources, stunSourceLimit, sockaddr, now) && tokenBucketTake(&stunBucket, stunTotalLimit, now);
+				if (!allowed)
+				{
+					++totals.stunRateLimited;
+					return;
+				}
+
+				// requests that aren't directed at us are discarded while parsing
+				StunBindingRequest req;
+				req.hmacKey = sessionKey.data();
+				req.nhmacKey = static_cast<uint32_t>(sessionKey.size());
+				req.expectedTarget = localId;
+				if (stunProcessBindingRequest(&req, incoming, read))
+				{
+					++totals.stunRequestsIn;
+
+					peerBindingRequest bindingRequest;
+					bindingRequest.id = req.incomingUsername;
+					bindingRequest.peerReflexivePriority = req.priority;
+					bindingRequest.localCandidate = localIndex;
+					bindingRequest.useCandidate = req.useCandidate;
+					addressTo(&bindingRequest.address, &bindingRequest.bePort, sockaddr);
+
+					// send a result to the requesting party
+					uint8_t* attr = nullptr;
+					int npacket;
+					switch (bindingRequest.address.family)
 					{
-						StunBindingRequest req;
-						req.hmacKey = sessionKey.data();
-						req.nhmacKey = static_cast<uint32_t>(sessionKey.size());
-						if (stunProcessBindingRequest(&req, incoming, read))
-						{
-							// if this request wasn't directed at us, discard it
-							if (req.targetUsername != localId)
-								continue;
-
-							peerBindingRequest bindingRequest;
-							bindingRequest.id = req.incomingUsername;
-							bindingRequest.peerReflexivePriority = req.priority;
-							bindingRequest.localCandidate = static_cast<uint8_t>(ii);
-							bindingRequest.useCandidate = req.useCandidate;
-							addressTo(&bindingRequest.address, &bindingRequest.bePort, sockaddr);
-
-							// send a result to the requesting party
-							uint8_t* attr = nullptr;
-							int npacket;
-							switch (bindingRequest.address.family)
-							{
-							case AddressFamily::IPv4:
-								npacket = 20+56;
-								attr = stunGenerateBindingResponse(stunResponse, 44, incoming);
-								attr = stunAppendXorMappedAddress12(attr, bindingRequest.bePort, bindingRequest.address.u.v4, stunResponse);
-								break;
-							case AddressFamily::IPv6:
-								npacket = 20+68;
-								attr = stunGenerateBindingResponse(stunResponse, 56, incoming);
-								attr = stunAppendXorMappedAddress24(attr, bindingRequest.bePort, bindingRequest.address.u.v6, stunResponse);
-								break;
-							}
-							if (attr)
-							{
-								attr = stunAppendMessageIntegrityAttribute24(attr, stunResponse, sessionKey.data(), static_cast<uint32_t>(sessionKey.size()));
-								attr = stunAppendFingerprint8(attr, stunResponse);
-
-								ConstBuffer b;
-								b.p = stunResponse;
-								b.len = static_cast<uint32_t>(attr-stunResponse);
-								if (socketSendTo(c.s, &b, 1, sockaddr))
-								{ 
-									// find the peer for this request
-									peerconn* p = nullptr;
-									for (size_t ii = 0, nn = peers.size(); ii != nn; ++ii)
-									{
-										peerconn* candidate = &peers[ii];
-										if (candidate->state != PeerState::Invalid && candidate->id == bindingRequest.id)
-										{
-											p = candidate;
-											break;
-										}
-									}
-						
-									if (p)
-									{
-										p->recvTimeout = now + c_peerReceiveTimeout*timeFreqMS;
-										processPeerStunRequest(p, bindingRequest, now);
-									}
-									else
-									{
-										// got a request for a peer we don't know about yet, queue it for later
-										pendingPeerRequests.push_back(bindingRequest);
-									}
-								}
-							}
-						}
+					case AddressFamily::IPv4:
+						npacket = 20+56;
+						attr = stunGenerateBindingResponse(stunResponse, 44, incoming);
+						attr = stunAppendXorMappedAddress12(attr, bindingRequest.bePort, bindingRequest.address.u.v4, stunResponse);
+						break;
+					case AddressFamily::IPv6:
+						npacket = 20+68;
+						attr = stunGenerateBindingResponse(stunResponse, 56, incoming);
+						attr = stunAppendXorMappedAddress24(attr, bindingRequest.bePort, bindingRequest.address.u.v6, stunResponse);
+						break;
 					}
-					else if (stunIsBindingResponse(incoming, read))
+					if (attr)
 					{
-						StunBindingResult result;
-						result.hmacKey = sessionKey.data();
-						result.nhmacKey = static_cast<uint32_t>(sessionKey.size());
-						if (stunProcessBindingResult(&result, incoming, read))
-						{
-							// find the peer that generated this request
+						attr = stunAppendMessageIntegrityAttribute24(attr, stunResponse, sessionKey.data(), static_cast<uint32_t>(sessionKey.size()));
+						attr = stunAppendFingerprint8(attr, stunResponse);
+
+						ConstBuffer b;
+						b.p = stunResponse;
+						b.len = static_cast<uint32_t>(attr-stunResponse);
+						if (sendFromCandidate(localIndex, &b, 1, sockaddr))
+						{ 
+							// find the peer for this request
 							peerconn* p = nullptr;
-							uint8_t remoteIndex = 0xff;
-							for (size_t ii = 0, nn1 = peers.size(); p == nullptr && ii != nn1; ++ii)
+							for (size_t ii = 0, nn = peers.size(); ii != nn; ++ii)
 							{
 								peerconn* candidate = &peers[ii];
-								for (uint8_t jj = 0, nn2 = static_cast<uint8_t>(candidate->connectivityChecks.size()); jj != nn2; ++jj)
+								if (candidate->state != PeerState::Invalid && candidate->id == bindingRequest.id)
 								{
-									if (stunMatchesTransactionId(incoming, candidate->connectivityChecks[jj].stunRequest))
-									{
-										p = candidate;
-										remoteIndex = jj;
-										break;
-									}
+									p = candidate;
+									break;
 								}
 							}
-					
+				
 							if (p)
 							{
 								p->recvTimeout = now + c_peerReceiveTimeout*timeFreqMS;
-								if (p->state == PeerState::Negotiating)
-								{
-									// TODO: downgrade open/restrited/moderate NAT here
-
-									ConnectivityCheck* check = &p->connectivityChecks[remoteIndex];
-									check->state = CheckState::Succeeded;
-									if (p->controlling && check->nominated)
-									{
-										const RemoteCandidate& candidate = p->remoteCandidates[check->remoteCandidate];
-										addressFrom(&p->sockaddr, candidate.address, candidate.port);
-
-										// build keep-alive packet
-										uint8_t* attr = stunGenerateBindingRequest(rand, p->keepAlive, 52);
-										attr = stunAppendUsernameAttribute20(attr, localId, p->id);
-										attr = stunAppendMessageIntegrityAttribute24(attr, p->keepAlive, sessionKey.data(), static_cast<uint32_t>(sessionKey.size()));
-										attr = stunAppendFingerprint8(attr, p->keepAlive);
-
-										p->localCandidate = check->localCandidate;
-										p->state = PeerState::Connected;
-										p->connectivityChecks.clear();
-										p->connectivityChecks.shrink_to_fit();
-									}
-								}
-								else
-								{
-								}
+								processPeerStunRequest(p, bindingRequest, now);
+							}
+							else
+							{
+								// got a request for a peer we don't know about yet, queue it for later
+								pendingPeerRequests.push_back(bindingRequest);
 							}
 						}
 					}
-					// media packet
-					else if (read > 21 && (incoming[0] & 0xC0) == 0xC0)
+				}
+			}
+			else if (stunIsBindingResponse(incoming, read))
+			{
+				TINY_PROFILE_ZONE("MeshICE::stunResponse");
+
+				// match the transaction before checking the MAC, responses
+				// to requests we never sent are dropped cheaply
+				peerconn* p = nullptr;
+				uint8_t remoteIndex = 0xff;
+				bool cancelledTransaction = false;
+				for (size_t ii = 0, nn1 = peers.size(); p == nullptr && ii != nn1; ++ii)
+				{
+					peerconn* candidate = &peers[ii];
+					for (uint8_t jj = 0, nn2 = static_cast<uint8_t>(candidate->connectivityChecks.size()); jj != nn2; ++jj)
 					{
-						// locate peer
-						peerconn* p = nullptr;
-						for (size_t ii = 0, nn = peers.size(); ii != nn; ++ii)
+						const ConnectivityCheck& check = candidate->connectivityChecks[jj];
+						cancelledTransaction = check.cancelled && stunMatchesTransactionId(incoming, check.cancelledRequest);
+						if (cancelledTransaction || stunMatchesTransactionId(incoming, check.stunRequest))
 						{
-							peerconn* candidate = &peers[ii];
-							if (candidate->state != PeerState::Invalid && candidate->sockaddr.size == sockaddr.size)
+							p = candidate;
+							remoteIndex = jj;
+							break;
+						}
+					}
+				}
+
+				// or an answer to a keep-alive
+				peerconn* keepAlive = nullptr;
+				for (size_t ii = 0, nn1 = peers.size(); p == nullptr && ii != nn1; ++ii)
+				{
+					peerconn* candidate = &peers[ii];
+					if (candidate->state == PeerState::Connected && candidate->keepAliveSentAt != 0
+						&& stunMatchesTransactionId(incoming, candidate->keepAlive))
+					{
+						keepAlive = candidate;
+						break;
+					}
+				}
+
+				if (!p && !keepAlive)
+				{
+					++totals.unmatchedStunDrops;
+					return;
+				}
+
+				StunBindingResult result;
+				result.hmacKey = sessionKey.data();
+				result.nhmacKey = static_cast<uint32_t>(sessionKey.size());
+				if (!stunProcessBindingResult(&result, incoming, read))
+					return;
+
+				++totals.stunResponsesIn;
+
+				if (p)
+				{
+					p->recvTimeout = now + c_peerReceiveTimeout*timeFreqMS;
+					if (p->state == PeerState::Negotiating)
+					{
+						// TODO: downgrade open/restrited/moderate NAT here
+
+						ConnectivityCheck* check = &p->connectivityChecks[remoteIndex];
+						check->state = CheckState::Succeeded;
+						if (!cancelledTransaction)
+						{
+							updateCheckRoundTrip(p, check, now);
+						}
+
+						// the peer saw us at our host address unless a NAT
+						// rewrote it on the way
+						const LocalCandidate& local = localCandidates[check->localCandidate];
+						if (local.relayed)
+						{
+							check->localType = CandidateType::Relay;
+						}
+						else if (addressIsEqual(result.address, local.address) && result.bePort == local.port)
+						{
+							check->localType = CandidateType::Host;
+						}
+						else
+						{
+							check->localType = CandidateType::PeerReflexive;
+							for (size_t jj = 0, nn2 = remoteCandidates.size(); jj != nn2; ++jj)
 							{
-								if (0 == memcmp(&sockaddr.storage, &candidate->sockaddr.storage, sockaddr.size))
+								if (addressIsEqual(result.address, remoteCandidates[jj].address) && result.bePort == remoteCandidates[jj].port)
 								{
-									p = candidate;
+									check->localType = CandidateType::ServerReflexive;
 									break;
 								}
 							}
 						}
 
-						if (p != nullptr)
+						if (p->controlling && check->nominated)
 						{
-							// verify hmac
-							hmac_sha1_state st;
-							hmac_sha1_begin(&st, sessionKey.data(), static_cast<uint32_t>(sessionKey.size()));
-							hmac_sha1_add(&st, &p->id, sizeof(p->id));
-							hmac_sha1_add(&st, &incoming[1], read - 21);
-
-							uint8_t mac[hmac_sha1_state::DIGEST_SIZE];
-							hmac_sha1_end(&st, mac);
-							if (hmac_sha1_digest_equal(mac, hmac_sha1_state::DIGEST_SIZE, &incoming[read-20], 20))
-							{
-								// valid packet incoming[1, read-20)
-								Message* msg = messageAlloc(read-21);
-								memcpy(msg->data, &incoming[1], read-21);
-								p->incoming.push_back(msg);
-
-								p->recvTimeout = now + c_peerReceiveTimeout*timeFreqMS;
-							}
+							peerConnected(p, check, now);
 						}
 					}
 				}
+				else
+				{
+					keepAlive->recvTimeout = now + c_peerReceiveTimeout*timeFreqMS;
+					updateRoundTrip(keepAlive, now);
+				}
+			}
+			// media packet
+			else if (isMediaPacket(incoming, read))
+			{
+				// locate peer
+				peerconn* p = nullptr;
+				for (size_t ii = 0, nn = peers.size(); ii != nn; ++ii)
+				{
+					peerconn* candidate = &peers[ii];
+					if (candidate->state != PeerState::Invalid && candidate->sockaddr.size == sockaddr.size)
+					{
+						if (0 == memcmp(&sockaddr.storage, &candidate->sockaddr.storage, sockaddr.size))
+						{
+							p = candidate;
+							break;
+						}
+					}
+				}
+
+				if (p == nullptr)
+				{
+					++totals.unknownSourceDrops;
+					return;
+				}
+
+				queueMedia(p, slot, incoming, read, now);
+			}
+		}
+
+		static bool isMediaPacket(const uint8_t* incoming, int32_t read)
+		{
+			if (read <= static_cast<int32_t>(c_mediaHeadroom + c_mediaTailroom) || (incoming[0] & 0xC0) != 0xC0)
+				return false;
+
+			return incoming[0] != c_sealedMediaPrefix || read >= static_cast<int32_t>(c_sealedHeadroom + c_sealedTailroom);
+		}
+
+		// queue a media packet from `p' for `verifyPendingMedia', which
+		// verifies its MAC with the other packets of this update. cheap
+		// checks first: a forged tag or a peer over its rate never costs a
+		// MAC
+		void queueMedia(peerconn* p, Message* slot, uint8_t* incoming, int32_t read, uint64_t now)
+		{
+			if (0 != memcmp(&incoming[1], &p->recvTag, c_connectionTagSize))
+			{
+				++p->stats.tagMismatches;
+				++totals.tagMismatches;
+				return;
 			}
+			if (!tokenBucketTake(&p->mediaBucket, mediaLimit, now))
+			{
+				++p->stats.rateLimited;
+				++totals.mediaRateLimited;
+				return;
+			}
+
+			PendingMedia pending;
+			pending.slot = slot;
+			pending.incoming = incoming;
+			pending.read = read;
+			pending.peer = static_cast<uint32_t>(p - peers.data());
+			pending.sealed = (incoming[0] == c_sealedMediaPrefix);
+			pendingMedia.push_back(pending);
+		}
+
+		// verify the MACs of the media packets queued by `processPacket' in
+		// one batch, which hashes several packets at once in SIMD lanes,
+		// and hand out the valid ones in arrival order. encrypted packets
+		// are opened in place
+		void verifyPendingMedia(uint64_t now)
+		{
+			const uint32_t npending = static_cast<uint32_t>(pendingMedia.size());
+			if (npending == 0)
+				return;
+
+			pendingInputs.clear();
+			for (uint32_t ii = 0; ii < npending; ++ii)
+			{
+				const PendingMedia& pending = pendingMedia[ii];
+				if (pending.sealed)
+					continue;
+
+				hmac_sha1_input input;
+				input.prefix = &peers[pending.peer].id;
+				input.nprefix = sizeof(peers[pending.peer].id);
+				input.p = &pending.incoming[1];
+				input.n = pending.read - 1 - c_mediaTailroom;
+				pendingInputs.push_back(input);
+			}
+
+			const uint32_t nmacs = static_cast<uint32_t>(pendingInputs.size());
+			pendingDigests.resize(nmacs);
+			if (nmacs)
+			{
+				hmac_sha1_batch(&sessionMacKey, pendingInputs.data(), nmacs, &pendingDigests[0].mac);
+			}
+
+			for (uint32_t ii = 0, nextDigest = 0; ii < npending; ++ii)
+			{
+				const PendingMedia& pending = pendingMedia[ii];
+				peerconn* p = &peers[pending.peer];
+
+				bool valid;
+				uint32_t headroom, tailroom;
+				if (pending.sealed)
+				{
+					headroom = c_sealedHeadroom;
+					tailroom = c_sealedTailroom;
+
+					uint8_t nonce[chacha20poly1305_key::NONCE_SIZE];
+					mediaNonce(nonce, &pending.incoming[1 + c_connectionTagSize]);
+					uint8_t* ciphertext = pending.incoming + headroom;
+					const uint32_t nciphertext = pending.read - headroom - tailroom;
+					valid = chacha20poly1305_open(&p->recvKey, nonce, pending.incoming, headroom
+						, ciphertext, ciphertext, nciphertext, ciphertext + nciphertext);
+				}
+				else
+				{
+					headroom = c_mediaHeadroom;
+					tailroom = c_mediaTailroom;
+					valid = hmac_sha1_digest_equal(pendingDigests[nextDigest++].mac, hmac_sha1_state::DIGEST_SIZE, &pending.incoming[pending.read - c_mediaTailroom], c_mediaTailroom);
+				}
+
+				if (valid)
+				{
+					// valid packet incoming[headroom, read-tailroom). hand
+					// out a view into the receive slot
+					Message* msg = pending.slot;
+					msg->data = pending.incoming + headroom;
+					msg->ndata = pending.read - static_cast<int32_t>(headroom + tailroom);
+					p->incoming.push_back(msg);
+
+					p->recvTimeout = now + c_peerReceiveTimeout*timeFreqMS;
+
+					++p->stats.packetsIn;
+					p->stats.bytesIn += msg->ndata;
+					++totals.packetsIn;
+					totals.bytesIn += msg->ndata;
+				}
+				else
+				{
+					++p->stats.authFailures;
+					++totals.authFailures;
+				}
+			}
+
+			pendingMedia.clear();
+		}
+
+		void updateRunning()
+		{
+			const uint64_t now = clock->current();
+
+			{
+				TINY_PROFILE_ZONE("MeshICE::timers");
+
+				// keep STUN binding requests alive
+				for (size_t ii = 0, nn = localCandidates.size(); ii != nn; ++ii)
+				{
+					LocalCandidate& c = localCandidates[ii];
+					if (c.hasServerReflexiveAddress && now > c.nextStunAttempt)
+					{
+						sendServerReflexiveBindingRequest(c, stunServers[c.stunServer], now);
+						c.nextStunAttempt = now + c_stunRetryConnectedMS*timeFreqMS;
+					}
+				}
+
+				// keep the relay allocation alive
+				if (relay.localCandidate != 0xff && now > relay.nextAttempt)
+				{
+					sendRelayAllocate();
+					relay.nextAttempt = now + c_relayRefreshMS*timeFreqMS;
+				}
+			}
+
+			// clear incoming arrays on all peers. the messages point into our
+			// receive slots, which are about to be overwritten
+			for (size_t ii = 0, nn = peers.size(); ii != nn; ++ii)
+			{
+				peers[ii].incoming.clear();
+			}
+
+			// co-located peers
+			for (size_t ii = 0, nn = peers.size(); ii != nn; ++ii)
+			{
+				peerconn* p = &peers[ii];
+				if (p->state == PeerState::Connected && p->shm)
+				{
+					receiveShared(p, now);
+				}
+			}
+
+			// process incoming messages
+			for (size_t ii = 0, nn = localCandidates.size(); ii != nn; ++ii)
+			{
+				// the relayed candidate's datagrams arrive on its base socket
+				LocalCandidate& c = localCandidates[ii];
+				if (c.s == InvalidSocket || c.relayed)
+					continue;
+
+				const size_t firstSlot = ii * c_recvBatchSize;
+				for (uint32_t jj = 0; jj < c_recvBatchSize; ++jj)
+				{
+					recvBatch[jj].p = &recvSlots[(firstSlot + jj) * c_recvSlotSize];
+					recvBatch[jj].capacity = c_recvSlotSize;
+				}
+
+				uint32_t nreceived;
+				{
+					TINY_PROFILE_ZONE("MeshICE::recv");
+					nreceived = engine->recvBatch(c.s, recvBatch.data(), c_recvBatchSize);
+				}
+
+				TINY_PROFILE_ZONE("MeshICE::processPackets");
+				for (uint32_t readAttempt = 0; readAttempt < nreceived; ++readAttempt)
+				{
+					const uint8_t* incoming = recvBatch[readAttempt].p;
+					const int32_t read = static_cast<int32_t>(recvBatch[readAttempt].len);
+					const PlatformSocketAddr& sockaddr = recvBatch[readAttempt].addr;
+
+					// data from a STUN server completes server reflexive gathering
+					const int32_t stunServer = findStunServer(sockaddr);
+					if (stunServer >= 0)
+					{
+						TINY_PROFILE_ZONE("MeshICE::stunServerResponse");
+						processServerReflexiveResponse(c, static_cast<uint32_t>(stunServer), incoming, read, now);
+						continue;
+					}
+
+					// relay control messages and relayed datagrams
+					if (ii == relay.baseCandidate && relay.addr.size == sockaddr.size && 0 == memcmp(&sockaddr.storage, &relay.addr.storage, sockaddr.size))
+					{
+						processRelayPacket(recvBatch[readAttempt].p, read, &recvMessages[firstSlot + readAttempt], now);
+						continue;
+					}
+
+					processPacket(static_cast<uint8_t>(ii), recvBatch[readAttempt].p, read, sockaddr, &recvMessages[firstSlot + readAttempt], now);
+				}
+			}
+
+			{
+				TINY_PROFILE_ZONE("MeshICE::verifyMedia");
+				verifyPendingMedia(now);
+			}
+
+			TINY_PROFILE_ZONE("MeshICE::timers");
 
 			// update peers
 			for (size_t ii = 0, nn = peers.size(); ii != nn; ++ii)
@@ -1135,14 +2705,10 @@ namespace
 					} break;
 
 				case PeerState::Connected:
-					// need to send keep-alive?
-					if (now > p->timeout)
+					// need to send keep-alive, or time for a round trip probe?
+					if (now > p->timeout || now > p->nextRttProbe)
 					{
-						ConstBuffer b;
-						b.p = p->keepAlive;
-						b.len = sizeof(p->keepAlive);
-						socketSendTo(localCandidates[p->localCandidate].s, &b, 1, p->sockaddr);
-						p->timeout = now + c_peerTrafficAbsentMS*timeFreqMS;
+						sendKeepAlive(p, now);
 					}
 					if (now > p->recvTimeout)
 					{
@@ -1150,31 +2716,72 @@ namespace
 					}
 					break;
 				}
+
+				if (p->state == PeerState::Invalid && p->shm)
+				{
+					closeSharedChannel(p);
+				}
 			}
+
+			scheduleChecks(now);
 		}
 
+		ISocketEngine* const engine;
+		IClock* const clock; // owned by `engine'
+
 		uint64_t localId;
 		uint64_t timeFreqMS;
 		MeshState::E state;
 
-		PlatformSocketAddr stunAddr4;
-		PlatformSocketAddr stunAddr6;
+		std::vector<StunServerState> stunServers;
+		std::vector<StunLatency> stunLatency;
 
 		uint32_t peerSequence;
 		uint8_t stunResponse[20+56];
 
+		uint64_t nextCheckAt;
+		uint32_t nextCheckPeer;
+		uint32_t triggerSequence;
+
 		CryptoRandSource rand;
 		std::vector<peerconn> peers;
 		std::vector<uint8_t> sessionKey;
 		std::vector<LocalCandidate> localCandidates;
+		uint32_t hostCandidateCount;
 		std::vector<Candidate> remoteCandidates;
+		RelayClient relay;
 		std::vector<peerBindingRequest> pendingPeerRequests;
+		std::vector<CachedPair> cachedPairs;
+
+		std::vector<uint8_t> recvSlots;
+		std::vector<Message> recvMessages;
+		std::vector<Datagram> recvBatch;
+		std::vector<PendingMedia> pendingMedia;
+		std::vector<hmac_sha1_input> pendingInputs;
+		std::vector<MediaDigest> pendingDigests;
+		hmac_sha1_key sessionMacKey;
+		std::vector<uint8_t> sealScratch;
+		bool encryptMedia; // see `setMediaEncryption'
+
+		// flood protection, see `processPacket'
+		RateLimit stunSourceLimit;
+		RateLimit stunTotalLimit;
+		RateLimit mediaLimit;
+		SourceRateLimiter stunSources;
+		TokenBucket stunBucket;
+
+		MeshStats totals;
 	};
 }
 
-IMesh* tiny::peer::meshCreateICE(uint32_t maxPeers, uint64_t localId, uint16_t port)
+IMesh* tiny::peer::meshCreateICE(uint32_t maxPeers, uint64_t localId, uint16_t port, ISocketEngine* engine)
 {
-	MeshICE* m = new MeshICE;
+	if (!engine)
+	{
+		engine = socketEngineCreatePlatform();
+	}
+
+	MeshICE* m = new MeshICE(engine);
 	if (!m->create(maxPeers, localId, port))
 	{
 		m->destroy();
@@ -1185,8 +2792,13 @@ IMesh* tiny::peer::meshCreateICE(uint32_t maxPeers, uint64_t localId, uint16_t p
 }
 
 #else
-IMesh* tiny::peer::meshCreateICE(uint32_t /*maxPeers*/, uint64_t /*localId*/, uint16_t /*port*/)
+IMesh* tiny::peer::meshCreateICE(uint32_t /*maxPeers*/, uint64_t /*localId*/, uint16_t /*port*/, net::ISocketEngine* engine)
 {
+	if (engine)
+	{
+		engine->release();
+	}
+
 	return nullptr;
 }
 #endif // TINY_PEER_ENABLE_ICE
@@ -69,7 +69,29 @@ uint32_t peer::priorityForHostAddress(const Address& addr)
 	return localPreference(addr) | TypePreference::Host;
 }
 
+uint32_t peer::priorityForRelayAddress(const Address& addr)
+{
+	return localPreference(addr) | TypePreference::Relay;
+}
+
 uint32_t peer::priorityChangeTypePreference(uint32_t priority, TypePreference::E newType)
 {
 	return (priority & 0x00FFFFFF) | newType;
 }
+
+CandidateType::E peer::priorityCandidateType(uint32_t priority)
+{
+	switch (priority & 0xFF000000)
+	{
+	case TypePreference::Host:
+		return CandidateType::Host;
+	case TypePreference::PeerReflexive:
+		return CandidateType::PeerReflexive;
+	case TypePreference::ServerReflexive:
+		return CandidateType::ServerReflexive;
+	case TypePreference::Relay:
+		return CandidateType::Relay;
+	default:
+		return CandidateType::Unknown;
+	}
+}
@@ -28,6 +28,7 @@
 #define TINY_SRC_PEER_ICE__PRIORITY_H
 
 #include <stdint.h>
+#include "tiny/peer/stats.h"
 
 namespace tiny
 {
@@ -47,7 +48,9 @@ namespace tiny
 		};
 
 		uint32_t priorityForHostAddress(const net::Address& addr);
+		uint32_t priorityForRelayAddress(const net::Address& addr);
 		uint32_t priorityChangeTypePreference(uint32_t priority, TypePreference::E newType);
+		CandidateType::E priorityCandidateType(uint32_t priority);
 	}
 }
 
@@ -0,0 +1,77 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "peer/ice/ratelimit.h"
+#include "tiny/hash/murmur3.h"
+#include "tiny/net/socket.h"
+
+using namespace tiny;
+using namespace tiny::hash;
+using namespace tiny::net;
+using namespace tiny::peer;
+
+RateLimit peer::rateLimitCreate(uint64_t ticksPerSecond, uint32_t perSecond, uint32_t burst)
+{
+	RateLimit limit;
+	limit.interval = ticksPerSecond / perSecond;
+	limit.burst = limit.interval * burst;
+	return limit;
+}
+
+void peer::sourceRateLimiterInit(SourceRateLimiter* limiter)
+{
+	memset(limiter, 0, sizeof(*limiter));
+}
+
+bool peer::sourceRateLimiterTake(SourceRateLimiter* limiter, const RateLimit& limit, const PlatformSocketAddr& source, uint64_t now)
+{
+	// sockaddr_in and sockaddr_in6 take the fixed size paths
+	const uint8_t* p = reinterpret_cast<const uint8_t*>(&source.storage);
+	uint64_t hash;
+	if (source.size == 16)
+		hash = murmur3_x64_128_fixed<16>(p).h1;
+	else if (source.size == 28)
+		hash = murmur3_x64_128_fixed<28>(p).h1;
+	else
+		hash = murmur3_x64_64(p, source.size);
+
+	const uint32_t key = static_cast<uint32_t>(hash) | 1;
+	const uint32_t slot = (key >> 1) % SourceRateLimiter::Slots;
+	if (limiter->keys[slot] != key)
+	{
+		// rotating sources would each get a fresh burst if a slot still
+		// in use was reset
+		limiter->keys[slot] = key;
+		if (limiter->buckets[slot].empty > now)
+		{
+			limiter->buckets[slot].empty = now + limit.burst;
+		}
+	}
+
+	return tokenBucketTake(&limiter->buckets[slot], limit, now);
+}
@@ -0,0 +1,91 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TINY_SRC_PEER_ICE__RATELIMIT_H
+#define TINY_SRC_PEER_ICE__RATELIMIT_H
+
+#include <stdint.h>
+
+namespace tiny
+{
+	namespace net
+	{
+		struct PlatformSocketAddr;
+	}
+
+	namespace peer
+	{
+		// token bucket held as the time the bucket next runs dry (the
+		// generic cell rate algorithm), so it costs a compare and an add
+		// per packet
+		struct TokenBucket
+		{
+			uint64_t empty;
+		};
+
+		struct RateLimit
+		{
+			uint64_t interval; // ticks per token
+			uint64_t burst; // ticks of tokens the bucket holds
+		};
+
+		// limit of `perSecond' packets with bursts of `burst' packets, for a
+		// clock of `ticksPerSecond'
+		RateLimit rateLimitCreate(uint64_t ticksPerSecond, uint32_t perSecond, uint32_t burst);
+
+		// take a token from `bucket' at time `now'. returns `false' if the
+		// bucket is dry and the packet should be dropped
+		static inline bool tokenBucketTake(TokenBucket* bucket, const RateLimit& limit, uint64_t now)
+		{
+			const uint64_t empty = (bucket->empty > now) ? bucket->empty : now;
+			if (empty - now >= limit.burst)
+				return false;
+
+			bucket->empty = empty + limit.interval;
+			return true;
+		}
+
+		// token buckets keyed by source address in a fixed, direct mapped
+		// table. a source that collides with another takes over its slot,
+		// but only an idle slot is handed over with a full bucket; one still
+		// in use is handed over dry. flooding from many (spoofed) sources
+		// still has to be bounded by an aggregate bucket as well
+		struct SourceRateLimiter
+		{
+			static const uint32_t Slots = 256;
+
+			uint32_t keys[Slots]; // 0 for an unused slot
+			TokenBucket buckets[Slots];
+		};
+
+		void sourceRateLimiterInit(SourceRateLimiter* limiter);
+
+		bool sourceRateLimiterTake(SourceRateLimiter* limiter, const RateLimit& limit
+			, const net::PlatformSocketAddr& source, uint64_t now);
+	}
+}
+
+#endif // TINY_SRC_PEER_ICE__RATELIMIT_H
@@ -0,0 +1,223 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "peer/ice/relay.h"
+#include "tiny/crypto/hmac.h"
+
+using namespace tiny;
+using namespace tiny::crypto;
+using namespace tiny::net;
+using namespace tiny::peer;
+
+static void relayMac(uint8_t* out, const uint8_t* packet, uint32_t npacket, const uint8_t* key, uint32_t nkey)
+{
+	hmac_sha1_state st;
+	hmac_sha1_begin(&st, key, nkey);
+	hmac_sha1_add(&st, packet, npacket);
+	hmac_sha1_end(&st, out);
+}
+
+static bool relayVerifyMac(const uint8_t* packet, uint32_t npacket, const uint8_t* key, uint32_t nkey)
+{
+	if (npacket < c_relayMacSize)
+		return false;
+
+	uint8_t digest[hmac_sha1_state::DIGEST_SIZE];
+	relayMac(digest, packet, npacket - c_relayMacSize, key, nkey);
+	return hmac_sha1_digest_equal(digest, hmac_sha1_state::DIGEST_SIZE, packet + npacket - c_relayMacSize, c_relayMacSize);
+}
+
+uint32_t peer::relayEncodeAddress(uint8_t* out, const Address& addr, uint16_t bePort)
+{
+	out[0] = addr.family;
+	memcpy(&out[1], &bePort, sizeof(bePort));
+
+	switch (addr.family)
+	{
+	case AddressFamily::IPv4:
+		memcpy(&out[3], &addr.u.v4, sizeof(addr.u.v4));
+		return 3 + sizeof(addr.u.v4);
+
+	case AddressFamily::IPv6:
+		memcpy(&out[3], &addr.u.v6, sizeof(addr.u.v6));
+		return 3 + sizeof(addr.u.v6);
+
+	default:
+		return 0;
+	}
+}
+
+uint32_t peer::relayDecodeAddress(Address* addr, uint16_t* bePort, const uint8_t* in, uint32_t n)
+{
+	if (n < 3)
+		return 0;
+
+	addr->family = in[0];
+	memcpy(bePort, &in[1], sizeof(*bePort));
+
+	switch (in[0])
+	{
+	case AddressFamily::IPv4:
+		if (n < 3 + sizeof(addr->u.v4))
+			return 0;
+		memcpy(&addr->u.v4, &in[3], sizeof(addr->u.v4));
+		return 3 + sizeof(addr->u.v4);
+
+	case AddressFamily::IPv6:
+		if (n < 3 + sizeof(addr->u.v6))
+			return 0;
+		memcpy(&addr->u.v6, &in[3], sizeof(addr->u.v6));
+		return 3 + sizeof(addr->u.v6);
+
+	default:
+		return 0;
+	}
+}
+
+uint32_t peer::relayGenerateAllocate(uint8_t out[c_relayAllocateSize], const uint8_t transactionId[c_relayTransactionIdSize], uint64_t clientId, const uint8_t cookie[c_relayCookieSize], const uint8_t* key, uint32_t nkey)
+{
+	uint8_t* p = out;
+	*p++ = RelayMessage::Allocate;
+	memcpy(p, transactionId, c_relayTransactionIdSize);
+	p += c_relayTransactionIdSize;
+	memcpy(p, &clientId, sizeof(clientId));
+	p += sizeof(clientId);
+	memcpy(p, cookie, c_relayCookieSize);
+	p += c_relayCookieSize;
+
+	relayMac(p, out, static_cast<uint32_t>(p - out), key, nkey);
+	return c_relayAllocateSize;
+}
+
+bool peer::relayProcessAllocate(uint8_t transactionId[c_relayTransactionIdSize], uint64_t* clientId, uint8_t cookie[c_relayCookieSize], const uint8_t* packet, uint32_t npacket, const uint8_t* key, uint32_t nkey)
+{
+	if (npacket != c_relayAllocateSize || packet[0] != RelayMessage::Allocate)
+		return false;
+
+	if (!relayVerifyMac(packet, npacket, key, nkey))
+		return false;
+
+	memcpy(transactionId, &packet[1], c_relayTransactionIdSize);
+	memcpy(clientId, &packet[1 + c_relayTransactionIdSize], sizeof(*clientId));
+	memcpy(cookie, &packet[1 + c_relayTransactionIdSize + sizeof(*clientId)], c_relayCookieSize);
+	return true;
+}
+
+uint32_t peer::relayGenerateChallenge(uint8_t out[c_relayChallengeSize], const uint8_t transactionId[c_relayTransactionIdSize], const uint8_t cookie[c_relayCookieSize])
+{
+	out[0] = RelayMessage::Challenge;
+	memcpy(&out[1], transactionId, c_relayTransactionIdSize);
+	memcpy(&out[1 + c_relayTransactionIdSize], cookie, c_relayCookieSize);
+	return c_relayChallengeSize;
+}
+
+bool peer::relayProcessChallenge(uint8_t cookie[c_relayCookieSize], const uint8_t* packet, uint32_t npacket, const uint8_t transactionId[c_relayTransactionIdSize])
+{
+	if (npacket != c_relayChallengeSize || packet[0] != RelayMessage::Challenge)
+		return false;
+
+	// unauthenticated, a forged cookie only costs the client a round trip
+	if (memcmp(&packet[1], transactionId, c_relayTransactionIdSize) != 0)
+		return false;
+
+	memcpy(cookie, &packet[1 + c_relayTransactionIdSize], c_relayCookieSize);
+	return true;
+}
+
+uint32_t peer::relayGenerateAllocated(uint8_t out[c_relayAllocatedMaxSize], const uint8_t transactionId[c_relayTransactionIdSize], const uint8_t token[c_relayTokenSize], const Address& addr, uint16_t bePort, const uint8_t* key, uint32_t nkey)
+{
+	uint8_t* p = out;
+	*p++ = RelayMessage::Allocated;
+	memcpy(p, transactionId, c_relayTransactionIdSize);
+	p += c_relayTransactionIdSize;
+	memcpy(p, token, c_relayTokenSize);
+	p += c_relayTokenSize;
+
+	const uint32_t naddr = relayEncodeAddress(p, addr, bePort);
+	if (naddr == 0)
+		return 0;
+	p += naddr;
+
+	relayMac(p, out, static_cast<uint32_t>(p - out), key, nkey);
+	p += c_relayMacSize;
+	return static_cast<uint32_t>(p - out);
+}
+
+bool peer::relayProcessAllocated(uint8_t token[c_relayTokenSize], Address* addr, uint16_t* bePort, const uint8_t* packet, uint32_t npacket, const uint8_t transactionId[c_relayTransactionIdSize], const uint8_t* key, uint32_t nkey)
+{
+	static const uint32_t c_fixed = 1 + c_relayTransactionIdSize + c_relayTokenSize;
+	if (npacket < c_fixed + c_relayMacSize || packet[0] != RelayMessage::Allocated)
+		return false;
+
+	if (memcmp(&packet[1], transactionId, c_relayTransactionIdSize) != 0)
+		return false;
+
+	const uint32_t naddr = relayDecodeAddress(addr, bePort, &packet[c_fixed], npacket - c_fixed - c_relayMacSize);
+	if (naddr == 0 || c_fixed + naddr + c_relayMacSize != npacket)
+		return false;
+
+	if (!relayVerifyMac(packet, npacket, key, nkey))
+		return false;
+
+	memcpy(token, &packet[1 + c_relayTransactionIdSize], c_relayTokenSize);
+	return true;
+}
+
+uint32_t peer::relayGenerateDataHeader(uint8_t out[c_relayDataHeaderMaxSize], const Address& sender, uint16_t bePort)
+{
+	out[0] = RelayMessage::Data;
+	const uint32_t naddr = relayEncodeAddress(&out[1], sender, bePort);
+	return naddr ? 1 + naddr : 0;
+}
+
+uint32_t peer::relayGenerateSendHeader(uint8_t out[c_relaySendHeaderMaxSize], const uint8_t token[c_relayTokenSize], const Address& destination, uint16_t bePort)
+{
+	out[0] = RelayMessage::Send;
+	memcpy(&out[1], token, c_relayTokenSize);
+	const uint32_t naddr = relayEncodeAddress(&out[1 + c_relayTokenSize], destination, bePort);
+	return naddr ? 1 + c_relayTokenSize + naddr : 0;
+}
+
+uint32_t peer::relayProcessData(Address* sender, uint16_t* bePort, const uint8_t* packet, uint32_t npacket)
+{
+	if (npacket < 1 || packet[0] != RelayMessage::Data)
+		return 0;
+
+	const uint32_t naddr = relayDecodeAddress(sender, bePort, &packet[1], npacket - 1);
+	return naddr ? 1 + naddr : 0;
+}
+
+uint32_t peer::relayProcessSend(const uint8_t** token, Address* destination, uint16_t* bePort, const uint8_t* packet, uint32_t npacket)
+{
+	if (npacket < 1 + c_relayTokenSize || packet[0] != RelayMessage::Send)
+		return 0;
+
+	*token = &packet[1];
+	const uint32_t naddr = relayDecodeAddress(destination, bePort, &packet[1 + c_relayTokenSize], npacket - 1 - c_relayTokenSize);
+	return naddr ? 1 + c_relayTokenSize + naddr : 0;
+}
@@ -0,0 +1,112 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TINY_SRC_PEER_ICE__RELAY_H
+#define TINY_SRC_PEER_ICE__RELAY_H
+
+#include <stdint.h>
+#include "tiny/net/address.h"
+
+namespace tiny
+{
+	namespace peer
+	{
+		// relay protocol. all messages start with a marker byte that can not
+		// be the first byte of a STUN message, the relay server's control
+		// port tells them apart from everything else by source address.
+		//
+		//  allocate  : [0xD0][transaction id : 12][client id : 8][cookie : 8][hmac : 20]
+		//  allocated : [0xD1][transaction id : 12][token : 8][relayed address][hmac : 20]
+		//  data      : [0xD2][sender address][payload]          relay -> client
+		//  send      : [0xD3][token : 8][destination address][payload]  client -> relay
+		//  challenge : [0xD4][transaction id : 12][cookie : 8]  relay -> client
+		//
+		// addresses are encoded as [family : 1][port : 2, network order][4 or 16 bytes].
+		// allocate and allocated are authenticated with a key shared between
+		// the relay server and its clients, sending is authorized by the
+		// random token handed out with the allocation and the client's
+		// source address.
+		//
+		// the server only allocates for an allocate that echoes a cookie
+		// bound to the client's source address, client id and the current
+		// time, like a STUN nonce. any other authenticated allocate is
+		// answered with a challenge carrying a fresh cookie, which is
+		// smaller than the request. a captured allocate can't be replayed
+		// from other addresses, or after the cookie expired.
+		struct RelayMessage
+		{
+			enum E
+			{
+				Allocate  = 0xD0,
+				Allocated = 0xD1,
+				Data      = 0xD2,
+				Send      = 0xD3,
+				Challenge = 0xD4,
+			};
+		};
+
+		static const uint32_t c_relayTransactionIdSize = 12;
+		static const uint32_t c_relayTokenSize = 8;
+		static const uint32_t c_relayCookieSize = 8;
+		static const uint32_t c_relayMacSize = 20;
+		static const uint32_t c_relayAddressMaxSize = 1 + 2 + 16;
+		static const uint32_t c_relayAllocateSize = 1 + c_relayTransactionIdSize + 8 + c_relayCookieSize + c_relayMacSize;
+		static const uint32_t c_relayChallengeSize = 1 + c_relayTransactionIdSize + c_relayCookieSize;
+		static const uint32_t c_relayAllocatedMaxSize = 1 + c_relayTransactionIdSize + c_relayTokenSize + c_relayAddressMaxSize + c_relayMacSize;
+		static const uint32_t c_relayDataHeaderMaxSize = 1 + c_relayAddressMaxSize;
+		static const uint32_t c_relaySendHeaderMaxSize = 1 + c_relayTokenSize + c_relayAddressMaxSize;
+
+		static inline bool relayIsMessage(const uint8_t* packet, uint32_t npacket)
+		{
+			return npacket > 0 && packet[0] >= RelayMessage::Allocate && packet[0] <= RelayMessage::Challenge;
+		}
+
+		// address encoding. `relayDecodeAddress' returns the number of bytes
+		// consumed, 0 if malformed
+		uint32_t relayEncodeAddress(uint8_t* out, const net::Address& addr, uint16_t bePort);
+		uint32_t relayDecodeAddress(net::Address* addr, uint16_t* bePort, const uint8_t* in, uint32_t n);
+
+		// a client without a cookie sends zeros
+		uint32_t relayGenerateAllocate(uint8_t out[c_relayAllocateSize], const uint8_t transactionId[c_relayTransactionIdSize], uint64_t clientId, const uint8_t cookie[c_relayCookieSize], const uint8_t* key, uint32_t nkey);
+		bool relayProcessAllocate(uint8_t transactionId[c_relayTransactionIdSize], uint64_t* clientId, uint8_t cookie[c_relayCookieSize], const uint8_t* packet, uint32_t npacket, const uint8_t* key, uint32_t nkey);
+
+		uint32_t relayGenerateChallenge(uint8_t out[c_relayChallengeSize], const uint8_t transactionId[c_relayTransactionIdSize], const uint8_t cookie[c_relayCookieSize]);
+		bool relayProcessChallenge(uint8_t cookie[c_relayCookieSize], const uint8_t* packet, uint32_t npacket, const uint8_t transactionId[c_relayTransactionIdSize]);
+
+		uint32_t relayGenerateAllocated(uint8_t out[c_relayAllocatedMaxSize], const uint8_t transactionId[c_relayTransactionIdSize], const uint8_t token[c_relayTokenSize], const net::Address& addr, uint16_t bePort, const uint8_t* key, uint32_t nkey);
+		bool relayProcessAllocated(uint8_t token[c_relayTokenSize], net::Address* addr, uint16_t* bePort, const uint8_t* packet, uint32_t npacket, const uint8_t transactionId[c_relayTransactionIdSize], const uint8_t* key, uint32_t nkey);
+
+		// headers prepended to the payload, which is sent as a separate buffer
+		uint32_t relayGenerateDataHeader(uint8_t out[c_relayDataHeaderMaxSize], const net::Address& sender, uint16_t bePort);
+		uint32_t relayGenerateSendHeader(uint8_t out[c_relaySendHeaderMaxSize], const uint8_t token[c_relayTokenSize], const net::Address& destination, uint16_t bePort);
+
+		// return the offset of the payload, 0 if malformed
+		uint32_t relayProcessData(net::Address* sender, uint16_t* bePort, const uint8_t* packet, uint32_t npacket);
+		uint32_t relayProcessSend(const uint8_t** token, net::Address* destination, uint16_t* bePort, const uint8_t* packet, uint32_t npacket);
+	}
+}
+
+#endif // TINY_SRC_PEER_ICE__RELAY_H
@@ -0,0 +1,530 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "peer/config.h"
+#include "tiny/peer/relayserver.h"
+
+using namespace tiny;
+using namespace tiny::peer;
+
+IRelayServer::~IRelayServer()
+{
+}
+
+#if TINY_PEER_ENABLE_ICE
+
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "peer/ice/relay.h"
+#include "tiny/crypto/hmac.h"
+#include "tiny/crypto/rand.h"
+#include "tiny/endian.h"
+#include "tiny/net/address.h"
+#include "tiny/net/socket.h"
+#include "tiny/time.h"
+
+using namespace tiny::crypto;
+using namespace tiny::net;
+
+// Datagrams read per receive batch and socket
+static const uint32_t c_relayBatchSize = 32;
+// Largest datagram forwarded, including the relay header
+static const uint32_t c_relayDatagramSize = 1500;
+// Most allocations served at once. a client id holds at most one, an
+// allocate for a known id from a new address replaces it
+static const uint32_t c_relayMaxAllocations = 1024;
+// Period after which allocate cookies change. a cookie is accepted for up
+// to two periods
+static const uint32_t c_relayCookiePeriodMS = 60000;
+// Remote addresses a single allocation may exchange datagrams with
+static const uint32_t c_relayMaxPermissions = 8;
+// Time an allocation lives without a refresh from its client
+static const uint32_t c_relayAllocationLifetimeMS = 30000;
+// Interval at which the worker expires allocations and checks for shutdown
+static const uint32_t c_relayWaitMS = 100;
+
+namespace
+{
+	struct Allocation
+	{
+		Socket s;
+		uint16_t bePort;
+		PlatformSocketAddr client;
+		uint64_t clientId;
+		uint64_t token;
+		uint64_t expiresAt;
+		Address permissions[c_relayMaxPermissions];
+		uint32_t npermissions;
+		uint32_t nextPermission;
+	};
+
+	static bool platformAddressIsEqual(const PlatformSocketAddr& a, const PlatformSocketAddr& b)
+	{
+		return a.size == b.size && memcmp(a.storage, b.storage, a.size) == 0;
+	}
+
+	class RelayServer : public IRelayServer
+	{
+	public:
+		RelayServer()
+			: s(InvalidSocket)
+			, quit(false)
+			, nallocations(0)
+			, relayed(0)
+		{
+			crandInit(&rand);
+			crandFill(&rand, cookieSecret, sizeof(cookieSecret));
+		}
+
+		~RelayServer()
+		{
+			quit.store(true, std::memory_order_release);
+			if (worker.joinable())
+			{
+				worker.join();
+			}
+
+			for (size_t ii = 0, nn = allocs.size(); ii != nn; ++ii)
+			{
+				socketClose(allocs[ii].s);
+			}
+
+			if (s != InvalidSocket)
+			{
+				socketClose(s);
+			}
+
+			crandDestroy(&rand);
+		}
+
+		bool create(const Address& bindAddr, const Address& publicAddr, uint16_t port, const uint8_t* key, uint32_t nkey)
+		{
+			this->bindAddr = bindAddr;
+			this->publicAddr = publicAddr;
+			this->key.assign(key, key + nkey);
+			this->timeFreqMS = timestampFrequency()/1000;
+
+			bePort = endianToBig(port);
+			if (!socketCreateUDP(&s, bindAddr, &bePort))
+			{
+				s = InvalidSocket;
+				return false;
+			}
+
+			// everything the worker touches per packet is allocated up front
+			allocs.reserve(c_relayMaxAllocations);
+			sockets.reserve(1 + c_relayMaxAllocations);
+			sockets.push_back(s);
+			readable.reset(new bool[1 + c_relayMaxAllocations]);
+			byToken.reserve(c_relayMaxAllocations);
+
+			storage.resize(c_relayBatchSize * c_relayDatagramSize);
+			for (uint32_t ii = 0; ii < c_relayBatchSize; ++ii)
+			{
+				dgs[ii].p = &storage[ii * c_relayDatagramSize];
+				dgs[ii].capacity = c_relayDatagramSize;
+			}
+
+			worker = std::thread(&RelayServer::run, this);
+			return true;
+		}
+
+		virtual void destroy()
+		{
+			delete this;
+		}
+
+		virtual uint16_t port()
+		{
+			return endianFromBig(bePort);
+		}
+
+		virtual uint32_t allocations()
+		{
+			return nallocations.load(std::memory_order_relaxed);
+		}
+
+		virtual uint64_t packetsRelayed()
+		{
+			return relayed.load(std::memory_order_relaxed);
+		}
+
+	private:
+		void run()
+		{
+			uint64_t nextExpiry = 0;
+			while (!quit.load(std::memory_order_acquire))
+			{
+				const uint32_t nsockets = static_cast<uint32_t>(sockets.size());
+				if (socketWaitReadable(sockets.data(), readable.get(), nsockets, c_relayWaitMS))
+				{
+					// allocations may be added or replaced while the control
+					// socket is processed. new ones were not polled so skip
+					// them this round; a moved one is read without data
+					if (readable[0])
+					{
+						processControl();
+					}
+
+					for (uint32_t ii = 1, nn = std::min(nsockets, static_cast<uint32_t>(sockets.size())); ii < nn; ++ii)
+					{
+						if (readable[ii])
+						{
+							processRelayed(ii - 1);
+						}
+					}
+				}
+
+				const uint64_t now = timestampCurrent();
+				if (now >= nextExpiry)
+				{
+					expireAllocations(now);
+					nextExpiry = now + c_relayWaitMS*timeFreqMS;
+				}
+			}
+		}
+
+		void processControl()
+		{
+			uint64_t sent = 0;
+			for (;;)
+			{
+				const uint32_t nreceived = socketRecvBatch(s, dgs, c_relayBatchSize);
+				for (uint32_t ii = 0; ii < nreceived; ++ii)
+				{
+					const Datagram& dg = dgs[ii];
+					if (dg.len == 0)
+						continue;
+
+					switch (dg.p[0])
+					{
+					case RelayMessage::Allocate:
+						processAllocate(dg);
+						break;
+
+					case RelayMessage::Send:
+						sent += processSend(dg) ? 1 : 0;
+						break;
+
+					default:
+						break;
+					}
+				}
+
+				if (nreceived < c_relayBatchSize)
+					break;
+			}
+
+			if (sent)
+			{
+				relayed.fetch_add(sent, std::memory_order_relaxed);
+			}
+		}
+
+		// cookie for an allocate from `client' in cookie period `period'
+		void allocateCookie(uint8_t out[c_relayCookieSize], const PlatformSocketAddr& client, uint64_t clientId, uint64_t period)
+		{
+			hmac_sha1_state st;
+			hmac_sha1_begin(&st, cookieSecret, sizeof(cookieSecret));
+			hmac_sha1_add(&st, &period, sizeof(period));
+			hmac_sha1_add(&st, &clientId, sizeof(clientId));
+			hmac_sha1_add(&st, client.storage, client.size);
+
+			uint8_t digest[hmac_sha1_state::DIGEST_SIZE];
+			hmac_sha1_end(&st, digest);
+			memcpy(out, digest, c_relayCookieSize);
+		}
+
+		void processAllocate(const Datagram& dg)
+		{
+			uint8_t transactionId[c_relayTransactionIdSize];
+			uint64_t clientId;
+			uint8_t cookie[c_relayCookieSize];
+			if (!relayProcessAllocate(transactionId, &clientId, cookie, dg.p, dg.len, key.data(), static_cast<uint32_t>(key.size())))
+				return;
+
+			const uint64_t now = timestampCurrent();
+
+			// the source address must have seen a recent cookie. otherwise
+			// challenge it, statelessly
+			const uint64_t period = now / (c_relayCookiePeriodMS*timeFreqMS);
+			uint8_t expected[c_relayCookieSize];
+			allocateCookie(expected, dg.addr, clientId, period);
+			if (!hmac_sha1_digest_equal(expected, c_relayCookieSize, cookie, c_relayCookieSize))
+			{
+				uint8_t previous[c_relayCookieSize];
+				allocateCookie(previous, dg.addr, clientId, period - 1);
+				if (!hmac_sha1_digest_equal(previous, c_relayCookieSize, cookie, c_relayCookieSize))
+				{
+					uint8_t challenge[c_relayChallengeSize];
+					ConstBuffer b;
+					b.p = challenge;
+					b.len = relayGenerateChallenge(challenge, transactionId, expected);
+					socketSendTo(s, &b, 1, dg.addr);
+					return;
+				}
+			}
+
+			// a refresh from the same client keeps its allocation. the same
+			// client id from a new address replaces it
+			Allocation* a = nullptr;
+			for (size_t ii = 0, nn = allocs.size(); ii != nn; ++ii)
+			{
+				if (allocs[ii].clientId == clientId)
+				{
+					if (platformAddressIsEqual(allocs[ii].client, dg.addr))
+					{
+						a = &allocs[ii];
+					}
+					else
+					{
+						removeAllocation(ii);
+					}
+					break;
+				}
+			}
+
+			if (!a)
+			{
+				if (allocs.size() >= c_relayMaxAllocations)
+					return;
+
+				Allocation n;
+				n.bePort = 0;
+				if (!socketCreateUDP(&n.s, bindAddr, &n.bePort))
+					return;
+
+				n.client = dg.addr;
+				n.clientId = clientId;
+				do
+				{
+					crandFill(&rand, reinterpret_cast<uint8_t*>(&n.token), sizeof(n.token));
+				} while (byToken.count(n.token));
+				n.npermissions = 0;
+				n.nextPermission = 0;
+
+				byToken[n.token] = static_cast<uint32_t>(allocs.size());
+				allocs.push_back(n);
+				sockets.push_back(n.s);
+				nallocations.store(static_cast<uint32_t>(allocs.size()), std::memory_order_relaxed);
+				a = &allocs.back();
+			}
+
+			a->expiresAt = now + c_relayAllocationLifetimeMS*timeFreqMS;
+
+			uint8_t response[c_relayAllocatedMaxSize];
+			const uint32_t nresponse = relayGenerateAllocated(response, transactionId, reinterpret_cast<const uint8_t*>(&a->token), publicAddr, a->bePort, key.data(), static_cast<uint32_t>(key.size()));
+			if (nresponse == 0)
+				return;
+
+			ConstBuffer b;
+			b.p = response;
+			b.len = nresponse;
+			socketSendTo(s, &b, 1, dg.addr);
+		}
+
+		bool processSend(const Datagram& dg)
+		{
+			const uint8_t* token;
+			Address destination;
+			uint16_t destinationPort;
+			const uint32_t offset = relayProcessSend(&token, &destination, &destinationPort, dg.p, dg.len);
+			if (offset == 0)
+				return false;
+
+			uint64_t t;
+			memcpy(&t, token, sizeof(t));
+			auto found = byToken.find(t);
+			if (found == byToken.end())
+				return false;
+
+			Allocation& a = allocs[found->second];
+			if (!platformAddressIsEqual(a.client, dg.addr))
+				return false;
+
+			// sending to an address opens the allocation for datagrams from it
+			bool permitted = false;
+			for (uint32_t ii = 0; ii < a.npermissions; ++ii)
+			{
+				if (addressIsEqual(a.permissions[ii], destination))
+				{
+					permitted = true;
+					break;
+				}
+			}
+
+			if (!permitted)
+			{
+				a.permissions[a.nextPermission] = destination;
+				a.nextPermission = (a.nextPermission + 1) % c_relayMaxPermissions;
+				if (a.npermissions < c_relayMaxPermissions)
+				{
+					++a.npermissions;
+				}
+			}
+
+			PlatformSocketAddr to;
+			addressFrom(&to, destination, destinationPort);
+
+			ConstBuffer b;
+			b.p = dg.p + offset;
+			b.len = dg.len - offset;
+			return socketSendTo(a.s, &b, 1, to);
+		}
+
+		void processRelayed(uint32_t index)
+		{
+			Allocation& a = allocs[index];
+
+			uint64_t sent = 0;
+			for (;;)
+			{
+				const uint32_t nreceived = socketRecvBatch(a.s, dgs, c_relayBatchSize);
+				for (uint32_t ii = 0; ii < nreceived; ++ii)
+				{
+					const Datagram& dg = dgs[ii];
+
+					Address from;
+					uint16_t fromPort;
+					addressTo(&from, &fromPort, dg.addr);
+
+					bool permitted = false;
+					for (uint32_t jj = 0; jj < a.npermissions; ++jj)
+					{
+						if (addressIsEqual(a.permissions[jj], from))
+						{
+							permitted = true;
+							break;
+						}
+					}
+
+					if (!permitted)
+						continue;
+
+					// header and payload are gathered straight from the receive slot
+					uint8_t header[c_relayDataHeaderMaxSize];
+					ConstBuffer b[2];
+					b[0].p = header;
+					b[0].len = relayGenerateDataHeader(header, from, fromPort);
+					b[1].p = dg.p;
+					b[1].len = dg.len;
+					if (b[0].len && socketSendTo(s, b, 2, a.client))
+					{
+						++sent;
+					}
+				}
+
+				if (nreceived < c_relayBatchSize)
+					break;
+			}
+
+			if (sent)
+			{
+				relayed.fetch_add(sent, std::memory_order_relaxed);
+			}
+		}
+
+		void expireAllocations(uint64_t now)
+		{
+			for (size_t ii = 0; ii < allocs.size(); )
+			{
+				if (now < allocs[ii].expiresAt)
+				{
+					++ii;
+					continue;
+				}
+
+				removeAllocation(ii);
+			}
+		}
+
+		// close allocation `index', the last allocation takes its place
+		void removeAllocation(size_t index)
+		{
+			socketClose(allocs[index].s);
+			byToken.erase(allocs[index].token);
+
+			const size_t last = allocs.size() - 1;
+			if (index != last)
+			{
+				allocs[index] = allocs[last];
+				sockets[1 + index] = sockets[1 + last];
+				byToken[allocs[index].token] = static_cast<uint32_t>(index);
+			}
+
+			allocs.pop_back();
+			sockets.pop_back();
+			nallocations.store(static_cast<uint32_t>(allocs.size()), std::memory_order_relaxed);
+		}
+
+		Socket s;
+		uint16_t bePort;
+		Address bindAddr;
+		Address publicAddr;
+		std::vector<uint8_t> key;
+		uint64_t timeFreqMS;
+		CryptoRandSource rand;
+		uint8_t cookieSecret[hmac_sha1_state::DIGEST_SIZE];
+
+		// worker state
+		std::vector<Allocation> allocs;
+		std::vector<Socket> sockets; // control socket followed by one per allocation
+		std::unique_ptr<bool[]> readable;
+		std::unordered_map<uint64_t, uint32_t> byToken;
+		std::vector<uint8_t> storage;
+		Datagram dgs[c_relayBatchSize];
+
+		std::atomic<bool> quit;
+		std::atomic<uint32_t> nallocations;
+		std::atomic<uint64_t> relayed;
+		std::thread worker;
+	};
+}
+
+IRelayServer* peer::relayServerCreate(const Address& bindAddr, const Address& publicAddr, uint16_t port, const uint8_t* key, uint32_t nkey)
+{
+	RelayServer* server = new RelayServer;
+	if (!server->create(bindAddr, publicAddr, port, key, nkey))
+	{
+		server->destroy();
+		return nullptr;
+	}
+
+	return server;
+}
+
+#else
+IRelayServer* peer::relayServerCreate(const net::Address& /*bindAddr*/, const net::Address& /*publicAddr*/, uint16_t /*port*/, const uint8_t* /*key*/, uint32_t /*nkey*/)
+{
+	return nullptr;
+}
+#endif // TINY_PEER_ENABLE_ICE
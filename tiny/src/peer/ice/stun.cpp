@@ -165,6 +165,38 @@ bool peer::stunMatchesTransactionId(const uint8_t a[20], const uint8_t b[20])
 	return 0 == memcmp(&a[8], &b[8], 12);
 }
 
+uint32_t peer::stunGenerateServerResponse(uint8_t out[c_stunServerResponseMaxSize], const uint8_t* request, uint32_t nrequest, const Address& addr, uint16_t bePort)
+{
+	if (!stunIsBindingRequest(request, static_cast<int>(nrequest)))
+		return 0;
+
+	uint16_t messageLength;
+	memcpy(&messageLength, &request[2], sizeof(messageLength));
+	messageLength = endianFromBig(messageLength);
+	if (nrequest != 20u+messageLength)
+		return 0;
+
+	uint8_t* attr;
+	switch (addr.family)
+	{
+	case AddressFamily::IPv4:
+		attr = stunGenerateBindingResponse(out, 12+8, request);
+		attr = stunAppendXorMappedAddress12(attr, bePort, addr.u.v4, out);
+		break;
+
+	case AddressFamily::IPv6:
+		attr = stunGenerateBindingResponse(out, 24+8, request);
+		attr = stunAppendXorMappedAddress24(attr, bePort, addr.u.v6, out);
+		break;
+
+	default:
+		return 0;
+	}
+
+	attr = stunAppendFingerprint8(attr, out);
+	return static_cast<uint32_t>(attr - out);
+}
+
 bool peer::stunIsBindingRequest(const uint8_t* packet, int npacket)
 {
 	if (npacket < 20)
@@ -238,6 +270,8 @@ bool peer::stunProcessBindingRequest(StunBindingRequest* req, const uint8_t* pac
 			memcpy(&req->targetUsername, &attribute[8], sizeof(req->targetUsername));
 			req->incomingUsername = endianFromBig(req->incomingUsername);
 			req->targetUsername = endianFromBig(req->targetUsername);
+			if (req->expectedTarget != 0 && req->targetUsername != req->expectedTarget)
+				return false;
 			break;
 
 		case 0x0008: // MESSAGE-INTEGRITY
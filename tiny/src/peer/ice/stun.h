@@ -41,6 +41,9 @@ namespace tiny
 			const uint8_t* hmacKey;
 			uint64_t incomingUsername;
 			uint64_t targetUsername;
+			// if not 0, requests for another target are rejected before
+			// the MAC is computed
+			uint64_t expectedTarget;
 			uint64_t controllingTiebreaker;
 			uint32_t nhmacKey;
 			uint32_t priority;
@@ -65,6 +68,12 @@ namespace tiny
 		uint8_t* stunAppendXorMappedAddress24(uint8_t* nextAttribute, uint16_t bePort, const net::Address6& addr, const uint8_t* packet);
 		uint8_t* stunAppendFingerprint8(uint8_t* nextAttribute, const uint8_t* packetStart);
 
+		// build the response of a standalone STUN server to `request' from
+		// `addr':`bePort'. stateless; returns the size of the response in
+		// `out' or 0 if `request' is not a well-formed binding request
+		static const uint32_t c_stunServerResponseMaxSize = 20+32;
+		uint32_t stunGenerateServerResponse(uint8_t out[c_stunServerResponseMaxSize], const uint8_t* request, uint32_t nrequest, const net::Address& addr, uint16_t bePort);
+
 		void stunGenerateNewTransactionId(crypto::CryptoRandSource& rand, uint8_t packet[20]);
 		bool stunMatchesTransactionId(const uint8_t a[20], const uint8_t b[20]);
 
@@ -0,0 +1,193 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "peer/config.h"
+#include "tiny/peer/stunserver.h"
+
+using namespace tiny;
+using namespace tiny::peer;
+
+IStunServer::~IStunServer()
+{
+}
+
+#if TINY_PEER_ENABLE_ICE
+
+#include <stdint.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "peer/ice/stun.h"
+#include "tiny/endian.h"
+#include "tiny/net/address.h"
+#include "tiny/net/socket.h"
+
+using namespace tiny::net;
+
+// Datagrams read per receive batch
+static const uint32_t c_stunServerBatchSize = 32;
+// Largest request accepted
+static const uint32_t c_stunServerRequestSize = 548;
+// Interval at which idle workers check for shutdown
+static const uint32_t c_stunServerWaitMS = 100;
+
+namespace
+{
+	class StunBindingServer : public IStunServer
+	{
+	public:
+		StunBindingServer()
+			: s(InvalidSocket)
+			, quit(false)
+			, responses(0)
+		{
+		}
+
+		~StunBindingServer()
+		{
+			quit.store(true, std::memory_order_release);
+			for (size_t ii = 0, nn = workers.size(); ii != nn; ++ii)
+			{
+				workers[ii].join();
+			}
+
+			if (s != InvalidSocket)
+			{
+				socketClose(s);
+			}
+		}
+
+		bool create(const Address& addr, uint16_t port, uint32_t nthreads)
+		{
+			bePort = endianToBig(port);
+			if (!socketCreateUDP(&s, addr, &bePort))
+			{
+				s = InvalidSocket;
+				return false;
+			}
+
+			if (nthreads == 0)
+			{
+				nthreads = 1;
+			}
+
+			workers.reserve(nthreads);
+			for (uint32_t ii = 0; ii < nthreads; ++ii)
+			{
+				workers.push_back(std::thread(&StunBindingServer::run, this));
+			}
+
+			return true;
+		}
+
+		virtual void destroy()
+		{
+			delete this;
+		}
+
+		virtual uint16_t port()
+		{
+			return endianFromBig(bePort);
+		}
+
+		virtual uint64_t responsesSent()
+		{
+			return responses.load(std::memory_order_relaxed);
+		}
+
+	private:
+		void run()
+		{
+			std::vector<uint8_t> storage(c_stunServerBatchSize * c_stunServerRequestSize);
+			Datagram dgs[c_stunServerBatchSize];
+			for (uint32_t ii = 0; ii < c_stunServerBatchSize; ++ii)
+			{
+				dgs[ii].p = &storage[ii * c_stunServerRequestSize];
+				dgs[ii].capacity = c_stunServerRequestSize;
+			}
+
+			uint8_t response[c_stunServerResponseMaxSize];
+			while (!quit.load(std::memory_order_acquire))
+			{
+				if (!socketWaitReadable(s, c_stunServerWaitMS))
+					continue;
+
+				// another worker may have drained the socket already
+				const uint32_t nreceived = socketRecvBatch(s, dgs, c_stunServerBatchSize);
+
+				uint64_t sent = 0;
+				for (uint32_t ii = 0; ii < nreceived; ++ii)
+				{
+					Address from;
+					uint16_t fromPort;
+					addressTo(&from, &fromPort, dgs[ii].addr);
+
+					const uint32_t nresponse = stunGenerateServerResponse(response, dgs[ii].p, dgs[ii].len, from, fromPort);
+					if (nresponse == 0)
+						continue;
+
+					ConstBuffer b;
+					b.p = response;
+					b.len = nresponse;
+					if (socketSendTo(s, &b, 1, dgs[ii].addr))
+					{
+						++sent;
+					}
+				}
+
+				if (sent)
+				{
+					responses.fetch_add(sent, std::memory_order_relaxed);
+				}
+			}
+		}
+
+		Socket s;
+		uint16_t bePort;
+		std::atomic<bool> quit;
+		std::atomic<uint64_t> responses;
+		std::vector<std::thread> workers;
+	};
+}
+
+IStunServer* peer::stunServerCreate(const Address& addr, uint16_t port, uint32_t nthreads)
+{
+	StunBindingServer* server = new StunBindingServer;
+	if (!server->create(addr, port, nthreads))
+	{
+		server->destroy();
+		return nullptr;
+	}
+
+	return server;
+}
+
+#else
+IStunServer* peer::stunServerCreate(const net::Address& /*addr*/, uint16_t /*port*/, uint32_t /*nthreads*/)
+{
+	return nullptr;
+}
+#endif // TINY_PEER_ENABLE_ICE
@@ -0,0 +1,79 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "peer/sharded/address.h"
+#include "tiny/endian.h"
+
+using namespace tiny;
+using namespace tiny::peer;
+
+bool peer::shardedAddressSelect(const uint8_t** address, uint32_t* naddress, uint64_t localId)
+{
+	const uint8_t* p = *address;
+	uint32_t n = *naddress;
+
+	// plain addresses start with a non-zero candidate count, or are a
+	// lone zero count
+	if (n <= 1 || p[0] != c_shardedAddressMagic[0])
+		return true;
+
+	if (n < c_shardedAddressHeader || 0 != memcmp(p, c_shardedAddressMagic, sizeof(c_shardedAddressMagic)))
+		return false;
+
+	const uint8_t nshards = p[sizeof(c_shardedAddressMagic)];
+	if (nshards == 0)
+		return false;
+
+	const uint32_t shard = shardForPeer(localId, nshards);
+	p += c_shardedAddressHeader;
+	n -= c_shardedAddressHeader;
+
+	for (uint32_t ii = 0; ; ++ii)
+	{
+		if (n < c_shardedAddressBlockHeader)
+			return false;
+
+		uint16_t blockLength;
+		memcpy(&blockLength, p, sizeof(blockLength));
+		blockLength = endianFromLittle(blockLength);
+		p += c_shardedAddressBlockHeader;
+		n -= c_shardedAddressBlockHeader;
+		if (blockLength > n)
+			return false;
+
+		if (ii == shard)
+		{
+			*address = p;
+			*naddress = blockLength;
+			return true;
+		}
+
+		p += blockLength;
+		n -= blockLength;
+	}
+}
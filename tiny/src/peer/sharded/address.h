@@ -0,0 +1,65 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TINY_SRC_PEER_SHARDED__ADDRESS_H
+#define TINY_SRC_PEER_SHARDED__ADDRESS_H
+
+#include <stdint.h>
+
+namespace tiny
+{
+	namespace peer
+	{
+		// a sharded mesh publishes one address block per shard:
+		//  [magic : 4][nshards] { [length : uint16_t little endian][address] } * nshards
+		// a remote peer is always hosted by shard `shardForPeer(remoteId)',
+		// so it connects to the address block at that index.
+		//
+		// the magic starts with a zero candidate count. a plain address
+		// with no candidates is exactly one byte, so a longer address
+		// starting with zero can't be a plain address. the last byte of
+		// the magic is the format version.
+		static const uint8_t c_shardedAddressMagic[4] = {0x00, 'S', 'H', 0x01};
+		static const uint32_t c_shardedAddressHeader = sizeof(c_shardedAddressMagic) + 1;
+		static const uint32_t c_shardedAddressBlockHeader = 2;
+
+		static inline uint32_t shardForPeer(uint64_t peerId, uint32_t nshards)
+		{
+			// fibonacci hash, ids are often sequential
+			const uint64_t h = peerId * 0x9E3779B97F4A7C15ull;
+			return static_cast<uint32_t>(h >> 32) % nshards;
+		}
+
+		// if `address' is a sharded address, narrow it to the block for the
+		// shard that hosts `localId'. plain addresses are left untouched.
+		// returns `false' if the address is malformed, including an
+		// address that starts like a sharded address with an unknown magic
+		// or version.
+		bool shardedAddressSelect(const uint8_t** address, uint32_t* naddress, uint64_t localId);
+	}
+}
+
+#endif // TINY_SRC_PEER_SHARDED__ADDRESS_H
@@ -0,0 +1,985 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "peer/config.h"
+
+#if TINY_PEER_ENABLE_ICE
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "peer/sharded/address.h"
+#include "spscqueue.h"
+#include "tiny/endian.h"
+#include "tiny/net/engine.h"
+#include "tiny/net/packet.h"
+#include "tiny/peer/mesh.h"
+#include "tiny/peer/message.h"
+#include "tiny/peer/stats.h"
+#include "tiny/profile.h"
+#include "tiny/sleep.h"
+
+using namespace tiny;
+using namespace tiny::net;
+using namespace tiny::peer;
+
+static const uint32_t c_shardMaxShards = 64;
+// Largest payload carried through a shard queue
+static const uint32_t c_shardPacketSize = 1200;
+// Space reserved around queued payloads for the inner mesh's framing
+static const uint32_t c_shardPacketHeadroom = 16;
+static const uint32_t c_shardPacketTailroom = 48;
+// Packets queued between the application and each shard, per direction
+static const uint32_t c_shardQueueDepth = 256;
+// Longest a worker blocks without socket data or application work. only
+// bounds the inner mesh's timers (checks, keep-alives, timeouts)
+static const uint32_t c_shardIdleWaitMS = 5;
+
+namespace
+{
+	struct ShardPacket
+	{
+		uint32_t peer; // sharded peer id
+		uint32_t n;
+		uint8_t data[c_shardPacketHeadroom + c_shardPacketSize + c_shardPacketTailroom];
+	};
+
+	typedef SpscQueue<ShardPacket, c_shardQueueDepth> ShardQueue;
+
+	struct ShardCommandType
+	{
+		enum E
+		{
+			StartSession,
+			SetRelayServer,
+			SetSessionKey,
+			SetMediaEncryption,
+			EndSession,
+			Connect,
+			AddRemoteCandidates,
+			Disconnect,
+		};
+	};
+
+	// a control operation queued by the application for a worker. the
+	// worker applies them in order before its next update
+	struct ShardCommand
+	{
+		ShardCommandType::E type;
+		uint32_t peer; // sharded peer id
+		uint32_t generation; // session generation, StartSession and EndSession
+		uint64_t remoteId;
+		uint16_t port;
+		bool flag; // relay only, or media encryption
+		bool hasHost;
+		std::string host;
+		std::vector<std::string> stunHosts;
+		std::vector<uint16_t> stunPorts;
+		std::vector<uint8_t> data; // key or remote address
+	};
+
+	// inner connection backing a sharded peer. owned by the worker
+	struct ShardInnerPeer
+	{
+		uint32_t peer; // sharded peer id, 0 if unused
+		uint32_t innerPeer;
+	};
+
+	// a single ICE mesh running on its own worker thread. the application
+	// never touches `mesh' while the worker runs: control operations go
+	// through `commands', media through the lock-free `outgoing' and
+	// `incoming' queues, and state, stats and the local address come back
+	// as published snapshots. the locks below only guard a swap or a copy.
+	struct Shard
+	{
+		IMesh* mesh;
+		ISocketEngine* engine; // owned by `mesh'
+		std::thread worker;
+
+		std::mutex commandLock;
+		std::vector<ShardCommand> commands; // guarded by `commandLock'
+		std::atomic<bool> waiting; // worker is blocked in `engine->wait'
+
+		// [generation:24][MeshState::E:8] published by the worker once it
+		// applied the session command of that generation
+		std::atomic<uint32_t> state;
+		// [sharded peer id:56][PeerState::E:8] by sharded peer index
+		std::atomic<uint64_t> peerStates[256];
+
+		std::mutex statsLock;
+		MeshStats meshStats; // guarded by `statsLock'
+		PeerStats peerStats[256]; // by sharded peer index, guarded by `statsLock'
+		uint32_t peerStatsId[256]; // sharded peer id of `peerStats', guarded by `statsLock'
+
+		// the local address serialized from each candidate index, guarded
+		// by `addressLock'. `addressFrom[ii]' is `localAddressSizeFrom(ii)'
+		// bytes; empty until the session starts
+		std::mutex addressLock;
+		std::vector<std::vector<uint8_t> > addressFrom;
+
+		ShardQueue outgoing; // application -> worker
+		ShardQueue incoming; // worker -> application
+
+		// worker thread only
+		std::vector<ShardCommand> applying;
+		ShardInnerPeer innerPeers[256]; // by sharded peer index
+		uint32_t publishedCandidates;
+		uint32_t generation;
+		bool sessionFailed; // `startSession' of `generation' failed
+
+		// application thread only: items of `incoming' currently handed out
+		// as messages, and the message views themselves
+		uint32_t incomingHeld;
+		Message messages[c_shardQueueDepth];
+	};
+
+	struct ShardedPeer
+	{
+		std::vector<Message*> incoming;
+		uint64_t id;
+		uint32_t sequence;
+		uint8_t shard;
+		bool active;
+	};
+
+	static inline uint64_t shardPeerState(uint32_t peer, PeerState::E state)
+	{
+		return (static_cast<uint64_t>(peer) << 8) | static_cast<uint8_t>(state);
+	}
+
+	static ShardInnerPeer* shardInnerPeer(Shard* shard, uint32_t peer)
+	{
+		ShardInnerPeer* ip = &shard->innerPeers[peer & 0xFF];
+		return (ip->peer == peer) ? ip : nullptr;
+	}
+
+	static void shardApplyCommand(Shard* shard, const ShardCommand& cmd)
+	{
+		IMesh* mesh = shard->mesh;
+		switch (cmd.type)
+		{
+		case ShardCommandType::StartSession:
+			{
+				std::vector<StunServer> servers(cmd.stunHosts.size());
+				for (size_t ii = 0, nn = servers.size(); ii != nn; ++ii)
+				{
+					servers[ii].host = cmd.stunHosts[ii].c_str();
+					servers[ii].port = cmd.stunPorts[ii];
+				}
+
+				shard->generation = cmd.generation;
+				shard->sessionFailed = !mesh->startSession(servers.data(), static_cast<uint32_t>(servers.size()));
+			}
+			break;
+
+		case ShardCommandType::SetRelayServer:
+			mesh->setRelayServer(cmd.hasHost ? cmd.host.c_str() : nullptr, cmd.port, cmd.data.data(), static_cast<uint32_t>(cmd.data.size()), cmd.flag);
+			break;
+
+		case ShardCommandType::SetSessionKey:
+			mesh->setSessionKey(cmd.data.data(), static_cast<int>(cmd.data.size()));
+			break;
+
+		case ShardCommandType::SetMediaEncryption:
+			mesh->setMediaEncryption(cmd.flag);
+			break;
+
+		case ShardCommandType::EndSession:
+			shard->generation = cmd.generation;
+			shard->sessionFailed = false;
+			mesh->endSession();
+			break;
+
+		case ShardCommandType::Connect:
+			{
+				ShardInnerPeer* ip = &shard->innerPeers[cmd.peer & 0xFF];
+				ip->innerPeer = mesh->connectToPeer(cmd.remoteId, cmd.data.data(), static_cast<uint32_t>(cmd.data.size()));
+				if (ip->innerPeer == InvalidMeshPeer)
+				{
+					ip->peer = 0;
+					shard->peerStates[cmd.peer & 0xFF].store(shardPeerState(cmd.peer, PeerState::Invalid), std::memory_order_release);
+				}
+				else
+				{
+					ip->peer = cmd.peer;
+				}
+			}
+			break;
+
+		case ShardCommandType::AddRemoteCandidates:
+			if (ShardInnerPeer* ip = shardInnerPeer(shard, cmd.peer))
+			{
+				mesh->addRemoteCandidates(ip->innerPeer, cmd.data.data(), static_cast<uint32_t>(cmd.data.size()));
+			}
+			break;
+
+		case ShardCommandType::Disconnect:
+			if (ShardInnerPeer* ip = shardInnerPeer(shard, cmd.peer))
+			{
+				mesh->disconnectPeer(ip->innerPeer);
+				ip->peer = 0;
+			}
+			break;
+		}
+	}
+
+	// publish the local address when candidates were gathered or the
+	// session changed
+	static void shardPublishAddress(Shard* shard, bool force)
+	{
+		const uint32_t count = shard->mesh->localCandidateCount();
+		if (!force && count == shard->publishedCandidates)
+			return;
+
+		std::vector<std::vector<uint8_t> > addressFrom(count ? count + 1 : 0);
+		for (uint32_t ii = 0, nn = static_cast<uint32_t>(addressFrom.size()); ii < nn; ++ii)
+		{
+			addressFrom[ii].resize(shard->mesh->localAddressSizeFrom(ii));
+			if (!addressFrom[ii].empty())
+			{
+				shard->mesh->serializeLocalAddressFrom(ii, addressFrom[ii].data());
+			}
+		}
+
+		{
+			std::unique_lock<std::mutex> l(shard->addressLock);
+			shard->addressFrom.swap(addressFrom);
+		}
+		shard->publishedCandidates = count;
+	}
+
+	static void shardPublishStats(Shard* shard)
+	{
+		MeshStats meshStats;
+		shard->mesh->meshStats(&meshStats);
+
+		std::unique_lock<std::mutex> l(shard->statsLock);
+		shard->meshStats = meshStats;
+		for (uint32_t ii = 0; ii < 256; ++ii)
+		{
+			const ShardInnerPeer* ip = &shard->innerPeers[ii];
+			if (ip->peer && shard->mesh->peerStats(ip->innerPeer, &shard->peerStats[ii]))
+			{
+				shard->peerStatsId[ii] = ip->peer;
+			}
+		}
+	}
+
+	static void shardWorker(Shard* shard, uint32_t index, const std::atomic<bool>* quit)
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "mesh shard %u", index);
+		profileThreadName(name);
+
+		while (!quit->load(std::memory_order_acquire))
+		{
+			bool busy = false;
+
+			// apply queued control operations
+			{
+				std::unique_lock<std::mutex> l(shard->commandLock);
+				shard->applying.swap(shard->commands);
+			}
+			for (size_t ii = 0, nn = shard->applying.size(); ii != nn; ++ii)
+			{
+				shardApplyCommand(shard, shard->applying[ii]);
+			}
+			const bool applied = !shard->applying.empty();
+			shard->applying.clear();
+			busy = applied;
+
+			// forward queued application packets. the inner mesh frames
+			// them in place inside the queue slot
+			const uint32_t noutgoing = shard->outgoing.size();
+			for (uint32_t ii = 0; ii < noutgoing; ++ii)
+			{
+				ShardPacket* pkt = shard->outgoing.peek(ii);
+				const ShardInnerPeer* ip = shardInnerPeer(shard, pkt->peer);
+				if (!ip)
+					continue;
+
+				PacketBuffer pb;
+				packetInit(&pb, pkt->data, sizeof(pkt->data), c_shardPacketHeadroom, c_shardPacketTailroom);
+				packetCommit(&pb, pkt->n);
+				shard->mesh->sendUnreliablePacketToPeer(ip->innerPeer, &pb);
+			}
+			shard->outgoing.pop(noutgoing);
+			busy |= (noutgoing != 0);
+
+			MeshState::E state = shard->mesh->update();
+			if (state == MeshState::StartComplete)
+			{
+				state = MeshState::Running;
+			}
+			else if (shard->sessionFailed)
+			{
+				state = MeshState::Invalid;
+			}
+			shard->state.store((shard->generation << 8) | state, std::memory_order_release);
+
+			// publish peer state and received media
+			for (uint32_t ii = 0; ii < 256; ++ii)
+			{
+				const ShardInnerPeer* ip = &shard->innerPeers[ii];
+				if (!ip->peer)
+					continue;
+
+				shard->peerStates[ii].store(shardPeerState(ip->peer, shard->mesh->peerState(ip->innerPeer)), std::memory_order_release);
+
+				Message** messages;
+				uint32_t nmessages;
+				if (shard->mesh->receive(ip->innerPeer, &messages, &nmessages))
+				{
+					for (uint32_t jj = 0; jj < nmessages; ++jj)
+					{
+						if (messages[jj]->ndata > c_shardPacketSize)
+							continue;
+
+						// application isn't keeping up, drop
+						ShardPacket* pkt = shard->incoming.beginPush();
+						if (!pkt)
+							break;
+
+						pkt->peer = ip->peer;
+						pkt->n = messages[jj]->ndata;
+						memcpy(pkt->data, messages[jj]->data, messages[jj]->ndata);
+						shard->incoming.commitPush();
+					}
+
+					busy = true;
+				}
+			}
+
+			shardPublishAddress(shard, applied);
+			shardPublishStats(shard);
+
+			if (!busy)
+			{
+				// block on the sockets. the application wakes the engine
+				// when it queues work while `waiting' is set
+				shard->waiting.store(true, std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				if (shard->outgoing.size() == 0)
+				{
+					bool pending;
+					{
+						std::unique_lock<std::mutex> l(shard->commandLock);
+						pending = !shard->commands.empty();
+					}
+					if (!pending && !quit->load(std::memory_order_acquire))
+					{
+						shard->engine->wait(c_shardIdleWaitMS);
+					}
+				}
+				shard->waiting.store(false, std::memory_order_relaxed);
+			}
+		}
+	}
+
+	class MeshSharded : public IMesh
+	{
+	public:
+		MeshSharded()
+			: quit(false)
+			, sessionStarted(false)
+			, started(false)
+			, localId(0)
+			, peerSequence(1)
+			, generation(0)
+		{
+		}
+
+		~MeshSharded()
+		{
+			quit.store(true, std::memory_order_release);
+			for (size_t ii = 0, nn = shards.size(); ii != nn; ++ii)
+			{
+				Shard* shard = shards[ii];
+				if (shard->worker.joinable())
+				{
+					shard->engine->wake();
+					shard->worker.join();
+				}
+				if (shard->mesh)
+				{
+					shard->mesh->destroy();
+				}
+				delete shard;
+			}
+		}
+
+		bool create(uint32_t nshards, uint32_t maxPeers, uint64_t localId, uint16_t port, SocketEngineType::E engineType)
+		{
+			if (nshards == 0 || nshards > c_shardMaxShards || maxPeers > 0xff)
+			{
+				return false;
+			}
+
+			this->localId = localId;
+			this->peers.resize(maxPeers);
+			for (size_t ii = 0, nn = maxPeers; ii != nn; ++ii)
+			{
+				this->peers[ii].active = false;
+				this->peers[ii].sequence = 0;
+			}
+
+			// every shard can host all peers, the partition is by remote id
+			// and need not be even
+			this->shards.reserve(nshards);
+			for (uint32_t ii = 0; ii < nshards; ++ii)
+			{
+				Shard* shard = new Shard;
+				shard->mesh = nullptr;
+				shard->waiting.store(false);
+				shard->state.store(MeshState::Created);
+				memset(&shard->meshStats, 0, sizeof(shard->meshStats));
+				shard->publishedCandidates = 0;
+				shard->generation = 0;
+				shard->sessionFailed = false;
+				shard->incomingHeld = 0;
+				for (uint32_t jj = 0; jj < 256; ++jj)
+				{
+					shard->peerStates[jj].store(shardPeerState(0, PeerState::Invalid));
+					shard->peerStatsId[jj] = 0;
+					shard->innerPeers[jj].peer = 0;
+				}
+				this->shards.push_back(shard);
+
+				const uint16_t shardPort = port ? static_cast<uint16_t>(port + ii) : 0;
+				shard->engine = socketEngineCreate(engineType);
+				shard->mesh = meshCreateICE(maxPeers, localId, shardPort, shard->engine);
+				if (!shard->mesh)
+				{
+					return false;
+				}
+			}
+
+			for (size_t ii = 0, nn = shards.size(); ii != nn; ++ii)
+			{
+				shards[ii]->worker = std::thread(shardWorker, shards[ii], static_cast<uint32_t>(ii), &quit);
+			}
+
+			return true;
+		}
+
+		virtual void destroy()
+		{
+			delete this;
+		}
+
+		virtual MeshState::E update()
+		{
+			// the application is done with the previous update's messages,
+			// return their queue slots to the workers
+			for (size_t ii = 0, nn = peers.size(); ii != nn; ++ii)
+			{
+				peers[ii].incoming.clear();
+			}
+
+			bool anyInvalid = false;
+			bool allRunning = true;
+			for (size_t ii = 0, nn = shards.size(); ii != nn; ++ii)
+			{
+				Shard* shard = shards[ii];
+				shard->incoming.pop(shard->incomingHeld);
+
+				const uint32_t nincoming = shard->incoming.size();
+				for (uint32_t jj = 0; jj < nincoming; ++jj)
+				{
+					ShardPacket* pkt = shard->incoming.peek(jj);
+					ShardedPeer* p = findPeer(pkt->peer);
+					if (!p)
+						continue;
+
+					Message* msg = &shard->messages[jj];
+					msg->data = pkt->data;
+					msg->ndata = pkt->n;
+					p->incoming.push_back(msg);
+				}
+				shard->incomingHeld = nincoming;
+
+				// a worker that hasn't applied the latest session command
+				// yet is still starting
+				const uint32_t state = shard->state.load(std::memory_order_acquire);
+				if ((state >> 8) != generation)
+				{
+					allRunning = false;
+					continue;
+				}
+
+				switch (state & 0xFF)
+				{
+				case MeshState::Invalid:
+					anyInvalid = true;
+					// fallthrough
+				case MeshState::Created:
+				case MeshState::Starting:
+					allRunning = false;
+					break;
+				}
+			}
+
+			if (anyInvalid)
+			{
+				return MeshState::Invalid;
+			}
+
+			if (!sessionStarted)
+			{
+				return MeshState::Created;
+			}
+
+			if (!allRunning)
+			{
+				return MeshState::Starting;
+			}
+
+			if (!started)
+			{
+				started = true;
+				return MeshState::StartComplete;
+			}
+
+			return MeshState::Running;
+		}
+
+		virtual bool startSession(const char* stunHost, uint16_t stunPort)
+		{
+			StunServer server;
+			server.host = stunHost;
+			server.port = stunPort;
+			return startSession(&server, stunHost ? 1 : 0);
+		}
+
+		virtual bool startSession(const StunServer* servers, uint32_t nservers)
+		{
+			// workers start their sessions asynchronously, a shard that
+			// fails to start reports `MeshState::Invalid' from `update'
+			generation = (generation + 1) & 0xFFFFFF;
+
+			ShardCommand cmd = command(ShardCommandType::StartSession);
+			cmd.generation = generation;
+			for (uint32_t ii = 0; ii < nservers; ++ii)
+			{
+				cmd.stunHosts.push_back(servers[ii].host ? servers[ii].host : "");
+				cmd.stunPorts.push_back(servers[ii].port);
+			}
+			pushAll(cmd);
+
+			sessionStarted = true;
+			started = false;
+			return true;
+		}
+
+		virtual void setRelayServer(const char* host, uint16_t port, const uint8_t* key, uint32_t nkey, bool relayOnly)
+		{
+			// every shard allocates its own relayed address
+			ShardCommand cmd = command(ShardCommandType::SetRelayServer);
+			cmd.hasHost = (host != nullptr);
+			cmd.host = host ? host : "";
+			cmd.port = port;
+			cmd.flag = relayOnly;
+			cmd.data.assign(key, key + nkey);
+			pushAll(cmd);
+		}
+
+		virtual void setSessionKey(const uint8_t* key, int nkey)
+		{
+			ShardCommand cmd = command(ShardCommandType::SetSessionKey);
+			cmd.data.assign(key, key + nkey);
+			pushAll(cmd);
+		}
+
+		virtual void setMediaEncryption(bool encrypt)
+		{
+			ShardCommand cmd = command(ShardCommandType::SetMediaEncryption);
+			cmd.flag = encrypt;
+			pushAll(cmd);
+		}
+
+		virtual void endSession()
+		{
+			generation = (generation + 1) & 0xFFFFFF;
+
+			ShardCommand cmd = command(ShardCommandType::EndSession);
+			cmd.generation = generation;
+			pushAll(cmd);
+
+			sessionStarted = false;
+			started = false;
+		}
+
+		virtual uint32_t localAddressSize()
+		{
+			return localAddressSizeFrom(0);
+		}
+
+		virtual void serializeLocalAddress(uint8_t* out)
+		{
+			serializeLocalAddressFrom(0, out);
+		}
+
+		virtual uint32_t localCandidateCount()
+		{
+			// shards gather independently. report the smallest count so a
+			// trickle from it resends, rather than skips, candidates of
+			// shards that are further along; the remote drops duplicates
+			uint32_t count = 0xFFFFFFFF;
+			for (size_t ii = 0, nn = shards.size(); ii != nn; ++ii)
+			{
+				std::unique_lock<std::mutex> l(shards[ii]->addressLock);
+				const size_t published = shards[ii]->addressFrom.size();
+				count = std::min(count, published ? static_cast<uint32_t>(published - 1) : 0);
+			}
+
+			return count;
+		}
+
+		virtual uint32_t localAddressSizeFrom(uint32_t first)
+		{
+			// workers keep gathering candidates concurrently, so snapshot the
+			// address here and hand out exactly this snapshot from
+			// `serializeLocalAddressFrom'
+			address.resize(c_shardedAddressHeader);
+			memcpy(address.data(), c_shardedAddressMagic, sizeof(c_shardedAddressMagic));
+			address[sizeof(c_shardedAddressMagic)] = static_cast<uint8_t>(shards.size());
+
+			for (size_t ii = 0, nn = shards.size(); ii != nn; ++ii)
+			{
+				std::unique_lock<std::mutex> l(shards[ii]->addressLock);
+				const std::vector<std::vector<uint8_t> >& from = shards[ii]->addressFrom;
+				if (from.empty())
+				{
+					address.clear();
+					return 0;
+				}
+
+				// candidates past the last one serialize like the last one
+				const std::vector<uint8_t>& block = from[std::min<size_t>(first, from.size() - 1)];
+				if (block.empty() || block.size() > 0xFFFF)
+				{
+					address.clear();
+					return 0;
+				}
+
+				const size_t offset = address.size();
+				address.resize(offset + c_shardedAddressBlockHeader + block.size());
+
+				const uint16_t leSize = endianToLittle(static_cast<uint16_t>(block.size()));
+				memcpy(&address[offset], &leSize, sizeof(leSize));
+				memcpy(&address[offset + c_shardedAddressBlockHeader], block.data(), block.size());
+			}
+
+			return static_cast<uint32_t>(address.size());
+		}
+
+		virtual void serializeLocalAddressFrom(uint32_t /*first*/, uint8_t* out)
+		{
+			memcpy(out, address.data(), address.size());
+		}
+
+		virtual uint32_t connectToPeer(uint64_t remoteId, const uint8_t* remoteAddress, uint32_t nremoteAddress)
+		{
+			if (!sessionStarted || remoteId == localId || nremoteAddress == 0)
+				return InvalidMeshPeer;
+
+			// catch malformed addresses here, the worker connects later
+			const uint8_t* selected = remoteAddress;
+			uint32_t nselected = nremoteAddress;
+			if (!shardedAddressSelect(&selected, &nselected, localId) || nselected == 0)
+				return InvalidMeshPeer;
+
+			uint32_t index = InvalidMeshPeer;
+			for (size_t ii = 0, nn = peers.size(); ii != nn; ++ii)
+			{
+				if (!peers[ii].active)
+				{
+					if (index == InvalidMeshPeer)
+					{
+						index = static_cast<uint8_t>(ii);
+					}
+				}
+				else if (peers[ii].id == remoteId)
+				{
+					return InvalidMeshPeer;
+				}
+			}
+			if (index == InvalidMeshPeer)
+				return InvalidMeshPeer;
+
+			const uint8_t shardIndex = static_cast<uint8_t>(shardForPeer(remoteId, static_cast<uint32_t>(shards.size())));
+
+			ShardedPeer* p = &peers[index];
+			p->id = remoteId;
+			p->shard = shardIndex;
+			p->active = true;
+			p->sequence = index|(peerSequence << 8);
+			++peerSequence;
+
+			// the worker reports `PeerState::Invalid' if the inner mesh
+			// rejects the connection
+			ShardCommand cmd = command(ShardCommandType::Connect);
+			cmd.peer = p->sequence;
+			cmd.remoteId = remoteId;
+			cmd.data.assign(remoteAddress, remoteAddress + nremoteAddress);
+			push(shards[shardIndex], cmd);
+			return p->sequence;
+		}
+
+		virtual bool addRemoteCandidates(uint32_t peerId, const uint8_t* remoteAddress, uint32_t nremoteAddress)
+		{
+			ShardedPeer* p = findPeer(peerId);
+			if (!p || peerState(peerId) != PeerState::Negotiating)
+				return false;
+
+			const uint8_t* selected = remoteAddress;
+			uint32_t nselected = nremoteAddress;
+			if (!shardedAddressSelect(&selected, &nselected, localId) || nselected == 0)
+				return false;
+
+			ShardCommand cmd = command(ShardCommandType::AddRemoteCandidates);
+			cmd.peer = peerId;
+			cmd.data.assign(remoteAddress, remoteAddress + nremoteAddress);
+			push(shards[p->shard], cmd);
+			return true;
+		}
+
+		virtual void disconnectPeer(uint32_t peerId)
+		{
+			ShardedPeer* p = findPeer(peerId);
+			if (!p)
+				return;
+
+			ShardCommand cmd = command(ShardCommandType::Disconnect);
+			cmd.peer = peerId;
+			push(shards[p->shard], cmd);
+
+			p->active = false;
+			p->incoming.clear();
+		}
+
+		virtual PeerState::E peerState(uint32_t peerId)
+		{
+			ShardedPeer* p = findPeer(peerId);
+			if (!p)
+				return PeerState::Invalid;
+
+			// until the worker applies the connect, the slot still holds the
+			// previous connection's state
+			const uint64_t state = shards[p->shard]->peerStates[peerId & 0xFF].load(std::memory_order_acquire);
+			if ((state >> 8) != peerId)
+				return PeerState::Negotiating;
+
+			return static_cast<PeerState::E>(state & 0xFF);
+		}
+
+		virtual void sendUnreliableDataToPeer(uint32_t peerId, const void* data, uint32_t n)
+		{
+			ShardedPeer* p = findPeer(peerId);
+			if (!p || n > c_shardPacketSize)
+				return;
+
+			// worker is behind, drop the packet
+			Shard* shard = shards[p->shard];
+			ShardPacket* pkt = shard->outgoing.beginPush();
+			if (!pkt)
+				return;
+
+			pkt->peer = peerId;
+			pkt->n = n;
+			memcpy(pkt->data + c_shardPacketHeadroom, data, n);
+			shard->outgoing.commitPush();
+			wakeWorker(shard);
+		}
+
+		virtual uint32_t packetHeadroom()
+		{
+			// packets are copied into the shard queues
+			return 0;
+		}
+
+		virtual uint32_t packetTailroom()
+		{
+			return 0;
+		}
+
+		virtual void sendUnreliablePacketToPeer(uint32_t peerId, PacketBuffer* packet)
+		{
+			sendUnreliableDataToPeer(peerId, packetData(*packet), packetSize(*packet));
+		}
+
+		virtual bool receive(uint32_t peerId, Message*** messages, uint32_t* nmessages)
+		{
+			ShardedPeer* p = findPeer(peerId);
+			if (!p || p->incoming.empty())
+				return false;
+
+			*messages = p->incoming.data();
+			*nmessages = static_cast<uint32_t>(p->incoming.size());
+			return true;
+		}
+
+		virtual bool peerStats(uint32_t peerId, PeerStats* stats)
+		{
+			ShardedPeer* p = findPeer(peerId);
+			if (!p)
+				return false;
+
+			// snapshot from the worker's last update. zero until the worker
+			// applied the connect
+			Shard* shard = shards[p->shard];
+			std::unique_lock<std::mutex> l(shard->statsLock);
+			if (shard->peerStatsId[peerId & 0xFF] == peerId)
+			{
+				*stats = shard->peerStats[peerId & 0xFF];
+			}
+			else
+			{
+				memset(stats, 0, sizeof(*stats));
+			}
+			return true;
+		}
+
+		virtual void meshStats(MeshStats* stats)
+		{
+			memset(stats, 0, sizeof(*stats));
+			for (size_t ii = 0, nn = shards.size(); ii != nn; ++ii)
+			{
+				MeshStats shardStats;
+				{
+					std::unique_lock<std::mutex> l(shards[ii]->statsLock);
+					shardStats = shards[ii]->meshStats;
+				}
+
+				stats->bytesIn += shardStats.bytesIn;
+				stats->bytesOut += shardStats.bytesOut;
+				stats->packetsIn += shardStats.packetsIn;
+				stats->packetsOut += shardStats.packetsOut;
+				stats->authFailures += shardStats.authFailures;
+				stats->unknownSourceDrops += shardStats.unknownSourceDrops;
+				stats->tagMismatches += shardStats.tagMismatches;
+				stats->mediaRateLimited += shardStats.mediaRateLimited;
+				stats->stunRateLimited += shardStats.stunRateLimited;
+				stats->unmatchedStunDrops += shardStats.unmatchedStunDrops;
+				stats->stunRequestsIn += shardStats.stunRequestsIn;
+				stats->stunResponsesIn += shardStats.stunResponsesIn;
+				stats->peersConnected += shardStats.peersConnected;
+				stats->peersNegotiating += shardStats.peersNegotiating;
+			}
+		}
+
+	private:
+		ShardedPeer* findPeer(uint32_t peerId)
+		{
+			const uint8_t index = static_cast<uint8_t>(peerId & 0xFF);
+			if (index >= peers.size())
+				return nullptr;
+
+			ShardedPeer* p = &peers[index];
+			if (!p->active || p->sequence != peerId)
+				return nullptr;
+
+			return p;
+		}
+
+		static ShardCommand command(ShardCommandType::E type)
+		{
+			ShardCommand cmd;
+			cmd.type = type;
+			cmd.peer = 0;
+			cmd.generation = 0;
+			cmd.remoteId = 0;
+			cmd.port = 0;
+			cmd.flag = false;
+			cmd.hasHost = false;
+			return cmd;
+		}
+
+		void push(Shard* shard, const ShardCommand& cmd)
+		{
+			{
+				std::unique_lock<std::mutex> l(shard->commandLock);
+				shard->commands.push_back(cmd);
+			}
+			wakeWorker(shard);
+		}
+
+		void pushAll(const ShardCommand& cmd)
+		{
+			for (size_t ii = 0, nn = shards.size(); ii != nn; ++ii)
+			{
+				push(shards[ii], cmd);
+			}
+		}
+
+		static void wakeWorker(Shard* shard)
+		{
+			// pairs with the fence between the worker storing `waiting' and
+			// checking for work; either it sees the work or we see it waiting
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (shard->waiting.load(std::memory_order_relaxed))
+			{
+				shard->engine->wake();
+			}
+		}
+
+		std::atomic<bool> quit;
+		bool sessionStarted;
+		bool started;
+		uint64_t localId;
+		uint32_t peerSequence;
+		uint32_t generation; // bumped by every start and end of a session
+
+		std::vector<Shard*> shards;
+		std::vector<ShardedPeer> peers;
+		std::vector<uint8_t> address;
+	};
+}
+
+IMesh* tiny::peer::meshCreateSharded(uint32_t shards, uint32_t maxPeers, uint64_t localId, uint16_t port, SocketEngineType::E engineType)
+{
+	MeshSharded* m = new MeshSharded;
+	if (!m->create(shards, maxPeers, localId, port, engineType))
+	{
+		m->destroy();
+		return nullptr;
+	}
+
+	return m;
+}
+
+#else
+tiny::peer::IMesh* tiny::peer::meshCreateSharded(uint32_t /*shards*/, uint32_t /*maxPeers*/, uint64_t /*localId*/, uint16_t /*port*/, tiny::net::SocketEngineType::E /*engineType*/)
+{
+	return nullptr;
+}
+#endif // TINY_PEER_ENABLE_ICE
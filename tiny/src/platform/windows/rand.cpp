@@ -26,6 +26,7 @@
 
 #include "tiny/platform.h"
 #include "tiny/crypto/rand.h"
+#include "crypto/randplatform.h"
 
 #if TINY_PLATFORM_WINDOWS
 
@@ -38,7 +39,7 @@ using namespace tiny::crypto;
 
 static_assert(sizeof(HCRYPTPROV) <= sizeof(void*), "WinCrypt provider handle will not reinterpret_cast into RandomGenerator::platformHandle");
 
-void crypto::crandInit(CryptoRandSource* s)
+void crypto::crandPlatformInit(CryptoRandSource* s)
 {
 	// attempt to use cryptographic provider
 	HCRYPTPROV crypto;
@@ -57,7 +58,7 @@ void crypto::crandInit(CryptoRandSource* s)
 	}
 }
 
-void crypto::crandDestroy(CryptoRandSource* s)
+void crypto::crandPlatformDestroy(CryptoRandSource* s)
 {
 	if (s->platformHandle)
 	{
@@ -66,7 +67,7 @@ void crypto::crandDestroy(CryptoRandSource* s)
 	}
 }
 
-void crypto::crandFill(CryptoRandSource* s, uint8_t* p, uint32_t n)
+void crypto::crandPlatformFill(CryptoRandSource* s, uint8_t* p, uint32_t n)
 {
 	if (!s->platformHandle || !CryptGenRandom(reinterpret_cast<HCRYPTPROV>(s->platformHandle), n, p))
 	{
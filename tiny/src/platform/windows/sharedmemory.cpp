@@ -0,0 +1,142 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "tiny/platform.h"
+#include "net/sharedmemory.h"
+
+using namespace tiny;
+using namespace tiny::net;
+
+#if TINY_PLATFORM_WINDOWS
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <string>
+
+// names are scoped to the login session
+static std::string localName(const char* name)
+{
+	return std::string("Local\\") + name;
+}
+
+namespace
+{
+	// security attributes granting access to the current user only. other
+	// processes of the login session can see the name, but not open it
+	struct UserOnlySecurity
+	{
+		UserOnlySecurity()
+			: valid(false)
+		{
+			HANDLE token;
+			if (!OpenProcessToken(GetCurrentProcess(), TOKEN_QUERY, &token))
+				return;
+
+			DWORD n = sizeof(tokenUser);
+			const BOOL haveUser = GetTokenInformation(token, TokenUser, tokenUser, n, &n);
+			CloseHandle(token);
+			if (!haveUser)
+				return;
+
+			PSID sid = reinterpret_cast<TOKEN_USER*>(tokenUser)->User.Sid;
+			if (!InitializeAcl(reinterpret_cast<ACL*>(acl), sizeof(acl), ACL_REVISION))
+				return;
+			if (!AddAccessAllowedAce(reinterpret_cast<ACL*>(acl), ACL_REVISION, GENERIC_ALL, sid))
+				return;
+			if (!InitializeSecurityDescriptor(&descriptor, SECURITY_DESCRIPTOR_REVISION))
+				return;
+			if (!SetSecurityDescriptorDacl(&descriptor, TRUE, reinterpret_cast<ACL*>(acl), FALSE))
+				return;
+
+			attributes.nLength = sizeof(attributes);
+			attributes.lpSecurityDescriptor = &descriptor;
+			attributes.bInheritHandle = FALSE;
+			valid = true;
+		}
+
+		DWORD tokenUser[(sizeof(TOKEN_USER) + SECURITY_MAX_SID_SIZE + sizeof(DWORD) - 1) / sizeof(DWORD)];
+		DWORD acl[(sizeof(ACL) + sizeof(ACCESS_ALLOWED_ACE) + SECURITY_MAX_SID_SIZE + sizeof(DWORD) - 1) / sizeof(DWORD)];
+		SECURITY_DESCRIPTOR descriptor;
+		SECURITY_ATTRIBUTES attributes;
+		bool valid;
+	};
+}
+
+void* net::sharedMemoryOpen(SharedHandle* handle, const char* name, uint32_t size)
+{
+	// never fall back to the default DACL, it may grant other accounts
+	// access to the mapping
+	UserOnlySecurity security;
+	if (!security.valid)
+		return nullptr;
+
+	// a new mapping of the page file is zero filled
+	HANDLE mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, &security.attributes, PAGE_READWRITE, 0, size, localName(name).c_str());
+	if (!mapping)
+		return nullptr;
+
+	void* p = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+	if (!p)
+	{
+		CloseHandle(mapping);
+		return nullptr;
+	}
+
+	*handle = reinterpret_cast<SharedHandle>(mapping);
+	return p;
+}
+
+void net::sharedMemoryClose(SharedHandle handle, void* p)
+{
+	UnmapViewOfFile(p);
+	CloseHandle(reinterpret_cast<HANDLE>(handle));
+}
+
+SharedHandle net::sharedEventOpen(const char* name)
+{
+	UserOnlySecurity security;
+	if (!security.valid)
+		return InvalidSharedHandle;
+
+	return reinterpret_cast<SharedHandle>(CreateEventA(&security.attributes, FALSE, FALSE, localName(name).c_str()));
+}
+
+void net::sharedEventClose(SharedHandle event)
+{
+	CloseHandle(reinterpret_cast<HANDLE>(event));
+}
+
+void net::sharedEventSignal(SharedHandle event)
+{
+	SetEvent(reinterpret_cast<HANDLE>(event));
+}
+
+bool net::sharedEventWait(SharedHandle event, uint32_t timeoutMS)
+{
+	return WAIT_OBJECT_0 == WaitForSingleObject(reinterpret_cast<HANDLE>(event), timeoutMS);
+}
+
+#endif // TINY_PLATFORM_WINDOWS
@@ -36,6 +36,7 @@ using namespace tiny::net;
 #include <Windows.h>
 #include <WinSock2.h>
 #include <WS2tcpip.h>
+#include <vector>
 #include "tiny/net/address.h"
 
 static_assert(sizeof(PlatformSocketAddr) >= sizeof(sockaddr_in ), "PlatformSocketAddr not large enough for IPv4 socket address");
@@ -145,11 +146,99 @@ int32_t net::socketRecvFrom(Socket s, uint8_t* buffer, int32_t nbuffer, Platform
 	return result;
 }
 
+uint32_t net::socketRecvBatch(Socket s, Datagram* datagrams, uint32_t ndatagrams)
+{
+	// winsock has no recvmmsg equivalent, drain the socket one datagram
+	// at a time directly into the caller's slots
+	uint32_t received = 0;
+	for (; received < ndatagrams; ++received)
+	{
+		Datagram* dg = &datagrams[received];
+
+		int addrLen = sizeof(dg->addr.storage);
+		int result = recvfrom(s, reinterpret_cast<char*>(dg->p), static_cast<int>(dg->capacity), 0, reinterpret_cast<sockaddr*>(&dg->addr.storage), &addrLen);
+		if (result < 0)
+			break;
+
+		dg->addr.size = static_cast<uint32_t>(addrLen);
+		dg->len = static_cast<uint32_t>(result);
+	}
+
+	return received;
+}
+
 bool net::socketOperationWouldHaveBlocked()
 {
 	return WSAGetLastError() == WSAEWOULDBLOCK;
 }
 
+bool net::socketWaitReadable(Socket s, uint32_t timeoutMS)
+{
+	WSAPOLLFD pfd;
+	pfd.fd = s;
+	pfd.events = POLLRDNORM;
+	pfd.revents = 0;
+	return WSAPoll(&pfd, 1, static_cast<INT>(timeoutMS)) > 0;
+}
+
+uint32_t net::socketWaitReadable(const Socket* s, bool* readable, uint32_t n, uint32_t timeoutMS)
+{
+	// reused between calls, the set of sockets rarely changes size
+	thread_local std::vector<WSAPOLLFD> pfds;
+	pfds.resize(n);
+	for (uint32_t ii = 0; ii < n; ++ii)
+	{
+		pfds[ii].fd = s[ii];
+		pfds[ii].events = POLLRDNORM;
+		pfds[ii].revents = 0;
+	}
+
+	const int result = WSAPoll(pfds.data(), n, static_cast<INT>(timeoutMS));
+	uint32_t nreadable = 0;
+	for (uint32_t ii = 0; ii < n; ++ii)
+	{
+		readable[ii] = result > 0 && (pfds[ii].revents & POLLRDNORM) != 0;
+		nreadable += readable[ii] ? 1 : 0;
+	}
+
+	return nreadable;
+}
+
+bool net::socketEventCreate(SocketEvent* out)
+{
+	WSAEVENT e = WSACreateEvent();
+	if (e == WSA_INVALID_EVENT)
+		return false;
+
+	*out = reinterpret_cast<SocketEvent>(e);
+	return true;
+}
+
+void net::socketEventDestroy(SocketEvent e)
+{
+	WSACloseEvent(reinterpret_cast<WSAEVENT>(e));
+}
+
+bool net::socketEventAttach(SocketEvent e, Socket s)
+{
+	// FD_READ is re-armed by every receive, so the event fires again if
+	// the socket isn't drained
+	return 0 == WSAEventSelect(s, reinterpret_cast<WSAEVENT>(e), FD_READ);
+}
+
+void net::socketEventSignal(SocketEvent e)
+{
+	WSASetEvent(reinterpret_cast<WSAEVENT>(e));
+}
+
+bool net::socketEventWait(SocketEvent e, uint32_t timeoutMS)
+{
+	WSAEVENT handle = reinterpret_cast<WSAEVENT>(e);
+	const DWORD result = WSAWaitForMultipleEvents(1, &handle, FALSE, timeoutMS, FALSE);
+	WSAResetEvent(handle);
+	return result == WSA_WAIT_EVENT_0;
+}
+
 void net::addressFrom(PlatformSocketAddr* out, const Address& addr, uint16_t bePort)
 {
 	memset(&out->storage, 0, sizeof(out->storage));
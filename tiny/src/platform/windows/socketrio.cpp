@@ -0,0 +1,487 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "tiny/platform.h"
+#include "tiny/net/engine.h"
+
+using namespace tiny;
+using namespace tiny::net;
+
+#if TINY_PLATFORM_WINDOWS
+
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <WinSock2.h>
+#include <WS2tcpip.h>
+#include <MSWSock.h>
+#include "tiny/net/adapter.h"
+
+static_assert(sizeof(PlatformSocketAddr::storage) >= sizeof(SOCKADDR_INET), "PlatformSocketAddr not large enough for SOCKADDR_INET");
+
+namespace
+{
+	static const uint32_t c_rioRecvSlots = 64; // receives kept posted per socket
+	static const uint32_t c_rioSendSlots = 64; // sends in flight per socket
+	static const uint32_t c_rioSlotSize = 1536;
+
+	// per-socket state. all buffers live in a single registered region:
+	//  [recv data][recv addresses][send data][send addresses]
+	struct RioSocket
+	{
+		SOCKET s;
+		RIO_RQ rq;
+		RIO_CQ recvCQ;
+		RIO_CQ sendCQ;
+		RIO_BUFFERID bufferId;
+		uint8_t* region;
+		uint32_t nregion;
+
+		// receive slots handed out by the last `recvBatch'. they are
+		// reposted to the kernel on the next call
+		uint32_t nrepost;
+		uint32_t repost[c_rioRecvSlots];
+
+		uint32_t nfreeSend;
+		uint32_t freeSend[c_rioSendSlots];
+		bool sendDeferred;
+	};
+
+	static const uint32_t c_recvDataOffset = 0;
+	static const uint32_t c_recvAddrOffset = c_recvDataOffset + c_rioRecvSlots*c_rioSlotSize;
+	static const uint32_t c_sendDataOffset = c_recvAddrOffset + c_rioRecvSlots*sizeof(SOCKADDR_INET);
+	static const uint32_t c_sendAddrOffset = c_sendDataOffset + c_rioSendSlots*c_rioSlotSize;
+	static const uint32_t c_regionSize = c_sendAddrOffset + c_rioSendSlots*sizeof(SOCKADDR_INET);
+
+	static inline RIO_BUF rioBuf(const RioSocket* rs, uint32_t offset, uint32_t length)
+	{
+		RIO_BUF b;
+		b.BufferId = rs->bufferId;
+		b.Offset = offset;
+		b.Length = length;
+		return b;
+	}
+
+	class RegisteredIOSocketEngine : public ISocketEngine
+	{
+	public:
+		explicit RegisteredIOSocketEngine(const RIO_EXTENSION_FUNCTION_TABLE& rio)
+			: rio(rio)
+			, batching(false)
+			, wouldBlock(false)
+		{
+			// auto-reset, armed per receive queue by `RIONotify'
+			recvEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+		}
+
+		~RegisteredIOSocketEngine()
+		{
+			while (!sockets.empty())
+			{
+				close(reinterpret_cast<Socket>(sockets.back()));
+			}
+
+			if (recvEvent)
+			{
+				CloseHandle(recvEvent);
+			}
+		}
+
+		virtual void release()
+		{
+			delete this;
+		}
+
+		virtual SocketEngineType::E type() const
+		{
+			return SocketEngineType::RegisteredIO;
+		}
+
+		virtual uint32_t adapters(Address* addresses, uint32_t naddresses)
+		{
+			return enumerateAdapters(addresses, naddresses);
+		}
+
+		virtual IClock* clock()
+		{
+			return clockPlatform();
+		}
+
+		virtual bool createUDP(Socket* out, const Address& addr, uint16_t* bePort)
+		{
+			int addressFamily;
+			switch (addr.family)
+			{
+			case AddressFamily::IPv4:
+				addressFamily = AF_INET;
+				break;
+
+			case AddressFamily::IPv6:
+				addressFamily = AF_INET6;
+				break;
+
+			default:
+				return false;
+			}
+
+			SOCKET s = WSASocket(addressFamily, SOCK_DGRAM, IPPROTO_UDP, nullptr, 0, WSA_FLAG_REGISTERED_IO);
+			if (s == INVALID_SOCKET)
+				return false;
+
+			const int exclusive = 1;
+			if (0 != setsockopt(s, SOL_SOCKET, SO_EXCLUSIVEADDRUSE, reinterpret_cast<const char*>(&exclusive), sizeof(exclusive)))
+			{
+				closesocket(s);
+				return false;
+			}
+
+			PlatformSocketAddr saddr;
+			addressFrom(&saddr, addr, *bePort);
+			if (0 != bind(s, reinterpret_cast<const sockaddr*>(&saddr.storage), saddr.size))
+			{
+				closesocket(s);
+				return false;
+			}
+
+			int addrLen = sizeof(saddr.storage);
+			if (0 != getsockname(s, reinterpret_cast<sockaddr*>(&saddr.storage), &addrLen))
+			{
+				closesocket(s);
+				return false;
+			}
+
+			Address boundAddr;
+			addressTo(&boundAddr, bePort, saddr);
+
+			RioSocket* rs = new RioSocket;
+			memset(rs, 0, sizeof(*rs));
+			rs->s = s;
+			rs->rq = RIO_INVALID_RQ;
+			rs->recvCQ = RIO_INVALID_CQ;
+			rs->sendCQ = RIO_INVALID_CQ;
+			rs->bufferId = RIO_INVALID_BUFFERID;
+
+			if (!setupQueues(rs))
+			{
+				destroySocket(rs);
+				return false;
+			}
+
+			sockets.push_back(rs);
+			*out = reinterpret_cast<Socket>(rs);
+			return true;
+		}
+
+		virtual void close(Socket s)
+		{
+			RioSocket* rs = reinterpret_cast<RioSocket*>(s);
+
+			std::vector<RioSocket*>::iterator it = std::find(sockets.begin(), sockets.end(), rs);
+			if (it != sockets.end())
+			{
+				sockets.erase(it);
+			}
+
+			destroySocket(rs);
+		}
+
+		virtual bool sendTo(Socket s, const ConstBuffer* buffers, uint32_t nbuffers, const PlatformSocketAddr& addr)
+		{
+			RioSocket* rs = reinterpret_cast<RioSocket*>(s);
+			reapSends(rs);
+
+			if (rs->nfreeSend == 0)
+			{
+				wouldBlock = true;
+				return false;
+			}
+
+			// gather the payload into a registered send slot
+			const uint32_t slot = rs->freeSend[rs->nfreeSend - 1];
+			uint8_t* data = rs->region + c_sendDataOffset + slot*c_rioSlotSize;
+			uint32_t total = 0;
+			for (uint32_t ii = 0; ii < nbuffers; ++ii)
+			{
+				if (total + buffers[ii].len > c_rioSlotSize)
+				{
+					wouldBlock = false;
+					return false;
+				}
+
+				memcpy(data + total, buffers[ii].p, buffers[ii].len);
+				total += buffers[ii].len;
+			}
+
+			uint8_t* remote = rs->region + c_sendAddrOffset + slot*sizeof(SOCKADDR_INET);
+			memset(remote, 0, sizeof(SOCKADDR_INET));
+			memcpy(remote, addr.storage, std::min<uint32_t>(addr.size, sizeof(SOCKADDR_INET)));
+
+			RIO_BUF dataBuf = rioBuf(rs, c_sendDataOffset + slot*c_rioSlotSize, total);
+			RIO_BUF addrBuf = rioBuf(rs, c_sendAddrOffset + slot*sizeof(SOCKADDR_INET), sizeof(SOCKADDR_INET));
+
+			const DWORD flags = batching ? RIO_MSG_DEFER : 0;
+			if (!rio.RIOSendEx(rs->rq, &dataBuf, 1, nullptr, &addrBuf, nullptr, nullptr, flags, reinterpret_cast<PVOID>(static_cast<uintptr_t>(slot))))
+			{
+				wouldBlock = (WSAGetLastError() == WSAENOBUFS);
+				return false;
+			}
+
+			--rs->nfreeSend;
+			rs->sendDeferred |= batching;
+			return true;
+		}
+
+		virtual uint32_t recvBatch(Socket s, Datagram* datagrams, uint32_t ndatagrams)
+		{
+			RioSocket* rs = reinterpret_cast<RioSocket*>(s);
+
+			// the caller is done with the previous batch, hand those slots
+			// back to the kernel
+			if (rs->nrepost)
+			{
+				for (uint32_t ii = 0; ii < rs->nrepost; ++ii)
+				{
+					postReceive(rs, rs->repost[ii], RIO_MSG_DEFER);
+				}
+				rio.RIOReceiveEx(rs->rq, nullptr, 0, nullptr, nullptr, nullptr, nullptr, RIO_MSG_COMMIT_ONLY, nullptr);
+				rs->nrepost = 0;
+			}
+
+			RIORESULT results[c_rioRecvSlots];
+			const ULONG count = rio.RIODequeueCompletion(rs->recvCQ, results, std::min(ndatagrams, c_rioRecvSlots));
+			if (count == RIO_CORRUPT_CQ || count == 0)
+			{
+				wouldBlock = (count == 0);
+				return 0;
+			}
+
+			uint32_t received = 0;
+			for (ULONG ii = 0; ii < count; ++ii)
+			{
+				const uint32_t slot = static_cast<uint32_t>(results[ii].RequestContext);
+				rs->repost[rs->nrepost++] = slot;
+
+				if (results[ii].Status != 0)
+					continue;
+
+				Datagram* dg = &datagrams[received];
+				dg->p = rs->region + c_recvDataOffset + slot*c_rioSlotSize;
+				dg->len = results[ii].BytesTransferred;
+
+				const SOCKADDR_INET* remote = reinterpret_cast<const SOCKADDR_INET*>(rs->region + c_recvAddrOffset + slot*sizeof(SOCKADDR_INET));
+				dg->addr.size = (remote->si_family == AF_INET6) ? sizeof(sockaddr_in6) : sizeof(sockaddr_in);
+				memcpy(dg->addr.storage, remote, dg->addr.size);
+				++received;
+			}
+
+			// failed completions (e.g. ICMP port unreachable) carry no
+			// data. if every result failed there is nothing to read right
+			// now, which is the same as an empty queue
+			wouldBlock = (received == 0);
+			return received;
+		}
+
+		virtual bool operationWouldHaveBlocked()
+		{
+			return wouldBlock;
+		}
+
+		virtual void sendBatchBegin()
+		{
+			batching = true;
+		}
+
+		virtual void sendBatchEnd()
+		{
+			batching = false;
+
+			// submit all deferred sends with one commit per socket
+			for (size_t ii = 0, nn = sockets.size(); ii != nn; ++ii)
+			{
+				RioSocket* rs = sockets[ii];
+				if (rs->sendDeferred)
+				{
+					rio.RIOSendEx(rs->rq, nullptr, 0, nullptr, nullptr, nullptr, nullptr, RIO_MSG_COMMIT_ONLY, nullptr);
+					rs->sendDeferred = false;
+				}
+			}
+		}
+
+		virtual void wait(uint32_t timeoutMS)
+		{
+			if (!recvEvent)
+			{
+				Sleep(timeoutMS);
+				return;
+			}
+
+			// a notification fires once per `RIONotify', and immediately if
+			// completions are already queued. queues that are still armed
+			// from a previous wait report WSAEALREADY
+			for (size_t ii = 0, nn = sockets.size(); ii != nn; ++ii)
+			{
+				rio.RIONotify(sockets[ii]->recvCQ);
+			}
+
+			WaitForSingleObject(recvEvent, timeoutMS);
+		}
+
+		virtual void wake()
+		{
+			if (recvEvent)
+			{
+				SetEvent(recvEvent);
+			}
+		}
+
+	private:
+		RegisteredIOSocketEngine(const RegisteredIOSocketEngine&); // = delete
+		RegisteredIOSocketEngine& operator=(const RegisteredIOSocketEngine&); // = delete
+
+		bool setupQueues(RioSocket* rs)
+		{
+			rs->nregion = c_regionSize;
+			rs->region = static_cast<uint8_t*>(VirtualAlloc(nullptr, rs->nregion, MEM_COMMIT|MEM_RESERVE, PAGE_READWRITE));
+			if (!rs->region)
+				return false;
+
+			rs->bufferId = rio.RIORegisterBuffer(reinterpret_cast<PCHAR>(rs->region), rs->nregion);
+			if (rs->bufferId == RIO_INVALID_BUFFERID)
+				return false;
+
+			// receive completions signal `recvEvent' once armed by `wait'.
+			// send completions are only polled
+			RIO_NOTIFICATION_COMPLETION notify;
+			memset(&notify, 0, sizeof(notify));
+			notify.Type = RIO_EVENT_COMPLETION;
+			notify.Event.EventHandle = recvEvent;
+			notify.Event.NotifyReset = FALSE;
+
+			rs->recvCQ = rio.RIOCreateCompletionQueue(c_rioRecvSlots, recvEvent ? &notify : nullptr);
+			rs->sendCQ = rio.RIOCreateCompletionQueue(c_rioSendSlots, nullptr);
+			if (rs->recvCQ == RIO_INVALID_CQ || rs->sendCQ == RIO_INVALID_CQ)
+				return false;
+
+			rs->rq = rio.RIOCreateRequestQueue(rs->s, c_rioRecvSlots, 1, c_rioSendSlots, 1, rs->recvCQ, rs->sendCQ, rs);
+			if (rs->rq == RIO_INVALID_RQ)
+				return false;
+
+			for (uint32_t ii = 0; ii < c_rioSendSlots; ++ii)
+			{
+				rs->freeSend[ii] = ii;
+			}
+			rs->nfreeSend = c_rioSendSlots;
+
+			// keep every receive slot posted
+			for (uint32_t ii = 0; ii < c_rioRecvSlots; ++ii)
+			{
+				if (!postReceive(rs, ii, RIO_MSG_DEFER))
+					return false;
+			}
+			return TRUE == rio.RIOReceiveEx(rs->rq, nullptr, 0, nullptr, nullptr, nullptr, nullptr, RIO_MSG_COMMIT_ONLY, nullptr);
+		}
+
+		bool postReceive(RioSocket* rs, uint32_t slot, DWORD flags)
+		{
+			RIO_BUF dataBuf = rioBuf(rs, c_recvDataOffset + slot*c_rioSlotSize, c_rioSlotSize);
+			RIO_BUF addrBuf = rioBuf(rs, c_recvAddrOffset + slot*sizeof(SOCKADDR_INET), sizeof(SOCKADDR_INET));
+			return TRUE == rio.RIOReceiveEx(rs->rq, &dataBuf, 1, nullptr, &addrBuf, nullptr, nullptr, flags, reinterpret_cast<PVOID>(static_cast<uintptr_t>(slot)));
+		}
+
+		void reapSends(RioSocket* rs)
+		{
+			RIORESULT results[c_rioSendSlots];
+			const ULONG count = rio.RIODequeueCompletion(rs->sendCQ, results, c_rioSendSlots);
+			if (count == RIO_CORRUPT_CQ)
+				return;
+
+			for (ULONG ii = 0; ii < count; ++ii)
+			{
+				rs->freeSend[rs->nfreeSend++] = static_cast<uint32_t>(results[ii].RequestContext);
+			}
+		}
+
+		void destroySocket(RioSocket* rs)
+		{
+			// closing the socket also closes its request queue
+			closesocket(rs->s);
+
+			if (rs->recvCQ != RIO_INVALID_CQ)
+				rio.RIOCloseCompletionQueue(rs->recvCQ);
+			if (rs->sendCQ != RIO_INVALID_CQ)
+				rio.RIOCloseCompletionQueue(rs->sendCQ);
+			if (rs->bufferId != RIO_INVALID_BUFFERID)
+				rio.RIODeregisterBuffer(rs->bufferId);
+			if (rs->region)
+				VirtualFree(rs->region, 0, MEM_RELEASE);
+
+			delete rs;
+		}
+
+		const RIO_EXTENSION_FUNCTION_TABLE rio;
+		std::vector<RioSocket*> sockets;
+		HANDLE recvEvent;
+		bool batching;
+		bool wouldBlock;
+	};
+}
+
+ISocketEngine* net::socketEngineCreateRegisteredIO()
+{
+	// RIO is exposed as a winsock extension (Windows 8+). query the function
+	// table from a temporary socket
+	SOCKET s = WSASocket(AF_INET, SOCK_DGRAM, IPPROTO_UDP, nullptr, 0, WSA_FLAG_REGISTERED_IO);
+	if (s == INVALID_SOCKET)
+		return nullptr;
+
+	GUID functionTableId = WSAID_MULTIPLE_RIO;
+	RIO_EXTENSION_FUNCTION_TABLE rio;
+	memset(&rio, 0, sizeof(rio));
+	rio.cbSize = sizeof(rio);
+
+	DWORD bytes = 0;
+	const int result = WSAIoctl(s, SIO_GET_MULTIPLE_EXTENSION_FUNCTION_POINTER
+		, &functionTableId, sizeof(functionTableId)
+		, &rio, sizeof(rio)
+		, &bytes, nullptr, nullptr
+		);
+	closesocket(s);
+
+	if (0 != result)
+		return nullptr;
+
+	return new RegisteredIOSocketEngine(rio);
+}
+
+#else
+ISocketEngine* net::socketEngineCreateRegisteredIO()
+{
+	return nullptr;
+}
+#endif // TINY_PLATFORM_WINDOWS
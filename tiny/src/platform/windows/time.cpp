@@ -26,6 +26,7 @@
 
 #include "tiny/time.h"
 #include "tiny/platform.h"
+#include "clock.h"
 
 using namespace tiny;
 
@@ -34,18 +35,34 @@ using namespace tiny;
 #define WIN32_LEAN_AND_MEAN
 #include <Windows.h>
 
-uint64_t tiny::timestampCurrent()
+uint64_t tiny::timestampPlatform()
 {
 	LARGE_INTEGER li;
 	QueryPerformanceCounter(&li);
 	return static_cast<uint64_t>(li.QuadPart);
 }
 
-uint64_t tiny::timestampFrequency()
+uint64_t tiny::timestampPlatformFrequency()
 {
 	LARGE_INTEGER li;
 	QueryPerformanceFrequency(&li);
 	return static_cast<uint64_t>(li.QuadPart);
 }
 
+uint64_t tiny::timestampCurrent()
+{
+	if (IClock* clock = clockInstalled())
+		return clock->current();
+
+	return timestampPlatform();
+}
+
+uint64_t tiny::timestampFrequency()
+{
+	if (IClock* clock = clockInstalled())
+		return clock->frequency();
+
+	return timestampPlatformFrequency();
+}
+
 #endif // TINY_PLATFORM_WINDOWS
@@ -36,11 +36,13 @@ using namespace tiny::audio;
 #include <Audioclient.h>
 #include <mmdeviceapi.h>
 #include <functiondiscoverykeys_devpkey.h>
+#include <atomic>
 #include <vector>
 #include <stdint.h>
 #include <string.h>
 #include "audio/module.h"
 #include "audio/types.h"
+#include "clock.h"
 #include "tiny/audio/capture.h"
 #include "tiny/audio/enum.h"
 #include "tiny/audio/render.h"
@@ -57,6 +59,8 @@ namespace
 			, deviceSampleRate(sampleRate)
 			, deviceSamplesPer10ms(samplesPer10ms)
 			, deviceChannels(channels)
+			, frontTimestamp(0)
+			, blockTimestamp(0)
 		{
 			buffer.reserve(channels*samplesPer10ms);
 		}
@@ -105,10 +109,15 @@ namespace
 			{
 				buffer.erase(buffer.begin(), buffer.begin() + deviceSamplesPer10ms);
 				currentSize -= deviceSamplesPer10ms;
+				if (frontTimestamp)
+				{
+					frontTimestamp += timestampFrequency() / 100;
+				}
 
 				// if we still have enough samples, return those
 				if (currentSize >= deviceSamplesPer10ms)
 				{
+					blockTimestamp = frontTimestamp;
 					return buffer.data();
 				}
 			}
@@ -131,12 +140,25 @@ namespace
 			BYTE* data;
 			UINT framesAvailable;
 			DWORD flags;
-			hr = captureClient->GetBuffer(&data, &framesAvailable, &flags, NULL, NULL);
+			UINT64 qpcPosition;
+			hr = captureClient->GetBuffer(&data, &framesAvailable, &flags, NULL, &qpcPosition);
 			if (FAILED(hr))
 			{
 				return nullptr;
 			}
 
+			// the device timestamps packets in 100ns units of the
+			// performance counter. only usable with the platform clock
+			if (currentSize == 0)
+			{
+				frontTimestamp = 0;
+				if (!clockInstalled() && !(flags & AUDCLNT_BUFFERFLAGS_TIMESTAMP_ERROR))
+				{
+					const uint64_t freq = timestampFrequency();
+					frontTimestamp = (qpcPosition / 10000000) * freq + (qpcPosition % 10000000) * freq / 10000000;
+				}
+			}
+
 			const float* floatData = reinterpret_cast<const float*>(data);
 			buffer.reserve(currentSize+framesAvailable);
 			for (int ii = 0; ii != framesAvailable; ++ii)
@@ -155,9 +177,15 @@ namespace
 				return nullptr;
 			}
 
+			blockTimestamp = frontTimestamp;
 			return buffer.data();
 		}
 
+		virtual uint64_t captureTimestamp() const
+		{
+			return blockTimestamp;
+		}
+
 	private:
 		WasapiCaptureDevice(const WasapiCaptureDevice&); // = delete
 		WasapiCaptureDevice& operator=(const WasapiCaptureDevice&); // = delete
@@ -174,6 +202,8 @@ namespace
 		const int deviceSampleRate;
 		const int deviceSamplesPer10ms;
 		const int deviceChannels;
+		uint64_t frontTimestamp; // capture time of `buffer[0]'
+		uint64_t blockTimestamp; // see `captureTimestamp'
 	};
 
 	class WasapiRenderDevice : public IRenderDevice
@@ -207,6 +237,8 @@ namespace
 			}
 
 			bufferIndex = 0;
+			queued.store(0, std::memory_order_relaxed);
+			devicePadding.store(0, std::memory_order_relaxed);
 			frameReadySem = CreateSemaphore(nullptr, c_npackets, c_npackets, nullptr);
 			frameCompleteSem = CreateSemaphore(nullptr, 0, c_npackets, nullptr);
 			threadShutdown = CreateEvent(nullptr, FALSE, FALSE, nullptr);
@@ -246,6 +278,7 @@ namespace
 		{
 			// notify the processing thread
 			++bufferIndex;
+			queued.fetch_add(c_nsamples, std::memory_order_relaxed);
 			ReleaseSemaphore(frameCompleteSem, 1, nullptr);
 		}
 
@@ -254,6 +287,11 @@ namespace
 			ReleaseSemaphore(frameReadySem, 1, nullptr);
 		}
 
+		virtual int queuedSamples()
+		{
+			return queued.load(std::memory_order_relaxed) + devicePadding.load(std::memory_order_relaxed);
+		}
+
 	private:
 		WasapiRenderDevice(const WasapiRenderDevice&); // = delete
 		WasapiRenderDevice& operator=(const WasapiRenderDevice&); // = delete
@@ -306,6 +344,8 @@ namespace
 						return;
 					}
 
+					devicePadding.store(static_cast<int>(currentPadding), std::memory_order_relaxed);
+
 					UINT bufferAvailable = bufferSize - currentPadding;
 					if (0 == bufferAvailable)
 					{
@@ -330,6 +370,8 @@ namespace
 
 					packet += bufferAvailable*2;
 					remainingSamples -= bufferAvailable;
+					devicePadding.store(static_cast<int>(currentPadding + bufferAvailable), std::memory_order_relaxed);
+					queued.fetch_sub(static_cast<int>(bufferAvailable), std::memory_order_relaxed);
 				}
 
 				// release the packet back to the client thread
@@ -357,6 +399,11 @@ namespace
 		HANDLE threadShutdown;
 		const int deviceSampleRate;
 		const UINT bufferSize;
+
+		// see `queuedSamples'. committed samples not yet handed to the
+		// device, and the device's own padding
+		std::atomic<int> queued;
+		std::atomic<int> devicePadding;
 	};
 }
 
@@ -105,6 +105,7 @@ namespace
 		virtual int acquireBuffer(float** buffer);
 		virtual void commitBuffer();
 		virtual void discardBuffer();
+		virtual int queuedSamples();
 
 	private:
 		virtual ~XAudio2RenderDevice();
@@ -235,6 +236,20 @@ void XAudio2RenderDevice::discardBuffer()
 	ReleaseSemaphore(bufferSema, 1, nullptr);
 }
 
+int XAudio2RenderDevice::queuedSamples()
+{
+	// every submitted buffer holds `c_nsamples'; the voice is part way
+	// through the first one still queued
+	XAUDIO2_VOICE_STATE state;
+	sourceVoice->GetState(&state);
+	if (state.BuffersQueued == 0)
+	{
+		return 0;
+	}
+
+	return static_cast<int>(state.BuffersQueued*c_nsamples - state.SamplesPlayed % c_nsamples);
+}
+
 #if TINY_AUDIO_XAUDIO2_USE_DYNAMIC_LOADING
 // XAudio2.7 guids
 static const GUID c_CLSID_XAudio2 = { 0x5a508685, 0xa254, 0x4fba, {0x9b, 0x82, 0x9a, 0x24, 0xb0, 0x03, 0x06, 0xaf} };
@@ -0,0 +1,359 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <mutex>
+#include "tiny/profile.h"
+#include "tiny/time.h"
+
+using namespace tiny;
+
+// zones kept per thread. must be a power of two
+static const uint32_t c_profileZones = 8192;
+// exported JSON is staged in chunks of this size
+static const uint32_t c_profileChunkSize = 4096;
+// exited threads whose zones are kept for the next export. beyond this the
+// buffer of the oldest is taken by the next new thread
+static const uint32_t c_profileRetainedThreads = 32;
+
+std::atomic<bool> detail::profileActive(false);
+static std::atomic<uint64_t> s_profileExits(0);
+
+namespace
+{
+	struct ProfileZone
+	{
+		const char* name;
+		uint64_t begin;
+		uint64_t end;
+	};
+
+	// zones recorded by a single thread. only the owning thread writes
+	// `zones' and `written'; the exporter copies zones out and discards
+	// any the owner may have overwritten meanwhile, like a seqlock.
+	// `zones' is allocated by the first record, so naming a thread that
+	// is never profiled stays cheap
+	struct ProfileThread
+	{
+		ProfileZone* zones;
+		std::atomic<uint64_t> written;
+		std::atomic<uint64_t> cleared; // zones before this were discarded
+		std::atomic<uint64_t> exited; // order in which the owner exited
+		std::atomic<bool> owned;
+		uint32_t tid;
+		char name[32]; // guarded by `s_profileNamesLock'
+		ProfileThread* next;
+	};
+
+	// releases the thread's buffer for reuse when the thread exits
+	struct ProfileThreadSlot
+	{
+		ProfileThreadSlot()
+			: t(nullptr)
+		{
+		}
+
+		~ProfileThreadSlot()
+		{
+			if (t)
+			{
+				t->exited.store(s_profileExits.fetch_add(1, std::memory_order_relaxed), std::memory_order_relaxed);
+				t->owned.store(false, std::memory_order_release);
+			}
+		}
+
+		ProfileThread* t;
+	};
+}
+
+// buffers are never freed, only handed to the next new thread
+static std::atomic<ProfileThread*> s_profileThreads(nullptr);
+static std::atomic<uint32_t> s_profileNextTid(1);
+static std::mutex s_profileNamesLock;
+static thread_local ProfileThreadSlot s_profileSlot;
+
+// take over the buffer of an exited thread, discarding any zones left in it
+static bool profileThreadClaim(ProfileThread* t)
+{
+	bool owned = false;
+	if (!t->owned.compare_exchange_strong(owned, true, std::memory_order_acquire))
+		return false;
+
+	t->cleared.store(t->written.load(std::memory_order_relaxed), std::memory_order_relaxed);
+
+	std::unique_lock<std::mutex> l(s_profileNamesLock);
+	t->tid = s_profileNextTid.fetch_add(1, std::memory_order_relaxed);
+	t->name[0] = 0;
+	return true;
+}
+
+static ProfileThread* profileThreadAcquire()
+{
+	// reuse the buffer of an exited thread once its zones were exported
+	// or cleared, so a capture still covers threads that exited before the
+	// export. threads that come and go without an export would keep
+	// adding buffers, so only the newest few exited threads are kept
+	ProfileThread* oldest = nullptr;
+	uint32_t retained = 0;
+	for (ProfileThread* t = s_profileThreads.load(std::memory_order_acquire); t; t = t->next)
+	{
+		if (t->owned.load(std::memory_order_relaxed))
+			continue;
+
+		if (t->cleared.load(std::memory_order_relaxed) != t->written.load(std::memory_order_relaxed))
+		{
+			++retained;
+			if (!oldest || t->exited.load(std::memory_order_relaxed) < oldest->exited.load(std::memory_order_relaxed))
+			{
+				oldest = t;
+			}
+			continue;
+		}
+
+		if (profileThreadClaim(t))
+			return t;
+	}
+
+	if (retained >= c_profileRetainedThreads && profileThreadClaim(oldest))
+		return oldest;
+
+	ProfileThread* t = new ProfileThread;
+	t->zones = nullptr;
+	t->written.store(0, std::memory_order_relaxed);
+	t->cleared.store(0, std::memory_order_relaxed);
+	t->exited.store(0, std::memory_order_relaxed);
+	t->owned.store(true, std::memory_order_relaxed);
+	t->tid = s_profileNextTid.fetch_add(1, std::memory_order_relaxed);
+	t->name[0] = 0;
+
+	ProfileThread* head = s_profileThreads.load(std::memory_order_relaxed);
+	do
+	{
+		t->next = head;
+	} while (!s_profileThreads.compare_exchange_weak(head, t, std::memory_order_release, std::memory_order_relaxed));
+
+	return t;
+}
+
+static ProfileThread* profileThreadCurrent()
+{
+	if (!s_profileSlot.t)
+	{
+		s_profileSlot.t = profileThreadAcquire();
+	}
+
+	return s_profileSlot.t;
+}
+
+void tiny::profileEnable(bool enable)
+{
+	detail::profileActive.store(enable, std::memory_order_relaxed);
+}
+
+void tiny::profileThreadName(const char* name)
+{
+	ProfileThread* t = profileThreadCurrent();
+
+	std::unique_lock<std::mutex> l(s_profileNamesLock);
+	strncpy(t->name, name, sizeof(t->name) - 1);
+	t->name[sizeof(t->name) - 1] = 0;
+}
+
+void tiny::profileRecord(const char* name, uint64_t begin, uint64_t end)
+{
+	ProfileThread* t = profileThreadCurrent();
+	if (!t->zones)
+	{
+		t->zones = new ProfileZone[c_profileZones];
+	}
+
+	const uint64_t n = t->written.load(std::memory_order_relaxed);
+	ProfileZone& zone = t->zones[n & (c_profileZones - 1)];
+	zone.name = name;
+	zone.begin = begin;
+	zone.end = end;
+	t->written.store(n + 1, std::memory_order_release);
+}
+
+void tiny::profileClear()
+{
+	for (ProfileThread* t = s_profileThreads.load(std::memory_order_acquire); t; t = t->next)
+	{
+		t->cleared.store(t->written.load(std::memory_order_acquire), std::memory_order_relaxed);
+	}
+}
+
+namespace
+{
+	// stages exported JSON into `c_profileChunkSize' writes
+	struct ProfileWriter
+	{
+		ProfileWriteFn write;
+		void* user;
+		uint32_t n;
+		char chunk[c_profileChunkSize];
+
+		void flush()
+		{
+			if (n)
+			{
+				write(user, chunk, n);
+				n = 0;
+			}
+		}
+
+		// room for at least `need' more bytes
+		char* reserve(uint32_t need)
+		{
+			if (n + need > sizeof(chunk))
+			{
+				flush();
+			}
+
+			return chunk + n;
+		}
+
+		void append(const char* p)
+		{
+			const uint32_t len = static_cast<uint32_t>(strlen(p));
+			memcpy(reserve(len), p, len);
+			n += len;
+		}
+
+		// `p' as a JSON string, truncated to 127 characters
+		void appendString(const char* p)
+		{
+			char* out = reserve(2 + 2*127);
+			uint32_t len = 0;
+			out[len++] = '"';
+			for (uint32_t ii = 0; p[ii] && ii < 127; ++ii)
+			{
+				const char c = p[ii];
+				if (c == '"' || c == '\\')
+				{
+					out[len++] = '\\';
+					out[len++] = c;
+				}
+				else if (static_cast<unsigned char>(c) >= 0x20)
+				{
+					out[len++] = c;
+				}
+			}
+			out[len++] = '"';
+			n += len;
+		}
+	};
+}
+
+void tiny::profileExportChromeTrace(ProfileWriteFn write, void* user)
+{
+	ProfileWriter* w = new ProfileWriter;
+	w->write = write;
+	w->user = user;
+	w->n = 0;
+
+	const double usPerTick = 1e6 / static_cast<double>(timestampPlatformFrequency());
+
+	ProfileZone* zones = new ProfileZone[c_profileZones];
+	bool first = true;
+
+	w->append("{\"traceEvents\":[");
+	for (ProfileThread* t = s_profileThreads.load(std::memory_order_acquire); t; t = t->next)
+	{
+		char line[160];
+
+		uint32_t tid;
+		char name[sizeof(t->name)];
+		{
+			std::unique_lock<std::mutex> l(s_profileNamesLock);
+			tid = t->tid;
+			memcpy(name, t->name, sizeof(name));
+		}
+
+		if (name[0])
+		{
+			snprintf(line, sizeof(line), "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":"
+				, first ? "" : ",", tid);
+			w->append(line);
+			w->appendString(name);
+			w->append("}}");
+			first = false;
+		}
+
+		// copy the live window out, then drop whatever the owner
+		// overwrote while we were copying
+		const uint64_t written = t->written.load(std::memory_order_acquire);
+		uint64_t begin = t->cleared.load(std::memory_order_relaxed);
+		if (written - begin > c_profileZones)
+		{
+			begin = written - c_profileZones;
+		}
+
+		for (uint64_t ii = begin; ii < written; ++ii)
+		{
+			zones[ii & (c_profileZones - 1)] = t->zones[ii & (c_profileZones - 1)];
+		}
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		const uint64_t after = t->written.load(std::memory_order_relaxed);
+		if (after - begin > c_profileZones)
+		{
+			begin = after - c_profileZones;
+		}
+
+		for (uint64_t ii = begin; ii < written; ++ii)
+		{
+			const ProfileZone& zone = zones[ii & (c_profileZones - 1)];
+			w->append(first ? "{\"name\":" : ",{\"name\":");
+			w->appendString(zone.name);
+
+			snprintf(line, sizeof(line), ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}"
+				, tid
+				, static_cast<double>(zone.begin) * usPerTick
+				, static_cast<double>(zone.end - zone.begin) * usPerTick);
+			w->append(line);
+			first = false;
+		}
+
+		// zones of an exited thread are consumed by the export, its buffer
+		// may go to the next new thread. never move `cleared' back, the
+		// buffer may have been claimed since
+		if (!t->owned.load(std::memory_order_acquire))
+		{
+			uint64_t cleared = t->cleared.load(std::memory_order_relaxed);
+			while (cleared < written && !t->cleared.compare_exchange_weak(cleared, written, std::memory_order_relaxed))
+			{
+			}
+		}
+	}
+	w->append("],\"displayTimeUnit\":\"ns\"}\n");
+	w->flush();
+
+	delete[] zones;
+	delete w;
+}
@@ -0,0 +1,100 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef TINY_SRC__SPSCQUEUE_H
+#define TINY_SRC__SPSCQUEUE_H
+
+#include <stdint.h>
+#include <atomic>
+
+namespace tiny
+{
+	// lock-free single-producer/single-consumer ring of `N' items. `N'
+	// must be a power of two. items are constructed once and reused in
+	// place: the producer fills the slot returned by `beginPush' then
+	// publishes it with `commitPush'; the consumer reads `peek(ii)' and
+	// releases slots with `pop'.
+	template<typename T, uint32_t N>
+	class SpscQueue
+	{
+		static_assert(N != 0 && (N & (N - 1)) == 0, "SpscQueue size must be a power of two");
+
+	public:
+		SpscQueue()
+			: head(0)
+			, tail(0)
+		{
+		}
+
+		// producer: next free slot, or `nullptr' if the queue is full
+		T* beginPush()
+		{
+			const uint32_t h = head.load(std::memory_order_relaxed);
+			if (h - tail.load(std::memory_order_acquire) == N)
+				return nullptr;
+
+			return &items[h & (N - 1)];
+		}
+
+		// producer: publish the slot returned by `beginPush'
+		void commitPush()
+		{
+			head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+		}
+
+		// consumer: number of published items
+		uint32_t size() const
+		{
+			return head.load(std::memory_order_acquire) - tail.load(std::memory_order_relaxed);
+		}
+
+		// consumer: `ii'th published item, `ii' < `size()'
+		T* peek(uint32_t ii)
+		{
+			return &items[(tail.load(std::memory_order_relaxed) + ii) & (N - 1)];
+		}
+
+		// consumer: release the `n' oldest items back to the producer
+		void pop(uint32_t n)
+		{
+			tail.store(tail.load(std::memory_order_relaxed) + n, std::memory_order_release);
+		}
+
+	private:
+		SpscQueue(const SpscQueue&); // = delete
+		SpscQueue& operator=(const SpscQueue&); // = delete
+
+		// keep producer and consumer indices on separate cache lines
+		std::atomic<uint32_t> head;
+		uint8_t pad0[64 - sizeof(std::atomic<uint32_t>)];
+		std::atomic<uint32_t> tail;
+		uint8_t pad1[64 - sizeof(std::atomic<uint32_t>)];
+
+		T items[N];
+	};
+}
+
+#endif // TINY_SRC__SPSCQUEUE_H
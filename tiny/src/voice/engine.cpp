@@ -34,13 +34,23 @@
 #include "tiny/audio/capture.h"
 #include "tiny/audio/resample.h"
 #include "tiny/endian.h"
+#include "tiny/net/packet.h"
+#include "tiny/profile.h"
+#include "tiny/time.h"
 #include "tiny/voice/engine.h"
 #include "tiny/voice/source.h"
+#include "tiny/voice/trace.h"
 
 using namespace tiny;
 using namespace tiny::audio;
 using namespace tiny::voice;
 
+// audio frame length marking the send timestamp extension. opus frames
+// never come close
+static const uint16_t c_timestampMarker = 0xFFFF;
+// marker, length, send time and capture age
+static const uint32_t c_timestampExtensionSize = 12;
+
 Engine::Engine(ICaptureDevice* mic, uint32_t sampleRate)
 	: mic(mic)
 	, encoder(nullptr)
@@ -49,7 +59,11 @@ Engine::Engine(ICaptureDevice* mic, uint32_t sampleRate)
 	, outputSampleRate(sampleRate)
 	, outgoingSequence(0)
 	, micSampleRate(mic ? mic->sampleRate() : 0)
+	, sendTimestamps(false)
+	, trace(nullptr)
 {
+	latencyReset(&latency);
+
 	if (mic)
 	{
 		assert(mic->channels() == 1);
@@ -101,11 +115,42 @@ void Engine::removeSource(Source* /*s*/)
 {
 }
 
+void Engine::setSendTimestamps(bool enable)
+{
+	sendTimestamps = enable;
+}
+
+void Engine::setPacketTrace(PacketTraceWriter* trace)
+{
+	this->trace = trace;
+}
+
+void Engine::latencyStats(LatencyStats* stats) const
+{
+	*stats = latency;
+}
+
+void Engine::resetLatencyStats()
+{
+	latencyReset(&latency);
+}
+
 uint32_t Engine::generatePacket(uint8_t* packet, uint32_t npacket)
 {
+	net::PacketBuffer pb;
+	net::packetInit(&pb, packet, npacket, 0, 0);
+	return generatePacket(&pb);
+}
+
+uint32_t Engine::generatePacket(net::PacketBuffer* pb)
+{
+	TINY_PROFILE_ZONE("Engine::generatePacket");
+
 	if (!mic || !outgoingProcessor || !encoder)
 		return 0;
 
+	uint8_t* packet = net::packetEnd(*pb);
+	uint32_t npacket = net::packetWritable(*pb);
 	if (npacket < 4)
 		return 0;
 
@@ -114,8 +159,22 @@ uint32_t Engine::generatePacket(uint8_t* packet, uint32_t npacket)
 	packet += sizeof(sequence);
 	npacket -= sizeof(sequence);
 
-	uint32_t packetWritten = sizeof(uint32_t);
+	// filled in once the packet is complete
+	uint8_t* timestampExtension = nullptr;
+	if (sendTimestamps)
+	{
+		if (npacket < c_timestampExtensionSize)
+			return 0;
+
+		timestampExtension = packet;
+		packet += c_timestampExtensionSize;
+		npacket -= c_timestampExtensionSize;
+	}
+
+	const uint32_t headerSize = static_cast<uint32_t>(packet - net::packetEnd(*pb));
+	uint32_t packetWritten = headerSize;
 	uint32_t packetsGenerated = 0;
+	uint64_t firstCapture = 0;
 	while (npacket > 200)
 	{
 		// do we have 10ms of data to encode?
@@ -123,19 +182,50 @@ uint32_t Engine::generatePacket(uint8_t* packet, uint32_t npacket)
 		if (!incoming)
 			break;
 
+		const uint64_t readAt = timestampCurrent();
+		uint64_t capturedAt = mic->captureTimestamp();
+		if (capturedAt && capturedAt <= readAt)
+		{
+			latencyRecord(&latency.stages[LatencyStage::CaptureQueue], latencyMicroseconds(readAt - capturedAt));
+		}
+		else
+		{
+			capturedAt = readAt;
+		}
+
 		// process the audio
 		float* out[1] = {monoBuffer};
-		if (webrtc::AudioProcessing::kNoError == outgoingProcessor->ProcessStream(&incoming, webrtc::StreamConfig(micSampleRate, 1, false), webrtc::StreamConfig(48000, 1, false), out))
+		int processed;
+		{
+			TINY_PROFILE_ZONE("Engine::processStream");
+			processed = outgoingProcessor->ProcessStream(&incoming, webrtc::StreamConfig(micSampleRate, 1, false), webrtc::StreamConfig(48000, 1, false), out);
+		}
+
+		const uint64_t processedAt = timestampCurrent();
+		latencyRecord(&latency.stages[LatencyStage::Processing], latencyMicroseconds(processedAt - readAt));
+
+		if (webrtc::AudioProcessing::kNoError == processed)
 		{
 			if (outgoingProcessor->voice_detection()->stream_has_voice())
 			{
 				// encode the audio
-				int32_t packetData = opus_encode_float(encoder, monoBuffer, c_monoSamples, packet+2, npacket-2);
+				int32_t packetData;
+				{
+					TINY_PROFILE_ZONE("Engine::opusEncode");
+					packetData = opus_encode_float(encoder, monoBuffer, c_monoSamples, packet+2, npacket-2);
+				}
+				latencyRecord(&latency.stages[LatencyStage::Encode], latencyMicroseconds(timestampCurrent() - processedAt));
+
 				if (packetData < 1) // no need to transmit this data
 				{
 					break;
 				}
 
+				if (!firstCapture)
+				{
+					firstCapture = capturedAt;
+				}
+
 				uint16_t encodedPacketData = endianToLittle(static_cast<uint16_t>(packetData));
 				memcpy(packet, &encodedPacketData, sizeof(encodedPacketData));
 
@@ -154,16 +244,40 @@ uint32_t Engine::generatePacket(uint8_t* packet, uint32_t npacket)
 	outgoingSequence += packetsGenerated;
 
 	// did we actually write any audio data?
-	if (packetWritten == sizeof(uint32_t))
+	if (packetWritten == headerSize)
 	{
 		return 0;
 	}
 
+	if (timestampExtension)
+	{
+		const uint64_t now = timestampCurrent();
+		const uint16_t marker = endianToLittle(c_timestampMarker);
+		const uint16_t size = endianToLittle(static_cast<uint16_t>(c_timestampExtensionSize - 4));
+		const uint32_t sendUs = endianToLittle(latencyMicroseconds(now));
+		const uint32_t ageUs = endianToLittle(latencyMicroseconds(now - firstCapture));
+		memcpy(timestampExtension, &marker, sizeof(marker));
+		memcpy(timestampExtension + 2, &size, sizeof(size));
+		memcpy(timestampExtension + 4, &sendUs, sizeof(sendUs));
+		memcpy(timestampExtension + 8, &ageUs, sizeof(ageUs));
+	}
+
+	net::packetCommit(pb, packetWritten);
 	return packetWritten;
 }
 
-void Engine::processPacket(Source* s, const uint8_t* packet, uint32_t npacket)
+void Engine::processPacket(Source* s, const uint8_t* packet, uint32_t npacket, uint32_t peer)
 {
+	TINY_PROFILE_ZONE("Engine::processPacket");
+
+	const uint64_t receivedAt = timestampCurrent();
+
+	// malformed packets are recorded too, they may be what's being chased
+	if (trace)
+	{
+		packetTraceRecord(trace, peer, packet, npacket, receivedAt);
+	}
+
 	if (npacket < 6)
 		return;
 
@@ -173,6 +287,47 @@ void Engine::processPacket(Source* s, const uint8_t* packet, uint32_t npacket)
 	packet += sizeof(incomingSequence);
 	npacket -= sizeof(incomingSequence);
 
+	// send timestamp extension, see `setSendTimestamps'
+	bool hasCapture = false;
+	uint32_t captureUs = 0;
+	uint16_t marker;
+	memcpy(&marker, packet, sizeof(marker));
+	if (endianFromLittle(marker) == c_timestampMarker)
+	{
+		if (npacket < 4)
+			return;
+
+		uint16_t size;
+		memcpy(&size, packet + 2, sizeof(size));
+		size = endianFromLittle(size);
+		packet += 4;
+		npacket -= 4;
+		if (size > npacket)
+			return;
+
+		if (size >= 8)
+		{
+			uint32_t sendUs;
+			uint32_t ageUs;
+			memcpy(&sendUs, packet, sizeof(sendUs));
+			memcpy(&ageUs, packet + 4, sizeof(ageUs));
+			sendUs = endianFromLittle(sendUs);
+			ageUs = endianFromLittle(ageUs);
+
+			const int32_t network = static_cast<int32_t>(latencyMicroseconds(receivedAt) - sendUs);
+			if (network >= 0)
+			{
+				latencyRecord(&s->latency.stages[LatencyStage::Network], static_cast<uint32_t>(network));
+			}
+
+			hasCapture = true;
+			captureUs = sendUs - ageUs;
+		}
+
+		packet += size;
+		npacket -= size;
+	}
+
 	// first packet? reset incoming sequence
 	if (s->incomingSequence == 0)
 	{
@@ -184,13 +339,21 @@ void Engine::processPacket(Source* s, const uint8_t* packet, uint32_t npacket)
 	{
 		for (uint32_t ii = s->incomingSequence; ii < incomingSequence; ++ii)
 		{
-			const int nsamples = opus_decode_float(s->decoder.p, nullptr, 0, monoBuffer, c_monoSamples, 0);
+			const uint64_t decodeStart = timestampCurrent();
+			int nsamples;
+			{
+				TINY_PROFILE_ZONE("Engine::opusConceal");
+				nsamples = opus_decode_float(s->decoder.p, nullptr, 0, monoBuffer, c_monoSamples, 0);
+			}
+
 			if (nsamples > 0)
 			{
+				TINY_PROFILE_ZONE("Engine::resample");
 				const uint32_t outputSamples = s->outputResampler.outputSamples(nsamples);
 				const size_t existingSize = s->incomingData.size();
 				s->incomingData.reserve(existingSize + outputSamples);
 				s->outputResampler.resampleMono(monoBuffer, nsamples, s->incomingData.data() + existingSize, outputSamples);
+				queueDecoded(s, existingSize, decodeStart, false, 0);
 			}
 		}
 	}
@@ -211,13 +374,21 @@ void Engine::processPacket(Source* s, const uint8_t* packet, uint32_t npacket)
 
 		if (s->valid() && incomingSequence >= s->incomingSequence)
 		{
-			const int nsamples = opus_decode_float(s->decoder.p, packet, audioPacketSize, monoBuffer, c_monoSamples, 0);
+			const uint64_t decodeStart = timestampCurrent();
+			int nsamples;
+			{
+				TINY_PROFILE_ZONE("Engine::opusDecode");
+				nsamples = opus_decode_float(s->decoder.p, packet, audioPacketSize, monoBuffer, c_monoSamples, 0);
+			}
+
 			if (nsamples > 0)
 			{
+				TINY_PROFILE_ZONE("Engine::resample");
 				const uint32_t outputSamples = s->outputResampler.outputSamples(nsamples);
 				const size_t existingSize = s->incomingData.size();
 				s->incomingData.resize(existingSize + outputSamples);
 				s->outputResampler.resampleMono(monoBuffer, nsamples, s->incomingData.data() + existingSize, outputSamples);
+				queueDecoded(s, existingSize, decodeStart, hasCapture, captureUs);
 			}
 		}
 		
@@ -228,3 +399,23 @@ void Engine::processPacket(Source* s, const uint8_t* packet, uint32_t npacket)
 
 	s->incomingSequence = incomingSequence;
 }
+
+// record the decode stage of the frame appended to `s->incomingData' past
+// `existingSize', and track it until consumed
+void Engine::queueDecoded(Source* s, size_t existingSize, uint64_t decodeStart, bool hasCapture, uint32_t captureUs)
+{
+	const uint64_t now = timestampCurrent();
+	latencyRecord(&s->latency.stages[LatencyStage::Decode], latencyMicroseconds(now - decodeStart));
+
+	const size_t samples = s->incomingData.size() - existingSize;
+	if (samples == 0)
+		return;
+
+	Source::QueuedAudio q;
+	q.samples = static_cast<uint32_t>(samples);
+	q.queuedAt = now;
+	q.captureUs = captureUs;
+	q.hasCapture = hasCapture;
+	q.consumed = false;
+	s->queuedAudio.push_back(q);
+}
@@ -0,0 +1,114 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdint.h>
+#include <string.h>
+#include "tiny/time.h"
+#include "tiny/voice/latency.h"
+
+using namespace tiny;
+using namespace tiny::voice;
+
+// bucket holding `us'. values below 4 map directly, above that the
+// exponent picks a group of 4 buckets and the next two bits the bucket
+static uint32_t latencyBucket(uint32_t us)
+{
+	if (us < 4)
+		return us;
+
+	uint32_t e = 2;
+	while (e < 31 && (us >> (e + 1)) != 0)
+	{
+		++e;
+	}
+
+	const uint32_t b = 4*(e - 1) + ((us >> (e - 2)) & 3);
+	return b < LatencyHistogram::Buckets ? b : LatencyHistogram::Buckets - 1;
+}
+
+// largest value held by bucket `b'
+static uint32_t latencyBucketLimit(uint32_t b)
+{
+	if (b < 4)
+		return b;
+
+	const uint32_t e = b/4 + 1;
+	return ((4 + (b & 3)) << (e - 2)) + (1u << (e - 2)) - 1;
+}
+
+void voice::latencyReset(LatencyStats* stats)
+{
+	memset(stats, 0, sizeof(*stats));
+}
+
+void voice::latencyRecord(LatencyHistogram* h, uint32_t us)
+{
+	++h->counts[latencyBucket(us)];
+	++h->count;
+	h->totalUs += us;
+	if (us > h->maxUs)
+	{
+		h->maxUs = us;
+	}
+}
+
+uint32_t voice::latencyPercentile(const LatencyHistogram& h, float fraction)
+{
+	if (h.count == 0)
+		return 0;
+
+	uint32_t rank = static_cast<uint32_t>(fraction * static_cast<float>(h.count) + 0.5f);
+	if (rank == 0)
+	{
+		rank = 1;
+	}
+
+	uint32_t seen = 0;
+	for (uint32_t ii = 0; ii < LatencyHistogram::Buckets; ++ii)
+	{
+		seen += h.counts[ii];
+		if (seen >= rank)
+		{
+			const uint32_t limit = latencyBucketLimit(ii);
+			return limit < h.maxUs ? limit : h.maxUs;
+		}
+	}
+
+	return h.maxUs;
+}
+
+uint32_t voice::latencyMean(const LatencyHistogram& h)
+{
+	if (h.count == 0)
+		return 0;
+
+	return static_cast<uint32_t>(h.totalUs / h.count);
+}
+
+uint32_t voice::latencyMicroseconds(uint64_t ticks)
+{
+	const uint64_t freq = timestampFrequency();
+	return static_cast<uint32_t>((ticks / freq) * 1000000 + (ticks % freq) * 1000000 / freq);
+}
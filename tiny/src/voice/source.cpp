@@ -27,6 +27,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <opus.h>
+#include "tiny/time.h"
 #include "tiny/voice/source.h"
 
 using namespace tiny;
@@ -88,13 +89,19 @@ void Source::reset(uint32_t sampleRate)
 	incomingSequence = 0;
 	decoder.reset();
 	outputResampler.reset(48000, sampleRate);
+	outputSampleRate = sampleRate;
+	queuedAudio.clear();
+	latencyReset(&latency);
 }
 
 void Source::swap(Source& other)
 {
 	incomingData.swap(other.incomingData);
+	queuedAudio.swap(other.queuedAudio);
 	outputResampler = other.outputResampler;
 	incomingSequence = other.incomingSequence;
+	outputSampleRate = other.outputSampleRate;
+	latency = other.latency;
 	decoder = std::move(other.decoder);
 	other.decoder.p = nullptr;
 }
@@ -104,15 +111,67 @@ uint32_t Source::getSourceAudio(const float** monoSamples)
 	*monoSamples = incomingData.data();
 	return static_cast<uint32_t>(incomingData.size());
 }
-
-void Source::consumeSourceAudio(uint32_t samples)
-{
-	incomingData.erase(incomingData.begin(), incomingData.begin() + samples);
-}
-
-std::vector<float> Source::takeAllSourceAudio()
-{
-	std::vector<float> temp;
-	temp.swap(incomingData);
-	return std::move(temp);
-}
+
+void Source::consumeSourceAudio(uint32_t samples, uint32_t renderQueued)
+{
+	incomingData.erase(incomingData.begin(), incomingData.begin() + samples);
+	recordConsumed(samples, renderQueued);
+}
+
+std::vector<float> Source::takeAllSourceAudio()
+{
+	recordConsumed(static_cast<uint32_t>(incomingData.size()), 0);
+
+	std::vector<float> temp;
+	temp.swap(incomingData);
+	return std::move(temp);
+}
+
+void Source::latencyStats(LatencyStats* stats) const
+{
+	*stats = latency;
+}
+
+void Source::resetLatencyStats()
+{
+	latencyReset(&latency);
+}
+
+void Source::recordConsumed(uint32_t samples, uint32_t renderQueued)
+{
+	if (!samples)
+		return;
+
+	const uint64_t now = timestampCurrent();
+	const uint32_t renderUs = outputSampleRate ? static_cast<uint32_t>(static_cast<uint64_t>(renderQueued) * 1000000 / outputSampleRate) : 0;
+	latencyRecord(&latency.stages[LatencyStage::RenderQueue], renderUs);
+
+	// each decoded frame is measured when it first starts to play out
+	const uint32_t playUs = latencyMicroseconds(now) + renderUs;
+	size_t finished = 0;
+	for (size_t nn = queuedAudio.size(); samples && finished != nn; )
+	{
+		QueuedAudio& q = queuedAudio[finished];
+		if (!q.consumed)
+		{
+			q.consumed = true;
+			latencyRecord(&latency.stages[LatencyStage::JitterBuffer], latencyMicroseconds(now - q.queuedAt));
+
+			const int32_t mouthToEar = static_cast<int32_t>(playUs - q.captureUs);
+			if (q.hasCapture && mouthToEar >= 0)
+			{
+				latencyRecord(&latency.stages[LatencyStage::MouthToEar], static_cast<uint32_t>(mouthToEar));
+			}
+		}
+
+		const uint32_t n = samples < q.samples ? samples : q.samples;
+		q.samples -= n;
+		samples -= n;
+		if (q.samples == 0)
+		{
+			++finished;
+		}
+	}
+
+	queuedAudio.erase(queuedAudio.begin(), queuedAudio.begin() + finished);
+}
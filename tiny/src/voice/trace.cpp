@@ -0,0 +1,263 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <thread>
+#include "spscqueue.h"
+#include "tiny/endian.h"
+#include "tiny/sleep.h"
+#include "tiny/time.h"
+#include "tiny/voice/trace.h"
+
+using namespace tiny;
+using namespace tiny::voice;
+
+static const uint8_t c_traceMagic[4] = {'T', 'V', 'P', 'T'};
+static const uint32_t c_traceHeaderSize = 8;
+static const uint32_t c_traceRecordHeaderSize = 10;
+// records queued for the writer thread. voice arrives at ~100 packets/s
+// per peer, so this covers seconds of a stalled disk
+static const uint32_t c_traceQueueSize = 1024;
+// time the writer sleeps when it finds the queue empty
+static const uint32_t c_traceIdleMS = 5;
+
+namespace
+{
+	struct TraceSlot
+	{
+		uint64_t arrivedAt;
+		uint32_t peer;
+		uint32_t npacket;
+		uint8_t packet[c_packetTraceMaxPacket];
+	};
+}
+
+struct voice::PacketTraceWriter
+{
+	FILE* file;
+	std::thread writer;
+	std::atomic<bool> quit;
+	std::atomic<uint32_t> dropped;
+
+	// only touched by the writer thread
+	uint64_t start;
+	uint64_t lastUs;
+
+	SpscQueue<TraceSlot, c_traceQueueSize> queue;
+};
+
+struct voice::PacketTraceReader
+{
+	FILE* file;
+	uint64_t arrivalUs;
+	uint8_t packet[0x10000];
+};
+
+// `ticks' of `timestampCurrent' in microseconds, without overflowing for
+// long traces
+static uint64_t traceMicroseconds(uint64_t ticks)
+{
+	const uint64_t frequency = timestampFrequency();
+	return (ticks / frequency) * 1000000 + (ticks % frequency) * 1000000 / frequency;
+}
+
+static void writeRecord(PacketTraceWriter* trace, const TraceSlot& slot)
+{
+	// arrival times come from the receive path and only move forward, but
+	// clamp anyway so a bad clock can't corrupt the deltas
+	uint64_t us = slot.arrivedAt > trace->start ? traceMicroseconds(slot.arrivedAt - trace->start) : 0;
+	if (us < trace->lastUs)
+	{
+		us = trace->lastUs;
+	}
+
+	const uint64_t delta = us - trace->lastUs;
+	trace->lastUs = us;
+
+	uint8_t header[c_traceRecordHeaderSize];
+	const uint32_t delta32 = endianToLittle(static_cast<uint32_t>(delta > 0xFFFFFFFF ? 0xFFFFFFFF : delta));
+	const uint32_t peer = endianToLittle(slot.peer);
+	const uint16_t size = endianToLittle(static_cast<uint16_t>(slot.npacket));
+	memcpy(header, &delta32, sizeof(delta32));
+	memcpy(header + 4, &peer, sizeof(peer));
+	memcpy(header + 8, &size, sizeof(size));
+
+	fwrite(header, sizeof(header), 1, trace->file);
+	fwrite(slot.packet, slot.npacket, 1, trace->file);
+}
+
+static void traceWriter(PacketTraceWriter* trace)
+{
+	for (;;)
+	{
+		// sample `quit' first so records queued before destruction are
+		// always written
+		const bool quit = trace->quit.load(std::memory_order_acquire);
+
+		const uint32_t n = trace->queue.size();
+		if (n == 0)
+		{
+			if (quit)
+				break;
+
+			sleep(c_traceIdleMS);
+			continue;
+		}
+
+		for (uint32_t ii = 0; ii < n; ++ii)
+		{
+			writeRecord(trace, *trace->queue.peek(ii));
+		}
+		trace->queue.pop(n);
+
+		// keep the file complete up to the last batch in case the
+		// process goes down
+		fflush(trace->file);
+	}
+}
+
+PacketTraceWriter* voice::packetTraceCreate(const char* path)
+{
+	FILE* file = fopen(path, "wb");
+	if (!file)
+		return nullptr;
+
+	uint8_t header[c_traceHeaderSize];
+	const uint32_t version = endianToLittle(c_packetTraceVersion);
+	memcpy(header, c_traceMagic, sizeof(c_traceMagic));
+	memcpy(header + 4, &version, sizeof(version));
+	if (1 != fwrite(header, sizeof(header), 1, file))
+	{
+		fclose(file);
+		return nullptr;
+	}
+
+	PacketTraceWriter* trace = new PacketTraceWriter;
+	trace->file = file;
+	trace->quit.store(false);
+	trace->dropped.store(0);
+	trace->start = timestampCurrent();
+	trace->lastUs = 0;
+	trace->writer = std::thread(traceWriter, trace);
+	return trace;
+}
+
+void voice::packetTraceDestroy(PacketTraceWriter* trace)
+{
+	trace->quit.store(true, std::memory_order_release);
+	trace->writer.join();
+
+	fclose(trace->file);
+	delete trace;
+}
+
+bool voice::packetTraceRecord(PacketTraceWriter* trace, uint32_t peer
+	, const uint8_t* packet, uint32_t npacket, uint64_t arrivedAt)
+{
+	TraceSlot* slot = npacket <= c_packetTraceMaxPacket ? trace->queue.beginPush() : nullptr;
+	if (!slot)
+	{
+		trace->dropped.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	slot->arrivedAt = arrivedAt;
+	slot->peer = peer;
+	slot->npacket = npacket;
+	memcpy(slot->packet, packet, npacket);
+	trace->queue.commitPush();
+	return true;
+}
+
+uint32_t voice::packetTraceDropped(PacketTraceWriter* trace)
+{
+	return trace->dropped.load(std::memory_order_relaxed);
+}
+
+PacketTraceReader* voice::packetTraceOpen(const char* path)
+{
+	FILE* file = fopen(path, "rb");
+	if (!file)
+		return nullptr;
+
+	uint8_t header[c_traceHeaderSize];
+	if (1 != fread(header, sizeof(header), 1, file))
+	{
+		fclose(file);
+		return nullptr;
+	}
+
+	uint32_t version;
+	memcpy(&version, header + 4, sizeof(version));
+	version = endianFromLittle(version);
+
+	if (0 != memcmp(header, c_traceMagic, sizeof(c_traceMagic)) || version != c_packetTraceVersion)
+	{
+		fclose(file);
+		return nullptr;
+	}
+
+	PacketTraceReader* reader = new PacketTraceReader;
+	reader->file = file;
+	reader->arrivalUs = 0;
+	return reader;
+}
+
+void voice::packetTraceClose(PacketTraceReader* reader)
+{
+	fclose(reader->file);
+	delete reader;
+}
+
+bool voice::packetTraceRead(PacketTraceReader* reader, PacketTraceRecord* record)
+{
+	uint8_t header[c_traceRecordHeaderSize];
+	if (1 != fread(header, sizeof(header), 1, reader->file))
+		return false;
+
+	uint32_t delta;
+	uint32_t peer;
+	uint16_t size;
+	memcpy(&delta, header, sizeof(delta));
+	memcpy(&peer, header + 4, sizeof(peer));
+	memcpy(&size, header + 8, sizeof(size));
+	size = endianFromLittle(size);
+
+	// a record cut short ends the trace
+	if (size && 1 != fread(reader->packet, size, 1, reader->file))
+		return false;
+
+	reader->arrivalUs += endianFromLittle(delta);
+
+	record->arrivalUs = reader->arrivalUs;
+	record->peer = endianFromLittle(peer);
+	record->npacket = size;
+	record->packet = reader->packet;
+	return true;
+}
@@ -0,0 +1,89 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tiny/net/address.h>
+#include <tiny/net/resolve.h>
+#include <tiny/peer/relayserver.h>
+#include <tiny/platform.h>
+#include <tiny/sleep.h>
+
+using namespace tiny;
+using namespace tiny::net;
+using namespace tiny::peer;
+
+// usage: relayserver <public ip> <key> [port]
+int main(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		fprintf(stderr, "usage: relayserver <public ip> <key> [port]\n");
+		return -1;
+	}
+
+	const uint16_t port = static_cast<uint16_t>(argc > 3 ? atoi(argv[3]) : 3479);
+	const uint8_t* key = reinterpret_cast<const uint8_t*>(argv[2]);
+	const uint32_t nkey = static_cast<uint32_t>(strlen(argv[2]));
+
+	if (!platformStartup())
+		return -1;
+
+	Address publicAddr;
+	if (!resolveNumericHost(&publicAddr, argv[1]))
+	{
+		fprintf(stderr, "invalid public address %s\n", argv[1]);
+		platformShutdown();
+		return -1;
+	}
+
+	// any address of the public address' family
+	Address bindAddr;
+	memset(&bindAddr, 0, sizeof(bindAddr));
+	bindAddr.family = publicAddr.family;
+
+	IRelayServer* server = relayServerCreate(bindAddr, publicAddr, port, key, nkey);
+	if (!server)
+	{
+		fprintf(stderr, "failed to bind port %d\n", port);
+		platformShutdown();
+		return -1;
+	}
+
+	printf("relaying on port %d for %s\n", server->port(), argv[1]);
+
+	uint64_t last = 0;
+	for (;;)
+	{
+		sleep(1000);
+
+		const uint64_t current = server->packetsRelayed();
+		printf("%u allocations, %llu packets/s\n", server->allocations(), static_cast<unsigned long long>(current - last));
+		last = current;
+	}
+}
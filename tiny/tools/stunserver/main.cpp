@@ -0,0 +1,78 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <tiny/net/address.h>
+#include <tiny/peer/stunserver.h>
+#include <tiny/platform.h>
+#include <tiny/sleep.h>
+
+using namespace tiny;
+using namespace tiny::net;
+using namespace tiny::peer;
+
+// usage: stunserver [port] [threads]
+int main(int argc, char** argv)
+{
+	const uint16_t port = static_cast<uint16_t>(argc > 1 ? atoi(argv[1]) : 3478);
+	uint32_t nthreads = argc > 2 ? static_cast<uint32_t>(atoi(argv[2])) : std::thread::hardware_concurrency();
+	if (nthreads == 0)
+	{
+		nthreads = 1;
+	}
+
+	if (!platformStartup())
+		return -1;
+
+	// any IPv4 address
+	Address addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.family = AddressFamily::IPv4;
+
+	IStunServer* server = stunServerCreate(addr, port, nthreads);
+	if (!server)
+	{
+		fprintf(stderr, "failed to bind port %d\n", port);
+		platformShutdown();
+		return -1;
+	}
+
+	printf("serving STUN on port %d with %u threads\n", server->port(), nthreads);
+
+	uint64_t last = 0;
+	for (;;)
+	{
+		sleep(1000);
+
+		const uint64_t current = server->responsesSent();
+		printf("%llu responses/s\n", static_cast<unsigned long long>(current - last));
+		last = current;
+	}
+}
@@ -0,0 +1,294 @@
+/**
+ * Copyright 2011-2015 Matthew Endsley
+ * All rights reserved
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted providing that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING
+ * IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <map>
+#include <tiny/platform.h>
+#include <tiny/profile.h>
+#include <tiny/sleep.h>
+#include <tiny/time.h>
+#include <tiny/voice/engine.h>
+#include <tiny/voice/latency.h>
+#include <tiny/voice/source.h>
+#include <tiny/voice/trace.h>
+
+using namespace tiny;
+using namespace tiny::voice;
+
+static const uint32_t c_sampleRate = 48000;
+// audio played out of every source per tick
+static const uint64_t c_tickUs = 10000;
+static const uint32_t c_samplesPerTick = c_sampleRate / 100;
+
+namespace
+{
+	struct ReplaySource
+	{
+		Source source;
+		bool started; // has produced audio; silence before that isn't an underrun
+		uint64_t packets;
+		uint64_t underruns;
+		uint32_t maxQueued;
+	};
+
+	struct Replay
+	{
+		bool realtime;
+		uint64_t wallStart; // when the first packet was replayed
+		uint64_t traceStart; // arrival of the first packet, us
+		uint64_t processTicks;
+		uint64_t packets;
+		uint64_t bytes;
+		std::map<uint32_t, ReplaySource*> sources;
+	};
+}
+
+static double secondsSince(uint64_t start)
+{
+	return static_cast<double>(timestampCurrent() - start) / static_cast<double>(timestampFrequency());
+}
+
+// in realtime mode, wait until the trace time `traceUs' comes up
+static void waitUntil(const Replay& replay, uint64_t traceUs)
+{
+	if (!replay.realtime)
+		return;
+
+	for (;;)
+	{
+		const double ahead = static_cast<double>(traceUs - replay.traceStart) / 1e6 - secondsSince(replay.wallStart);
+		if (ahead <= 0.0)
+			break;
+
+		sleep(ahead > 0.002 ? static_cast<uint32_t>(ahead * 1000.0) - 1 : 0);
+	}
+}
+
+// consume one tick of audio from every source, as a render device would
+static void playout(Replay* replay)
+{
+	for (std::map<uint32_t, ReplaySource*>::iterator it = replay->sources.begin(), end = replay->sources.end(); it != end; ++it)
+	{
+		ReplaySource* rs = it->second;
+
+		const float* samples;
+		uint32_t available = rs->source.getSourceAudio(&samples);
+		if (available > rs->maxQueued)
+		{
+			rs->maxQueued = available;
+		}
+
+		if (available)
+		{
+			rs->started = true;
+		}
+
+		if (available < c_samplesPerTick)
+		{
+			if (rs->started)
+			{
+				++rs->underruns;
+			}
+		}
+		else
+		{
+			available = c_samplesPerTick;
+		}
+
+		rs->source.consumeSourceAudio(available);
+	}
+}
+
+static void writeFile(void* user, const char* p, uint32_t n)
+{
+	fwrite(p, 1, n, static_cast<FILE*>(user));
+}
+
+// usage: voicereplay <trace> [realtime] [profile.json]
+//
+// feeds the packets of a trace (see `packetTraceCreate') through a voice
+// engine, one source per peer, and plays 10ms of every source out per
+// 10ms of trace time. by default the trace is replayed as fast as
+// possible, which profiles the decode path; `realtime' keeps the
+// recorded timing so jitter buffer latency is measured as it was in the
+// field. if a profile path is given, the replay is exported there as a
+// chrome trace
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "usage: %s <trace> [realtime] [profile.json]\n", argv[0]);
+		return -1;
+	}
+
+	PacketTraceReader* reader = packetTraceOpen(argv[1]);
+	if (!reader)
+	{
+		fprintf(stderr, "failed to open trace `%s'\n", argv[1]);
+		return -1;
+	}
+
+	if (!platformStartup())
+		return -1;
+
+	const char* profilePath = nullptr;
+	Replay replay;
+	replay.realtime = false;
+	for (int ii = 2; ii < argc; ++ii)
+	{
+		if (0 == strcmp(argv[ii], "realtime"))
+		{
+			replay.realtime = true;
+		}
+		else
+		{
+			profilePath = argv[ii];
+		}
+	}
+
+	if (profilePath)
+	{
+		profileThreadName("replay");
+		profileEnable(true);
+	}
+
+	Engine engine(nullptr, c_sampleRate);
+	replay.processTicks = 0;
+	replay.packets = 0;
+	replay.bytes = 0;
+
+	uint64_t nextTickUs = 0;
+	uint64_t traceUs = 0;
+	replay.wallStart = timestampCurrent();
+	replay.traceStart = 0;
+
+	PacketTraceRecord record;
+	while (packetTraceRead(reader, &record))
+	{
+		// the first packet starts the playout clock. arrival times count
+		// from when the trace was started, not from the first packet
+		if (replay.packets == 0)
+		{
+			nextTickUs = record.arrivalUs;
+			traceUs = record.arrivalUs;
+			replay.traceStart = record.arrivalUs;
+			replay.wallStart = timestampCurrent();
+		}
+
+		while (nextTickUs <= record.arrivalUs)
+		{
+			waitUntil(replay, nextTickUs);
+			playout(&replay);
+			nextTickUs += c_tickUs;
+		}
+
+		ReplaySource*& rs = replay.sources[record.peer];
+		if (!rs)
+		{
+			rs = new ReplaySource;
+			rs->started = false;
+			rs->packets = 0;
+			rs->underruns = 0;
+			rs->maxQueued = 0;
+			engine.addSource(&rs->source);
+		}
+
+		waitUntil(replay, record.arrivalUs);
+
+		const uint64_t start = timestampCurrent();
+		engine.processPacket(&rs->source, record.packet, record.npacket, record.peer);
+		replay.processTicks += timestampCurrent() - start;
+
+		++rs->packets;
+		++replay.packets;
+		replay.bytes += record.npacket;
+		traceUs = record.arrivalUs;
+	}
+	packetTraceClose(reader);
+
+	const double wallSeconds = secondsSince(replay.wallStart);
+	const double traceSeconds = static_cast<double>(traceUs - replay.traceStart) / 1e6;
+	const double processSeconds = static_cast<double>(replay.processTicks) / static_cast<double>(timestampFrequency());
+
+	printf("%llu packets (%llu bytes) from %u peers over %.2fs of trace in %.2fs (%.1fx realtime)\n"
+		, static_cast<unsigned long long>(replay.packets)
+		, static_cast<unsigned long long>(replay.bytes)
+		, static_cast<uint32_t>(replay.sources.size())
+		, traceSeconds, wallSeconds
+		, wallSeconds > 0.0 ? traceSeconds / wallSeconds : 0.0);
+	printf("processPacket: %.2fus per packet\n"
+		, replay.packets ? processSeconds * 1e6 / static_cast<double>(replay.packets) : 0.0);
+
+	for (std::map<uint32_t, ReplaySource*>::iterator it = replay.sources.begin(), end = replay.sources.end(); it != end; ++it)
+	{
+		ReplaySource* rs = it->second;
+
+		LatencyStats stats;
+		rs->source.latencyStats(&stats);
+		const LatencyHistogram& decode = stats.stages[LatencyStage::Decode];
+		const LatencyHistogram& jitter = stats.stages[LatencyStage::JitterBuffer];
+
+		printf("peer %u: %llu packets, %llu underruns, max queued %.1fms, decode p50 %.1fus p99 %.1fus"
+			, it->first
+			, static_cast<unsigned long long>(rs->packets)
+			, static_cast<unsigned long long>(rs->underruns)
+			, rs->maxQueued * 1000.0 / c_sampleRate
+			, static_cast<double>(latencyPercentile(decode, 0.5f))
+			, static_cast<double>(latencyPercentile(decode, 0.99f)));
+
+		// queueing is only meaningful against the recorded timing
+		if (replay.realtime)
+		{
+			printf(", jitter buffer p50 %.2fms p99 %.2fms"
+				, latencyPercentile(jitter, 0.5f) / 1000.0
+				, latencyPercentile(jitter, 0.99f) / 1000.0);
+		}
+		printf("\n");
+
+		engine.removeSource(&rs->source);
+		delete rs;
+	}
+
+	if (profilePath)
+	{
+		profileEnable(false);
+
+		FILE* file = fopen(profilePath, "wb");
+		if (file)
+		{
+			profileExportChromeTrace(writeFile, file);
+			fclose(file);
+		}
+		else
+		{
+			fprintf(stderr, "failed to write profile `%s'\n", profilePath);
+		}
+	}
+
+	platformShutdown();
+}